@@ -1,6 +1,12 @@
+#include <math.h>
+#include <pthread.h>
 #include <string.h>
 
 #include <esp_log.h>
+#include <esp_timer.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 
 #include "bm1397.h"
 #include "bm1366.h"
@@ -9,206 +15,436 @@
 #include "bm1373.h"
 
 #include "asic.h"
+#include "asic_rx.h"
 #include "global_state.h"
 #include "mining.h"
 #include "device_config.h"
 #include "frequency_transition_bmXX.h"
+#include "job_interval.h"
+#include "result_ring.h"
+#include "utils.h"
 
 static const char *TAG = "asic";
 
+#define RESULT_BATCH_MAX 16 // frames decoded per wake-up before the consumer is signalled
+
+static const bm13xx_chip_t * const ASIC_CHIPS[] = {
+    [BM1397] = &BM1397_CHIP,
+    [BM1366] = &BM1366_CHIP,
+    [BM1368] = &BM1368_CHIP,
+    [BM1370] = &BM1370_CHIP,
+    [BM1373] = &BM1373_CHIP,
+};
+
+// Resolved once by ASIC_init, every other call goes straight to the BM13xx engine
+static const bm13xx_chip_t * asic_chip;
+
+// Share of the nonce space the chips search per job. Fixed: nothing narrows it,
+// the chip tuner only resizes the hash counting number for a new frequency.
+#define NONCE_SPACE_PERCENT 1.0
+static uint32_t active_version_mask = STRATUM_DEFAULT_VERSION_MASK;
+
+// fed by the decode tasks, read by the create jobs task
+static job_interval_t job_intervals[ASIC_CHAIN_COUNT];
+static pthread_mutex_t job_interval_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// decoded results, from ASIC_process_work() of each chain to ASIC_take_result()
+static result_ring_t result_rings[ASIC_CHAIN_COUNT];
+static SemaphoreHandle_t result_ready; // given by any chain
+static volatile uint32_t result_epoch; // bumped on every RX start, see ASIC_take_result()
+static uint32_t consumer_epoch;
+static uint8_t next_result_chain;      // consumer side only
+
+static uint8_t next_work_chain;        // ASIC_send_work() deals jobs out round robin
+
+uint16_t ASIC_get_chain_asic_count(GlobalState * GLOBAL_STATE)
+{
+    return GLOBAL_STATE->DEVICE_CONFIG.family.asic_count / ASIC_CHAIN_COUNT;
+}
+
 uint8_t ASIC_init(GlobalState * GLOBAL_STATE)
 {
-    ESP_LOGI(TAG, "Initializing %dx %s", GLOBAL_STATE->DEVICE_CONFIG.family.asic_count, GLOBAL_STATE->DEVICE_CONFIG.family.asic.name);
-    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
-        case BM1397:
-            return BM1397_init(GLOBAL_STATE);
-        case BM1366:
-            return BM1366_init(GLOBAL_STATE);
-        case BM1368:
-            return BM1368_init(GLOBAL_STATE);
-        case BM1370:
-            return BM1370_init(GLOBAL_STATE);
-        case BM1373:
-            return BM1373_init(GLOBAL_STATE);
-    }
-    ESP_LOGE(TAG, "Unknown ASIC id %d", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
-    return 0;
-}
-
-task_result * ASIC_process_work(GlobalState * GLOBAL_STATE)
-{
-    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
-        case BM1397:
-            return BM1397_process_work(GLOBAL_STATE);
-        case BM1366:
-            return BM1366_process_work(GLOBAL_STATE);
-        case BM1368:
-            return BM1368_process_work(GLOBAL_STATE);
-        case BM1370:
-            return BM1370_process_work(GLOBAL_STATE);
-        case BM1373:
-            return BM1373_process_work(GLOBAL_STATE);
-    }
-    ESP_LOGE(TAG, "Unknown ASIC id %d — cannot process work", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
-    return NULL;
-}
-
-int ASIC_set_max_baud(GlobalState * GLOBAL_STATE)
-{
-    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
-        case BM1397:
-            return BM1397_set_max_baud();
-        case BM1366:
-            return BM1366_set_max_baud();
-        case BM1368:
-            return BM1368_set_max_baud();
-        case BM1370:
-            return BM1370_set_max_baud();
-        case BM1373:
-            return BM1373_set_max_baud();
-    }
-    ESP_LOGE(TAG, "Unknown ASIC id %d — cannot set max baud", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
-    return 0;
+    uint16_t asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
+
+    ESP_LOGI(TAG, "Initializing %dx %s on %d chain(s)", asic_count, GLOBAL_STATE->DEVICE_CONFIG.family.asic.name, ASIC_CHAIN_COUNT);
+
+    Asic id = GLOBAL_STATE->DEVICE_CONFIG.family.asic.id;
+    if (id >= sizeof(ASIC_CHIPS) / sizeof(ASIC_CHIPS[0]) || ASIC_CHIPS[id] == NULL) {
+        ESP_LOGE(TAG, "Unknown ASIC id %d", id);
+        asic_chip = NULL;
+        return 0;
+    }
+    if (asic_count % ASIC_CHAIN_COUNT != 0) {
+        ESP_LOGE(TAG, "%d ASICs do not split evenly across %d chains", asic_count, ASIC_CHAIN_COUNT);
+        asic_chip = NULL;
+        return 0;
+    }
+
+    asic_chip = ASIC_CHIPS[id];
+    BM13XX_select_chip(asic_chip);
+    active_version_mask = STRATUM_DEFAULT_VERSION_MASK;
+    next_work_chain = 0;
+
+    pthread_mutex_lock(&job_interval_lock);
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        job_interval_init(&job_intervals[chain]);
+    }
+    pthread_mutex_unlock(&job_interval_lock);
+
+    // a chain that comes up short fails the whole init, the chip numbering assumes full chains
+    uint8_t chip_count = 0;
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        uint8_t chain_chip_count = BM13XX_init(GLOBAL_STATE, chain);
+        if (chain_chip_count == 0) {
+            ESP_LOGE(TAG, "Chain %d failed to initialize", chain);
+            return 0;
+        }
+        chip_count += chain_chip_count;
+    }
+    return chip_count;
+}
+
+static bool is_duplicate(const task_result * result)
+{
+    pthread_mutex_lock(&job_interval_lock);
+    bool duplicate = job_interval_result(&job_intervals[result->chain], result->job_id, result->nonce, result->rolled_version);
+    pthread_mutex_unlock(&job_interval_lock);
+
+    if (duplicate) {
+        // the pool would only reject it
+        ESP_LOGD(TAG, "Duplicate result for job %u/0x%02X, nonce %08lx", result->chain, result->job_id, (unsigned long)result->nonce);
+    }
+    return duplicate;
 }
 
-void ASIC_send_work(GlobalState * GLOBAL_STATE, bm_job * next_job)
+int ASIC_process_work(GlobalState * GLOBAL_STATE, uint8_t chain)
 {
-    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
-        case BM1397:
-            BM1397_send_work(GLOBAL_STATE, next_job);
-            break;
-        case BM1366:
-            BM1366_send_work(GLOBAL_STATE, next_job);
-            break;
-        case BM1368:
-            BM1368_send_work(GLOBAL_STATE, next_job);
-            break;
-        case BM1370:
-            BM1370_send_work(GLOBAL_STATE, next_job);
-            break;
-        case BM1373:
-            BM1373_send_work(GLOBAL_STATE, next_job);
-            break;
-        default:
-            ESP_LOGE(TAG, "Unknown ASIC id %d — cannot send work", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
+    if (asic_chip == NULL || result_ready == NULL) {
+        ESP_LOGE(TAG, "ASIC not initialized — cannot process work");
+        vTaskDelay(pdMS_TO_TICKS(100));
+        return 0;
+    }
+
+    result_ring_t * result_ring = &result_rings[chain];
+    uint8_t first_asic = chain * ASIC_get_chain_asic_count(GLOBAL_STATE);
+    task_result result;
+    int queued = 0;
+    uint32_t timeout_ms = ASIC_RX_TIMEOUT_MS;
+
+    // wait for the first frame, then take whatever arrived with it
+    for (int i = 0; i < RESULT_BATCH_MAX; i++) {
+        esp_err_t err = BM13XX_process_work(GLOBAL_STATE, chain, timeout_ms, &result);
+        if (err == ESP_FAIL) {
             break;
+        }
+        timeout_ms = 0;
+
+        if (err != ESP_OK) {
+            continue;
+        }
+        if (result.register_type == REGISTER_INVALID && is_duplicate(&result)) {
+            continue;
+        }
+
+        // chips are numbered across all chains from here on
+        result.asic_nr += first_asic;
+
+        uint32_t high_water = result_ring->stats.high_water;
+        if (!result_ring_push(result_ring, &result)) {
+            ESP_LOGW(TAG, "Chain %u result ring full, dropped a result (%lu so far)", chain, (unsigned long)result_ring->stats.overflows);
+            continue;
+        }
+        if (result_ring->stats.high_water > high_water && result_ring->stats.high_water >= RESULT_RING_SIZE / 2) {
+            ESP_LOGW(TAG, "Result validation falling behind: %lu of %d chain %u results waiting",
+                     (unsigned long)result_ring->stats.high_water, RESULT_RING_SIZE, chain);
+        }
+        queued++;
     }
+
+    if (queued > 0) {
+        xSemaphoreGive(result_ready);
+    }
+    return queued;
+}
+
+// Takes from the chains in turn so a busy chain cannot starve the others
+static bool pop_result(task_result * result)
+{
+    for (int i = 0; i < ASIC_CHAIN_COUNT; i++) {
+        uint8_t chain = (next_result_chain + i) % ASIC_CHAIN_COUNT;
+        if (result_ring_pop(&result_rings[chain], result)) {
+            next_result_chain = (chain + 1) % ASIC_CHAIN_COUNT;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ASIC_take_result(GlobalState * GLOBAL_STATE, task_result * result, uint32_t timeout_ms)
+{
+    if (result_ready == NULL) {
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+        return false;
+    }
+
+    // results decoded before a re-init refer to jobs that are gone
+    if (consumer_epoch != result_epoch) {
+        consumer_epoch = result_epoch;
+        for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+            result_ring_discard(&result_rings[chain]);
+        }
+    }
+
+    while (!pop_result(result)) {
+        if (xSemaphoreTake(result_ready, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ASIC_get_result_stats(GlobalState * GLOBAL_STATE, result_ring_stats_t * stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        result_ring_stats_t chain_stats;
+        result_ring_get_stats(&result_rings[chain], &chain_stats);
+        stats->pushed += chain_stats.pushed;
+        stats->overflows += chain_stats.overflows;
+        if (chain_stats.high_water > stats->high_water) {
+            stats->high_water = chain_stats.high_water;
+        }
+    }
+}
+
+esp_err_t ASIC_start_rx(GlobalState * GLOBAL_STATE)
+{
+    if (asic_chip == NULL) {
+        ESP_LOGE(TAG, "ASIC not initialized — cannot start RX");
+        return ESP_FAIL;
+    }
+    if (result_ready == NULL) {
+        result_ready = xSemaphoreCreateBinary();
+        if (result_ready == NULL) {
+            ESP_LOGE(TAG, "Failed to create the result semaphore");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    result_epoch++;
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        esp_err_t err = asic_rx_start(chain, asic_chip->result_length);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+void ASIC_stop_rx(GlobalState * GLOBAL_STATE)
+{
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        asic_rx_stop(chain);
+    }
+}
+
+int ASIC_negotiate_baud(GlobalState * GLOBAL_STATE)
+{
+    if (asic_chip == NULL) {
+        ESP_LOGE(TAG, "ASIC not initialized — cannot negotiate baud");
+        return 0;
+    }
+
+    // each chain settles on its own rate, report the slowest
+    int baud = 0;
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        int chain_baud = BM13XX_negotiate_baud(chain, ASIC_get_chain_asic_count(GLOBAL_STATE));
+        if (chain == 0 || chain_baud < baud) {
+            baud = chain_baud;
+        }
+    }
+    return baud;
+}
+
+void ASIC_check_baud(GlobalState * GLOBAL_STATE)
+{
+    if (asic_chip == NULL) {
+        return;
+    }
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        BM13XX_check_baud(chain);
+    }
+}
+
+void ASIC_send_work(GlobalState * GLOBAL_STATE, bm_job * next_job)
+{
+    if (asic_chip == NULL) {
+        ESP_LOGE(TAG, "ASIC not initialized — cannot send work");
+        return;
+    }
+    // only the create jobs task sends work
+    uint8_t chain = next_work_chain;
+    next_work_chain = (chain + 1) % ASIC_CHAIN_COUNT;
+    BM13XX_send_work(GLOBAL_STATE, chain, next_job);
 }
 
 void ASIC_set_version_mask(GlobalState * GLOBAL_STATE, uint32_t mask)
 {
-    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
-        case BM1397:
-            BM1397_set_version_mask(mask);
-            break;
-        case BM1366:
-            BM1366_set_version_mask(mask);
-            break;
-        case BM1368:
-            BM1368_set_version_mask(mask);
-            break;
-        case BM1370:
-            BM1370_set_version_mask(mask);
-            break;
-        case BM1373:
-            BM1373_set_version_mask(mask);
-            break;
-        default:
-            ESP_LOGE(TAG, "Unknown ASIC id %d — cannot set version mask", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
-            break;
+    if (asic_chip == NULL) {
+        ESP_LOGE(TAG, "ASIC not initialized — cannot set version mask");
+        return;
+    }
+    active_version_mask = mask;
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        BM13XX_set_version_mask(chain, mask);
+    }
+}
+
+static void frequency_ramp_done(GlobalState * GLOBAL_STATE)
+{
+    ASIC_set_nonce_space(GLOBAL_STATE);
+}
+
+// The ramp steps every chain together
+static float send_hash_frequency(float target_freq)
+{
+    float frequency = 0;
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        frequency = BM13XX_send_hash_frequency(chain, target_freq);
     }
+    return frequency;
 }
 
 void ASIC_set_frequency(GlobalState * GLOBAL_STATE)
 {
-    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
-        case BM1397:
-            do_frequency_transition(GLOBAL_STATE, BM1397_send_hash_frequency);
-            return;
-        case BM1366:
-            do_frequency_transition(GLOBAL_STATE, BM1366_send_hash_frequency);
-            return;
-        case BM1368:
-            do_frequency_transition(GLOBAL_STATE, BM1368_send_hash_frequency);
-            return;
-        case BM1370:
-            do_frequency_transition(GLOBAL_STATE, BM1370_send_hash_frequency);
-            return;
-        case BM1373:
-            do_frequency_transition(GLOBAL_STATE, BM1373_send_hash_frequency);
-            return;
-    }
-    ESP_LOGE(TAG, "Unknown ASIC id %d — cannot set frequency", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
+    if (asic_chip == NULL) {
+        ESP_LOGE(TAG, "ASIC not initialized — cannot set frequency");
+        return;
+    }
+    // the nonce space follows the frequency the ramp actually lands on
+    frequency_transition_start(GLOBAL_STATE, send_hash_frequency, frequency_ramp_done);
+}
+
+void ASIC_wait_frequency(GlobalState * GLOBAL_STATE)
+{
+    frequency_transition_wait(FREQUENCY_TRANSITION_WAIT_FOREVER);
+}
+
+bool ASIC_supports_chip_frequency(GlobalState * GLOBAL_STATE)
+{
+    if (asic_chip == NULL || GLOBAL_STATE->DEVICE_CONFIG.family.asic_count <= 1) {
+        return false;
+    }
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        if (!BM13XX_supports_chip_frequency(chain)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+float ASIC_set_chip_frequency(GlobalState * GLOBAL_STATE, uint8_t asic_nr, float frequency)
+{
+    if (!ASIC_supports_chip_frequency(GLOBAL_STATE)) {
+        ESP_LOGE(TAG, "Per-chip frequency not supported");
+        return 0;
+    }
+    uint16_t chain_asic_count = ASIC_get_chain_asic_count(GLOBAL_STATE);
+    return BM13XX_send_chip_frequency(asic_nr / chain_asic_count, asic_nr % chain_asic_count, frequency);
 }
 
 void ASIC_set_nonce_space(GlobalState * GLOBAL_STATE)
 {
-    float nonce_percent = 1.0;
     int cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.core_count;
-    int asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
-    float frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency;
-
-    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
-        case BM1397:
-            return;
-        case BM1366:
-            BM1366_set_nonce_space(nonce_percent, frequency, asic_count, cores);
-            return;
-        case BM1368:
-            BM1368_set_nonce_space(nonce_percent, frequency, asic_count, cores);
-            return;
-        case BM1370:
-            BM1370_set_nonce_space(nonce_percent, frequency, asic_count, cores);
-            return;
-        case BM1373:
-            BM1373_set_nonce_space(nonce_percent, frequency, asic_count, cores);
-            return;
-    }
-    ESP_LOGE(TAG, "Unknown ASIC id %d — cannot set nonce space", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
+    int asic_count = ASIC_get_chain_asic_count(GLOBAL_STATE);
+    // the nonce space is chain wide, size it for the fastest chip
+    float frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency + GLOBAL_STATE->POWER_MANAGEMENT_MODULE.max_chip_offset;
+
+    if (asic_chip == NULL) {
+        ESP_LOGE(TAG, "ASIC not initialized — cannot set nonce space");
+        return;
+    }
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        BM13XX_set_nonce_space(chain, NONCE_SPACE_PERCENT, frequency, asic_count, cores);
+    }
+}
+
+// Versions one job covers: rolled on-chip, or the midstates of a job packet
+static uint32_t job_version_size(void)
+{
+    if (asic_chip->job_layout == BM13XX_JOB_MIDSTATES) {
+        return 4;
+    }
+    // the chips roll version bits 13-28, see BM13XX_set_version_mask()
+    return 1u << __builtin_popcount((active_version_mask >> 13) & 0xFFFF);
 }
 
 double ASIC_get_asic_job_frequency_ms(GlobalState * GLOBAL_STATE)
 {
-    float freq = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
-    int cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.core_count;
-    int small_cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.small_core_count;
-    int asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+    int asic_count = ASIC_get_chain_asic_count(GLOBAL_STATE);
     int asic_default_timeout_divided = GLOBAL_STATE->DEVICE_CONFIG.family.asic.default_asic_timeout / _next_power_of_two(asic_count);
 
-    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
-        case BM1397:
-            // no version-rolling so same Nonce Space is splitted between Big Cores
-            return calculate_bm_timeout_ms(freq, asic_count, small_cores, cores, 4, 1.0, asic_default_timeout_divided);
-        case BM1366:
-        case BM1368:
-        case BM1370:
-        case BM1373:
-            return asic_default_timeout_divided;
+    if (asic_chip == NULL) {
+        ESP_LOGE(TAG, "ASIC not initialized — cannot compute job frequency");
+        return 500;
     }
-    ESP_LOGE(TAG, "Unknown ASIC id %d — cannot compute job frequency", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
-    return 500;
+
+    // the live frequency, the target until the first ramp step landed
+    float frequency = power_management->actual_frequency > 0 ? power_management->actual_frequency : power_management->frequency_value;
+
+    job_interval_chain_t chain = {
+        // the fastest chip runs out of work first
+        .frequency_mhz = frequency + power_management->max_chip_offset,
+        .asic_count = asic_count,
+        .cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.core_count,
+        .small_cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.small_core_count,
+        .version_size = job_version_size(),
+        .nonce_percent = NONCE_SPACE_PERCENT,
+    };
+    double model_ms = job_interval_model_ms(&chain);
+
+    // a chip rolling versions takes minutes to run dry, the default keeps its work fresh
+    double cap_ms = asic_chip->job_layout == BM13XX_JOB_MIDSTATES ? INFINITY : asic_default_timeout_divided;
+
+    // nonces at the chip difficulty the chain should return per second
+    double expected_nonces_per_s = frequency * 1e6 * chain.small_cores * asic_count /
+                                   (GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty * NONCE_SPACE);
+
+    // every chain is the same model, each corrected by what it returns
+    double interval_ms = INFINITY;
+    int64_t now_us = esp_timer_get_time();
+
+    pthread_mutex_lock(&job_interval_lock);
+    for (int c = 0; c < ASIC_CHAIN_COUNT; c++) {
+        job_interval_t * job_interval = &job_intervals[c];
+        if (power_management->frequency_ramping) {
+            // the expected rate moves under the window, count from where the ramp lands
+            job_interval->window_start_us = 0;
+        }
+        if (job_interval_update(job_interval, model_ms, cap_ms, expected_nonces_per_s, now_us)) {
+            ESP_LOGI(TAG, "Chain %d job interval correction %.2f, %.1f ms of %.1f ms modeled", c, job_interval->correction,
+                     job_interval_ms(job_interval, model_ms, cap_ms), model_ms);
+        }
+        interval_ms = fmin(interval_ms, job_interval_ms(job_interval, model_ms, cap_ms));
+    }
+    pthread_mutex_unlock(&job_interval_lock);
+
+    if (isinf(interval_ms)) {
+        interval_ms = asic_default_timeout_divided;
+    }
+
+    // jobs are dealt out round robin, each chain wants one per interval
+    return interval_ms / ASIC_CHAIN_COUNT;
 }
 
 void ASIC_read_registers(GlobalState * GLOBAL_STATE)
 {
-    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
-        case BM1397:
-            BM1397_read_registers();
-            break;
-        case BM1366:
-            BM1366_read_registers();
-            break;
-        case BM1368:
-            BM1368_read_registers();
-            break;
-        case BM1370:
-            BM1370_read_registers();
-            break;
-        case BM1373:
-            BM1373_read_registers();
-            break;
-        default:
-            ESP_LOGE(TAG, "Unknown ASIC id %d — cannot read registers", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
-            break;
+    if (asic_chip == NULL) {
+        ESP_LOGE(TAG, "ASIC not initialized — cannot read registers");
+        return;
+    }
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        BM13XX_read_registers(chain);
     }
 }
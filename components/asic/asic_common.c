@@ -7,10 +7,14 @@
 #include "serial.h"
 #include "esp_log.h"
 #include "crc.h"
-#include "esp_timer.h"
 
 #define PREAMBLE 0xAA55
 
+#define CHIP_ID_TIMEOUT_MS 1000
+// once the expected chips have answered, only wait long enough for an extra
+// chip's answer to follow, it arrives right behind the others
+#define CHIP_ID_EXTRA_TIMEOUT_MS 20
+
 static const char * TAG = "common";
 static char asic_chain_error[96];
 
@@ -79,7 +83,7 @@ int _next_power_of_two(int num)
     return power;
 }
 
-int count_asic_chips_with_id_alias(uint16_t asic_count, uint16_t chip_id, uint16_t chip_id_alias, int chip_id_response_length)
+int count_asic_chips_with_id_alias(uint8_t chain, uint16_t asic_count, uint16_t chip_id, uint16_t chip_id_alias, int chip_id_response_length)
 {
     uint8_t buffer[11] = {0};
 
@@ -87,7 +91,8 @@ int count_asic_chips_with_id_alias(uint16_t asic_count, uint16_t chip_id, uint16
 
     int chip_counter = 0;
     while (true) {
-        int received = SERIAL_rx(buffer, chip_id_response_length, 1000);
+        uint16_t timeout_ms = chip_counter < asic_count ? CHIP_ID_TIMEOUT_MS : CHIP_ID_EXTRA_TIMEOUT_MS;
+        int received = SERIAL_rx(chain, buffer, chip_id_response_length, timeout_ms);
         if (received == 0) break;
 
         if (received == -1) {
@@ -131,14 +136,16 @@ int count_asic_chips_with_id_alias(uint16_t asic_count, uint16_t chip_id, uint16
     }    
     
     if (chip_counter != asic_count) {
-        ESP_LOGE(TAG, "%i chip(s) detected on the chain, expected %i", chip_counter, asic_count);
+        ESP_LOGE(TAG, "%i chip(s) detected on chain %u, expected %i", chip_counter, chain, asic_count);
 
+        // chips are numbered across all chains
+        int first = chain * asic_count;
         char asic_indices[64];
         if (chip_counter < asic_count) {
-            format_asic_indices(asic_indices, sizeof(asic_indices), chip_counter, asic_count);
+            format_asic_indices(asic_indices, sizeof(asic_indices), first + chip_counter, first + asic_count);
             snprintf(asic_chain_error, sizeof(asic_chain_error), "ASIC %s not found", asic_indices);
         } else {
-            format_asic_indices(asic_indices, sizeof(asic_indices), asic_count, chip_counter);
+            format_asic_indices(asic_indices, sizeof(asic_indices), first + asic_count, first + chip_counter);
             snprintf(asic_chain_error, sizeof(asic_chain_error), "Unexpected ASIC %s detected", asic_indices);
         }
         ESP_LOGE(TAG, "%s", asic_chain_error);
@@ -149,51 +156,66 @@ int count_asic_chips_with_id_alias(uint16_t asic_count, uint16_t chip_id, uint16
     return chip_counter;
 }
 
-int count_asic_chips(uint16_t asic_count, uint16_t chip_id, int chip_id_response_length)
+int count_asic_chips(uint8_t chain, uint16_t asic_count, uint16_t chip_id, int chip_id_response_length)
 {
-    return count_asic_chips_with_id_alias(asic_count, chip_id, chip_id, chip_id_response_length);
+    return count_asic_chips_with_id_alias(chain, asic_count, chip_id, chip_id, chip_id_response_length);
 }
 
-esp_err_t receive_work(uint8_t * buffer, int buffer_size, uint64_t *out_timestamp_us)
+static void parser_drop(asic_frame_parser_t *parser, uint16_t count)
 {
-    int received = SERIAL_rx(buffer, buffer_size, 10000);
-    if (out_timestamp_us) {
-        *out_timestamp_us = esp_timer_get_time();
-    }
+    memmove(parser->buf, parser->buf + count, parser->len - count);
+    parser->len -= count;
+    parser->stats.bytes_dropped += count;
+}
 
-    if (received < 0) {
-        ESP_LOGE(TAG, "UART error in serial RX");
-        return ESP_FAIL;
-    }
+bool asic_frame_parser_next(asic_frame_parser_t *parser, uint8_t *frame, int frame_size)
+{
+    bool resyncing = false;
+
+    while (parser->len >= 2) {
+        uint16_t preamble = (parser->buf[0] << 8) | parser->buf[1];
+        if (preamble != PREAMBLE) {
+            // slide to the next possible preamble start
+            uint16_t skip = 1;
+            while (skip < parser->len && parser->buf[skip] != (PREAMBLE >> 8)) {
+                skip++;
+            }
+            if (!resyncing) {
+                parser->stats.resyncs++;
+                resyncing = true;
+            }
+            parser_drop(parser, skip);
+            continue;
+        }
 
-    if (received == 0) {
-        ESP_LOGD(TAG, "UART timeout in serial RX");
-        return ESP_FAIL;
-    }
+        if (parser->len < frame_size) {
+            return false;
+        }
 
-    if (received != buffer_size) {
-        ESP_LOGE(TAG, "Invalid response length %i", received);
-        ESP_LOG_BUFFER_HEX(TAG, buffer, received);
-        SERIAL_clear_buffer();
-        return ESP_FAIL;
-    }
+        if (crc5(parser->buf + 2, frame_size - 2) != 0) {
+            // a preamble inside noise, or a corrupted frame: skip one byte and rescan
+            parser->stats.crc_errors++;
+            if (!resyncing) {
+                parser->stats.resyncs++;
+                resyncing = true;
+            }
+            parser_drop(parser, 1);
+            continue;
+        }
 
-    uint16_t received_preamble = (buffer[0] << 8) | buffer[1];
-    if (received_preamble != PREAMBLE) {
-        ESP_LOGE(TAG, "Preamble mismatch: got 0x%04x, expected 0x%04x", received_preamble, PREAMBLE);
-        ESP_LOG_BUFFER_HEX(TAG, buffer, received);
-        SERIAL_clear_buffer();
-        return ESP_FAIL;
+        memcpy(frame, parser->buf, frame_size);
+        memmove(parser->buf, parser->buf + frame_size, parser->len - frame_size);
+        parser->len -= frame_size;
+        parser->stats.frames++;
+        return true;
     }
 
-    if (crc5(buffer + 2, buffer_size - 2) != 0) {
-        ESP_LOGE(TAG, "Checksum failed on response");        
-        ESP_LOG_BUFFER_HEX(TAG, buffer, received);
-        SERIAL_clear_buffer();
-        return ESP_FAIL;
+    // a lone byte can only be kept if it may start a preamble
+    if (parser->len == 1 && parser->buf[0] != (PREAMBLE >> 8)) {
+        parser_drop(parser, 1);
     }
 
-    return ESP_OK;
+    return false;
 }
 
 void get_difficulty_mask(double difficulty, uint8_t *job_difficulty_mask)
@@ -252,3 +274,15 @@ double calculate_bm_timeout_ms(float frequency_mhz, size_t asic_count, size_t sm
 
     return (double)timeout_percent * fullspace_timeout_ms;
 }
+
+// The temperature sensor register carries a finished conversion in its low 16 bits
+// with bit 31 set, conversion taken from the NerdAxe firmware
+bool asic_decode_temperature(uint32_t value, float *temp_c)
+{
+    if (!(value & 0x80000000)) {
+        return false;
+    }
+
+    *temp_c = (float)(value & 0xFFFF) * 0.171342f - 299.5144f;
+    return true;
+}
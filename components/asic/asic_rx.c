@@ -0,0 +1,245 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "asic_rx.h"
+#include "serial.h"
+
+#define RX_TASK_PRIORITY 21 // above create_jobs_task so arrival stamps are not delayed by job building
+#define RX_TASK_STACK_SIZE 3072
+#define RX_IDLE_WAIT_MS 1000
+
+static const char * TAG = "asic_rx";
+
+typedef struct
+{
+    uint8_t chain;
+    asic_rx_ring_t ring;
+    asic_frame_parser_t parser;
+    uint32_t ring_overflows;
+    uint32_t uart_overflows;
+
+    TaskHandle_t task_handle;
+    SemaphoreHandle_t lock;  // held by the RX task while it owns the UART
+    SemaphoreHandle_t ready; // given whenever frames were pushed
+    volatile bool running;
+    volatile int frame_size;
+
+    // bumped on every start so the consumer throws away frames from before a re-init
+    volatile uint32_t epoch;
+    uint32_t consumer_epoch;
+} asic_rx_chain_t;
+
+static asic_rx_chain_t chains[ASIC_CHAIN_COUNT];
+
+bool asic_rx_ring_push(asic_rx_ring_t *ring, const uint8_t *frame, int frame_size, uint64_t timestamp_us)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail >= ASIC_RX_RING_SIZE || frame_size > ASIC_RX_FRAME_MAX) {
+        return false;
+    }
+
+    asic_rx_frame_t *slot = &ring->slots[head & (ASIC_RX_RING_SIZE - 1)];
+    memcpy(slot->frame, frame, frame_size);
+    slot->timestamp_us = timestamp_us;
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool asic_rx_ring_pop(asic_rx_ring_t *ring, uint8_t *frame, int frame_size, uint64_t *timestamp_us)
+{
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail || frame_size > ASIC_RX_FRAME_MAX) {
+        return false;
+    }
+
+    const asic_rx_frame_t *slot = &ring->slots[tail & (ASIC_RX_RING_SIZE - 1)];
+    memcpy(frame, slot->frame, frame_size);
+    if (timestamp_us) {
+        *timestamp_us = slot->timestamp_us;
+    }
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// Consumer side only
+void asic_rx_ring_discard(asic_rx_ring_t *ring)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+}
+
+unsigned asic_rx_ring_count(asic_rx_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire) - atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+static void rx_read_frames(asic_rx_chain_t *rx, int available, uint64_t timestamp_us)
+{
+    asic_frame_parser_t *parser = &rx->parser;
+    uint8_t frame[ASIC_RX_FRAME_MAX];
+    bool pushed = false;
+    asic_rx_stats_t before = parser->stats;
+
+    while (available > 0) {
+        int space = ASIC_RX_BUFFER_SIZE - parser->len;
+        int received = SERIAL_rx(rx->chain, parser->buf + parser->len, available < space ? available : space, 0);
+        if (received <= 0) {
+            break;
+        }
+        parser->len += received;
+        available -= received;
+
+        // every frame completed by this interrupt shares its arrival time
+        while (asic_frame_parser_next(parser, frame, rx->frame_size)) {
+            if (asic_rx_ring_push(&rx->ring, frame, rx->frame_size, timestamp_us)) {
+                pushed = true;
+            } else {
+                rx->ring_overflows++;
+            }
+        }
+    }
+
+    if (parser->stats.resyncs != before.resyncs) {
+        ESP_LOGW(TAG, "Resynchronized chain %u RX stream: %lu bytes dropped, %lu CRC errors so far", rx->chain,
+                 (unsigned long)parser->stats.bytes_dropped, (unsigned long)parser->stats.crc_errors);
+    }
+
+    if (pushed) {
+        xSemaphoreGive(rx->ready);
+    }
+}
+
+static void asic_rx_task(void *pvParameters)
+{
+    asic_rx_chain_t *rx = pvParameters;
+
+    while (1) {
+        int available = SERIAL_wait_rx(rx->chain, RX_IDLE_WAIT_MS);
+        // taken right after the UART interrupt hands over, not after a blocking read returns
+        uint64_t timestamp_us = esp_timer_get_time();
+
+        if (available == 0) {
+            continue;
+        }
+
+        xSemaphoreTake(rx->lock, portMAX_DELAY);
+
+        // while stopped the init code reads the UART directly
+        if (rx->running) {
+            if (available < 0) {
+                rx->uart_overflows++;
+                ESP_LOGW(TAG, "Chain %u UART RX overflow, flushing", rx->chain);
+                SERIAL_clear_buffer(rx->chain);
+                rx->parser.stats.bytes_dropped += rx->parser.len;
+                rx->parser.len = 0;
+            } else {
+                rx_read_frames(rx, available, timestamp_us);
+            }
+        }
+
+        xSemaphoreGive(rx->lock);
+    }
+}
+
+esp_err_t asic_rx_start(uint8_t chain, int frame_size)
+{
+    asic_rx_chain_t *rx = &chains[chain];
+
+    if (frame_size > ASIC_RX_FRAME_MAX) {
+        ESP_LOGE(TAG, "Response length %i exceeds the RX frame size", frame_size);
+        return ESP_FAIL;
+    }
+
+    if (rx->task_handle == NULL) {
+        rx->chain = chain;
+        rx->lock = xSemaphoreCreateMutex();
+        rx->ready = xSemaphoreCreateBinary();
+        if (rx->lock == NULL || rx->ready == NULL) {
+            ESP_LOGE(TAG, "Failed to create RX semaphores");
+            return ESP_ERR_NO_MEM;
+        }
+        if (xTaskCreate(asic_rx_task, "asic rx", RX_TASK_STACK_SIZE, rx, RX_TASK_PRIORITY, &rx->task_handle) != pdPASS) {
+            ESP_LOGE(TAG, "Error creating asic rx task");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(rx->lock, portMAX_DELAY);
+    rx->parser.len = 0;
+    rx->frame_size = frame_size;
+    rx->epoch++;
+    rx->running = true;
+    xSemaphoreGive(rx->lock);
+
+    return ESP_OK;
+}
+
+void asic_rx_stop(uint8_t chain)
+{
+    asic_rx_chain_t *rx = &chains[chain];
+
+    if (rx->lock == NULL) {
+        return;
+    }
+
+    // once the lock has been cycled the RX task will not touch the UART again
+    xSemaphoreTake(rx->lock, portMAX_DELAY);
+    rx->running = false;
+    xSemaphoreGive(rx->lock);
+
+    // wake a consumer still blocked on the old session so it cannot eat frames meant for init
+    xSemaphoreGive(rx->ready);
+}
+
+esp_err_t asic_rx_receive(uint8_t chain, uint8_t *buffer, int buffer_size, uint64_t *out_timestamp_us, uint32_t timeout_ms)
+{
+    asic_rx_chain_t *rx = &chains[chain];
+
+    if (rx->ready == NULL || buffer_size != rx->frame_size) {
+        ESP_LOGE(TAG, "Chain %u RX not started for %i byte responses", chain, buffer_size);
+        vTaskDelay(pdMS_TO_TICKS(100));
+        return ESP_FAIL;
+    }
+
+    if (rx->consumer_epoch != rx->epoch) {
+        rx->consumer_epoch = rx->epoch;
+        asic_rx_ring_discard(&rx->ring);
+    }
+
+    while (!asic_rx_ring_pop(&rx->ring, buffer, buffer_size, out_timestamp_us)) {
+        if (!rx->running) {
+            return ESP_FAIL;
+        }
+        if (xSemaphoreTake(rx->ready, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+            ESP_LOGD(TAG, "UART timeout in serial RX");
+            return ESP_FAIL;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t receive_work(uint8_t chain, uint8_t *buffer, int buffer_size, uint64_t *out_timestamp_us)
+{
+    return asic_rx_receive(chain, buffer, buffer_size, out_timestamp_us, ASIC_RX_TIMEOUT_MS);
+}
+
+void get_receive_work_stats(uint8_t chain, asic_rx_stats_t *stats)
+{
+    asic_rx_chain_t *rx = &chains[chain];
+
+    *stats = rx->parser.stats;
+    stats->ring_overflows = rx->ring_overflows;
+    stats->uart_overflows = rx->uart_overflows;
+}
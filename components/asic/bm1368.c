@@ -1,39 +1,18 @@
 #include "bm1368.h"
 
-#include "crc.h"
 #include "global_state.h"
 #include "mining.h"
-#include "serial.h"
 #include "utils.h"
 
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "frequency_transition_bmXX.h"
-#include "pll.h"
 
-#include <math.h>
 #include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <arpa/inet.h>
 
 #define BM1368_CHIP_ID 0x1368
 #define BM1368_CHIP_ID_RESPONSE_LENGTH 11
 
-#define TYPE_JOB 0x20
-#define TYPE_CMD 0x40
-
-#define GROUP_SINGLE 0x00
-#define GROUP_ALL 0x10
-
-#define CMD_SETADDRESS 0x00
-#define CMD_WRITE 0x01
-#define CMD_READ 0x02
-#define CMD_INACTIVE 0x03
-
-#define MISC_CONTROL 0x18
 #define FAST_UART_CONFIGURATION 0x28
 
 static const register_type_t REGISTER_MAP[] = {
@@ -42,306 +21,120 @@ static const register_type_t REGISTER_MAP[] = {
     [0x89] = REGISTER_DOMAIN_1_COUNT,
     [0x8A] = REGISTER_DOMAIN_2_COUNT,
     [0x8B] = REGISTER_DOMAIN_3_COUNT,
-    [0x8C] = REGISTER_TOTAL_COUNT
+    [0x8C] = REGISTER_TOTAL_COUNT,
+    [0xB4] = REGISTER_TEMPERATURE
 };
 
-typedef struct __attribute__((__packed__))
-{
-    uint32_t nonce;                   // 2-5
-    uint8_t midstate_num;             // 6
-    uint8_t id;                       // 7
-    uint16_t version;                 // 8-9
-} bm1368_asic_result_job_t;
-
-typedef struct __attribute__((__packed__))
-{
-    uint32_t value;                   // 2-5
-    uint8_t asic_address;             // 6
-    uint8_t register_address;         // 7
-    uint16_t                  : 16;   // 8-9
-} bm1368_asic_result_cmd_t;
-
-typedef struct __attribute__((__packed__))
-{
-    uint16_t preamble;                // 0-1
-    union {
-        bm1368_asic_result_job_t job; // 2-9
-        bm1368_asic_result_cmd_t cmd; // 2-9
-    };
-    uint8_t crc             : 5;      // 10:0-5
-    uint8_t                 : 2;      // 10:6-7
-    uint8_t is_job_response : 1;      // 10:8
-} bm1368_asic_result_t;
-
 static const char * TAG = "bm1368";
 
-static task_result result;
-
-static int address_interval;
-
-static void _send_BM1368(uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
-{
-    packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
-    uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
-
-    uint8_t buf[total_length];
-
-    buf[0] = 0x55;
-    buf[1] = 0xAA;
-    buf[2] = header;
-    buf[3] = (packet_type == JOB_PACKET) ? (data_len + 4) : (data_len + 3);
-    memcpy(buf + 4, data, data_len);
-
-    if (packet_type == JOB_PACKET) {
-        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
-        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
-        buf[5 + data_len] = crc16_total & 0xFF;
-    } else {
-        buf[4 + data_len] = crc5(buf + 2, data_len + 2);
-    }
-
-    SERIAL_send(buf, total_length, debug);
-}
-
-
-static void _send_chain_inactive(void)
-{
-    unsigned char read_address[2] = {0x00, 0x00};
-    _send_BM1368((TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1368_SERIALTX_DEBUG);
-}
-
-static void _set_chip_address(uint8_t chipAddr)
-{
-    unsigned char read_address[2] = {chipAddr, 0x00};
-    _send_BM1368((TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1368_SERIALTX_DEBUG);
-}
-
-void BM1368_set_version_mask(uint32_t version_mask) 
-{
-    int versions_to_roll = version_mask >> 13;
-    uint8_t version_byte0 = (versions_to_roll >> 8);
-    uint8_t version_byte1 = (versions_to_roll & 0xFF); 
-    uint8_t version_cmd[] = {0x00, 0xA4, 0x90, 0x00, version_byte0, version_byte1};
-    _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1368_SERIALTX_DEBUG);
-}
-
-void BM1368_set_hash_counting_number(uint32_t hcn) {
-    uint8_t set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x00, 0x00};
-    set_10_hash_counting[2] = (hcn >> 24) & 0xFF;
-    set_10_hash_counting[3] = (hcn >> 16) & 0xFF;
-    set_10_hash_counting[4] = (hcn >> 8) & 0xFF;
-    set_10_hash_counting[5] = hcn & 0xFF;
-    _send_BM1368((TYPE_CMD | GROUP_ALL | CMD_WRITE), set_10_hash_counting, 6, BM1368_SERIALTX_DEBUG);
-}
-
-void BM1368_set_nonce_space(double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores) 
-{   
-    int cores_up = _next_power_of_two(cores);
-    int asic_count_up =  _next_power_of_two(asic_count);
-
-    // HCN hash counting number (the size of the nonce space)
-    float hcn_space = (float)NONCE_SPACE / cores_up / asic_count_up;
-    double hcn_max = hcn_space * (double)FREQ_MULT / frequency * 0.5f; 
-    double hcn_frac = nonce_percent * hcn_max;
-    uint32_t hcn_register_value = (uint32_t)hcn_frac;
+static const bm13xx_register_write_t CHAIN_SETUP[] = {
+    {0xA8, 0x00070000},
+    {0x18, 0xFF0FC100},
+    {0x3C, 0x80008B00},
+    {0x3C, 0x80008018},
+    {0x14, 0x000000FF},
+    {0x54, 0x00000003}, //Analog Mux
+    {0x58, 0x02111111}
+};
 
-    BM1368_set_hash_counting_number(hcn_register_value);
-}
+static const bm13xx_register_write_t CHIP_SETUP[] = {
+    {0xA8, 0x000701F0},
+    {0x18, 0xF000C100},
+    {0x3C, 0x80008B00},
+    {0x3C, 0x80008018},
+    {0x3C, 0x800082AA}
+};
 
-float BM1368_send_hash_frequency(float target_freq)
+static uint8_t BM1368_init(GlobalState * GLOBAL_STATE, uint8_t chain)
 {
-    uint8_t fb_divider, refdiv, postdiv1, postdiv2;
-    float new_freq;
-    
-    pll_get_parameters(target_freq, 144, 235, &fb_divider, &refdiv, &postdiv1, &postdiv2, &new_freq);
+    BM13XX_batch_begin(chain);
 
-    uint8_t vdo_scale = (fb_divider * FREQ_MULT / refdiv >= 2400) ? 0x50 : 0x40;
-    uint8_t postdiv = (((postdiv1 - 1) & 0xf) << 4) | ((postdiv2 - 1) & 0xf);
-    uint8_t freqbuf[6] = {0x00, 0x08, vdo_scale, fb_divider, refdiv, postdiv};
-
-    _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_WRITE, freqbuf, sizeof(freqbuf), BM1368_SERIALTX_DEBUG);
-
-    ESP_LOGI(TAG, "Setting Frequency to %g MHz (%g)", target_freq, new_freq);
-
-    return new_freq;
-}
-
-uint8_t BM1368_init(GlobalState * GLOBAL_STATE)
-{
     // set version mask
     for (int i = 0; i < 4; i++) {
-        BM1368_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
+        BM13XX_set_version_mask(chain, STRATUM_DEFAULT_VERSION_MASK);
     }
 
-    _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_READ, (uint8_t[]){0x00, 0x00}, 2, false);
+    BM13XX_read_chip_id(chain);
+    BM13XX_batch_flush(chain);
 
-    uint16_t asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
-    int chip_counter = count_asic_chips(asic_count, BM1368_CHIP_ID, BM1368_CHIP_ID_RESPONSE_LENGTH);
+    uint16_t asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count / ASIC_CHAIN_COUNT;
+    int chip_counter = BM13XX_count_chips(chain, asic_count);
 
     if (chip_counter == 0) {
         return 0;
     }
 
-    _send_chain_inactive();
-    
-    uint8_t init_cmds[][6] = {
-        {0x00, 0xA8, 0x00, 0x07, 0x00, 0x00},
-        {0x00, 0x18, 0xFF, 0x0F, 0xC1, 0x00},
-        {0x00, 0x3C, 0x80, 0x00, 0x8b, 0x00},
-        {0x00, 0x3C, 0x80, 0x00, 0x80, 0x18},
-        {0x00, 0x14, 0x00, 0x00, 0x00, 0xFF},
-        {0x00, 0x54, 0x00, 0x00, 0x00, 0x03}, //Analog Mux
-        {0x00, 0x58, 0x02, 0x11, 0x11, 0x11}
-    };
-
-    for (int i = 0; i < sizeof(init_cmds) / sizeof(init_cmds[0]); i++) {
-        _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_WRITE, init_cmds[i], 6, false);
-    }
+    BM13XX_batch_begin(chain);
+
+    BM13XX_send_chain_inactive(chain);
 
-    address_interval = 256 / chip_counter;
+    BM13XX_write_all_table(chain, CHAIN_SETUP, BM13XX_TABLE_SIZE(CHAIN_SETUP));
+
+    uint8_t address_interval = 256 / chip_counter;
     for (int i = 0; i < chip_counter; i++) {
-        _set_chip_address(i * address_interval);
+        BM13XX_set_chip_address(chain, i * address_interval);
     }
+    BM13XX_set_chain(chain, chip_counter, address_interval);
 
     for (int i = 0; i < chip_counter; i++) {
-        uint8_t chip_init_cmds[][6] = {
-            {i * address_interval, 0xA8, 0x00, 0x07, 0x01, 0xF0},
-            {i * address_interval, 0x18, 0xF0, 0x00, 0xC1, 0x00},
-            {i * address_interval, 0x3C, 0x80, 0x00, 0x8b, 0x00},
-            {i * address_interval, 0x3C, 0x80, 0x00, 0x80, 0x18},
-            {i * address_interval, 0x3C, 0x80, 0x00, 0x82, 0xAA}
-        };
-
-        for (int j = 0; j < sizeof(chip_init_cmds) / sizeof(chip_init_cmds[0]); j++) {
-            _send_BM1368(TYPE_CMD | GROUP_SINGLE | CMD_WRITE, chip_init_cmds[j], 6, false);
-        }
+        BM13XX_write_chip_table(chain, i * address_interval, CHIP_SETUP, BM13XX_TABLE_SIZE(CHIP_SETUP));
+        // each chip gets its settle time after its own writes are on the wire
+        BM13XX_batch_flush(chain);
         vTaskDelay(pdMS_TO_TICKS(500));
+        BM13XX_batch_begin(chain);
     }
 
     uint16_t difficulty = GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty;
 
     uint8_t difficulty_mask[6];
     get_difficulty_mask(difficulty, difficulty_mask);
-    _send_BM1368((TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM1368_SERIALTX_DEBUG);    
-
-    do_frequency_transition(GLOBAL_STATE, BM1368_send_hash_frequency);
+    BM13XX_send(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM13XX_SERIALTX_DEBUG);
 
     float frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
     int cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.core_count;
 
-    BM1368_set_nonce_space(1.0, frequency, asic_count,cores);
-    BM1368_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
+    BM13XX_set_nonce_space(chain, 1.0, frequency, asic_count, cores);
+    BM13XX_set_version_mask(chain, STRATUM_DEFAULT_VERSION_MASK);
 
-    return chip_counter;
-}
+    if (!BM13XX_batch_flush(chain)) {
+        ESP_LOGE(TAG, "Failed to send the init sequence");
+    }
 
-int BM1368_set_default_baud(void)
-{
-    unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01111010, 0b00110001};
-    _send_BM1368((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1368_SERIALTX_DEBUG);
-    return 115749;
+    return chip_counter;
 }
 
-int BM1368_set_max_baud(void)
+static int BM1368_set_max_baud(uint8_t chain)
 {
     ESP_LOGI(TAG, "Setting max baud of 1000000");
 
-    unsigned char fast_uart[] = {0x00, FAST_UART_CONFIGURATION, 0x11, 0x30, 0x02, 0x00};
-    _send_BM1368((TYPE_CMD | GROUP_ALL | CMD_WRITE), fast_uart, 6, BM1368_SERIALTX_DEBUG);
+    BM13XX_write_all(chain, FAST_UART_CONFIGURATION, 0x11300200);
 
     return 1000000;
 }
 
-static uint8_t id = 0;
-
-void BM1368_send_work(GlobalState * GLOBAL_STATE, bm_job * next_bm_job)
-{
-    BM1368_job job;
-    id = (id + 24) % 128;
-    job.job_id = id;
-    job.num_midstates = 0x01;
-    memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
-    memcpy(&job.nbits, &next_bm_job->target, 4);
-    memcpy(&job.ntime, &next_bm_job->ntime, 4);
-    memcpy(job.merkle_root, next_bm_job->merkle_root, 32);
-    memcpy(job.prev_block_hash, next_bm_job->prev_block_hash, 32);
-    memcpy(&job.version, &next_bm_job->version, 4);
-
-    // Hold valid_jobs_lock across the free + reassignment so the result task
-    // (which snapshots active_jobs[job_id] under the same lock) can never observe
-    // or copy a slot we are freeing/replacing here. valid_jobs is set inside the
-    // same critical section so validity and the pointer stay consistent.
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL) {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
-    }
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
-
-    #if BM1368_DEBUG_JOBS
-    ESP_LOGI(TAG, "⁠​‌‌​​​‌​​‌‌​‌​​‌​‌‌‌​‌​​​‌‌​​​​‌​‌‌‌‌​​​​‌‌​​‌​‌⁠Send Job: %02X", job.job_id);
-    #endif
-
-    _send_BM1368((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1368_job), BM1368_DEBUG_WORK);
-}
-
-task_result * BM1368_process_work(GlobalState * GLOBAL_STATE)
-{
-    bm1368_asic_result_t asic_result = {0};
-
-    memset(&result, 0, sizeof(task_result));
+const bm13xx_chip_t BM1368_CHIP = {
+    .name = "bm1368",
+    .chip_id = BM1368_CHIP_ID,
+    .chip_id_alias = BM1368_CHIP_ID,
+    .chip_id_response_length = BM1368_CHIP_ID_RESPONSE_LENGTH,
+    .result_length = 11,
 
-    if (receive_work((uint8_t *)&asic_result, sizeof(asic_result), &result.timestamp_us) == ESP_FAIL) {
-        return NULL;
-    }
+    .job_layout = BM13XX_JOB_HEADER,
+    .job_id_step = 24,
 
-    if (!asic_result.is_job_response) {
-        result.register_type = REGISTER_MAP[asic_result.cmd.register_address];
-        if (result.register_type == REGISTER_INVALID) {
-            ESP_LOGW(TAG, "Unknown register read: %02x", asic_result.cmd.register_address);
-            return NULL;
-        }
-        result.asic_nr = asic_result.cmd.asic_address / address_interval;
-        result.value = ntohl(asic_result.cmd.value);
-        
-        return &result;
-    }
+    .result_job_id = { .mask = 0xf0, .shift = 1 },
+    .result_small_core = { .mask = 0x0f, .shift = 0 },
+    .nonce_chip_address = { .mask = 0x01fe0000, .shift = 17 },
+    .nonce_core_id = { .mask = 0xfe000000, .shift = 25 },
 
-    uint8_t job_id = (asic_result.job.id & 0xf0) >> 1;
-    uint32_t nonce_h = ntohl(asic_result.job.nonce);
-    uint8_t asic_nr = (uint8_t)((nonce_h >> 17) & 0xff) / address_interval;
-    uint8_t core_id = (uint8_t)((nonce_h >> 25) & 0x7f);
-    uint8_t small_core_id = asic_result.job.id & 0x0f;
-    uint32_t version_bits = (ntohs(asic_result.job.version) << 13);
-
-    // Read active_jobs[job_id] under the lock
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    if (GLOBAL_STATE->valid_jobs[job_id] == 0 || GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id] == NULL) {
-        pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
-        ESP_LOGW(TAG, "Invalid job nonce found, 0x%02X", job_id);
-        return NULL;
-    }
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version | version_bits;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+    .register_map = REGISTER_MAP,
+    .register_map_size = sizeof(REGISTER_MAP) / sizeof(REGISTER_MAP[0]),
 
-    result.job_id = job_id;
-    result.nonce = asic_result.job.nonce;
-    result.rolled_version = rolled_version;
-    result.asic_nr = asic_nr;
-    result.core_id = core_id;
-    result.small_core_id = small_core_id;
+    .pll_fb_min = 144,
+    .pll_fb_max = 235,
 
-    return &result;
-}
+    .hcn_mode = BM13XX_HCN_NONCE_SPACE,
 
-void BM1368_read_registers(void)
-{
-    int size = sizeof(REGISTER_MAP) / sizeof(REGISTER_MAP[0]);
-    for (int reg = 0; reg < size; reg++) {
-        if (REGISTER_MAP[reg] != REGISTER_INVALID) {
-            _send_BM1368((TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, reg}, 2, BM1368_SERIALTX_DEBUG);
-            vTaskDelay(1 / portTICK_PERIOD_MS);
-        }
-    }
-}
+    .init = BM1368_init,
+    .set_max_baud = BM1368_set_max_baud,
+};
@@ -1,37 +1,16 @@
 #include "bm1370.h"
 
-#include "crc.h"
 #include "global_state.h"
 #include "mining.h"
-#include "serial.h"
 #include "utils.h"
 
 #include "esp_log.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "frequency_transition_bmXX.h"
-#include "pll.h"
 
 #include <stdint.h>
-#include <string.h>
-#include <arpa/inet.h>
 
 #define BM1370_CHIP_ID 0x1370
 #define BM1370_CHIP_ID_RESPONSE_LENGTH 11
 
-#define TYPE_JOB 0x20
-#define TYPE_CMD 0x40
-
-#define GROUP_SINGLE 0x00
-#define GROUP_ALL 0x10
-
-#define CMD_SETADDRESS 0x00
-#define CMD_WRITE 0x01
-#define CMD_READ 0x02
-#define CMD_INACTIVE 0x03
-
-#define BM_CHIP_ID 0x00
-#define MISC_CONTROL 0x18
 #define FAST_UART_CONFIGURATION 0x28
 
 static const register_type_t REGISTER_MAP[] = {
@@ -40,377 +19,144 @@ static const register_type_t REGISTER_MAP[] = {
     [0x89] = REGISTER_DOMAIN_1_COUNT,
     [0x8A] = REGISTER_DOMAIN_2_COUNT,
     [0x8B] = REGISTER_DOMAIN_3_COUNT,
-    [0x8C] = REGISTER_TOTAL_COUNT
+    [0x8C] = REGISTER_TOTAL_COUNT,
+    [0xB4] = REGISTER_TEMPERATURE
 };
 
-typedef struct __attribute__((__packed__))
-{
-    uint32_t nonce;                   // 2-5
-    uint8_t midstate_num;             // 6
-    uint8_t id;                       // 7
-    uint16_t version;                 // 8-9
-} bm1370_asic_result_job_t;
-
-typedef struct __attribute__((__packed__))
-{
-    uint32_t value;                   // 2-5
-    uint8_t asic_address;             // 6
-    uint8_t register_address;         // 7
-    uint16_t                  : 16;   // 8-9
-} bm1370_asic_result_cmd_t;
-
-typedef struct __attribute__((__packed__))
-{
-    uint16_t preamble;                // 0-1
-    union {
-        bm1370_asic_result_job_t job; // 2-9
-        bm1370_asic_result_cmd_t cmd; // 2-9
-    };
-    uint8_t crc             : 5;      // 10:0-5
-    uint8_t                 : 2;      // 10:6-7
-    uint8_t is_job_response : 1;      // 10:8
-} bm1370_asic_result_t;
-
 static const char * TAG = "bm1370";
 
-static task_result result;
-
-static int address_interval;
-
-/// @brief
-/// @param ftdi
-/// @param header
-/// @param data
-/// @param len
-static void _send_BM1370(uint8_t header, const uint8_t * data, uint8_t data_len, bool debug)
-{
-    packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
-    const uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
-
-    uint8_t buf[total_length];
-
-    // add the preamble
-    buf[0] = 0x55;
-    buf[1] = 0xAA;
-
-    // add the header field
-    buf[2] = header;
-
-    // add the length field
-    buf[3] = (packet_type == JOB_PACKET) ? (data_len + 4) : (data_len + 3);
-
-    // add the data
-    memcpy(buf + 4, data, data_len);
-
-    // add the correct crc type
-    if (packet_type == JOB_PACKET) {
-        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
-        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
-        buf[5 + data_len] = crc16_total & 0xFF;
-    } else {
-        buf[4 + data_len] = crc5(buf + 2, data_len + 2);
-    }
-
-    // send serial data
-    if (SERIAL_send(buf, total_length, debug) == 0) {
-        ESP_LOGE(TAG, "Failed to send data to BM1370");
-    }
-}
-
-static void _send_chain_inactive(void)
-{
-    unsigned char read_address[] = {0x00, 0x00};
-    // send serial data
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1370_SERIALTX_DEBUG);
-}
-
-static void _set_chip_address(uint8_t chipAddr)
-{
-    unsigned char read_address[] = {chipAddr, 0x00};
-    // send serial data
-    _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1370_SERIALTX_DEBUG);
-}
-
-void BM1370_set_version_mask(uint32_t version_mask) 
-{
-    int versions_to_roll = version_mask >> 13;
-    uint8_t version_byte0 = (versions_to_roll >> 8);
-    uint8_t version_byte1 = (versions_to_roll & 0xFF); 
-    uint8_t version_cmd[] = {0x00, 0xA4, 0x90, 0x00, version_byte0, version_byte1};
-    _send_BM1370(TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1370_SERIALTX_DEBUG);
-}
+// Init sequences from the S21 Pro dump, the S21 dump values are noted where they differ
+static const bm13xx_register_write_t CHAIN_SETUP[] = {
+    {0xA8, 0x00070000}, // Reg_A8
+    {0x18, 0xF000C100}, // Misc Control, S21: 0xFF0FC100
+};
 
-void BM1370_set_hash_counting_number(uint32_t hcn) {
-    uint8_t set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x00, 0x00};
-    set_10_hash_counting[2] = (hcn >> 24) & 0xFF;
-    set_10_hash_counting[3] = (hcn >> 16) & 0xFF;
-    set_10_hash_counting[4] = (hcn >> 8) & 0xFF;
-    set_10_hash_counting[5] = hcn & 0xFF;
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), set_10_hash_counting, 6, BM1370_SERIALTX_DEBUG);
-}
+static const bm13xx_register_write_t CORE_SETUP[] = {
+    {0x3C, 0x80008B00}, // Core Register Control
+    {0x3C, 0x8000800C}, // Core Register Control, S21: 0x80008018
+};
 
-void BM1370_set_nonce_space(double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores) 
-{   
-    int cores_up = _next_power_of_two(cores);
-    int asic_count_up =  _next_power_of_two(asic_count);
+// Analog Mux Control 0x54 = 0x00000003 is not sent on the S21 Pro
+static const bm13xx_register_write_t IO_SETUP[] = {
+    {0x58, 0x00011111}, // IO Driver Strength, S21: 0x02111111
+};
 
-    // HCN hash counting number (the size of the nonce space)
-    float hcn_space = (float)NONCE_SPACE / cores_up / asic_count_up;
-    double hcn_max = hcn_space * (double)FREQ_MULT / frequency * 0.5f; 
-    // BM1370 has a HW errata of 134 per clock cycle
-    // use 2x value overwise we can get duplicates
-    int hcn_error = 2 * 134;
-    double hcn_frac = nonce_percent * (hcn_max - hcn_error);
-    uint32_t hcn_register_value = (uint32_t)hcn_frac;
+static const bm13xx_register_write_t CHIP_SETUP[] = {
+    {0xA8, 0x000701F0}, // Reg_A8
+    {0x18, 0xF000C100}, // Misc Control
+    {0x3C, 0x80008B00}, // Core Register Control
+    {0x3C, 0x8000800C}, // Core Register Control
+    {0x3C, 0x800082AA}, // Core Register Control
+};
 
-    BM1370_set_hash_counting_number(hcn_register_value);
-}
+static const bm13xx_register_write_t FINAL_SETUP[] = {
+    {0xB9, 0x00004480},
+    {0x54, 0x00000002}, // Analog Mux Control, rumored to control the temp diode
+    {0xB9, 0x00004480}, // duplicate of the first command in the dump
+    {0x3C, 0x80008DEE},
+};
 
-float BM1370_send_hash_frequency(float target_freq)
+static uint8_t BM1370_init(GlobalState * GLOBAL_STATE, uint8_t chain)
 {
-    uint8_t fb_divider, refdiv, postdiv1, postdiv2;
-    float frequency;
-
-    pll_get_parameters(target_freq, 160, 239, &fb_divider, &refdiv, &postdiv1, &postdiv2, &frequency);
-    
-    uint8_t vdo_scale = (fb_divider * FREQ_MULT / refdiv >= 2400) ? 0x50 : 0x40;
-    uint8_t postdiv = (((postdiv1 - 1) & 0xf) << 4) | ((postdiv2 - 1) & 0xf);
-    uint8_t freqbuf[6] = {0x00, 0x08, vdo_scale, fb_divider, refdiv, postdiv};
-
-    _send_BM1370(TYPE_CMD | GROUP_ALL | CMD_WRITE, freqbuf, 6, BM1370_SERIALTX_DEBUG);
-
-    ESP_LOGI(TAG, "Setting Frequency to %g MHz (%g)", target_freq, frequency);
+    BM13XX_batch_begin(chain);
 
-    return frequency;
-}
-
-uint8_t BM1370_init(GlobalState * GLOBAL_STATE)
-{
     // set version mask
     for (int i = 0; i < 3; i++) {
-        BM1370_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
+        BM13XX_set_version_mask(chain, STRATUM_DEFAULT_VERSION_MASK);
     }
 
     //read register 00 on all chips (should respond AA 55 13 68 00 00 00 00 00 00 0F)
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, BM_CHIP_ID}, 2, BM1370_SERIALTX_DEBUG);
+    BM13XX_read_chip_id(chain);
+    BM13XX_batch_flush(chain);
 
-    uint16_t asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
-    int chip_counter = count_asic_chips(asic_count, BM1370_CHIP_ID, BM1370_CHIP_ID_RESPONSE_LENGTH);
+    uint16_t asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count / ASIC_CHAIN_COUNT;
+    int chip_counter = BM13XX_count_chips(chain, asic_count);
 
     if (chip_counter == 0) {
         return 0;
     }
 
+    BM13XX_batch_begin(chain);
 
     // set version mask
-    BM1370_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
+    BM13XX_set_version_mask(chain, STRATUM_DEFAULT_VERSION_MASK);
 
-    //Reg_A8
-    //unsigned char init5[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03};
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0xA8, 0x00, 0x07, 0x00, 0x00}, 6, BM1370_SERIALTX_DEBUG);
-
-    //Misc Control
-    //TX: 55 AA 51 09 [00 18 F0 00 C1 00] 04 //command all chips, write chip address 00, register 18, data F0 00 C1 00 - Misc Control
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x18, 0xF0, 0x00, 0xC1, 0x00}, 6, BM1370_SERIALTX_DEBUG); //from S21Pro dump
-    //_send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x18, 0xFF, 0x0F, 0xC1, 0x00}, 6, BM1370_SERIALTX_DEBUG); //from S21 dump
+    BM13XX_write_all_table(chain, CHAIN_SETUP, BM13XX_TABLE_SIZE(CHAIN_SETUP));
 
     //chain inactive
-    _send_chain_inactive();
-    // unsigned char init7[7] = {0x55, 0xAA, 0x53, 0x05, 0x00, 0x00, 0x03};
-    // _send_simple(init7, 7);
+    BM13XX_send_chain_inactive(chain);
 
     // split the chip address space evenly
-    address_interval = 256 / chip_counter;
+    uint8_t address_interval = 256 / chip_counter;
     for (uint8_t i = 0; i < chip_counter; i++) {
-        _set_chip_address(i * address_interval);
-        // unsigned char init8[7] = {0x55, 0xAA, 0x40, 0x05, 0x00, 0x00, 0x1C};
-        // _send_simple(init8, 7);
+        BM13XX_set_chip_address(chain, i * address_interval);
     }
+    BM13XX_set_chain(chain, chip_counter, address_interval);
 
-    //Core Register Control
-    //unsigned char init9[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x8B, 0x00, 0x12};
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x8B, 0x00}, 6, BM1370_SERIALTX_DEBUG);
-
-    //Core Register Control
-    //TX: 55 AA 51 09 [00 3C 80 00 80 0C] 11  //command all chips, write chip address 00, register 3C, data 80 00 80 0C - Core Register Control
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x80, 0x0C}, 6, BM1370_SERIALTX_DEBUG); //from S21Pro dump
-    //_send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x80, 0x18}, 6, BM1370_SERIALTX_DEBUG); //from S21 dump
+    BM13XX_write_all_table(chain, CORE_SETUP, BM13XX_TABLE_SIZE(CORE_SETUP));
 
     uint16_t difficulty = GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty;
-    
+
     //set difficulty mask
     uint8_t difficulty_mask[6];
     get_difficulty_mask(difficulty, difficulty_mask);
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM1370_SERIALTX_DEBUG);    
-
-    //Analog Mux Control -- not sent on S21 Pro?
-    // unsigned char init12[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x54, 0x00, 0x00, 0x00, 0x03, 0x1D};
-    // _send_simple(init12, 11);
+    BM13XX_send(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM13XX_SERIALTX_DEBUG);
 
-    //Set the IO Driver Strength on chip 00
-    //TX: 55 AA 51 09 [00 58 00 01 11 11] 0D  //command all chips, write chip address 00, register 58, data 01 11 11 11 - Set the IO Driver Strength on chip 00
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x58, 0x00, 0x01, 0x11, 0x11}, 6, BM1370_SERIALTX_DEBUG); //from S21Pro dump
-    //_send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x58, 0x02, 0x11, 0x11, 0x11}, 6, BM1370_SERIALTX_DEBUG); //from S21Pro dump
-    
+    BM13XX_write_all_table(chain, IO_SETUP, BM13XX_TABLE_SIZE(IO_SETUP));
 
     for (uint8_t i = 0; i < chip_counter; i++) {
-        //TX: 55 AA 41 09 00 [A8 00 07 01 F0] 15    // Reg_A8
-        unsigned char set_a8_register[6] = {i * address_interval, 0xA8, 0x00, 0x07, 0x01, 0xF0};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_a8_register, 6, BM1370_SERIALTX_DEBUG);
-        //TX: 55 AA 41 09 00 [18 F0 00 C1 00] 0C    // Misc Control
-        unsigned char set_18_register[6] = {i * address_interval, 0x18, 0xF0, 0x00, 0xC1, 0x00};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_18_register, 6, BM1370_SERIALTX_DEBUG);
-        //TX: 55 AA 41 09 00 [3C 80 00 8B 00] 1A    // Core Register Control
-        unsigned char set_3c_register_first[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x8B, 0x00};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_first, 6, BM1370_SERIALTX_DEBUG);
-        //TX: 55 AA 41 09 00 [3C 80 00 80 0C] 19    // Core Register Control
-        unsigned char set_3c_register_second[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x80, 0x0C};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_second, 6, BM1370_SERIALTX_DEBUG);
-        //TX: 55 AA 41 09 00 [3C 80 00 82 AA] 05    // Core Register Control
-        unsigned char set_3c_register_third[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x82, 0xAA};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_third, 6, BM1370_SERIALTX_DEBUG);
+        BM13XX_write_chip_table(chain, i * address_interval, CHIP_SETUP, BM13XX_TABLE_SIZE(CHIP_SETUP));
     }
 
-    //Some misc settings?
-    // TX: 55 AA 51 09 [00 B9 00 00 44 80] 0D    //command all chips, write chip address 00, register B9, data 00 00 44 80
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0xB9, 0x00, 0x00, 0x44, 0x80}, 6, BM1370_SERIALTX_DEBUG);
-    // TX: 55 AA 51 09 [00 54 00 00 00 02] 18    //command all chips, write chip address 00, register 54, data 00 00 00 02 - Analog Mux Control - rumored to control the temp diode
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x54, 0x00, 0x00, 0x00, 0x02}, 6, BM1370_SERIALTX_DEBUG);
-    // TX: 55 AA 51 09 [00 B9 00 00 44 80] 0D    //command all chips, write chip address 00, register B9, data 00 00 44 80 -- duplicate of first command in series
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0xB9, 0x00, 0x00, 0x44, 0x80}, 6, BM1370_SERIALTX_DEBUG);
-    // TX: 55 AA 51 09 [00 3C 80 00 8D EE] 1B    //command all chips, write chip address 00, register 3C, data 80 00 8D EE
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x8D, 0xEE}, 6, BM1370_SERIALTX_DEBUG);
-
-    //ramp up the hash frequency
-    do_frequency_transition(GLOBAL_STATE, BM1370_send_hash_frequency);
+    BM13XX_write_all_table(chain, FINAL_SETUP, BM13XX_TABLE_SIZE(FINAL_SETUP));
 
     float frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
     int cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.core_count;
 
-    BM1370_set_nonce_space(1.0, frequency, asic_count, cores);
+    BM13XX_set_nonce_space(chain, 1.0, frequency, asic_count, cores);
 
-    return chip_counter;
-}
-
-// static void _send_read_address(void)
-// {
-
-//     unsigned char read_address[2] = {0x00, 0x00};
-//     // send serial data
-//     _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_READ), read_address, 2, BM1370_SERIALTX_DEBUG);
-// }
+    if (!BM13XX_batch_flush(chain)) {
+        ESP_LOGE(TAG, "Failed to send the init sequence");
+    }
 
-// Baud formula = 25M/((denominator+1)*8)
-// The denominator is 5 bits found in the misc_control (bits 9-13)
-int BM1370_set_default_baud(void)
-{
-    // default divider of 26 (11010) for 115,749
-    unsigned char baudrate[] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01111010, 0b00110001}; // baudrate - misc_control
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1370_SERIALTX_DEBUG);
-    return 115749;
+    return chip_counter;
 }
 
-int BM1370_set_max_baud(void)
+static int BM1370_set_max_baud(uint8_t chain)
 {
     // divider of 0 for 3,125,000
-    ESP_LOGI(TAG, "Setting max baud of 1000000 ⁠​‌‌​​​‌​​‌‌​‌​​‌​‌‌‌​‌​​​‌‌​​​​‌​‌‌‌‌​​​​‌‌​​‌​‌⁠");
+    ESP_LOGI(TAG, "Setting max baud of 1000000");
 
-    unsigned char fast_uart[] = {0x00, FAST_UART_CONFIGURATION, 0x11, 0x30, 0x02, 0x00};
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), fast_uart, 6, BM1370_SERIALTX_DEBUG);
+    BM13XX_write_all(chain, FAST_UART_CONFIGURATION, 0x11300200);
     return 1000000;
 }
 
-static uint8_t id = 0;
-
-void BM1370_send_work(GlobalState * GLOBAL_STATE, bm_job * next_bm_job)
-{
-    BM1370_job job;
-    id = (id + 24) % 128;
-    job.job_id = id;
-    job.num_midstates = 0x01;
-    memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
-    memcpy(&job.nbits, &next_bm_job->target, 4);
-    memcpy(&job.ntime, &next_bm_job->ntime, 4);
-    memcpy(job.merkle_root, next_bm_job->merkle_root, 32);
-    memcpy(job.prev_block_hash, next_bm_job->prev_block_hash, 32);
-    memcpy(&job.version, &next_bm_job->version, 4);
-
-    // Hold valid_jobs_lock across the free + reassignment so the result task
-    // (which snapshots active_jobs[job_id] under the same lock) can never observe
-    // or copy a slot we are freeing/replacing here. valid_jobs is set inside the
-    // same critical section so validity and the pointer stay consistent.
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL) {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
-    }
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
-
-    //debug sent jobs - this can get crazy if the interval is short
-    #if BM1370_DEBUG_JOBS
-    ESP_LOGI(TAG, "⁠​‌‌​​​‌​​‌‌​‌​​‌​‌‌‌​‌​​​‌‌​​​​‌​‌‌‌‌​​​​‌‌​​‌​‌⁠Send Job: %02X", job.job_id);
-    #endif
+const bm13xx_chip_t BM1370_CHIP = {
+    .name = "bm1370",
+    .chip_id = BM1370_CHIP_ID,
+    .chip_id_alias = BM1370_CHIP_ID,
+    .chip_id_response_length = BM1370_CHIP_ID_RESPONSE_LENGTH,
+    .result_length = 11,
 
-    _send_BM1370((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1370_job), BM1370_DEBUG_WORK);
-}
+    .job_layout = BM13XX_JOB_HEADER,
+    .job_id_step = 24,
 
-task_result * BM1370_process_work(GlobalState * GLOBAL_STATE)
-{
-    bm1370_asic_result_t asic_result = {0};
+    .result_job_id = { .mask = 0xf0, .shift = 1 },
+    .result_small_core = { .mask = 0x0f, .shift = 0 },    // BM1370 has 16 small cores, so it should be coded on 4 bits
+    .nonce_chip_address = { .mask = 0x01fe0000, .shift = 17 }, // Asic address is encoded in the next 8 bits
+    .nonce_core_id = { .mask = 0xfe000000, .shift = 25 },      // BM1370 has 80 cores, so it should be coded on 7 bits
 
-    memset(&result, 0, sizeof(task_result));
+    .register_map = REGISTER_MAP,
+    .register_map_size = sizeof(REGISTER_MAP) / sizeof(REGISTER_MAP[0]),
 
-    if (receive_work((uint8_t *)&asic_result, sizeof(asic_result), &result.timestamp_us) == ESP_FAIL) {
-        return NULL;
-    }
-    
-    if (!asic_result.is_job_response) {
-        result.register_type = REGISTER_MAP[asic_result.cmd.register_address];
-        if (result.register_type == REGISTER_INVALID) {
-            ESP_LOGW(TAG, "Unknown register read: %02x", asic_result.cmd.register_address);
-            return NULL;
-        }
-        result.asic_nr = asic_result.cmd.asic_address / address_interval;
-        result.value = ntohl(asic_result.cmd.value);
-        
-        return &result;
-    }
+    .pll_fb_min = 160,
+    .pll_fb_max = 239,
 
-    uint8_t job_id = (asic_result.job.id & 0xf0) >> 1;
-    uint32_t nonce_h = ntohl(asic_result.job.nonce);
-    uint8_t asic_nr = (uint8_t)((nonce_h >> 17) & 0xff) / address_interval; // Asic address is encoded in the next 8 bits
-    uint8_t core_id = (uint8_t)((nonce_h >> 25) & 0x7f); // BM1370 has 80 cores, so it should be coded on 7 bits
-    uint8_t small_core_id = asic_result.job.id & 0x0f; // BM1370 has 16 small cores, so it should be coded on 4 bits
-    uint32_t version_bits = (ntohs(asic_result.job.version) << 13); // shift the 16 bit value left 13
-
-    // Read active_jobs[job_id] under the lock
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    if (GLOBAL_STATE->valid_jobs[job_id] == 0 || GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id] == NULL) {
-        pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
-        ESP_LOGW(TAG, "Invalid job nonce found, 0x%02X", job_id);
-        return NULL;
-    }
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version | version_bits;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
-
-    result.job_id = job_id;
-    result.nonce = asic_result.job.nonce;
-    result.rolled_version = rolled_version;
-    result.asic_nr = asic_nr;
-    result.core_id = core_id;
-    result.small_core_id = small_core_id;
-
-    return &result;
-}
+    .hcn_mode = BM13XX_HCN_NONCE_SPACE,
+    // BM1370 has a HW errata of 134 per clock cycle
+    // use 2x value overwise we can get duplicates
+    .hcn_error = 2 * 134,
 
-void BM1370_read_registers(void)
-{
-    int size = sizeof(REGISTER_MAP) / sizeof(REGISTER_MAP[0]);
-    for (int reg = 0; reg < size; reg++) {
-        if (REGISTER_MAP[reg] != REGISTER_INVALID) {
-            _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, reg}, 2, BM1370_SERIALTX_DEBUG);
-            vTaskDelay(1 / portTICK_PERIOD_MS);
-        }
-    }
-}
+    .init = BM1370_init,
+    .set_max_baud = BM1370_set_max_baud,
+};
@@ -1,44 +1,27 @@
-#include <stdio.h>
-#include <stdlib.h>
 #include <stdint.h>
-#include <string.h>
-#include <math.h>
-#include <arpa/inet.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "frequency_transition_bmXX.h"
 #include "esp_log.h"
 
-#include "serial.h"
 #include "bm1397.h"
-#include "utils.h"
-#include "crc.h"
-#include "mining.h"
 #include "global_state.h"
 #include "pll.h"
 
 #define BM1397_CHIP_ID 0x1397
 #define BM1397_CHIP_ID_RESPONSE_LENGTH 9
 
-#define TYPE_JOB 0x20
-#define TYPE_CMD 0x40
-
-#define GROUP_SINGLE 0x00
-#define GROUP_ALL 0x10
-
-#define CMD_SETADDRESS 0x00
-#define CMD_WRITE 0x01
-#define CMD_READ 0x02
-#define CMD_INACTIVE 0x03
+#define BM1397_PLL_FB_MIN 60
+#define BM1397_PLL_FB_MAX 200
 
 #define SLEEP_TIME 20
-#define FREQ_MULT 25.0
 
+#define PLL0_PARAMETER 0x08
 #define CLOCK_ORDER_CONTROL_0 0x80
 #define CLOCK_ORDER_CONTROL_1 0x84
 #define ORDERED_CLOCK_ENABLE 0x20
 #define CORE_REGISTER_CONTROL 0x3C
+#define PLL0_DIVIDER 0x70
 #define PLL3_PARAMETER 0x68
 #define FAST_UART_CONFIGURATION 0x28
 #define MISC_CONTROL 0x18
@@ -48,127 +31,28 @@ static const register_type_t REGISTER_MAP[] = {
     [0x4C] = REGISTER_ERROR_COUNT,
 };
 
-typedef struct __attribute__((__packed__))
-{
-    uint32_t nonce;                   // 2-5
-    uint8_t midstate_num;             // 6
-    uint8_t id;                       // 7
-} bm1397_asic_result_job_t;
-
-typedef struct __attribute__((__packed__))
-{
-    uint32_t value;                   // 2-5
-    uint8_t asic_address;             // 6
-    uint8_t register_address;         // 7
-} bm1397_asic_result_cmd_t;
-
-typedef struct __attribute__((__packed__))
-{
-    uint16_t preamble;                // 0-1
-    union {
-        bm1397_asic_result_job_t job; // 2-7
-        bm1397_asic_result_cmd_t cmd; // 2-7
-    };
-    uint8_t crc             : 5;      // 8:0-5
-    uint8_t                 : 2;      // 8:6-7
-    uint8_t is_job_response : 1;      // 8:8
-} bm1397_asic_result_t;
-
 static const char * TAG = "bm1397";
 
-static uint32_t prev_nonce = 0;
-static task_result result;
-
-static int address_interval;
-
-/// @brief
-/// @param ftdi
-/// @param header
-/// @param data
-/// @param len
-static void _send_BM1397(uint8_t header, uint8_t *data, uint8_t data_len, bool debug)
-{
-    packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
-    uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
-
-    uint8_t buf[total_length];
-
-    // add the preamble
-    buf[0] = 0x55;
-    buf[1] = 0xAA;
-
-    // add the header field
-    buf[2] = header;
-
-    // add the length field
-    buf[3] = (packet_type == JOB_PACKET) ? (data_len + 4) : (data_len + 3);
-
-    // add the data
-    memcpy(buf + 4, data, data_len);
-
-    // add the correct crc type
-    if (packet_type == JOB_PACKET)
-    {
-        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
-        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
-        buf[5 + data_len] = crc16_total & 0xFF;
-    }
-    else
-    {
-        buf[4 + data_len] = crc5(buf + 2, data_len + 2);
-    }
-
-    // send serial data
-    SERIAL_send(buf, total_length, debug);
-}
-
-static void _send_read_address(void)
-{
-    unsigned char read_address[2] = {0x00, 0x00};
-    // send serial data
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_READ), read_address, 2, BM1397_SERIALTX_DEBUG);
-}
-
-static void _send_chain_inactive(void)
-{
-    unsigned char read_address[2] = {0x00, 0x00};
-    // send serial data
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1397_SERIALTX_DEBUG);
-}
-
-static void _set_chip_address(uint8_t chipAddr)
-{
-    unsigned char read_address[2] = {chipAddr, 0x00};
-    // send serial data
-    _send_BM1397((TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1397_SERIALTX_DEBUG);
-}
-
-void BM1397_set_version_mask(uint32_t version_mask) 
-{
-    // placeholder
-}
-
-float BM1397_send_hash_frequency(float target_freq)
+static float BM1397_send_hash_frequency(uint8_t chain, float target_freq)
 {
     uint8_t fb_divider, refdiv, postdiv1, postdiv2;
     float frequency;
 
-    pll_get_parameters(target_freq, 60, 200, &fb_divider, &refdiv, &postdiv1, &postdiv2, &frequency);
+    pll_get_parameters(target_freq, BM1397_PLL_FB_MIN, BM1397_PLL_FB_MAX, &fb_divider, &refdiv, &postdiv1, &postdiv2, &frequency);
 
     uint8_t vdo_scale = 0x40;
     uint8_t postdiv = ((postdiv1 & 0x7) << 4) + (postdiv2 & 0x7);
-    uint8_t freqbuf[6] = {0x00, 0x08, vdo_scale, fb_divider, refdiv, postdiv};  // freqbuf - pll0_parameter
-    uint8_t prefreq1[6] = {0x00, 0x70, 0x0F, 0x0F, 0x0F, 0x00}; // prefreq - pll0_divider
+    uint32_t pll_value = ((uint32_t)vdo_scale << 24) | ((uint32_t)fb_divider << 16) | ((uint32_t)refdiv << 8) | postdiv;
 
     for (int i = 0; i < 2; i++)
     {
         vTaskDelay(10 / portTICK_PERIOD_MS);
-        _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), prefreq1, 6, BM1397_SERIALTX_DEBUG);
+        BM13XX_write_all(chain, PLL0_DIVIDER, 0x0F0F0F00); // prefreq - pll0_divider
     }
     for (int i = 0; i < 2; i++)
     {
         vTaskDelay(10 / portTICK_PERIOD_MS);
-        _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), freqbuf, 6, BM1397_SERIALTX_DEBUG);
+        BM13XX_write_all(chain, PLL0_PARAMETER, pll_value); // freqbuf - pll0_parameter
     }
 
     vTaskDelay(10 / portTICK_PERIOD_MS);
@@ -178,13 +62,25 @@ float BM1397_send_hash_frequency(float target_freq)
     return frequency;
 }
 
-uint8_t BM1397_init(GlobalState * GLOBAL_STATE)
+static const bm13xx_register_write_t CLOCK_SETUP[] = {
+    {CLOCK_ORDER_CONTROL_0, 0x00000000}, // init1 - clock_order_control0
+    {CLOCK_ORDER_CONTROL_1, 0x00000000}, // init2 - clock_order_control1
+    {ORDERED_CLOCK_ENABLE, 0x00000001},  // init3 - ordered_clock_enable
+    {CORE_REGISTER_CONTROL, 0x80008074}, // init4 - init_4_?
+};
+
+static const bm13xx_register_write_t UART_SETUP[] = {
+    {PLL3_PARAMETER, 0xC0700111},          // init5 - pll3_parameter
+    {FAST_UART_CONFIGURATION, 0x0600000F}, // init6 - fast_uart_configuration
+};
+
+static uint8_t BM1397_init(GlobalState * GLOBAL_STATE, uint8_t chain)
 {
     // send the init command
-    _send_read_address();
+    BM13XX_read_chip_id(chain);
 
-    uint16_t asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
-    int chip_counter = count_asic_chips(asic_count, BM1397_CHIP_ID, BM1397_CHIP_ID_RESPONSE_LENGTH);
+    uint16_t asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count / ASIC_CHAIN_COUNT;
+    int chip_counter = BM13XX_count_chips(chain, asic_count);
 
     if (chip_counter == 0) {
         return 0;
@@ -192,205 +88,86 @@ uint8_t BM1397_init(GlobalState * GLOBAL_STATE)
 
     // send serial data
     vTaskDelay(SLEEP_TIME / portTICK_PERIOD_MS);
-    _send_chain_inactive();
+
+    BM13XX_batch_begin(chain);
+    BM13XX_send_chain_inactive(chain);
 
     // split the chip address space evenly
-    address_interval = 256 / chip_counter;
+    uint8_t address_interval = 256 / chip_counter;
     for (uint8_t i = 0; i < chip_counter; i++) {
-        _set_chip_address(i * address_interval);
+        BM13XX_set_chip_address(chain, i * address_interval);
     }
+    BM13XX_set_chain(chain, chip_counter, address_interval);
 
-    unsigned char init[6] = {0x00, CLOCK_ORDER_CONTROL_0, 0x00, 0x00, 0x00, 0x00}; // init1 - clock_order_control0
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init, 6, BM1397_SERIALTX_DEBUG);
-
-    unsigned char init2[6] = {0x00, CLOCK_ORDER_CONTROL_1, 0x00, 0x00, 0x00, 0x00}; // init2 - clock_order_control1
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init2, 6, BM1397_SERIALTX_DEBUG);
-
-    unsigned char init3[9] = {0x00, ORDERED_CLOCK_ENABLE, 0x00, 0x00, 0x00, 0x01}; // init3 - ordered_clock_enable
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init3, 6, BM1397_SERIALTX_DEBUG);
-
-    unsigned char init4[9] = {0x00, CORE_REGISTER_CONTROL, 0x80, 0x00, 0x80, 0x74}; // init4 - init_4_?
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init4, 6, BM1397_SERIALTX_DEBUG);
+    BM13XX_write_all_table(chain, CLOCK_SETUP, BM13XX_TABLE_SIZE(CLOCK_SETUP));
 
     uint16_t difficulty = GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty;
 
     //set difficulty mask
     uint8_t difficulty_mask[6];
     get_difficulty_mask(difficulty, difficulty_mask);
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM1397_SERIALTX_DEBUG);
+    BM13XX_send(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM13XX_SERIALTX_DEBUG);
 
-    unsigned char init5[9] = {0x00, PLL3_PARAMETER, 0xC0, 0x70, 0x01, 0x11}; // init5 - pll3_parameter
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init5, 6, BM1397_SERIALTX_DEBUG);
+    BM13XX_write_all_table(chain, UART_SETUP, BM13XX_TABLE_SIZE(UART_SETUP));
 
-    unsigned char init6[9] = {0x00, FAST_UART_CONFIGURATION, 0x06, 0x00, 0x00, 0x0F}; // init6 - fast_uart_configuration
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init6, 6, BM1397_SERIALTX_DEBUG);
-
-    BM1397_set_default_baud();
+    // the baud change must not overtake the queued writes
+    if (!BM13XX_batch_flush(chain)) {
+        ESP_LOGE(TAG, "Failed to send the init sequence");
+    }
 
-    //ramp up the hash frequency
-    do_frequency_transition(GLOBAL_STATE, BM1397_send_hash_frequency);
+    BM13XX_set_default_baud(chain);
 
     return chip_counter;
 }
 
-// Baud formula = 25M/((denominator+1)*8)
-// The denominator is 5 bits found in the misc_control (bits 9-13)
-int BM1397_set_default_baud(void)
-{
-    // default divider of 26 (11010) for 115,749
-    unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01111010, 0b00110001}; // baudrate - misc_control
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1397_SERIALTX_DEBUG);
-    return 115749;
-}
-
-int BM1397_set_max_baud(void)
+static int BM1397_set_max_baud(uint8_t chain)
 {
     // divider of 0 for 3,125,000
     ESP_LOGI(TAG, "Setting max baud of 3125000");
-    unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01100000, 0b00110001};
-    ; // baudrate - misc_control
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1397_SERIALTX_DEBUG);
+    BM13XX_write_all(chain, MISC_CONTROL, 0x00006031); // baudrate - misc_control
     return 3125000;
 }
 
-static uint8_t id = 0;
+// misc_control bits 8-12 hold the divider d, baud = 25M / ((d + 1) * 8)
+static const bm13xx_baud_step_t BAUD_STEPS[] = {
+    { MISC_CONTROL, 0x00007A31,  115740 }, // d = 26, reset rate
+    { MISC_CONTROL, 0x00006331,  781250 }, // d = 3
+    { MISC_CONTROL, 0x00006231, 1041666 }, // d = 2
+    { MISC_CONTROL, 0x00006131, 1562500 }, // d = 1
+    { MISC_CONTROL, 0x00006031, 3125000 }, // d = 0
+};
+
+const bm13xx_chip_t BM1397_CHIP = {
+    .name = "bm1397",
+    .chip_id = BM1397_CHIP_ID,
+    .chip_id_alias = BM1397_CHIP_ID,
+    .chip_id_response_length = BM1397_CHIP_ID_RESPONSE_LENGTH,
+    .result_length = 9,
 
-void BM1397_send_work(GlobalState * GLOBAL_STATE, bm_job * next_bm_job)
-{
-    job_packet job;
     // max job number is 128
     // there is still some really weird logic with the job id bits for the asic to sort out
     // so we have it limited to 128 and it has to increment by 4
-    id = (id + 4) % 128;
-
-    job.job_id = id;
-    job.num_midstates = next_bm_job->num_midstates;
-    memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
-    memcpy(&job.nbits, &next_bm_job->target, 4);
-    memcpy(&job.ntime, &next_bm_job->ntime, 4);
-    memcpy(&job.merkle4, next_bm_job->merkle_root, 4);
-    memcpy(job.midstate, next_bm_job->midstate, 32);
-
-    if (job.num_midstates == 4)
-    {
-        memcpy(job.midstate1, next_bm_job->midstate1, 32);
-        memcpy(job.midstate2, next_bm_job->midstate2, 32);
-        memcpy(job.midstate3, next_bm_job->midstate3, 32);
-    }
+    .job_layout = BM13XX_JOB_MIDSTATES,
+    .job_id_step = 4,
 
-    // Hold valid_jobs_lock across the free + reassignment so the result task
-    // (which snapshots active_jobs[job_id] under the same lock) can never observe
-    // or copy a slot we are freeing/replacing here. valid_jobs is set inside the
-    // same critical section so validity and the pointer stay consistent.
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL)
-    {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
-    }
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
-
-    #if BM1397_DEBUG_JOBS
-    ESP_LOGI(TAG, "Send Job: %02X", job.job_id);
-    #endif
-
-    _send_BM1397((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(job_packet), BM1397_DEBUG_WORK);
-}
-
-task_result *BM1397_process_work(GlobalState * GLOBAL_STATE)
-{
-    bm1397_asic_result_t asic_result = {0};
-
-    memset(&result, 0, sizeof(task_result));
-
-    if (receive_work((uint8_t *)&asic_result, sizeof(asic_result), &result.timestamp_us) == ESP_FAIL) {
-        return NULL;
-    }
+    .result_job_id = { .mask = 0xfc, .shift = 0 },
+    .result_small_core = { .mask = 0x0f, .shift = 0 },
+    .result_midstate = { .mask = 0x03, .shift = 0 },
+    .nonce_chip_address = { .mask = 0x01fe0000, .shift = 17 },
+    .nonce_core_id = { .mask = 0xfe000000, .shift = 25 },
 
-    if (!asic_result.is_job_response) {
-        result.register_type = REGISTER_MAP[asic_result.cmd.register_address];
-        if (result.register_type == REGISTER_INVALID) {
-            ESP_LOGW(TAG, "Unknown register read: %02x", asic_result.cmd.register_address);
-            return NULL;
-        }
-        result.asic_nr = asic_result.cmd.asic_address / address_interval;
-        result.value = ntohl(asic_result.cmd.value);
+    .register_map = REGISTER_MAP,
+    .register_map_size = sizeof(REGISTER_MAP) / sizeof(REGISTER_MAP[0]),
 
-        return &result;
-    }
+    .pll_fb_min = BM1397_PLL_FB_MIN,
+    .pll_fb_max = BM1397_PLL_FB_MAX,
 
-    uint8_t nonce_found = 0;
-    uint32_t first_nonce = 0;
+    .hcn_mode = BM13XX_HCN_NONE,
 
-    uint8_t rx_job_id = asic_result.job.id & 0xfc;
-    uint8_t rx_midstate_index = asic_result.job.id & 0x03;
+    .baud_steps = BAUD_STEPS,
+    .baud_step_count = sizeof(BAUD_STEPS) / sizeof(BAUD_STEPS[0]),
 
-    // Read active_jobs[rx_job_id] under the lock: BM1397_send_work() can free and
-    // replace this slot from the create-jobs task, so dereferencing ->version /
-    // ->version_mask without the lock is a use-after-free. Snapshot both fields,
-    // then unlock and roll the version outside the critical section.
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    if (GLOBAL_STATE->valid_jobs[rx_job_id] == 0 || GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[rx_job_id] == NULL)
-    {
-        pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
-        ESP_LOGW(TAG, "Invalid job nonce found, id=%d", rx_job_id);
-        return NULL;
-    }
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[rx_job_id]->version;
-    uint32_t version_mask = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[rx_job_id]->version_mask;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
-
-    for (int i = 0; i < rx_midstate_index; i++)
-    {
-        rolled_version = increment_bitmask(rolled_version, version_mask);
-    }
-
-    // ASIC may return the same nonce multiple times
-    // or one that was already found
-    // most of the time it behaves however
-    if (nonce_found == 0)
-    {
-        first_nonce = asic_result.job.nonce;
-        nonce_found = 1;
-    }
-    else if (asic_result.job.nonce == first_nonce)
-    {
-        // stop if we've already seen this nonce
-        return NULL;
-    }
-
-    if (asic_result.job.nonce == prev_nonce)
-    {
-        return NULL;
-    }
-    else
-    {
-        prev_nonce = asic_result.job.nonce;
-    }
-
-    uint32_t nonce_h = ntohl(asic_result.job.nonce);
-    uint8_t asic_nr = (uint8_t)((nonce_h >> 17) & 0xff) / address_interval;
-    uint8_t core_id = (uint8_t)((nonce_h >> 25) & 0x7f);
-    uint8_t small_core_id = asic_result.job.id & 0x0f;
-
-    result.job_id = rx_job_id;
-    result.nonce = asic_result.job.nonce;
-    result.rolled_version = rolled_version;
-    result.asic_nr = asic_nr;
-    result.core_id = core_id;
-    result.small_core_id = small_core_id;
-
-    return &result;
-}
-
-void BM1397_read_registers(void)
-{
-    int size = sizeof(REGISTER_MAP) / sizeof(REGISTER_MAP[0]);
-    for (int reg = 0; reg < size; reg++) {
-        if (REGISTER_MAP[reg] != REGISTER_INVALID) {
-            _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, reg}, 2, BM1397_SERIALTX_DEBUG);
-            vTaskDelay(1 / portTICK_PERIOD_MS);
-        }
-    }
-}
+    .init = BM1397_init,
+    .set_max_baud = BM1397_set_max_baud,
+    .send_hash_frequency = BM1397_send_hash_frequency,
+};
@@ -0,0 +1,682 @@
+#include "bm13xx.h"
+
+#include "asic_rx.h"
+#include "crc.h"
+#include "global_state.h"
+#include "mining.h"
+#include "serial.h"
+#include "utils.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "frequency_transition_bmXX.h"
+#include "job_encoder.h"
+#include "pll.h"
+#include "register_poll.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#define BM_CHIP_ID 0x00
+#define PLL0_PARAMETER 0x08
+#define HASH_COUNTING_NUMBER 0x10
+#define MISC_CONTROL 0x18
+#define VERSION_ROLLING 0xA4
+
+#define WRITE_RETRY_DELAY_MS 50
+
+#define BAUD_PROBE_READS 16
+#define BAUD_PROBE_TIMEOUT_MS 50
+#define BAUD_SETTLE_MS 10
+#define BAUD_FALLBACK_WRITES 3 // the chain may already be losing bytes at the rate we are leaving
+#define BAUD_MONITOR_MIN_FRAMES 500
+#define BAUD_MONITOR_MAX_ERROR_PERMILLE 10
+
+#define REGISTER_POLL_READS_PER_JOB 4  // a read is 7 bytes on the wire, a job 88
+#define REGISTER_POLL_FALLBACK_MS 500  // polled without jobs once this overdue, e.g. while no pool is up
+
+#define BATCH_BUFFER_SIZE 512          // ~70 commands, well inside the UART TX ring
+
+static const bm13xx_chip_t * chip;
+
+// All chains carry the same chip, everything else is kept per chain
+typedef struct
+{
+    uint8_t address_interval;       // spacing of the assigned chip addresses
+    uint8_t nonce_address_interval; // spacing of the chip field inside nonces
+    uint32_t prev_nonce;
+    uint8_t id;
+    job_encoder_t job_encoder;      // the last job packet, see BM13XX_send_work()
+
+    int baud_step;                  // index into chip->baud_steps, -1 when not negotiated
+
+    // register reads ride along behind job packets, see poll_registers()
+    register_poll_t register_poll;
+    asic_rx_stats_t baud_window;    // RX stats at the start of the monitoring window
+
+    // held across every UART write, and across a whole baud switch so no other
+    // task's packet goes out at a rate the chain is leaving
+    SemaphoreHandle_t tx_lock;
+
+    // init sequences queue their packets here and go out in one UART write, see BM13XX_batch_begin()
+    uint8_t batch_buffer[BATCH_BUFFER_SIZE];
+    size_t batch_length;
+    TaskHandle_t batch_owner;
+} chain_state_t;
+
+static chain_state_t chains[ASIC_CHAIN_COUNT];
+static pthread_mutex_t register_poll_lock = PTHREAD_MUTEX_INITIALIZER; // guards every chain's register_poll
+
+static inline uint32_t _field(uint32_t value, bm13xx_field_t field)
+{
+    return (value & field.mask) >> field.shift;
+}
+
+void BM13XX_select_chip(const bm13xx_chip_t * selected)
+{
+    chip = selected;
+
+    for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        chain_state_t * state = &chains[chain];
+        state->address_interval = 0;
+        state->nonce_address_interval = 0;
+        state->prev_nonce = 0;
+        state->id = 0;
+        state->baud_step = -1;
+        job_encoder_reset(&state->job_encoder);
+        if (state->tx_lock == NULL) {
+            state->tx_lock = xSemaphoreCreateRecursiveMutex();
+        }
+
+        pthread_mutex_lock(&register_poll_lock);
+        register_poll_init(&state->register_poll, chip->register_map, chip->register_map_size, 1, esp_timer_get_time());
+        pthread_mutex_unlock(&register_poll_lock);
+    }
+}
+
+const bm13xx_chip_t * BM13XX_chip(void)
+{
+    return chip;
+}
+
+static bool transmit(uint8_t chain, uint8_t * data, int length, bool debug)
+{
+    SemaphoreHandle_t tx_lock = chains[chain].tx_lock;
+    uint8_t attempts = chip->write_attempts > 0 ? chip->write_attempts : 1;
+
+    xSemaphoreTakeRecursive(tx_lock, portMAX_DELAY);
+    for (uint8_t attempt = 1; attempt <= attempts; attempt++) {
+        int bytes_written = SERIAL_send(chain, data, length, debug);
+        if (bytes_written == length) {
+            xSemaphoreGiveRecursive(tx_lock);
+            return true;
+        }
+
+        ESP_LOGW(chip->name, "Chain %u write failed (%d/%d bytes), attempt %u/%u", chain, bytes_written, length, attempt, attempts);
+        if (attempt < attempts) {
+            vTaskDelay(pdMS_TO_TICKS(WRITE_RETRY_DELAY_MS));
+        }
+    }
+    xSemaphoreGiveRecursive(tx_lock);
+
+    ESP_LOGE(chip->name, "Failed to send data to ASIC");
+    return false;
+}
+
+static bool flush_batch(uint8_t chain)
+{
+    chain_state_t * state = &chains[chain];
+
+    if (state->batch_length == 0) {
+        return true;
+    }
+
+    bool sent = transmit(chain, state->batch_buffer, state->batch_length, BM13XX_SERIALTX_DEBUG);
+    state->batch_length = 0;
+    return sent;
+}
+
+/**
+ * Queues the packets the calling task sends from here on, so a whole init
+ * sequence leaves in a few large UART writes instead of one per command.
+ * Flush before anything that waits on the chips: a read, a delay or a baud
+ * change.
+ */
+void BM13XX_batch_begin(uint8_t chain)
+{
+    chains[chain].batch_length = 0;
+    chains[chain].batch_owner = xTaskGetCurrentTaskHandle();
+}
+
+// Sends whatever was queued and ends the batch
+bool BM13XX_batch_flush(uint8_t chain)
+{
+    bool sent = flush_batch(chain);
+    chains[chain].batch_owner = NULL;
+    return sent;
+}
+
+static bool send_framed(uint8_t chain, uint8_t * packet, uint8_t length, bool debug)
+{
+    chain_state_t * state = &chains[chain];
+
+    // only the batching task queues, anything else (e.g. a frequency ramp) goes straight out
+    if (state->batch_owner != NULL && state->batch_owner == xTaskGetCurrentTaskHandle()) {
+        if (state->batch_length + length > sizeof(state->batch_buffer) && !flush_batch(chain)) {
+            return false;
+        }
+        memcpy(state->batch_buffer + state->batch_length, packet, length);
+        state->batch_length += length;
+        return true;
+    }
+
+    return transmit(chain, packet, length, debug);
+}
+
+bool BM13XX_send(uint8_t chain, uint8_t header, const uint8_t * data, uint8_t data_len, bool debug)
+{
+    packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
+    const uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
+
+    uint8_t buf[total_length];
+
+    // add the preamble
+    buf[0] = 0x55;
+    buf[1] = 0xAA;
+
+    // add the header field
+    buf[2] = header;
+
+    // add the length field
+    buf[3] = (packet_type == JOB_PACKET) ? (data_len + 4) : (data_len + 3);
+
+    // add the data
+    memcpy(buf + 4, data, data_len);
+
+    // add the correct crc type
+    if (packet_type == JOB_PACKET) {
+        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
+        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
+        buf[5 + data_len] = crc16_total & 0xFF;
+    } else {
+        buf[4 + data_len] = crc5(buf + 2, data_len + 2);
+    }
+
+    return send_framed(chain, buf, total_length, debug);
+}
+
+bool BM13XX_write_register(uint8_t chain, uint8_t group, uint8_t chip_address, uint8_t register_address, uint32_t value)
+{
+    uint8_t command[6] = {
+        chip_address,
+        register_address,
+        (uint8_t)(value >> 24),
+        (uint8_t)(value >> 16),
+        (uint8_t)(value >> 8),
+        (uint8_t)value,
+    };
+
+    return BM13XX_send(chain, TYPE_CMD | group | CMD_WRITE, command, sizeof(command), BM13XX_SERIALTX_DEBUG);
+}
+
+bool BM13XX_write_all(uint8_t chain, uint8_t register_address, uint32_t value)
+{
+    return BM13XX_write_register(chain, GROUP_ALL, 0x00, register_address, value);
+}
+
+bool BM13XX_write_chip(uint8_t chain, uint8_t chip_address, uint8_t register_address, uint32_t value)
+{
+    return BM13XX_write_register(chain, GROUP_SINGLE, chip_address, register_address, value);
+}
+
+bool BM13XX_write_all_table(uint8_t chain, const bm13xx_register_write_t * writes, size_t count)
+{
+    bool written = true;
+    for (size_t i = 0; i < count; i++) {
+        written &= BM13XX_write_all(chain, writes[i].register_address, writes[i].value);
+    }
+    return written;
+}
+
+bool BM13XX_write_chip_table(uint8_t chain, uint8_t chip_address, const bm13xx_register_write_t * writes, size_t count)
+{
+    bool written = true;
+    for (size_t i = 0; i < count; i++) {
+        written &= BM13XX_write_chip(chain, chip_address, writes[i].register_address, writes[i].value);
+    }
+    return written;
+}
+
+bool BM13XX_send_chain_inactive(uint8_t chain)
+{
+    const uint8_t command[2] = {0x00, 0x00};
+    return BM13XX_send(chain, TYPE_CMD | GROUP_ALL | CMD_INACTIVE, command, sizeof(command), BM13XX_SERIALTX_DEBUG);
+}
+
+bool BM13XX_set_chip_address(uint8_t chain, uint8_t chip_address)
+{
+    const uint8_t command[2] = {chip_address, 0x00};
+    return BM13XX_send(chain, TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS, command, sizeof(command), BM13XX_SERIALTX_DEBUG);
+}
+
+bool BM13XX_read_chip_id(uint8_t chain)
+{
+    // read register 00 on all chips (should respond AA 55 13 70 00 00 00 00 00 00 0F)
+    const uint8_t command[2] = {0x00, BM_CHIP_ID};
+    return BM13XX_send(chain, TYPE_CMD | GROUP_ALL | CMD_READ, command, sizeof(command), BM13XX_SERIALTX_DEBUG);
+}
+
+int BM13XX_count_chips(uint8_t chain, uint16_t asic_count)
+{
+    return count_asic_chips_with_id_alias(chain, asic_count, chip->chip_id, chip->chip_id_alias, chip->chip_id_response_length);
+}
+
+void BM13XX_set_chain(uint8_t chain, uint8_t chip_count, uint8_t interval)
+{
+    chain_state_t * state = &chains[chain];
+
+    state->address_interval = interval;
+    state->nonce_address_interval = chip_count > 0 ? 256 / chip_count : 0;
+
+    // every chip answers a broadcast read
+    pthread_mutex_lock(&register_poll_lock);
+    register_poll_init(&state->register_poll, chip->register_map, chip->register_map_size, chip_count, esp_timer_get_time());
+    pthread_mutex_unlock(&register_poll_lock);
+}
+
+uint8_t BM13XX_init(GlobalState * GLOBAL_STATE, uint8_t chain)
+{
+    return chip->init(GLOBAL_STATE, chain);
+}
+
+void BM13XX_set_version_mask(uint8_t chain, uint32_t version_mask)
+{
+    if (chip->job_layout == BM13XX_JOB_MIDSTATES) {
+        // versions are rolled through the midstates
+        return;
+    }
+
+    uint32_t versions_to_roll = version_mask >> 13;
+    BM13XX_write_all(chain, VERSION_ROLLING, 0x90000000 | (versions_to_roll & 0xFFFF));
+}
+
+void BM13XX_set_hash_counting_number(uint8_t chain, uint32_t hcn)
+{
+    BM13XX_write_all(chain, HASH_COUNTING_NUMBER, hcn);
+}
+
+void BM13XX_set_nonce_space(uint8_t chain, double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores)
+{
+    switch (chip->hcn_mode) {
+        case BM13XX_HCN_NONE:
+            return;
+        case BM13XX_HCN_FIXED:
+            BM13XX_set_hash_counting_number(chain, chip->hcn_fixed);
+            return;
+        case BM13XX_HCN_NONCE_SPACE:
+            break;
+    }
+
+    int cores_up = _next_power_of_two(cores);
+    int asic_count_up = _next_power_of_two(asic_count);
+
+    // HCN hash counting number (the size of the nonce space)
+    float hcn_space = (float)NONCE_SPACE / cores_up / asic_count_up;
+    double hcn_max = hcn_space * (double)FREQ_MULT / frequency * 0.5f;
+    double hcn_frac = nonce_percent * (hcn_max - chip->hcn_error);
+    uint32_t hcn_register_value = (uint32_t)hcn_frac;
+
+    BM13XX_set_hash_counting_number(chain, hcn_register_value);
+}
+
+static uint32_t pll_register_value(float target_freq, float * actual_freq)
+{
+    uint8_t fb_divider, refdiv, postdiv1, postdiv2;
+
+    pll_get_parameters(target_freq, chip->pll_fb_min, chip->pll_fb_max, &fb_divider, &refdiv, &postdiv1, &postdiv2, actual_freq);
+
+    uint8_t vdo_scale = (fb_divider * FREQ_MULT / refdiv >= 2400) ? 0x50 : 0x40;
+    uint8_t postdiv = (((postdiv1 - 1) & 0xf) << 4) | ((postdiv2 - 1) & 0xf);
+    return ((uint32_t)vdo_scale << 24) |
+           ((uint32_t)fb_divider << 16) |
+           ((uint32_t)refdiv << 8) |
+           postdiv;
+}
+
+bool BM13XX_write_pll(uint8_t chain, float target_freq, float * actual_freq)
+{
+    return BM13XX_write_all(chain, PLL0_PARAMETER, pll_register_value(target_freq, actual_freq));
+}
+
+bool BM13XX_supports_chip_frequency(uint8_t chain)
+{
+    // chips with their own frequency sequence only know how to do it chain wide
+    return chip->send_hash_frequency == NULL && chains[chain].address_interval != 0;
+}
+
+float BM13XX_send_chip_frequency(uint8_t chain, uint8_t asic_nr, float target_freq)
+{
+    if (!BM13XX_supports_chip_frequency(chain)) {
+        return 0;
+    }
+
+    float frequency;
+    BM13XX_write_chip(chain, asic_nr * chains[chain].address_interval, PLL0_PARAMETER, pll_register_value(target_freq, &frequency));
+
+    ESP_LOGI(chip->name, "Setting chain %u chip %d frequency to %g MHz (%g)", chain, asic_nr, target_freq, frequency);
+
+    return frequency;
+}
+
+float BM13XX_send_hash_frequency(uint8_t chain, float target_freq)
+{
+    if (chip->send_hash_frequency != NULL) {
+        return chip->send_hash_frequency(chain, target_freq);
+    }
+
+    float frequency;
+    BM13XX_write_pll(chain, target_freq, &frequency);
+
+    ESP_LOGI(chip->name, "Setting Frequency to %g MHz (%g)", target_freq, frequency);
+
+    return frequency;
+}
+
+// Baud formula = 25M/((denominator+1)*8)
+// The denominator is 5 bits found in the misc_control (bits 8-12)
+int BM13XX_set_default_baud(uint8_t chain)
+{
+    // default divider of 26 (11010) for 115,749
+    BM13XX_write_all(chain, MISC_CONTROL, 0x00007A31);
+    return 115749;
+}
+
+int BM13XX_set_max_baud(uint8_t chain)
+{
+    return chip->set_max_baud(chain);
+}
+
+// A CRC failure always starts or continues a resync, counting both would count it twice
+static uint32_t rx_errors(const asic_rx_stats_t * stats)
+{
+    return stats->resyncs;
+}
+
+// Jobs keep going out from create_jobs_task while the hashrate monitor steps the
+// rate down, so the whole switch runs under the chain's TX lock
+static void baud_switch(uint8_t chain, int step, int writes)
+{
+    const bm13xx_baud_step_t * target = &chip->baud_steps[step];
+    chain_state_t * state = &chains[chain];
+
+    xSemaphoreTakeRecursive(state->tx_lock, portMAX_DELAY);
+    if (state->batch_owner == xTaskGetCurrentTaskHandle()) {
+        flush_batch(chain);
+    }
+    for (int i = 0; i < writes; i++) {
+        BM13XX_write_all(chain, target->register_address, target->value);
+    }
+    SERIAL_set_baud(chain, target->baud);
+    vTaskDelay(pdMS_TO_TICKS(BAUD_SETTLE_MS));
+    state->baud_step = step;
+    xSemaphoreGiveRecursive(state->tx_lock);
+}
+
+// Reads a polled register back from every chip. Errors are the missing
+// responses plus every frame the RX path rejected or resynchronized over.
+static int baud_probe(uint8_t chain, uint16_t asic_count)
+{
+    uint8_t probe_register = 0;
+    while (probe_register < chip->register_map_size && chip->register_map[probe_register] == REGISTER_INVALID) {
+        probe_register++;
+    }
+    if (probe_register == chip->register_map_size) {
+        return 0;
+    }
+
+    // drop whatever the switch left behind
+    uint8_t frame[BM13XX_MAX_RESULT_LENGTH];
+    while (asic_rx_receive(chain, frame, chip->result_length, NULL, 0) == ESP_OK) {
+    }
+
+    asic_rx_stats_t before;
+    get_receive_work_stats(chain, &before);
+
+    int missing = 0;
+    for (int i = 0; i < BAUD_PROBE_READS; i++) {
+        BM13XX_send(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, probe_register}, 2, BM13XX_SERIALTX_DEBUG);
+
+        int received = 0;
+        while (received < asic_count && asic_rx_receive(chain, frame, chip->result_length, NULL, BAUD_PROBE_TIMEOUT_MS) == ESP_OK) {
+            if (!(frame[chip->result_length - 1] & 0x80) && frame[7] == probe_register) {
+                received++;
+            }
+        }
+        missing += asic_count - received;
+    }
+
+    asic_rx_stats_t after;
+    get_receive_work_stats(chain, &after);
+
+    return missing + (int)(rx_errors(&after) - rx_errors(&before));
+}
+
+// Needs the RX path running and nothing else talking to the chain
+int BM13XX_negotiate_baud(uint8_t chain, uint16_t asic_count)
+{
+    chain_state_t * state = &chains[chain];
+    int baud;
+
+    if (chip->baud_step_count == 0) {
+        state->baud_step = -1;
+        baud = chip->set_max_baud(chain);
+        SERIAL_set_baud(chain, baud);
+        vTaskDelay(pdMS_TO_TICKS(BAUD_SETTLE_MS));
+
+        int errors = baud_probe(chain, asic_count);
+        if (errors > 0) {
+            ESP_LOGW(chip->name, "Chain %u: %d errors in %d register reads at %d baud", chain, errors, BAUD_PROBE_READS * asic_count, baud);
+        }
+    } else {
+        // climb from the slowest rate and stop at the first one that loses anything
+        int reliable = 0;
+        for (int step = 0; step < chip->baud_step_count; step++) {
+            baud_switch(chain, step, 1);
+
+            int errors = baud_probe(chain, asic_count);
+            ESP_LOGI(chip->name, "Chain %u baud %d: %d errors in %d register reads", chain, chip->baud_steps[step].baud, errors, BAUD_PROBE_READS * asic_count);
+            if (errors > 0) {
+                break;
+            }
+            reliable = step;
+        }
+
+        if (state->baud_step != reliable) {
+            baud_switch(chain, reliable, BAUD_FALLBACK_WRITES);
+        }
+        baud = chip->baud_steps[reliable].baud;
+        ESP_LOGI(chip->name, "Chain %u settled on %d baud", chain, baud);
+    }
+
+    get_receive_work_stats(chain, &state->baud_window);
+    return baud;
+}
+
+// Called periodically while mining, steps down one rate when the RX error rate rises
+void BM13XX_check_baud(uint8_t chain)
+{
+    chain_state_t * state = &chains[chain];
+    asic_rx_stats_t now;
+    get_receive_work_stats(chain, &now);
+
+    uint32_t frames = now.frames - state->baud_window.frames;
+    uint32_t errors = rx_errors(&now) - rx_errors(&state->baud_window);
+    if (frames + errors < BAUD_MONITOR_MIN_FRAMES) {
+        return;
+    }
+    state->baud_window = now;
+
+    if (errors * 1000 <= (frames + errors) * BAUD_MONITOR_MAX_ERROR_PERMILLE) {
+        return;
+    }
+
+    if (state->baud_step <= 0) {
+        ESP_LOGW(chip->name, "Chain %u: %lu RX errors in %lu frames, no slower rate to fall back to", chain, (unsigned long)errors, (unsigned long)frames);
+        return;
+    }
+
+    ESP_LOGW(chip->name, "Chain %u: %lu RX errors in %lu frames, falling back to %d baud", chain, (unsigned long)errors, (unsigned long)frames, chip->baud_steps[state->baud_step - 1].baud);
+    baud_switch(chain, state->baud_step - 1, BAUD_FALLBACK_WRITES);
+    get_receive_work_stats(chain, &state->baud_window);
+}
+
+// Reads whatever registers are due, the answers come back through process_work
+static void poll_registers(uint8_t chain, int max, int64_t min_overdue_us)
+{
+    uint8_t addresses[REGISTER_POLL_MAX];
+
+    pthread_mutex_lock(&register_poll_lock);
+    int count = register_poll_due(&chains[chain].register_poll, esp_timer_get_time(), min_overdue_us, addresses, max);
+    pthread_mutex_unlock(&register_poll_lock);
+
+    for (int i = 0; i < count; i++) {
+        BM13XX_send(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, addresses[i]}, 2, BM13XX_SERIALTX_DEBUG);
+    }
+}
+
+void BM13XX_send_work(GlobalState * GLOBAL_STATE, uint8_t chain, bm_job * next_bm_job)
+{
+    chain_state_t * state = &chains[chain];
+
+    // max job number is 128
+    // the job id bits the chip echoes back depend on the chip, hence the per-chip step
+    state->id = (state->id + chip->job_id_step) % ASIC_JOB_IDS;
+    uint8_t id = state->id;
+    int slot = ASIC_JOB_SLOT(chain, id);
+
+    uint8_t length = job_encoder_encode(&state->job_encoder, chip->job_layout, id, next_bm_job);
+
+    // Hold valid_jobs_lock across the free + reassignment so the result task
+    // (which snapshots active_jobs[slot] under the same lock) can never observe
+    // or copy a slot we are freeing/replacing here. valid_jobs is set inside the
+    // same critical section so validity and the pointer stay consistent.
+    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
+    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[slot] != NULL) {
+        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[slot]);
+    }
+    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[slot] = next_bm_job;
+    GLOBAL_STATE->valid_jobs[slot] = 1;
+    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+
+    //debug sent jobs - this can get crazy if the interval is short
+    #if BM13XX_DEBUG_JOBS
+    ESP_LOGI(chip->name, "Send Job: %u/%02X", chain, id);
+    #endif
+
+    send_framed(chain, state->job_encoder.packet, length, BM13XX_DEBUG_WORK);
+
+    // the job is on its way, the next one is a job interval off: room for a few reads
+    poll_registers(chain, REGISTER_POLL_READS_PER_JOB, 0);
+}
+
+esp_err_t BM13XX_process_work(GlobalState * GLOBAL_STATE, uint8_t chain, uint32_t timeout_ms, task_result * result)
+{
+    chain_state_t * state = &chains[chain];
+
+    // Result frame layout (the version bytes are missing on midstate chips):
+    //   0-1   preamble
+    //   2-5   nonce          | register value
+    //   6     midstate_num   | asic address
+    //   7     id             | register address
+    //   8-9   version        |
+    //   last  crc:5, is_job_response:1 (msb)
+    uint8_t frame[BM13XX_MAX_RESULT_LENGTH] = {0};
+
+    memset(result, 0, sizeof(task_result));
+    result->chain = chain;
+
+    if (asic_rx_receive(chain, frame, chip->result_length, &result->timestamp_us, timeout_ms) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    uint32_t word;
+    memcpy(&word, frame + 2, 4);
+    bool is_job_response = frame[chip->result_length - 1] & 0x80;
+
+    if (!is_job_response) {
+        uint8_t register_address = frame[7];
+        if (register_address >= chip->register_map_size || chip->register_map[register_address] == REGISTER_INVALID) {
+            ESP_LOGW(chip->name, "Unknown register read: %02x", register_address);
+            return ESP_ERR_NOT_FOUND;
+        }
+        result->register_type = chip->register_map[register_address];
+        result->asic_nr = state->address_interval ? frame[6] / state->address_interval : 0;
+        result->value = ntohl(word);
+
+        pthread_mutex_lock(&register_poll_lock);
+        register_poll_response(&state->register_poll, register_address, result->timestamp_us);
+        pthread_mutex_unlock(&register_poll_lock);
+
+        return ESP_OK;
+    }
+
+    uint8_t rx_id = frame[7];
+    uint8_t job_id = _field(rx_id, chip->result_job_id);
+    uint32_t nonce_h = ntohl(word);
+    int slot = ASIC_JOB_SLOT(chain, job_id);
+
+    // Read active_jobs[slot] under the lock: send_work() can free and replace
+    // this slot from the create-jobs task, so snapshot the fields we need.
+    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
+    if (GLOBAL_STATE->valid_jobs[slot] == 0 || GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[slot] == NULL) {
+        pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+        ESP_LOGW(chip->name, "Invalid job nonce found, %u/0x%02X", chain, job_id);
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[slot]->version;
+    uint32_t version_mask = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[slot]->version_mask;
+    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+
+    if (chip->job_layout == BM13XX_JOB_MIDSTATES) {
+        // ASIC may return the same nonce multiple times
+        if (word == state->prev_nonce) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        state->prev_nonce = word;
+
+        uint8_t rx_midstate_index = _field(rx_id, chip->result_midstate);
+        for (int i = 0; i < rx_midstate_index; i++) {
+            rolled_version = increment_bitmask(rolled_version, version_mask);
+        }
+    } else {
+        uint32_t version_bits = ((frame[8] << 8) | frame[9]) << 13; // shift the 16 bit value left 13
+        rolled_version |= version_bits;
+    }
+
+    result->job_id = job_id;
+    result->nonce = word;
+    result->rolled_version = rolled_version;
+    result->asic_nr = state->nonce_address_interval ? _field(nonce_h, chip->nonce_chip_address) / state->nonce_address_interval : 0;
+    result->core_id = _field(nonce_h, chip->nonce_core_id);
+    result->small_core_id = _field(rx_id, chip->result_small_core);
+
+    return ESP_OK;
+}
+
+void BM13XX_read_registers(uint8_t chain)
+{
+    // normally send_work has long taken care of these
+    poll_registers(chain, REGISTER_POLL_MAX, REGISTER_POLL_FALLBACK_MS * 1000LL);
+}
+
+void BM13XX_get_register_poll_stats(uint8_t chain, register_poll_stats_t * stats)
+{
+    pthread_mutex_lock(&register_poll_lock);
+    *stats = chains[chain].register_poll.stats;
+    pthread_mutex_unlock(&register_poll_lock);
+}
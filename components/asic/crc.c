@@ -1,9 +1,10 @@
+#include "sdkconfig.h"
 
 #include "crc.h"
-
+#include "crc_tables.h"
 
 // Poly x⁵ + x² + 1 MSB-first
-uint8_t crc5(uint8_t *data, uint8_t len) {
+uint8_t crc5_reference(const uint8_t *data, uint8_t len) {
 
     uint8_t crc = 0x1F;
     uint8_t bit_counter, byte_counter;
@@ -23,33 +24,81 @@ uint8_t crc5(uint8_t *data, uint8_t len) {
     return crc;
 }
 
-// with loop unrolling
-uint16_t crc16(uint8_t *data, uint16_t len)
+// Poly 0x1021 MSB-first
+uint16_t crc16_update_reference(uint16_t crc, const uint8_t *data, uint16_t len)
 {
-    uint16_t crc = 0;
-
-    while(len >= 4) {
-        crc = crc16_table[(crc >> 8) ^ *data++] ^ (crc << 8);
-        crc = crc16_table[(crc >> 8) ^ *data++] ^ (crc << 8);
-        crc = crc16_table[(crc >> 8) ^ *data++] ^ (crc << 8);
-        crc = crc16_table[(crc >> 8) ^ *data++] ^ (crc << 8);
-        len -= 4;
+    while(len--) {
+        crc ^= *data++ << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+// The table kernels run the CRC5 in the top bits of a byte, so one lookup
+// per data byte replaces the eight shifts.
+uint8_t crc5(uint8_t *data, uint8_t len) {
+#if defined(CONFIG_ASIC_CRC_BITWISE)
+    return crc5_reference(data, len);
+#else
+    uint8_t crc = 0x1F << 3;
+
+#if defined(CONFIG_ASIC_CRC_SLICE_BY_8)
+    while(len >= 8) {
+        crc = CRC5_TABLES[7][crc ^ data[0]] ^ CRC5_TABLES[6][data[1]] ^
+              CRC5_TABLES[5][data[2]] ^ CRC5_TABLES[4][data[3]] ^
+              CRC5_TABLES[3][data[4]] ^ CRC5_TABLES[2][data[5]] ^
+              CRC5_TABLES[1][data[6]] ^ CRC5_TABLES[0][data[7]];
+        data += 8;
+        len -= 8;
     }
+#endif
 
     while(len--) {
-        crc = crc16_table[(crc >> 8) ^ *data++] ^ (crc << 8);
+        crc = CRC5_TABLES[0][crc ^ *data++];
     }
 
-    return crc;
+    return crc >> 3;
+#endif
+}
+
+uint16_t crc16(uint8_t *data, uint16_t len)
+{
+    return crc16_update(0, data, len);
 }
 
 uint16_t crc16_false(uint8_t *data, uint16_t len)
 {
-    uint16_t crc = 0xFFFF;
+    return crc16_update(0xFFFF, data, len);
+}
+
+// continues a CRC16 from a previous state, crc16_false() starts at 0xFFFF
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, uint16_t len)
+{
+#if defined(CONFIG_ASIC_CRC_BITWISE)
+    return crc16_update_reference(crc, data, len);
+#else
+
+#if defined(CONFIG_ASIC_CRC_SLICE_BY_8)
+    // the state folds into the first two bytes, the other six are looked up
+    // by how many bytes still follow them in the block
+    while(len >= 8) {
+        crc ^= (data[0] << 8) | data[1];
+        crc = CRC16_TABLES[7][crc >> 8] ^ CRC16_TABLES[6][crc & 0xFF] ^
+              CRC16_TABLES[5][data[2]] ^ CRC16_TABLES[4][data[3]] ^
+              CRC16_TABLES[3][data[4]] ^ CRC16_TABLES[2][data[5]] ^
+              CRC16_TABLES[1][data[6]] ^ CRC16_TABLES[0][data[7]];
+        data += 8;
+        len -= 8;
+    }
+#endif
 
     while(len--) {
-        crc = crc16_table[(crc >> 8) ^ *data++] ^ (crc << 8);
+        crc = CRC16_TABLES[0][(crc >> 8) ^ *data++] ^ (crc << 8);
     }
 
     return crc;
+#endif
 }
@@ -2,52 +2,155 @@
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include <math.h>
 #include "global_state.h"
 
 #define EPSILON 0.0001f
 #define STEP_SIZE 6.25 // MHz step size
+#define STEP_INTERVAL_MS 100
+#define WAIT_POLL_MS 10
+
+#define RAMP_TASK_STACK_SIZE 3072
+#define RAMP_TASK_PRIORITY 10
 
 static const char * TAG = "frequency_transition";
 
-void do_frequency_transition(GlobalState * GLOBAL_STATE, set_hash_frequency_fn set_frequency_fn)
+// Everything below is shared between the callers and the ramp task, under ramp_lock
+static SemaphoreHandle_t ramp_lock;
+static TaskHandle_t ramp_task_handle;
+
+static GlobalState * ramp_state;
+static set_hash_frequency_fn ramp_set_frequency_fn;
+static frequency_transition_done_fn ramp_done_fn;
+static float ramp_target;
+static float ramp_commanded; // last frequency written, actual_frequency is what the PLL made of it
+static volatile bool ramp_active;
+
+// Next point on the 6.25 MHz grid towards the target, or the target itself once within a step
+static float next_frequency(float current, float target)
 {
-    float target_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
-    float current_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency;
+    if (fabs(target - current) < STEP_SIZE) {
+        return target;
+    }
 
-    if (fabs(current_frequency - target_frequency) < EPSILON) {
-        return;
+    float next;
+    if (target > current) {
+        next = (floor(current / STEP_SIZE + EPSILON) + 1) * STEP_SIZE;
+        return next > target - EPSILON ? target : next;
     }
 
-    if (fabs(target_frequency - current_frequency) < STEP_SIZE) {
-        current_frequency = target_frequency;
-        GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency = set_frequency_fn(current_frequency);
-        return;
+    next = (ceil(current / STEP_SIZE - EPSILON) - 1) * STEP_SIZE;
+    return next < target + EPSILON ? target : next;
+}
+
+// Writes one step, returns false once the ramp has landed
+static bool ramp_step(void)
+{
+    xSemaphoreTake(ramp_lock, portMAX_DELAY);
+    if (!ramp_active) {
+        xSemaphoreGive(ramp_lock);
+        return false;
     }
+    GlobalState * GLOBAL_STATE = ramp_state;
+    set_hash_frequency_fn set_frequency_fn = ramp_set_frequency_fn;
+    float frequency = next_frequency(ramp_commanded, ramp_target);
+    xSemaphoreGive(ramp_lock);
 
-    ESP_LOGI(TAG, "Ramping up frequency from %g MHz to %g MHz", current_frequency, target_frequency);
+    // the PLL write goes out without the lock so a retarget never waits on the UART
+    float actual_frequency = set_frequency_fn(frequency);
 
-    int current_step = (target_frequency > current_frequency) ? (int)floor(current_frequency / STEP_SIZE) : (int)ceil(current_frequency / STEP_SIZE);
-    int target_step = (target_frequency > current_frequency) ? (int)floor(target_frequency / STEP_SIZE) : (int)ceil(target_frequency / STEP_SIZE);
+    xSemaphoreTake(ramp_lock, portMAX_DELAY);
+    GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency = actual_frequency;
+    ramp_commanded = frequency;
 
-    if (current_step != target_step) {
-        int signum = (target_frequency > current_frequency) ? 1 : -1;
-        
-        while ((signum > 0 && current_step < target_step) ||
-               (signum < 0 && current_step > target_step)) {
-            current_step += signum;
+    // a retarget that came in during the write keeps the ramp going
+    bool landed = fabs(ramp_commanded - ramp_target) < EPSILON;
+    frequency_transition_done_fn done_fn = ramp_done_fn;
+    if (landed) {
+        ramp_active = false;
+        GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_ramping = false;
+    }
+    xSemaphoreGive(ramp_lock);
 
-            current_frequency = current_step * STEP_SIZE;
-            GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency = set_frequency_fn(current_frequency);
-            
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+    if (landed) {
+        ESP_LOGI(TAG, "Successfully transitioned to %g MHz", frequency);
+        if (done_fn != NULL) {
+            done_fn(GLOBAL_STATE);
         }
     }
-    
-    if (fabs(current_frequency - target_frequency) > EPSILON) {
-        current_frequency = target_frequency;
-        GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency = set_frequency_fn(current_frequency);
+
+    return !landed;
+}
+
+static void ramp_task(void * pvParameters)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        TickType_t last_step = xTaskGetTickCount();
+        while (ramp_step()) {
+            vTaskDelayUntil(&last_step, pdMS_TO_TICKS(STEP_INTERVAL_MS));
+        }
     }
-    
-    ESP_LOGI(TAG, "Successfully transitioned to %g MHz", target_frequency);
+}
+
+void frequency_transition_start(GlobalState * GLOBAL_STATE, set_hash_frequency_fn set_frequency_fn, frequency_transition_done_fn done_fn)
+{
+    // the first ramp is started by the ASIC init, before anything else can race us here
+    if (ramp_task_handle == NULL) {
+        ramp_lock = xSemaphoreCreateMutex();
+        if (ramp_lock == NULL ||
+            xTaskCreate(ramp_task, "freq ramp", RAMP_TASK_STACK_SIZE, NULL, RAMP_TASK_PRIORITY, &ramp_task_handle) != pdPASS) {
+            ESP_LOGE(TAG, "Error creating frequency ramp task");
+            return;
+        }
+    }
+
+    float target_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
+
+    xSemaphoreTake(ramp_lock, portMAX_DELAY);
+    if (ramp_active) {
+        ESP_LOGI(TAG, "Retargeting frequency ramp from %g MHz to %g MHz", ramp_target, target_frequency);
+    } else {
+        float current_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency;
+        if (fabs(current_frequency - target_frequency) < EPSILON) {
+            xSemaphoreGive(ramp_lock);
+            return;
+        }
+        ESP_LOGI(TAG, "Ramping frequency from %g MHz to %g MHz", current_frequency, target_frequency);
+        ramp_commanded = current_frequency;
+        ramp_active = true;
+    }
+    ramp_state = GLOBAL_STATE;
+    ramp_set_frequency_fn = set_frequency_fn;
+    ramp_done_fn = done_fn;
+    ramp_target = target_frequency;
+    GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_ramping = true;
+    xSemaphoreGive(ramp_lock);
+
+    xTaskNotifyGive(ramp_task_handle);
+}
+
+bool frequency_transition_is_active(void)
+{
+    return ramp_active;
+}
+
+bool frequency_transition_wait(uint32_t timeout_ms)
+{
+    TickType_t start = xTaskGetTickCount();
+    while (ramp_active) {
+        if (timeout_ms != FREQUENCY_TRANSITION_WAIT_FOREVER && xTaskGetTickCount() - start >= pdMS_TO_TICKS(timeout_ms)) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(WAIT_POLL_MS));
+    }
+    return true;
+}
+
+void do_frequency_transition(GlobalState * GLOBAL_STATE, set_hash_frequency_fn set_frequency_fn)
+{
+    frequency_transition_start(GLOBAL_STATE, set_frequency_fn, NULL);
+    frequency_transition_wait(FREQUENCY_TRANSITION_WAIT_FOREVER);
 }
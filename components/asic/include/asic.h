@@ -3,17 +3,34 @@
 
 #include <esp_err.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef struct GlobalState GlobalState;
 typedef struct task_result task_result;
+typedef struct result_ring_stats_t result_ring_stats_t;
 typedef struct bm_job bm_job;
 
+// Brings up every chain, returns the chips found on all of them
 uint8_t ASIC_init(GlobalState * GLOBAL_STATE);
-task_result * ASIC_process_work(GlobalState * GLOBAL_STATE);
-int ASIC_set_max_baud(GlobalState * GLOBAL_STATE);
+// Chips per chain, DEVICE_CONFIG.family.asic_count split evenly
+uint16_t ASIC_get_chain_asic_count(GlobalState * GLOBAL_STATE);
+// Producer, one per chain: decodes the frames the chain sent, waiting for the
+// first one, and queues the results. Returns how many were queued.
+int ASIC_process_work(GlobalState * GLOBAL_STATE, uint8_t chain);
+// Consumer: takes a queued result from the chains in turn, false when none
+// came within timeout_ms. asic_nr counts across all chains.
+bool ASIC_take_result(GlobalState * GLOBAL_STATE, task_result * result, uint32_t timeout_ms);
+void ASIC_get_result_stats(GlobalState * GLOBAL_STATE, result_ring_stats_t * stats);
+esp_err_t ASIC_start_rx(GlobalState * GLOBAL_STATE);
+void ASIC_stop_rx(GlobalState * GLOBAL_STATE);
+int ASIC_negotiate_baud(GlobalState * GLOBAL_STATE);
+void ASIC_check_baud(GlobalState * GLOBAL_STATE);
 void ASIC_send_work(GlobalState * GLOBAL_STATE, bm_job * next_job);
 void ASIC_set_version_mask(GlobalState * GLOBAL_STATE, uint32_t mask);
 void ASIC_set_frequency(GlobalState * GLOBAL_STATE);
+void ASIC_wait_frequency(GlobalState * GLOBAL_STATE);
+bool ASIC_supports_chip_frequency(GlobalState * GLOBAL_STATE);
+float ASIC_set_chip_frequency(GlobalState * GLOBAL_STATE, uint8_t asic_nr, float frequency);
 void ASIC_set_nonce_space(GlobalState * GLOBAL_STATE);
 double ASIC_get_asic_job_frequency_ms(GlobalState * GLOBAL_STATE);
 void ASIC_read_registers(GlobalState * GLOBAL_STATE);
@@ -4,9 +4,17 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "sdkconfig.h"
 
 static const double NONCE_SPACE = 4294967296.0; //  2^32
 
+#define ASIC_CHAIN_COUNT CONFIG_ASIC_CHAIN_COUNT
+
+// Each chain has its own 7 bit job id space; the job tables in GlobalState
+// hold ASIC_JOB_IDS slots per chain
+#define ASIC_JOB_IDS 128
+#define ASIC_JOB_SLOT(chain, job_id) ((chain) * ASIC_JOB_IDS + (job_id))
+
 typedef enum
 {
     REGISTER_INVALID = 0,
@@ -18,6 +26,7 @@ typedef enum
     REGISTER_DOMAIN_3_COUNT,
     REGISTER_ERROR_COUNT,    // error count register (all)
     REGISTER_PLL_PARAM,      // PLL/clock config readback (BM1370)
+    REGISTER_TEMPERATURE,    // on-die temperature sensor (BM1366,BM1368,BM1370)
 } register_type_t;
 
 typedef struct task_result
@@ -26,6 +35,7 @@ typedef struct task_result
     uint8_t job_id;
     uint32_t nonce;
     uint32_t rolled_version;
+    uint8_t chain;
     // ---- register response
     register_type_t register_type;
     uint8_t asic_nr;
@@ -36,15 +46,38 @@ typedef struct task_result
     uint64_t timestamp_us;
 } task_result;
 
+#define ASIC_RX_BUFFER_SIZE 64
+
+typedef struct
+{
+    uint32_t frames;         // frames that passed the preamble and CRC5 checks
+    uint32_t resyncs;        // times the parser had to hunt for a new preamble
+    uint32_t crc_errors;     // candidate frames rejected by CRC5
+    uint32_t bytes_dropped;  // bytes skipped while resynchronizing
+    uint32_t ring_overflows; // frames lost because the result task fell behind
+    uint32_t uart_overflows; // times the UART driver buffer overflowed and was flushed
+} asic_rx_stats_t;
+
+// Streaming result-frame parser. Bytes are appended to buf; frames are
+// extracted from the front and garbage is skipped one byte at a time so a
+// glitch never costs the frames queued behind it.
+typedef struct
+{
+    uint8_t buf[ASIC_RX_BUFFER_SIZE];
+    uint16_t len;
+    asic_rx_stats_t stats;
+} asic_frame_parser_t;
+
 unsigned char _reverse_bits(unsigned char num);
 int _largest_power_of_two(int num);
 int _next_power_of_two(int num);
 void clear_asic_chain_error(void);
 const char *get_asic_chain_error(void);
-int count_asic_chips(uint16_t asic_count, uint16_t chip_id, int chip_id_response_length);
-int count_asic_chips_with_id_alias(uint16_t asic_count, uint16_t chip_id, uint16_t chip_id_alias, int chip_id_response_length);
-esp_err_t receive_work(uint8_t * buffer, int buffer_size, uint64_t *out_timestamp_us);
+int count_asic_chips(uint8_t chain, uint16_t asic_count, uint16_t chip_id, int chip_id_response_length);
+int count_asic_chips_with_id_alias(uint8_t chain, uint16_t asic_count, uint16_t chip_id, uint16_t chip_id_alias, int chip_id_response_length);
+bool asic_frame_parser_next(asic_frame_parser_t *parser, uint8_t *frame, int frame_size);
 void get_difficulty_mask(double difficulty, uint8_t *job_difficulty_mask);
+bool asic_decode_temperature(uint32_t value, float *temp_c);
 double calculate_bm_timeout_ms(float frequency_mhz, size_t asic_count, size_t small_cores, size_t cores, size_t version_size, float timeout_percent, double default_time_ms);
 
 #endif /* ASIC_COMMON_H_ */
@@ -0,0 +1,42 @@
+#ifndef ASIC_RX_H_
+#define ASIC_RX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+#include "asic_common.h"
+
+#define ASIC_RX_FRAME_MAX 11
+#define ASIC_RX_RING_SIZE 32 // must be a power of two
+#define ASIC_RX_TIMEOUT_MS 10000
+
+typedef struct
+{
+    uint8_t frame[ASIC_RX_FRAME_MAX];
+    uint64_t timestamp_us;
+} asic_rx_frame_t;
+
+// Single-producer single-consumer ring between the RX task and the result
+// task. head is only written by the producer and tail only by the consumer,
+// so neither side ever takes a lock.
+typedef struct
+{
+    asic_rx_frame_t slots[ASIC_RX_RING_SIZE];
+    atomic_uint head;
+    atomic_uint tail;
+} asic_rx_ring_t;
+
+bool asic_rx_ring_push(asic_rx_ring_t *ring, const uint8_t *frame, int frame_size, uint64_t timestamp_us);
+bool asic_rx_ring_pop(asic_rx_ring_t *ring, uint8_t *frame, int frame_size, uint64_t *timestamp_us);
+void asic_rx_ring_discard(asic_rx_ring_t *ring);
+unsigned asic_rx_ring_count(asic_rx_ring_t *ring);
+
+// One RX task and ring per chain
+esp_err_t asic_rx_start(uint8_t chain, int frame_size);
+void asic_rx_stop(uint8_t chain);
+esp_err_t asic_rx_receive(uint8_t chain, uint8_t *buffer, int buffer_size, uint64_t *out_timestamp_us, uint32_t timeout_ms);
+esp_err_t receive_work(uint8_t chain, uint8_t *buffer, int buffer_size, uint64_t *out_timestamp_us);
+void get_receive_work_stats(uint8_t chain, asic_rx_stats_t *stats);
+
+#endif /* ASIC_RX_H_ */
@@ -0,0 +1,188 @@
+#ifndef BM13XX_H_
+#define BM13XX_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "asic_common.h"
+#include "register_poll.h"
+
+typedef struct GlobalState GlobalState;
+typedef struct bm_job bm_job;
+
+#define BM13XX_SERIALTX_DEBUG false
+#define BM13XX_SERIALRX_DEBUG false
+#define BM13XX_DEBUG_WORK false //causes insane amount of debug output
+#define BM13XX_DEBUG_JOBS false //causes insane amount of debug output
+
+#define TYPE_JOB 0x20
+#define TYPE_CMD 0x40
+
+#define GROUP_SINGLE 0x00
+#define GROUP_ALL 0x10
+
+#define CMD_SETADDRESS 0x00
+#define CMD_WRITE 0x01
+#define CMD_READ 0x02
+#define CMD_INACTIVE 0x03
+
+#define BM13XX_MAX_RESULT_LENGTH 11
+
+// Job packet for chips that hash the full block header and roll versions on-chip
+typedef struct __attribute__((__packed__))
+{
+    uint8_t job_id;
+    uint8_t num_midstates;
+    uint8_t starting_nonce[4];
+    uint8_t nbits[4];
+    uint8_t ntime[4];
+    uint8_t merkle_root[32];
+    uint8_t prev_block_hash[32];
+    uint8_t version[4];
+} BM13XX_job;
+
+// Job packet for chips that are fed precomputed midstates (BM1397)
+typedef struct __attribute__((__packed__))
+{
+    uint8_t job_id;
+    uint8_t num_midstates;
+    uint8_t starting_nonce[4];
+    uint8_t nbits[4];
+    uint8_t ntime[4];
+    uint8_t merkle4[4];
+    uint8_t midstate[32];
+    uint8_t midstate1[32];
+    uint8_t midstate2[32];
+    uint8_t midstate3[32];
+} job_packet;
+
+typedef enum
+{
+    BM13XX_JOB_HEADER = 0,   // BM13XX_job, rolled version bits come back with each nonce
+    BM13XX_JOB_MIDSTATES,    // job_packet, the midstate index comes back with each nonce
+} bm13xx_job_layout_t;
+
+typedef enum
+{
+    BM13XX_HCN_NONE = 0,     // no hash counting number register
+    BM13XX_HCN_NONCE_SPACE,  // derived from the nonce space, frequency and chain size
+    BM13XX_HCN_FIXED,        // fixed register value
+} bm13xx_hcn_mode_t;
+
+// Bitfield extracted as (value & mask) >> shift
+typedef struct
+{
+    uint32_t mask;
+    uint8_t shift;
+} bm13xx_field_t;
+
+// One UART speed the chain can be switched to with a single broadcast write
+typedef struct
+{
+    uint8_t register_address;
+    uint32_t value;
+    int baud;
+} bm13xx_baud_step_t;
+
+// One step of a chip init sequence
+typedef struct
+{
+    uint8_t register_address;
+    uint32_t value;
+} bm13xx_register_write_t;
+
+#define BM13XX_TABLE_SIZE(table) (sizeof(table) / sizeof((table)[0]))
+
+/**
+ * @brief Everything that differs between the BM13xx chips.
+ *
+ * Each chip file provides one of these; the shared engine in bm13xx.c does
+ * the framing, job dispatch, result decoding and register polling from it.
+ */
+typedef struct bm13xx_chip
+{
+    const char * name;
+    uint16_t chip_id;
+    uint16_t chip_id_alias;            // alternative CHIP_ID answer, equal to chip_id if none
+    uint8_t chip_id_response_length;
+    uint8_t result_length;             // result frame length including preamble and crc
+
+    // job layout
+    bm13xx_job_layout_t job_layout;
+    uint8_t job_id_step;               // job ids advance by this much, modulo 128
+
+    // result decoding
+    bm13xx_field_t result_job_id;      // from the result id byte
+    bm13xx_field_t result_small_core;  // from the result id byte
+    bm13xx_field_t result_midstate;    // from the result id byte, BM13XX_JOB_MIDSTATES only
+    bm13xx_field_t nonce_chip_address; // from the big-endian nonce
+    bm13xx_field_t nonce_core_id;      // from the big-endian nonce
+
+    // register map, indexed by register address
+    const register_type_t * register_map;
+    size_t register_map_size;
+
+    // PLL feedback divider limits, see pll_get_parameters()
+    uint16_t pll_fb_min;
+    uint16_t pll_fb_max;
+
+    // nonce space
+    bm13xx_hcn_mode_t hcn_mode;
+    uint32_t hcn_fixed;
+    int hcn_error;                     // hash counting slack per clock cycle (HW errata)
+
+    uint8_t write_attempts;            // UART write attempts per packet, 0 means 1
+
+    // baud ladder for negotiation, slowest first; without one set_max_baud is the only fast step
+    const bm13xx_baud_step_t * baud_steps;
+    uint8_t baud_step_count;
+
+    // chip specific sequences
+    uint8_t (*init)(GlobalState * GLOBAL_STATE, uint8_t chain);
+    int (*set_max_baud)(uint8_t chain);
+    float (*send_hash_frequency)(uint8_t chain, float frequency); // NULL for the shared PLL0 write
+} bm13xx_chip_t;
+
+void BM13XX_select_chip(const bm13xx_chip_t * chip);
+const bm13xx_chip_t * BM13XX_chip(void);
+
+// Everything below works on one chain, the chip selected above is shared by all
+// of them. Chip numbers (asic_nr, chip_count, asic_count) count within the chain.
+
+// building blocks for the chip init sequences
+bool BM13XX_send(uint8_t chain, uint8_t header, const uint8_t * data, uint8_t data_len, bool debug);
+bool BM13XX_write_register(uint8_t chain, uint8_t group, uint8_t chip_address, uint8_t register_address, uint32_t value);
+bool BM13XX_write_all(uint8_t chain, uint8_t register_address, uint32_t value);
+bool BM13XX_write_chip(uint8_t chain, uint8_t chip_address, uint8_t register_address, uint32_t value);
+bool BM13XX_write_all_table(uint8_t chain, const bm13xx_register_write_t * writes, size_t count);
+bool BM13XX_write_chip_table(uint8_t chain, uint8_t chip_address, const bm13xx_register_write_t * writes, size_t count);
+void BM13XX_batch_begin(uint8_t chain);
+bool BM13XX_batch_flush(uint8_t chain);
+bool BM13XX_send_chain_inactive(uint8_t chain);
+bool BM13XX_set_chip_address(uint8_t chain, uint8_t chip_address);
+bool BM13XX_read_chip_id(uint8_t chain);
+int BM13XX_count_chips(uint8_t chain, uint16_t asic_count);
+void BM13XX_set_chain(uint8_t chain, uint8_t chip_count, uint8_t address_interval);
+bool BM13XX_write_pll(uint8_t chain, float target_freq, float * actual_freq);
+int BM13XX_set_default_baud(uint8_t chain);
+
+// chip independent operations
+uint8_t BM13XX_init(GlobalState * GLOBAL_STATE, uint8_t chain);
+void BM13XX_send_work(GlobalState * GLOBAL_STATE, uint8_t chain, bm_job * next_bm_job);
+// Decodes the next result frame of the chain into result. ESP_FAIL when none
+// arrived within timeout_ms, ESP_ERR_NOT_FOUND when the frame was dropped.
+esp_err_t BM13XX_process_work(GlobalState * GLOBAL_STATE, uint8_t chain, uint32_t timeout_ms, task_result * result);
+void BM13XX_read_registers(uint8_t chain);
+void BM13XX_get_register_poll_stats(uint8_t chain, register_poll_stats_t * stats);
+void BM13XX_set_version_mask(uint8_t chain, uint32_t version_mask);
+void BM13XX_set_hash_counting_number(uint8_t chain, uint32_t hcn);
+void BM13XX_set_nonce_space(uint8_t chain, double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores);
+float BM13XX_send_hash_frequency(uint8_t chain, float target_freq);
+bool BM13XX_supports_chip_frequency(uint8_t chain);
+float BM13XX_send_chip_frequency(uint8_t chain, uint8_t asic_nr, float target_freq); // 0 when unsupported
+int BM13XX_set_max_baud(uint8_t chain);
+int BM13XX_negotiate_baud(uint8_t chain, uint16_t asic_count);
+void BM13XX_check_baud(uint8_t chain);
+
+#endif /* BM13XX_H_ */
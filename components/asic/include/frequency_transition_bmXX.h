@@ -2,6 +2,7 @@
 #define FREQUENCY_TRANSITION_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct GlobalState GlobalState;
 
@@ -17,11 +18,47 @@ extern const char *FREQUENCY_TRANSITION_TAG;
  */
 typedef float (*set_hash_frequency_fn)(float frequency);
 
+/**
+ * @brief Called from the ramp task once a ramp lands on its target
+ *
+ * @param GLOBAL_STATE Pointer to the GlobalState structure
+ */
+typedef void (*frequency_transition_done_fn)(GlobalState * GLOBAL_STATE);
+
+#define FREQUENCY_TRANSITION_WAIT_FOREVER UINT32_MAX
+
+/**
+ * @brief Start ramping the ASIC frequency towards POWER_MANAGEMENT_MODULE.frequency_value
+ *
+ * Returns immediately. A ramp task steps the PLL in 6.25 MHz increments every
+ * 100 ms, updating actual_frequency after each step, while jobs keep being
+ * dispatched. Calling this again mid-ramp retargets the running ramp from
+ * wherever it currently is. frequency_ramping is set for the duration.
+ *
+ * @param GLOBAL_STATE Pointer to the GlobalState structure
+ * @param set_frequency_fn Function pointer to the appropriate ASIC's set_hash_frequency function
+ * @param done_fn Optional callback once the target is reached, NULL for none
+ */
+void frequency_transition_start(GlobalState * GLOBAL_STATE, set_hash_frequency_fn set_frequency_fn, frequency_transition_done_fn done_fn);
+
+/**
+ * @brief Whether a ramp is still running
+ */
+bool frequency_transition_is_active(void);
+
+/**
+ * @brief Wait for the running ramp to land
+ *
+ * @param timeout_ms Maximum wait, FREQUENCY_TRANSITION_WAIT_FOREVER to wait indefinitely
+ * @return true if no ramp is running anymore
+ */
+bool frequency_transition_wait(uint32_t timeout_ms);
+
 /**
  * @brief Transition the ASIC frequency to a target value
  * 
- * This function gradually adjusts the ASIC frequency to reach the target value,
- * stepping up or down in increments to ensure stability.
+ * Blocking form of frequency_transition_start(), for init sequences that
+ * must not continue before the PLL has settled.
  * 
  * @param GLOBAL_STATE Pointer to the GlobalState structure
  * @param set_frequency_fn Function pointer to the appropriate ASIC's set_hash_frequency function
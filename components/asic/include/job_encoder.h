@@ -0,0 +1,29 @@
+#ifndef JOB_ENCODER_H_
+#define JOB_ENCODER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bm13xx.h"
+#include "mining.h"
+
+// preamble, header, length, job, crc16
+#define JOB_ENCODER_MAX_PACKET (4 + sizeof(job_packet) + 2)
+
+// A framed job packet kept between jobs. The fields that stay the same for a
+// notify are written once, together with the CRC16 of the constant tail
+// (prev block hash and version), so each job only patches what changed.
+typedef struct
+{
+    uint8_t packet[JOB_ENCODER_MAX_PACKET];
+    uint8_t length;              // of the framed packet, 0 while there is no template
+    bm13xx_job_layout_t layout;
+    uint16_t tail_crc;           // CRC16 of the constant tail from a zero state
+} job_encoder_t;
+
+void job_encoder_reset(job_encoder_t * encoder);
+
+// Encodes the job into encoder->packet, ready for the UART. Returns its length.
+uint8_t job_encoder_encode(job_encoder_t * encoder, bm13xx_job_layout_t layout, uint8_t job_id, const bm_job * job);
+
+#endif /* JOB_ENCODER_H_ */
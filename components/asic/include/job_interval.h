@@ -0,0 +1,57 @@
+#ifndef JOB_INTERVAL_H_
+#define JOB_INTERVAL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define JOB_INTERVAL_MIN_MS 10              // a job is ~1 ms on the wire, plus its generation
+#define JOB_INTERVAL_WINDOW_S 60            // measurement window of the online correction
+#define JOB_INTERVAL_MIN_EXPECTED 50        // expected nonces before a window's rate says anything
+#define JOB_INTERVAL_LOW_RATE_SIGMAS 3      // Poisson sigmas below the expected count that mean idle cores
+#define JOB_INTERVAL_DUPLICATE_PERMILLE 10  // duplicates per nonce that mean the chips ran out of work
+#define JOB_INTERVAL_SHRINK 0.75f
+#define JOB_INTERVAL_GROW 0.05f
+#define JOB_INTERVAL_MIN_CORRECTION 0.1f
+#define JOB_INTERVAL_RECENT 32              // results remembered to spot duplicates
+
+// What the chain looks like right now
+typedef struct
+{
+    float frequency_mhz;    // of the fastest chip
+    uint16_t asic_count;
+    uint16_t cores;
+    uint16_t small_cores;
+    uint32_t version_size;  // versions one job covers, rolled by the chips or carried as midstates
+    double nonce_percent;   // share of the nonce space set by ASIC_set_nonce_space()
+} job_interval_chain_t;
+
+// Online correction of the model from the nonces that actually come back.
+// The caller serializes access.
+typedef struct
+{
+    float correction;       // applied to the model, JOB_INTERVAL_MIN_CORRECTION..1
+    int64_t window_start_us;
+    int64_t last_update_us;
+    uint32_t nonces;
+    uint32_t duplicates;
+    uint32_t recent[JOB_INTERVAL_RECENT];
+    uint8_t recent_count;
+    uint8_t recent_head;
+} job_interval_t;
+
+// Time for the chain to search everything one job covers
+double job_interval_model_ms(const job_interval_chain_t * chain);
+
+void job_interval_init(job_interval_t * interval);
+
+// Counts a job result, returns true when the same result already came back recently
+bool job_interval_result(job_interval_t * interval, uint8_t job_id, uint32_t nonce, uint32_t version);
+
+// Closes the measurement window once it is long enough and adjusts the correction.
+// cap_ms is the interval used regardless of the model, INFINITY for none, expected_nonces_per_s what the
+// chain should return at its frequency. Returns true when the correction changed.
+bool job_interval_update(job_interval_t * interval, double model_ms, double cap_ms, double expected_nonces_per_s, int64_t now_us);
+
+double job_interval_ms(const job_interval_t * interval, double model_ms, double cap_ms);
+
+#endif /* JOB_INTERVAL_H_ */
@@ -6,8 +6,23 @@
 
 #define FREQ_MULT 25.0 // MHz
 
+typedef struct
+{
+    uint8_t fb_divider;
+    uint8_t refdiv;
+    uint8_t postdiv1;
+    uint8_t postdiv2;
+    float actual_freq;
+} pll_setting_t;
+
+// Looks the target up in the build-time table first and searches the divider space
+// for frequencies off the 6.25 MHz grid and the configured frequency options
 void pll_get_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max, 
                         uint8_t *fb_divider, uint8_t *refdiv, uint8_t *postdiv1, uint8_t *postdiv2,
                         float *actual_freq);
 
+// The two halves of pll_get_parameters, tools/gen_pll_table.py mirrors the search
+bool pll_lookup_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max, pll_setting_t *setting);
+void pll_search_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max, pll_setting_t *setting);
+
 #endif /* PLL_H_ */
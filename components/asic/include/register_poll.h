@@ -0,0 +1,49 @@
+#ifndef REGISTER_POLL_H_
+#define REGISTER_POLL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "asic_common.h"
+
+#define REGISTER_POLL_MAX 16
+#define REGISTER_POLL_TIMEOUT_MS 200 // a read some chip has not answered by then is given up on
+
+typedef struct
+{
+    uint8_t register_address;
+    uint32_t period_ms;
+    int64_t next_due_us;
+    int64_t issued_us;   // 0 while no read is outstanding
+    uint16_t responses;  // answers to the outstanding read so far
+} register_poll_slot_t;
+
+typedef struct
+{
+    uint32_t reads;          // reads sent
+    uint32_t completed;      // reads every chip answered
+    uint32_t timeouts;       // reads at least one chip never answered
+    uint32_t unexpected;     // answers without an outstanding read
+    uint32_t max_latency_us; // slowest completed read
+} register_poll_stats_t;
+
+// Decides which registers to read when, and matches the answers to the reads.
+// The caller does the sending and serializes access.
+typedef struct
+{
+    register_poll_slot_t slots[REGISTER_POLL_MAX];
+    uint8_t count;
+    uint16_t chip_count;
+    register_poll_stats_t stats;
+} register_poll_t;
+
+uint32_t register_poll_period_ms(register_type_t type);
+
+void register_poll_init(register_poll_t *poll, const register_type_t *register_map, size_t register_map_size, uint16_t chip_count, int64_t now_us);
+
+// Fills addresses with up to max registers that were due at least min_overdue_us ago,
+// most overdue first, and marks them outstanding. Returns how many.
+int register_poll_due(register_poll_t *poll, int64_t now_us, int64_t min_overdue_us, uint8_t *addresses, int max);
+
+void register_poll_response(register_poll_t *poll, uint8_t register_address, int64_t now_us);
+
+#endif /* REGISTER_POLL_H_ */
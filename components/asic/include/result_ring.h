@@ -0,0 +1,37 @@
+#ifndef RESULT_RING_H_
+#define RESULT_RING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "asic_common.h"
+
+#define RESULT_RING_SIZE 64 // must be a power of two
+
+typedef struct result_ring_stats_t
+{
+    uint32_t pushed;     // results handed to the consumer
+    uint32_t overflows;  // results dropped because the ring was full
+    uint32_t high_water; // most results ever waiting at once
+} result_ring_stats_t;
+
+// Single-producer single-consumer ring of decoded results between the task
+// decoding the chain's frames and the one validating and submitting them.
+// Like asic_rx_ring_t, head and tail each have a single writer. The stats
+// are only written by the producer.
+typedef struct
+{
+    task_result slots[RESULT_RING_SIZE];
+    atomic_uint head;
+    atomic_uint tail;
+    result_ring_stats_t stats;
+} result_ring_t;
+
+bool result_ring_push(result_ring_t *ring, const task_result *result);
+bool result_ring_pop(result_ring_t *ring, task_result *result);
+void result_ring_discard(result_ring_t *ring);
+unsigned result_ring_count(result_ring_t *ring);
+void result_ring_get_stats(result_ring_t *ring, result_ring_stats_t *stats);
+
+#endif /* RESULT_RING_H_ */
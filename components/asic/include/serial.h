@@ -1,6 +1,9 @@
 #ifndef SERIAL_H_
 #define SERIAL_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "esp_err.h"
 
 typedef enum
@@ -11,12 +14,14 @@ typedef enum
 
 #define UART_FREQ 115200
 
-int SERIAL_send(uint8_t *, int, bool);
-esp_err_t SERIAL_init(void);
-void SERIAL_debug_rx(void);
-int16_t SERIAL_rx(uint8_t *, uint16_t, uint16_t);
-void SERIAL_clear_buffer(void);
-esp_err_t SERIAL_set_baud(int baud);
-bool SERIAL_is_initialized(void);
+// Every call takes the chain, 0 .. ASIC_CHAIN_COUNT - 1, whose UART it drives
+int SERIAL_send(uint8_t chain, uint8_t *, int, bool);
+esp_err_t SERIAL_init(uint8_t chain);
+void SERIAL_debug_rx(uint8_t chain);
+int16_t SERIAL_rx(uint8_t chain, uint8_t *, uint16_t, uint16_t);
+int SERIAL_wait_rx(uint8_t chain, uint32_t timeout_ms);
+void SERIAL_clear_buffer(uint8_t chain);
+esp_err_t SERIAL_set_baud(uint8_t chain, int baud);
+bool SERIAL_is_initialized(uint8_t chain);
 
 #endif /* SERIAL_H_ */
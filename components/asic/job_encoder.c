@@ -0,0 +1,127 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "crc.h"
+#include "job_encoder.h"
+
+#define JOB_HEADER (TYPE_JOB | GROUP_SINGLE | CMD_WRITE)
+#define JOB_OFFSET 4 // preamble, header, length
+
+// The CRC covers header, length and job. For BM13XX_job everything after the
+// merkle root stays the same for a notify.
+#define TAIL_OFFSET (JOB_OFFSET + offsetof(BM13XX_job, prev_block_hash))
+#define TAIL_LENGTH (sizeof(BM13XX_job) - offsetof(BM13XX_job, prev_block_hash))
+
+// Running a CRC16 over TAIL_LENGTH zero bytes is linear in the starting state:
+// shift(s) = SHIFT_HIGH[s >> 8] ^ SHIFT_LOW[s & 0xff]. With it the CRC of the
+// whole packet is shift(CRC of the head) ^ CRC of the tail from a zero state.
+static uint16_t SHIFT_HIGH[256];
+static uint16_t SHIFT_LOW[256];
+static bool shift_ready;
+
+static uint16_t shift_zeros(uint16_t crc, int count)
+{
+    static const uint8_t zero = 0;
+    while (count--) {
+        crc = crc16_update(crc, &zero, 1);
+    }
+    return crc;
+}
+
+static void build_shift_tables(void)
+{
+    for (int i = 0; i < 256; i++) {
+        SHIFT_HIGH[i] = shift_zeros(i << 8, TAIL_LENGTH);
+        SHIFT_LOW[i] = shift_zeros(i, TAIL_LENGTH);
+    }
+    shift_ready = true;
+}
+
+void job_encoder_reset(job_encoder_t * encoder)
+{
+    memset(encoder, 0, sizeof(*encoder));
+}
+
+static void frame(job_encoder_t * encoder, bm13xx_job_layout_t layout, uint8_t job_length)
+{
+    memset(encoder->packet, 0, sizeof(encoder->packet));
+    encoder->packet[0] = 0x55;
+    encoder->packet[1] = 0xAA;
+    encoder->packet[2] = JOB_HEADER;
+    encoder->packet[3] = job_length + 4;
+    encoder->length = JOB_OFFSET + job_length + 2;
+    encoder->layout = layout;
+}
+
+static void finish(job_encoder_t * encoder, uint16_t crc)
+{
+    encoder->packet[encoder->length - 2] = crc >> 8;
+    encoder->packet[encoder->length - 1] = crc & 0xFF;
+}
+
+static uint8_t encode_header(job_encoder_t * encoder, uint8_t job_id, const bm_job * job)
+{
+    BM13XX_job * packet = (BM13XX_job *)(encoder->packet + JOB_OFFSET);
+
+    // a new notify brings a new tail
+    if (encoder->length == 0 || encoder->layout != BM13XX_JOB_HEADER ||
+        memcmp(packet->prev_block_hash, job->prev_block_hash, 32) != 0 ||
+        memcmp(packet->version, &job->version, 4) != 0 ||
+        memcmp(packet->nbits, &job->target, 4) != 0) {
+        if (!shift_ready) {
+            build_shift_tables();
+        }
+        frame(encoder, BM13XX_JOB_HEADER, sizeof(BM13XX_job));
+        packet->num_midstates = 0x01;
+        memcpy(packet->nbits, &job->target, 4);
+        memcpy(packet->prev_block_hash, job->prev_block_hash, 32);
+        memcpy(packet->version, &job->version, 4);
+        encoder->tail_crc = crc16_update(0, encoder->packet + TAIL_OFFSET, TAIL_LENGTH);
+    }
+
+    packet->job_id = job_id;
+    memcpy(packet->starting_nonce, &job->starting_nonce, 4);
+    memcpy(packet->ntime, &job->ntime, 4);
+    memcpy(packet->merkle_root, job->merkle_root, 32);
+
+    uint16_t head_crc = crc16_update(0xFFFF, encoder->packet + 2, TAIL_OFFSET - 2);
+    finish(encoder, SHIFT_HIGH[head_crc >> 8] ^ SHIFT_LOW[head_crc & 0xFF] ^ encoder->tail_crc);
+
+    return encoder->length;
+}
+
+static uint8_t encode_midstates(job_encoder_t * encoder, uint8_t job_id, const bm_job * job)
+{
+    job_packet * packet = (job_packet *)(encoder->packet + JOB_OFFSET);
+
+    // the midstates follow the merkle root, nothing but the framing carries over
+    if (encoder->length == 0 || encoder->layout != BM13XX_JOB_MIDSTATES) {
+        frame(encoder, BM13XX_JOB_MIDSTATES, sizeof(job_packet));
+    }
+
+    packet->job_id = job_id;
+    packet->num_midstates = job->num_midstates;
+    memcpy(packet->starting_nonce, &job->starting_nonce, 4);
+    memcpy(packet->nbits, &job->target, 4);
+    memcpy(packet->ntime, &job->ntime, 4);
+    memcpy(packet->merkle4, job->merkle_root, 4);
+    memcpy(packet->midstate, job->midstate, 32);
+
+    if (job->num_midstates == 4) {
+        memcpy(packet->midstate1, job->midstate1, 32);
+        memcpy(packet->midstate2, job->midstate2, 32);
+        memcpy(packet->midstate3, job->midstate3, 32);
+    }
+
+    finish(encoder, crc16_update(0xFFFF, encoder->packet + 2, encoder->length - 4));
+
+    return encoder->length;
+}
+
+uint8_t job_encoder_encode(job_encoder_t * encoder, bm13xx_job_layout_t layout, uint8_t job_id, const bm_job * job)
+{
+    if (layout == BM13XX_JOB_MIDSTATES) {
+        return encode_midstates(encoder, job_id, job);
+    }
+    return encode_header(encoder, job_id, job);
+}
@@ -0,0 +1,108 @@
+#include <math.h>
+#include <string.h>
+
+#include "asic_common.h"
+#include "job_interval.h"
+
+double job_interval_model_ms(const job_interval_chain_t * chain)
+{
+    if (chain->asic_count == 0 || chain->cores == 0 || chain->frequency_mhz <= 0) {
+        return 0;
+    }
+
+    // Like calculate_bm_timeout_ms(): the small cores of a core work on different
+    // versions side by side, the cores and chips split the nonce range
+    int cores_up = _next_power_of_two(chain->cores);
+    int small_cores_up = _next_power_of_two(chain->small_cores);
+    int asic_count_up = _next_power_of_two(chain->asic_count);
+
+    double midstates = small_cores_up > cores_up ? (double)small_cores_up / cores_up : 1.0;
+    // with fewer versions than small cores the job still takes one pass over the nonces
+    double serial_versions = fmax((double)chain->version_size / midstates, 1.0);
+    double serial_nonces = NONCE_SPACE * chain->nonce_percent / cores_up / asic_count_up;
+
+    return serial_versions * serial_nonces / (chain->frequency_mhz * 1000.0);
+}
+
+static void start_window(job_interval_t * interval, int64_t now_us)
+{
+    interval->window_start_us = now_us;
+    interval->nonces = 0;
+    interval->duplicates = 0;
+}
+
+void job_interval_init(job_interval_t * interval)
+{
+    memset(interval, 0, sizeof(*interval));
+    interval->correction = 1.0f;
+}
+
+bool job_interval_result(job_interval_t * interval, uint8_t job_id, uint32_t nonce, uint32_t version)
+{
+    uint32_t key = nonce ^ (version * 0x9E3779B1u) ^ ((uint32_t)job_id << 24);
+
+    for (int i = 0; i < interval->recent_count; i++) {
+        if (interval->recent[i] == key) {
+            interval->duplicates++;
+            return true;
+        }
+    }
+
+    interval->recent[interval->recent_head] = key;
+    interval->recent_head = (interval->recent_head + 1) % JOB_INTERVAL_RECENT;
+    if (interval->recent_count < JOB_INTERVAL_RECENT) {
+        interval->recent_count++;
+    }
+    interval->nonces++;
+    return false;
+}
+
+bool job_interval_update(job_interval_t * interval, double model_ms, double cap_ms, double expected_nonces_per_s, int64_t now_us)
+{
+    // jobs stopped going out for a while (no pool, a reset): whatever was counted says nothing.
+    // Without a cap (chips that do not roll versions) the model interval sets the pace.
+    double pace_ms = isinf(cap_ms) ? model_ms : cap_ms;
+    int64_t gap_us = now_us - interval->last_update_us;
+    interval->last_update_us = now_us;
+    if (interval->window_start_us == 0 || gap_us > (int64_t)(fmax(2 * pace_ms, 1000) * 1000)) {
+        start_window(interval, now_us);
+        return false;
+    }
+
+    double window_s = (now_us - interval->window_start_us) / 1e6;
+    if (window_s < JOB_INTERVAL_WINDOW_S) {
+        return false;
+    }
+
+    float correction = interval->correction;
+    double expected = expected_nonces_per_s * window_s;
+    bool model_bound = model_ms * correction < cap_ms;
+
+    if (interval->duplicates * 1000 > (interval->nonces + interval->duplicates) * JOB_INTERVAL_DUPLICATE_PERMILLE) {
+        // the chips went round their search space again before the next job came
+        correction *= JOB_INTERVAL_SHRINK;
+    } else if (model_bound && expected >= JOB_INTERVAL_MIN_EXPECTED &&
+               interval->nonces < expected - JOB_INTERVAL_LOW_RATE_SIGMAS * sqrt(expected)) {
+        // cores sat idle at the end of each job; a short cap means the rate was low for another reason
+        correction *= JOB_INTERVAL_SHRINK;
+    } else {
+        correction += JOB_INTERVAL_GROW;
+    }
+    correction = fminf(fmaxf(correction, JOB_INTERVAL_MIN_CORRECTION), 1.0f);
+
+    start_window(interval, now_us);
+
+    if (correction == interval->correction) {
+        return false;
+    }
+    interval->correction = correction;
+    return true;
+}
+
+double job_interval_ms(const job_interval_t * interval, double model_ms, double cap_ms)
+{
+    if (!(model_ms > 0)) {
+        return cap_ms;
+    }
+    return fmax(fmin(model_ms * interval->correction, cap_ms), JOB_INTERVAL_MIN_MS);
+}
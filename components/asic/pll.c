@@ -3,6 +3,7 @@
 #include <math.h>
 
 #include "pll.h"
+#include "pll_table.h" // generated by tools/gen_pll_table.py
 
 #include "esp_log.h"
 
@@ -10,9 +11,37 @@
 
 static const char * TAG = "pll";
 
-void pll_get_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max, 
-                        uint8_t *fb_divider, uint8_t *refdiv, uint8_t *postdiv1, uint8_t *postdiv2,
-                        float *actual_freq) 
+bool pll_lookup_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max, pll_setting_t *setting)
+{
+    const pll_table_t *table = NULL;
+    for (int i = 0; i < PLL_TABLE_COUNT; i++) {
+        if (PLL_TABLES[i].fb_divider_min == fb_divider_min && PLL_TABLES[i].fb_divider_max == fb_divider_max) {
+            table = &PLL_TABLES[i];
+            break;
+        }
+    }
+    if (table == NULL) {
+        return false;
+    }
+
+    // grid points are exact in float, anything else has to match an option exactly too
+    float step = target_freq / PLL_TABLE_STEP;
+    if (step == floorf(step) && step >= PLL_TABLE_GRID_FIRST && step <= PLL_TABLE_GRID_LAST) {
+        *setting = table->grid[(int)step - PLL_TABLE_GRID_FIRST];
+        return true;
+    }
+
+    for (int i = 0; i < PLL_TABLE_EXTRA_SIZE; i++) {
+        if (PLL_TABLE_EXTRA_FREQUENCIES[i] == target_freq) {
+            *setting = table->extra[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void pll_search_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max, pll_setting_t *setting)
 {
     float best_freq = 0;
     uint8_t best_refdiv = 0, best_fb_divider = 0, best_postdiv1 = 0, best_postdiv2 = 0;
@@ -51,11 +80,30 @@ void pll_get_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_
         }
     }
 
-    ESP_LOGI(TAG, "Frequency: %g MHz (fb_divider: %d, refdiv: %d, postdiv1: %d, postdiv2: %d)", best_freq, best_fb_divider, best_refdiv, best_postdiv1, best_postdiv2);
+    setting->actual_freq = best_freq;
+    setting->fb_divider = best_fb_divider;
+    setting->refdiv = best_refdiv;
+    setting->postdiv1 = best_postdiv1;
+    setting->postdiv2 = best_postdiv2;
+}
+
+void pll_get_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max, 
+                        uint8_t *fb_divider, uint8_t *refdiv, uint8_t *postdiv1, uint8_t *postdiv2,
+                        float *actual_freq) 
+{
+    pll_setting_t setting;
+
+    // the ramp asks for a grid point every step, keep those off the log
+    if (pll_lookup_parameters(target_freq, fb_divider_min, fb_divider_max, &setting)) {
+        ESP_LOGD(TAG, "Frequency: %g MHz (fb_divider: %d, refdiv: %d, postdiv1: %d, postdiv2: %d)", setting.actual_freq, setting.fb_divider, setting.refdiv, setting.postdiv1, setting.postdiv2);
+    } else {
+        pll_search_parameters(target_freq, fb_divider_min, fb_divider_max, &setting);
+        ESP_LOGI(TAG, "Frequency: %g MHz (fb_divider: %d, refdiv: %d, postdiv1: %d, postdiv2: %d)", setting.actual_freq, setting.fb_divider, setting.refdiv, setting.postdiv1, setting.postdiv2);
+    }
 
-    *actual_freq = best_freq;
-    *fb_divider = best_fb_divider;
-    *refdiv = best_refdiv;
-    *postdiv1 = best_postdiv1;
-    *postdiv2 = best_postdiv2;
+    *actual_freq = setting.actual_freq;
+    *fb_divider = setting.fb_divider;
+    *refdiv = setting.refdiv;
+    *postdiv1 = setting.postdiv1;
+    *postdiv2 = setting.postdiv2;
 }
@@ -0,0 +1,109 @@
+#include <string.h>
+
+#include "register_poll.h"
+
+// Counters feeding the per-second hashrate and error figures are read every poll
+// of the hashrate monitor, the rest only as often as anything looks at them
+uint32_t register_poll_period_ms(register_type_t type)
+{
+    switch (type) {
+        case REGISTER_HASHRATE:
+        case REGISTER_TOTAL_COUNT:
+        case REGISTER_ERROR_COUNT:
+            return 1000;
+        case REGISTER_DOMAIN_0_COUNT:
+        case REGISTER_DOMAIN_1_COUNT:
+        case REGISTER_DOMAIN_2_COUNT:
+        case REGISTER_DOMAIN_3_COUNT:
+            return 2000;
+        case REGISTER_TEMPERATURE:
+            return 5000;
+        case REGISTER_PLL_PARAM:
+            return 10000;
+        default:
+            return 0;
+    }
+}
+
+void register_poll_init(register_poll_t *poll, const register_type_t *register_map, size_t register_map_size, uint16_t chip_count, int64_t now_us)
+{
+    memset(poll, 0, sizeof(*poll));
+    poll->chip_count = chip_count > 0 ? chip_count : 1;
+
+    for (size_t address = 0; address < register_map_size && poll->count < REGISTER_POLL_MAX; address++) {
+        uint32_t period_ms = register_poll_period_ms(register_map[address]);
+        if (period_ms == 0) continue;
+
+        register_poll_slot_t *slot = &poll->slots[poll->count++];
+        slot->register_address = address;
+        slot->period_ms = period_ms;
+        slot->next_due_us = now_us;
+    }
+}
+
+static void expire(register_poll_t *poll, int64_t now_us)
+{
+    for (int i = 0; i < poll->count; i++) {
+        register_poll_slot_t *slot = &poll->slots[i];
+        if (slot->issued_us != 0 && now_us - slot->issued_us >= REGISTER_POLL_TIMEOUT_MS * 1000LL) {
+            slot->issued_us = 0;
+            poll->stats.timeouts++;
+        }
+    }
+}
+
+int register_poll_due(register_poll_t *poll, int64_t now_us, int64_t min_overdue_us, uint8_t *addresses, int max)
+{
+    expire(poll, now_us);
+
+    int picked = 0;
+    while (picked < max) {
+        register_poll_slot_t *next = NULL;
+        for (int i = 0; i < poll->count; i++) {
+            register_poll_slot_t *slot = &poll->slots[i];
+            if (slot->issued_us == 0 && now_us - slot->next_due_us >= min_overdue_us &&
+                (next == NULL || slot->next_due_us < next->next_due_us)) {
+                next = slot;
+            }
+        }
+        if (next == NULL) break;
+
+        next->issued_us = now_us;
+        next->responses = 0;
+        next->next_due_us += next->period_ms * 1000LL;
+        if (next->next_due_us <= now_us) {
+            // fell behind by more than a period, don't burst to catch up
+            next->next_due_us = now_us + next->period_ms * 1000LL;
+        }
+
+        addresses[picked++] = next->register_address;
+        poll->stats.reads++;
+    }
+
+    return picked;
+}
+
+void register_poll_response(register_poll_t *poll, uint8_t register_address, int64_t now_us)
+{
+    for (int i = 0; i < poll->count; i++) {
+        register_poll_slot_t *slot = &poll->slots[i];
+        if (slot->register_address != register_address) continue;
+
+        if (slot->issued_us == 0) {
+            poll->stats.unexpected++;
+            return;
+        }
+
+        if (++slot->responses >= poll->chip_count) {
+            uint32_t latency_us = now_us > slot->issued_us ? now_us - slot->issued_us : 0;
+            if (latency_us > poll->stats.max_latency_us) {
+                poll->stats.max_latency_us = latency_us;
+            }
+            poll->stats.completed++;
+            slot->issued_us = 0;
+        }
+        return;
+    }
+
+    poll->stats.unexpected++;
+}
@@ -0,0 +1,56 @@
+#include <string.h>
+
+#include "result_ring.h"
+
+bool result_ring_push(result_ring_t *ring, const task_result *result)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail >= RESULT_RING_SIZE) {
+        ring->stats.overflows++;
+        return false;
+    }
+
+    ring->slots[head & (RESULT_RING_SIZE - 1)] = *result;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    // the consumer can only have shrunk the backlog since tail was loaded
+    unsigned waiting = head + 1 - tail;
+    if (waiting > ring->stats.high_water) {
+        ring->stats.high_water = waiting;
+    }
+    ring->stats.pushed++;
+    return true;
+}
+
+bool result_ring_pop(result_ring_t *ring, task_result *result)
+{
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail) {
+        return false;
+    }
+
+    *result = ring->slots[tail & (RESULT_RING_SIZE - 1)];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// Consumer side only
+void result_ring_discard(result_ring_t *ring)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+}
+
+unsigned result_ring_count(result_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire) - atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+void result_ring_get_stats(result_ring_t *ring, result_ring_stats_t *stats)
+{
+    *stats = ring->stats;
+}
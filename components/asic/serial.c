@@ -10,18 +10,42 @@
 #include "soc/uart_struct.h"
 
 #include "serial.h"
+#include "asic_common.h"
+#include "bm13xx.h"
 #include "utils.h"
 
-#define ECHO_TEST_TXD (17)
-#define ECHO_TEST_RXD (18)
 #define BUF_SIZE (1024)
+#define EVENT_QUEUE_SIZE (32)
+
+// Interrupt as soon as one result frame sits in the RX FIFO, or after the
+// line has been idle for a couple of symbols, instead of waiting for the
+// driver's default 120 byte threshold
+#define RX_FULL_THRESHOLD (BM13XX_MAX_RESULT_LENGTH)
+#define RX_TIMEOUT_SYMBOLS (2)
 
 static const char *TAG = "serial";
 
-esp_err_t SERIAL_init(void)
+typedef struct
+{
+    uart_port_t port;
+    int tx_pin;
+    int rx_pin;
+} chain_port_t;
+
+static const chain_port_t PORTS[ASIC_CHAIN_COUNT] = {
+    {UART_NUM_1, 17, 18},
+#if ASIC_CHAIN_COUNT > 1
+    {UART_NUM_2, CONFIG_ASIC_CHAIN1_TX_GPIO, CONFIG_ASIC_CHAIN1_RX_GPIO},
+#endif
+};
+
+static QueueHandle_t uart_queues[ASIC_CHAIN_COUNT];
+
+esp_err_t SERIAL_init(uint8_t chain)
 {
-    ESP_LOGI(TAG, "Initializing serial");
-    // Configure UART1 parameters
+    uart_port_t port = PORTS[chain].port;
+
+    ESP_LOGI(TAG, "Initializing serial for chain %u", chain);
     uart_config_t uart_config = {
         .baud_rate = UART_FREQ,
         .data_bits = UART_DATA_8_BITS,
@@ -30,35 +54,41 @@ esp_err_t SERIAL_init(void)
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
         .rx_flow_ctrl_thresh = 122,
     };
-    // Configure UART1 parameters
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_param_config(UART_NUM_1, &uart_config));
-    // Set UART1 pins(TX: IO17, RX: I018)
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_pin(UART_NUM_1, ECHO_TEST_TXD, ECHO_TEST_RXD, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_param_config(port, &uart_config));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_pin(port, PORTS[chain].tx_pin, PORTS[chain].rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
 
-    // Install UART driver (we don't need an event queue here)
+    // Install UART driver, the event queue wakes the RX task per frame
     // tx buffer 0 so the tx time doesn't overlap with the job wait time
     //  by returning before the job is written
-    return uart_driver_install(UART_NUM_1, BUF_SIZE * 2, BUF_SIZE * 2, 0, NULL, 0);
+    esp_err_t err = uart_driver_install(port, BUF_SIZE * 2, BUF_SIZE * 2, EVENT_QUEUE_SIZE, &uart_queues[chain], 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_rx_full_threshold(port, RX_FULL_THRESHOLD));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_rx_timeout(port, RX_TIMEOUT_SYMBOLS));
+
+    return ESP_OK;
 }
 
-bool SERIAL_is_initialized(void)
+bool SERIAL_is_initialized(uint8_t chain)
 {
-    return uart_is_driver_installed(UART_NUM_1);
+    return uart_is_driver_installed(PORTS[chain].port);
 }
 
-esp_err_t SERIAL_set_baud(int baud)
+esp_err_t SERIAL_set_baud(uint8_t chain, int baud)
 {
-    ESP_LOGI(TAG, "Changing UART baud to %i", baud);
+    ESP_LOGI(TAG, "Changing chain %u UART baud to %i", chain, baud);
 
     // Make sure that we are done writing before setting a new baudrate.
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_wait_tx_done(UART_NUM_1, 1000 / portTICK_PERIOD_MS));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_wait_tx_done(PORTS[chain].port, 1000 / portTICK_PERIOD_MS));
 
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_baudrate(UART_NUM_1, baud));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_baudrate(PORTS[chain].port, baud));
 
     return ESP_OK;
 }
 
-int SERIAL_send(uint8_t *data, int len, bool debug)
+int SERIAL_send(uint8_t chain, uint8_t *data, int len, bool debug)
 {
     if (debug)
     {
@@ -67,21 +97,22 @@ int SERIAL_send(uint8_t *data, int len, bool debug)
         printf("\n");
     }
 
-    return uart_write_bytes(UART_NUM_1, (const char *)data, len);
+    return uart_write_bytes(PORTS[chain].port, (const char *)data, len);
 }
 
 /// @brief waits for a serial response from the device
+/// @param chain chain to read from
 /// @param buf buffer to read data into
 /// @param buf number of ms to wait before timing out
 /// @return number of bytes read, or -1 on error
-int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
+int16_t SERIAL_rx(uint8_t chain, uint8_t *buf, uint16_t size, uint16_t timeout_ms)
 {
-    int16_t bytes_read = uart_read_bytes(UART_NUM_1, buf, size, timeout_ms / portTICK_PERIOD_MS);
+    int16_t bytes_read = uart_read_bytes(PORTS[chain].port, buf, size, timeout_ms / portTICK_PERIOD_MS);
 
-    #if BM1397_SERIALRX_DEBUG || BM1366_SERIALRX_DEBUG || BM1368_SERIALRX_DEBUG || BM1370_SERIALRX_DEBUG || BM1373_SERIALRX_DEBUG
+    #if BM13XX_SERIALRX_DEBUG
     size_t buff_len = 0;
     if (bytes_read > 0) {
-        uart_get_buffered_data_len(UART_NUM_1, &buff_len);
+        uart_get_buffered_data_len(PORTS[chain].port, &buff_len);
         printf("rx: ");
         prettyHex((unsigned char*) buf, bytes_read);
         printf(" [%d]\n", buff_len);
@@ -91,12 +122,41 @@ int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
     return bytes_read;
 }
 
-void SERIAL_debug_rx(void)
+/// @brief waits for the UART driver to report received data
+/// @param chain chain to wait on
+/// @param timeout_ms number of ms to wait for an event
+/// @return number of bytes buffered, 0 on timeout, or -1 if the RX FIFO or buffer overflowed
+int SERIAL_wait_rx(uint8_t chain, uint32_t timeout_ms)
+{
+    QueueHandle_t uart_queue = uart_queues[chain];
+    uart_event_t event;
+
+    if (uart_queue == NULL || xQueueReceive(uart_queue, &event, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return 0;
+    }
+
+    switch (event.type) {
+        case UART_DATA: {
+            size_t buffered = 0;
+            uart_get_buffered_data_len(PORTS[chain].port, &buffered);
+            return buffered;
+        }
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // the driver stops posting data events until the backlog is flushed
+            xQueueReset(uart_queue);
+            return -1;
+        default:
+            return 0;
+    }
+}
+
+void SERIAL_debug_rx(uint8_t chain)
 {
     int ret;
     uint8_t buf[100];
 
-    ret = SERIAL_rx(buf, 100, 20);
+    ret = SERIAL_rx(chain, buf, 100, 20);
     if (ret < 0)
     {
         fprintf(stderr, "unable to read data\n");
@@ -106,7 +166,7 @@ void SERIAL_debug_rx(void)
     memset(buf, 0, 100);
 }
 
-void SERIAL_clear_buffer(void)
+void SERIAL_clear_buffer(uint8_t chain)
 {
-    uart_flush(UART_NUM_1);
+    uart_flush(PORTS[chain].port);
 }
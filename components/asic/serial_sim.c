@@ -0,0 +1,529 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <arpa/inet.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+#include "serial.h"
+#include "asic_common.h"
+#include "bm1370.h"
+#include "crc.h"
+#include "mining.h"
+#include "utils.h"
+
+// Software BM1370 chains behind the SERIAL_* interface, one per ASIC chain. Commands are decoded
+// as they are written, register reads are answered straight away and jobs
+// are handed to a search task that hashes a reduced nonce space and sends
+// back every nonce that meets the ticket mask, scaled down by
+// SIM_DIFFICULTY_SHIFT so a software hasher finds some.
+
+#define SIM_CHIP_COUNT CONFIG_ASIC_SIM_CHIP_COUNT
+#define SIM_HASHES_PER_SECOND CONFIG_ASIC_SIM_HASHES_PER_SECOND
+#define SIM_DIFFICULTY_SHIFT CONFIG_ASIC_SIM_DIFFICULTY_SHIFT
+#define SIM_NONCES_PER_JOB CONFIG_ASIC_SIM_NONCES_PER_JOB
+#define SIM_RESULT_LATENCY_US CONFIG_ASIC_SIM_RESULT_LATENCY_US
+#define SIM_CORRUPT_PERMILLE CONFIG_ASIC_SIM_CORRUPT_PERMILLE
+
+#define SIM_CHIP_ID 0x1370
+#define SIM_CORES 128
+#define SIM_SMALL_CORES 16
+#define SIM_HASH_ENGINES 2040 // small cores per chip, drives the hash counters
+#define SIM_DEFAULT_FREQUENCY 50.0f
+#define SIM_DEFAULT_TICKET_DIFF 256
+
+#define RESULT_LENGTH 11
+#define RX_BUFFER_SIZE 2048
+#define SEARCH_CHUNK 64  // nonces hashed between checks for new work
+#define PENDING_SIZE 32  // results held back to model latency
+
+#define REG_CHIP_ID 0x00
+#define REG_PLL0 0x08
+#define REG_TICKET_MASK 0x14
+#define REG_ERROR_COUNT 0x4C
+#define REG_DOMAIN_0_COUNT 0x88
+#define REG_DOMAIN_3_COUNT 0x8B
+#define REG_TOTAL_COUNT 0x8C
+#define REG_VERSION_ROLLING 0xA4
+#define REG_TEMPERATURE 0xB4
+
+static const char *TAG = "serial_sim";
+
+typedef struct
+{
+    uint8_t address;
+    bool addressed;
+    float frequency;
+    double hashes;       // nominal hashes done at the configured PLL frequency
+    int64_t hashes_us;   // when hashes was last brought up to date
+    uint32_t registers[256];
+} sim_chip_t;
+
+typedef struct
+{
+    uint8_t frame[RESULT_LENGTH];
+    int64_t due_us;
+} sim_result_t;
+
+typedef struct
+{
+    sim_chip_t chips[SIM_CHIP_COUNT];
+    uint32_t ticket_diff;
+    uint32_t version_mask;
+    uint32_t corrupted_frames;
+
+    BM13XX_job next_job;
+    bool next_job_pending;
+
+    SemaphoreHandle_t sim_lock;  // chip state and next_job
+    SemaphoreHandle_t rx_lock;   // writers of rx_stream
+    SemaphoreHandle_t rx_event;  // given whenever bytes were queued
+    StreamBufferHandle_t rx_stream;
+    volatile bool rx_overflow;
+    TaskHandle_t sim_task_handle;
+
+    sim_result_t pending[PENDING_SIZE];
+    int pending_head, pending_count;
+} sim_chain_t;
+
+static sim_chain_t chains[ASIC_CHAIN_COUNT];
+
+static uint8_t reverse_bits(uint8_t value)
+{
+    uint8_t reversed = 0;
+    for (int i = 0; i < 8; i++) {
+        reversed = (reversed << 1) | (value & 1);
+        value >>= 1;
+    }
+    return reversed;
+}
+
+// Fill the crc5 bits of the last byte so the frame checks out like a chip's
+static void seal_frame(uint8_t *frame, int len, uint8_t flags)
+{
+    for (uint8_t crc = 0; crc < 32; crc++) {
+        frame[len - 1] = flags | crc;
+        if (crc5(frame + 2, len - 2) == 0) {
+            return;
+        }
+    }
+}
+
+static void rx_push(sim_chain_t *sim, const uint8_t *data, int len)
+{
+    xSemaphoreTake(sim->rx_lock, portMAX_DELAY);
+    if (xStreamBufferSend(sim->rx_stream, data, len, 0) != len) {
+        sim->rx_overflow = true;
+    }
+    xSemaphoreGive(sim->rx_lock);
+    xSemaphoreGive(sim->rx_event);
+}
+
+static void update_hashes(sim_chip_t *sim_chip, int64_t now_us)
+{
+    sim_chip->hashes += (double)(now_us - sim_chip->hashes_us) * sim_chip->frequency * SIM_HASH_ENGINES;
+    sim_chip->hashes_us = now_us;
+}
+
+static uint32_t read_register(sim_chain_t *sim, sim_chip_t *sim_chip, uint8_t reg)
+{
+    update_hashes(sim_chip, esp_timer_get_time());
+
+    // counters tick once per 2^32 hashes, like the real ones at difficulty 1
+    uint32_t total = (uint32_t)(sim_chip->hashes / NONCE_SPACE);
+
+    switch (reg) {
+        case REG_CHIP_ID:
+            return ((uint32_t)SIM_CHIP_ID << 16) | sim_chip->address;
+        case REG_TOTAL_COUNT:
+            return total;
+        case REG_ERROR_COUNT:
+            return sim->corrupted_frames;
+        case REG_TEMPERATURE: {
+            // warms up with the clock, later chips on the chain a little hotter
+            float temp_c = 40.0f + sim_chip->frequency / 20.0f + (sim_chip - sim->chips);
+            return 0x80000000 | (uint16_t)((temp_c + 299.5144f) / 0.171342f + 0.5f);
+        }
+        default:
+            if (reg >= REG_DOMAIN_0_COUNT && reg <= REG_DOMAIN_3_COUNT) {
+                return total / 4;
+            }
+            return sim_chip->registers[reg];
+    }
+}
+
+static void write_register(sim_chain_t *sim, sim_chip_t *sim_chip, uint8_t reg, uint32_t value)
+{
+    sim_chip->registers[reg] = value;
+
+    switch (reg) {
+        case REG_PLL0: {
+            uint8_t fb_divider = (value >> 16) & 0xFF;
+            uint8_t refdiv = (value >> 8) & 0xFF;
+            uint8_t postdiv1 = ((value >> 4) & 0xF) + 1;
+            uint8_t postdiv2 = (value & 0xF) + 1;
+            if (refdiv > 0) {
+                update_hashes(sim_chip, esp_timer_get_time());
+                sim_chip->frequency = 25.0f * fb_divider / (refdiv * postdiv1 * postdiv2);
+            }
+            break;
+        }
+        case REG_TICKET_MASK: {
+            // the mask is sent bit reversed, see get_difficulty_mask()
+            uint32_t mask = ((uint32_t)reverse_bits(value >> 24) << 24) |
+                            ((uint32_t)reverse_bits(value >> 16) << 16) |
+                            ((uint32_t)reverse_bits(value >> 8) << 8) |
+                            reverse_bits(value);
+            sim->ticket_diff = mask + 1;
+            break;
+        }
+        case REG_VERSION_ROLLING:
+            sim->version_mask = (value & 0xFFFF) << 13;
+            break;
+    }
+}
+
+static void send_register(sim_chain_t *sim, sim_chip_t *sim_chip, uint8_t reg)
+{
+    uint8_t frame[RESULT_LENGTH] = {0xAA, 0x55};
+    uint32_t value = htonl(read_register(sim, sim_chip, reg));
+
+    memcpy(frame + 2, &value, 4);
+    frame[6] = sim_chip->address;
+    frame[7] = reg;
+    seal_frame(frame, RESULT_LENGTH, 0x00);
+
+    rx_push(sim, frame, RESULT_LENGTH);
+}
+
+static void handle_command(sim_chain_t *sim, uint8_t header, const uint8_t *data, int len)
+{
+    sim_chip_t *chips = sim->chips;
+    bool all = header & GROUP_ALL;
+
+    switch (header & 0x0F) {
+        case CMD_SETADDRESS:
+            // the first chip that has not been addressed yet takes it
+            for (int i = 0; i < SIM_CHIP_COUNT; i++) {
+                if (!chips[i].addressed) {
+                    chips[i].address = data[0];
+                    chips[i].addressed = true;
+                    break;
+                }
+            }
+            break;
+        case CMD_INACTIVE:
+            for (int i = 0; i < SIM_CHIP_COUNT; i++) {
+                chips[i].addressed = false;
+            }
+            break;
+        case CMD_WRITE: {
+            if (len < 6) {
+                break;
+            }
+            uint32_t value = ((uint32_t)data[2] << 24) | ((uint32_t)data[3] << 16) | ((uint32_t)data[4] << 8) | data[5];
+            for (int i = 0; i < SIM_CHIP_COUNT; i++) {
+                if (all || chips[i].address == data[0]) {
+                    write_register(sim, &chips[i], data[1], value);
+                }
+            }
+            break;
+        }
+        case CMD_READ:
+            for (int i = 0; i < SIM_CHIP_COUNT; i++) {
+                if (all || chips[i].address == data[0]) {
+                    send_register(sim, &chips[i], data[1]);
+                }
+            }
+            break;
+    }
+}
+
+static void queue_result(sim_chain_t *sim, const uint8_t *frame)
+{
+    if (sim->pending_count == PENDING_SIZE) {
+        // out of room, the oldest result goes out early
+        rx_push(sim, sim->pending[sim->pending_head].frame, RESULT_LENGTH);
+        sim->pending_head = (sim->pending_head + 1) % PENDING_SIZE;
+        sim->pending_count--;
+    }
+
+    sim_result_t *slot = &sim->pending[(sim->pending_head + sim->pending_count) % PENDING_SIZE];
+    memcpy(slot->frame, frame, RESULT_LENGTH);
+    slot->due_us = esp_timer_get_time() + SIM_RESULT_LATENCY_US;
+    sim->pending_count++;
+}
+
+static void deliver_results(sim_chain_t *sim)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    while (sim->pending_count > 0 && sim->pending[sim->pending_head].due_us <= now_us) {
+        rx_push(sim, sim->pending[sim->pending_head].frame, RESULT_LENGTH);
+        sim->pending_head = (sim->pending_head + 1) % PENDING_SIZE;
+        sim->pending_count--;
+    }
+}
+
+static void send_nonce(sim_chain_t *sim, const BM13XX_job *job, uint32_t nonce_h, uint32_t version_bits, uint8_t small_core)
+{
+    const bm13xx_chip_t *descriptor = &BM1370_CHIP;
+    uint8_t frame[RESULT_LENGTH] = {0xAA, 0x55};
+    uint32_t word = htonl(nonce_h);
+    uint16_t versions = version_bits >> 13;
+
+    memcpy(frame + 2, &word, 4);
+    frame[6] = (nonce_h >> 17) & 0xFF;
+    frame[7] = ((job->job_id << descriptor->result_job_id.shift) & descriptor->result_job_id.mask) |
+               (small_core & descriptor->result_small_core.mask);
+    frame[8] = versions >> 8;
+    frame[9] = versions & 0xFF;
+    seal_frame(frame, RESULT_LENGTH, 0x80);
+
+    if (SIM_CORRUPT_PERMILLE > 0 && esp_random() % 1000 < SIM_CORRUPT_PERMILLE) {
+        frame[2 + esp_random() % (RESULT_LENGTH - 2)] ^= 1 << (esp_random() % 8);
+        sim->corrupted_frames++;
+    }
+
+    queue_result(sim, frame);
+}
+
+static void sim_task(void *pvParameters)
+{
+    sim_chain_t *sim = pvParameters;
+    sim_chip_t *chips = sim->chips;
+    BM13XX_job job;
+    bm_job header;
+    bool searching = false;
+    uint32_t position = 0;
+    uint32_t version_bits = 0;
+
+    int64_t budget_start_us = esp_timer_get_time();
+    uint64_t hashes_done = 0;
+
+    while (1) {
+        xSemaphoreTake(sim->sim_lock, portMAX_DELAY);
+        if (sim->next_job_pending) {
+            job = sim->next_job;
+            sim->next_job_pending = false;
+            searching = true;
+            position = 0;
+            version_bits = 0;
+
+            memset(&header, 0, sizeof(header));
+            memcpy(&header.version, job.version, 4);
+            memcpy(&header.ntime, job.ntime, 4);
+            memcpy(&header.target, job.nbits, 4);
+            memcpy(header.prev_block_hash, job.prev_block_hash, 32);
+            memcpy(header.merkle_root, job.merkle_root, 32);
+        }
+        double diff = ldexp(sim->ticket_diff, -SIM_DIFFICULTY_SHIFT);
+        uint32_t mask = sim->version_mask;
+        uint8_t chip_count = 0;
+        for (int i = 0; i < SIM_CHIP_COUNT; i++) {
+            chip_count += chips[i].addressed;
+        }
+        xSemaphoreGive(sim->sim_lock);
+
+        deliver_results(sim);
+
+        if (!searching || chip_count == 0) {
+            ulTaskNotifyTake(pdTRUE, sim->pending_count > 0 ? 1 : pdMS_TO_TICKS(100));
+            budget_start_us = esp_timer_get_time();
+            hashes_done = 0;
+            continue;
+        }
+
+        // the nonce space is split between chips and cores the way
+        // BM13XX_process_work() decodes it back
+        uint8_t nonce_interval = 256 / chip_count;
+        for (int i = 0; i < SEARCH_CHUNK && position < SIM_NONCES_PER_JOB; i++, position++) {
+            uint32_t core = position % SIM_CORES;
+            uint32_t chip_index = (position / SIM_CORES) % chip_count;
+            uint32_t low = (position / SIM_CORES / chip_count) & 0x1FFFF;
+            uint32_t nonce_h = (core << 25) | ((uint32_t)(chip_index * nonce_interval) << 17) | low;
+
+            if (test_nonce_value(&header, htonl(nonce_h), header.version | version_bits) >= diff) {
+                send_nonce(sim, &job, nonce_h, version_bits, position % SIM_SMALL_CORES);
+            }
+        }
+        hashes_done += SEARCH_CHUNK;
+
+        if (position >= SIM_NONCES_PER_JOB) {
+            // roll the version like the chip does once the nonce range is spent
+            position = 0;
+            version_bits = increment_bitmask(version_bits, mask) & mask;
+            searching = version_bits != 0;
+        }
+
+        // hold the configured hash rate
+        int64_t ahead_us = (int64_t)(hashes_done * 1000000 / SIM_HASHES_PER_SECOND) - (esp_timer_get_time() - budget_start_us);
+        if (ahead_us >= portTICK_PERIOD_MS * 1000) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ahead_us / 1000));
+        }
+    }
+}
+
+esp_err_t SERIAL_init(uint8_t chain)
+{
+    sim_chain_t *sim = &chains[chain];
+
+    ESP_LOGI(TAG, "Initializing simulated chain %u of %d BM1370", chain, SIM_CHIP_COUNT);
+
+    if (sim->rx_stream != NULL) {
+        return ESP_OK;
+    }
+
+    sim->ticket_diff = SIM_DEFAULT_TICKET_DIFF;
+    sim->sim_lock = xSemaphoreCreateMutex();
+    sim->rx_lock = xSemaphoreCreateMutex();
+    sim->rx_event = xSemaphoreCreateBinary();
+    sim->rx_stream = xStreamBufferCreate(RX_BUFFER_SIZE, 1);
+    if (sim->sim_lock == NULL || sim->rx_lock == NULL || sim->rx_event == NULL || sim->rx_stream == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate the simulator");
+        return ESP_ERR_NO_MEM;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    for (int i = 0; i < SIM_CHIP_COUNT; i++) {
+        sim->chips[i].frequency = SIM_DEFAULT_FREQUENCY;
+        sim->chips[i].hashes_us = now_us;
+    }
+
+    if (xTaskCreate(sim_task, "asic sim", 4096, sim, 3, &sim->sim_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Error creating asic sim task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+bool SERIAL_is_initialized(uint8_t chain)
+{
+    return chains[chain].rx_stream != NULL;
+}
+
+esp_err_t SERIAL_set_baud(uint8_t chain, int baud)
+{
+    ESP_LOGI(TAG, "Changing simulated chain %u baud to %i", chain, baud);
+    return ESP_OK;
+}
+
+static void send_packet(sim_chain_t *sim, uint8_t *data, int len)
+{
+    uint8_t header = data[2];
+
+    if (header & TYPE_JOB) {
+        uint16_t crc = (data[len - 2] << 8) | data[len - 1];
+        if (crc16_false(data + 2, len - 4) != crc || len - 6 != sizeof(BM13XX_job)) {
+            ESP_LOGW(TAG, "Dropping job packet with bad CRC16 or length");
+            return;
+        }
+
+        xSemaphoreTake(sim->sim_lock, portMAX_DELAY);
+        memcpy(&sim->next_job, data + 4, sizeof(BM13XX_job));
+        sim->next_job_pending = true;
+        xSemaphoreGive(sim->sim_lock);
+        xTaskNotifyGive(sim->sim_task_handle);
+        return;
+    }
+
+    if (crc5(data + 2, len - 3) != data[len - 1]) {
+        ESP_LOGW(TAG, "Dropping command with bad CRC5");
+        return;
+    }
+
+    xSemaphoreTake(sim->sim_lock, portMAX_DELAY);
+    handle_command(sim, header, data + 4, len - 5);
+    xSemaphoreGive(sim->sim_lock);
+}
+
+int SERIAL_send(uint8_t chain, uint8_t *data, int len, bool debug)
+{
+    if (debug) {
+        printf("tx: ");
+        prettyHex((unsigned char *)data, len);
+        printf("\n");
+    }
+
+    // batched writes carry several packets back to back
+    int offset = 0;
+    while (offset < len) {
+        int remaining = len - offset;
+        uint8_t *packet = data + offset;
+        if (remaining < 5 || packet[0] != 0x55 || packet[1] != 0xAA || packet[3] + 2 > remaining) {
+            ESP_LOGW(TAG, "Malformed packet of %d bytes", remaining);
+            break;
+        }
+
+        send_packet(&chains[chain], packet, packet[3] + 2);
+        offset += packet[3] + 2;
+    }
+
+    return len;
+}
+
+int16_t SERIAL_rx(uint8_t chain, uint8_t *buf, uint16_t size, uint16_t timeout_ms)
+{
+    StreamBufferHandle_t rx_stream = chains[chain].rx_stream;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+    uint16_t received = 0;
+
+    // like uart_read_bytes(), wait for the full size or the timeout
+    while (received < size) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        TickType_t remaining = elapsed < timeout ? timeout - elapsed : 0;
+        size_t bytes = xStreamBufferReceive(rx_stream, buf + received, size - received, remaining);
+        if (bytes == 0) {
+            break;
+        }
+        received += bytes;
+    }
+
+    return received;
+}
+
+int SERIAL_wait_rx(uint8_t chain, uint32_t timeout_ms)
+{
+    sim_chain_t *sim = &chains[chain];
+
+    if (sim->rx_overflow) {
+        sim->rx_overflow = false;
+        return -1;
+    }
+
+    size_t available = xStreamBufferBytesAvailable(sim->rx_stream);
+    if (available > 0) {
+        return available;
+    }
+
+    if (xSemaphoreTake(sim->rx_event, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return 0;
+    }
+
+    return xStreamBufferBytesAvailable(sim->rx_stream);
+}
+
+void SERIAL_debug_rx(uint8_t chain)
+{
+    uint8_t buf[100];
+
+    SERIAL_rx(chain, buf, sizeof(buf), 20);
+}
+
+void SERIAL_clear_buffer(uint8_t chain)
+{
+    sim_chain_t *sim = &chains[chain];
+
+    xSemaphoreTake(sim->rx_lock, portMAX_DELAY);
+    xStreamBufferReset(sim->rx_stream);
+    xSemaphoreGive(sim->rx_lock);
+}
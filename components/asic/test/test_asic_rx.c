@@ -0,0 +1,52 @@
+#include "unity.h"
+
+#include "asic_rx.h"
+
+#include <string.h>
+
+TEST_CASE("RX ring keeps frames and timestamps in order", "[asic_rx]")
+{
+    static asic_rx_ring_t ring;
+    memset(&ring, 0, sizeof(ring));
+
+    uint8_t frame[ASIC_RX_FRAME_MAX], out[ASIC_RX_FRAME_MAX];
+    uint64_t timestamp_us;
+
+    // run the indices around the ring a few times
+    for (int i = 0; i < 3 * ASIC_RX_RING_SIZE; i++) {
+        memset(frame, i, sizeof(frame));
+        TEST_ASSERT_TRUE(asic_rx_ring_push(&ring, frame, sizeof(frame), 1000 + i));
+        TEST_ASSERT_EQUAL(1, asic_rx_ring_count(&ring));
+
+        TEST_ASSERT_TRUE(asic_rx_ring_pop(&ring, out, sizeof(out), &timestamp_us));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, out, sizeof(out));
+        TEST_ASSERT_EQUAL_UINT64(1000 + i, timestamp_us);
+    }
+
+    TEST_ASSERT_FALSE(asic_rx_ring_pop(&ring, out, sizeof(out), &timestamp_us));
+}
+
+TEST_CASE("RX ring refuses frames when full", "[asic_rx]")
+{
+    static asic_rx_ring_t ring;
+    memset(&ring, 0, sizeof(ring));
+
+    uint8_t frame[ASIC_RX_FRAME_MAX] = {0};
+    uint64_t timestamp_us;
+
+    for (int i = 0; i < ASIC_RX_RING_SIZE; i++) {
+        frame[2] = i;
+        TEST_ASSERT_TRUE(asic_rx_ring_push(&ring, frame, sizeof(frame), i));
+    }
+    TEST_ASSERT_FALSE(asic_rx_ring_push(&ring, frame, sizeof(frame), 0));
+    TEST_ASSERT_EQUAL(ASIC_RX_RING_SIZE, asic_rx_ring_count(&ring));
+
+    // the oldest frame is still the first one out
+    TEST_ASSERT_TRUE(asic_rx_ring_pop(&ring, frame, sizeof(frame), &timestamp_us));
+    TEST_ASSERT_EQUAL_UINT8(0, frame[2]);
+    TEST_ASSERT_EQUAL_UINT64(0, timestamp_us);
+
+    asic_rx_ring_discard(&ring);
+    TEST_ASSERT_EQUAL(0, asic_rx_ring_count(&ring));
+    TEST_ASSERT_FALSE(asic_rx_ring_pop(&ring, frame, sizeof(frame), &timestamp_us));
+}
@@ -0,0 +1,70 @@
+#include "unity.h"
+
+#include "bm1397.h"
+#include "bm1366.h"
+#include "bm1368.h"
+#include "bm1370.h"
+#include "bm1373.h"
+
+static const bm13xx_chip_t * const chips[] = {
+    &BM1397_CHIP,
+    &BM1366_CHIP,
+    &BM1368_CHIP,
+    &BM1370_CHIP,
+    &BM1373_CHIP,
+};
+
+TEST_CASE("Check BM13xx chip descriptors", "[bm13xx]")
+{
+    for (int c = 0; c < sizeof(chips) / sizeof(chips[0]); c++) {
+        const bm13xx_chip_t * chip = chips[c];
+
+        TEST_ASSERT_NOT_NULL_MESSAGE(chip->init, chip->name);
+        TEST_ASSERT_NOT_NULL_MESSAGE(chip->set_max_baud, chip->name);
+        TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(BM13XX_MAX_RESULT_LENGTH, chip->result_length, chip->name);
+        TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(256, chip->register_map_size, chip->name);
+        TEST_ASSERT_LESS_THAN_MESSAGE(chip->pll_fb_max, chip->pll_fb_min, chip->name);
+
+        bool any_register = false;
+        for (int reg = 0; reg < chip->register_map_size; reg++) {
+            any_register |= chip->register_map[reg] != REGISTER_INVALID;
+        }
+        TEST_ASSERT_TRUE_MESSAGE(any_register, chip->name);
+    }
+}
+
+TEST_CASE("Check BM13xx baud ladders", "[bm13xx]")
+{
+    for (int c = 0; c < sizeof(chips) / sizeof(chips[0]); c++) {
+        const bm13xx_chip_t * chip = chips[c];
+
+        // chips without a ladder only verify the rate set_max_baud picks
+        if (chip->baud_step_count == 0) continue;
+
+        // negotiation climbs from the rate the chain comes out of reset at
+        TEST_ASSERT_GREATER_THAN_MESSAGE(1, chip->baud_step_count, chip->name);
+        TEST_ASSERT_INT_WITHIN_MESSAGE(1000, 115200, chip->baud_steps[0].baud, chip->name);
+        for (int step = 1; step < chip->baud_step_count; step++) {
+            TEST_ASSERT_GREATER_THAN_MESSAGE(chip->baud_steps[step - 1].baud, chip->baud_steps[step].baud, chip->name);
+        }
+    }
+}
+
+TEST_CASE("Check BM13xx job ids survive the result id byte", "[bm13xx]")
+{
+    for (int c = 0; c < sizeof(chips) / sizeof(chips[0]); c++) {
+        const bm13xx_chip_t * chip = chips[c];
+        bm13xx_field_t field = chip->result_job_id;
+
+        // every job id send_work can hand out must decode back from the id
+        // byte the chip echoes, whatever small core answered
+        uint8_t id = 0;
+        for (int i = 0; i < 128; i++) {
+            id = (id + chip->job_id_step) % 128;
+            uint32_t echoed = (uint32_t)id << field.shift;
+            TEST_ASSERT_LESS_THAN_MESSAGE(256, echoed, chip->name);
+            echoed |= chip->result_small_core.mask & ~field.mask;
+            TEST_ASSERT_EQUAL_UINT8_MESSAGE(id, (echoed & field.mask) >> field.shift, chip->name);
+        }
+    }
+}
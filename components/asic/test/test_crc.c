@@ -0,0 +1,131 @@
+#include "unity.h"
+
+#include <stdio.h>
+
+#include "esp_timer.h"
+
+#include "crc.h"
+
+static void fill(uint8_t * data, size_t length, uint32_t seed)
+{
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+    }
+}
+
+TEST_CASE("CRC5 matches the bit serial version on every one and two byte input", "[crc]")
+{
+    uint8_t data[2];
+
+    for (int i = 0; i < 65536; i++) {
+        data[0] = i >> 8;
+        data[1] = i & 0xFF;
+        TEST_ASSERT_EQUAL_HEX8(crc5_reference(data, 2), crc5(data, 2));
+        TEST_ASSERT_EQUAL_HEX8(crc5_reference(data, 1), crc5(data, 1));
+    }
+}
+
+TEST_CASE("CRC16 matches the bit serial version from every state", "[crc]")
+{
+    uint8_t data[2];
+
+    for (int i = 0; i < 65536; i++) {
+        data[0] = i >> 8;
+        data[1] = i & 0xFF;
+        TEST_ASSERT_EQUAL_HEX16(crc16_update_reference(0xFFFF, data, 2), crc16_false(data, 2));
+        TEST_ASSERT_EQUAL_HEX16(crc16_update_reference(0, data, 2), crc16(data, 2));
+    }
+
+    // the 8 byte block of slice-by-8 folds the state in, so walk all of them
+    uint8_t block[11];
+    fill(block, sizeof(block), 2);
+    for (int state = 0; state < 65536; state++) {
+        TEST_ASSERT_EQUAL_HEX16(crc16_update_reference(state, block, sizeof(block)),
+                                crc16_update(state, block, sizeof(block)));
+    }
+}
+
+TEST_CASE("CRC kernels match on every length and alignment", "[crc]")
+{
+    static uint8_t buffer[256 + 8];
+
+    for (uint32_t seed = 0; seed < 64; seed++) {
+        fill(buffer, sizeof(buffer), seed);
+        for (int offset = 0; offset < 8; offset++) {
+            for (int length = 0; length <= 255; length++) {
+                uint8_t * data = buffer + offset;
+                TEST_ASSERT_EQUAL_HEX8(crc5_reference(data, length), crc5(data, length));
+                TEST_ASSERT_EQUAL_HEX16(crc16_update_reference(0xFFFF, data, length), crc16_false(data, length));
+            }
+        }
+    }
+
+    // a CRC16 split anywhere continues to the same value
+    fill(buffer, 88, 99);
+    uint16_t whole = crc16_false(buffer, 88);
+    for (int split = 0; split <= 88; split++) {
+        TEST_ASSERT_EQUAL_HEX16(whole, crc16_update(crc16_false(buffer, split), buffer + split, 88 - split));
+    }
+}
+
+TEST_CASE("CRC kernels reproduce known packets", "[crc]")
+{
+    // chain inactive and set address as they go out on the wire
+    uint8_t chain_inactive[] = {0x55, 0xAA, 0x53, 0x05, 0x00, 0x00, 0x03};
+    uint8_t set_address[] = {0x55, 0xAA, 0x40, 0x05, 0x00, 0x00, 0x1C};
+    TEST_ASSERT_EQUAL_HEX8(chain_inactive[6], crc5(chain_inactive + 2, 4));
+    TEST_ASSERT_EQUAL_HEX8(set_address[6], crc5(set_address + 2, 4));
+
+    uint8_t check[] = "123456789";
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16_false(check, 9));
+    TEST_ASSERT_EQUAL_HEX16(0x31C3, crc16(check, 9));
+}
+
+TEST_CASE("CRC throughput on ASIC packet sizes", "[crc][benchmark]")
+{
+    // commands, result frames and job packets
+    static const uint8_t LENGTHS[] = {7, 9, 11, 54, 88};
+    static uint8_t packet[88];
+    const int iterations = 20000;
+    volatile uint16_t sink = 0;
+
+    fill(packet, sizeof(packet), 7);
+
+    for (int l = 0; l < sizeof(LENGTHS); l++) {
+        uint8_t length = LENGTHS[l];
+
+        int64_t start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            packet[0] = i;
+            sink ^= crc5_reference(packet, length);
+        }
+        int64_t crc5_reference_us = esp_timer_get_time() - start;
+
+        start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            packet[0] = i;
+            sink ^= crc5(packet, length);
+        }
+        int64_t crc5_us = esp_timer_get_time() - start;
+
+        start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            packet[0] = i;
+            sink ^= crc16_update_reference(0xFFFF, packet, length);
+        }
+        int64_t crc16_reference_us = esp_timer_get_time() - start;
+
+        start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            packet[0] = i;
+            sink ^= crc16_false(packet, length);
+        }
+        int64_t crc16_us = esp_timer_get_time() - start;
+
+        printf("%2d bytes: crc5 %.3f -> %.3f us, crc16 %.3f -> %.3f us\n", length,
+               crc5_reference_us / (double)iterations, crc5_us / (double)iterations,
+               crc16_reference_us / (double)iterations, crc16_us / (double)iterations);
+    }
+    (void)sink;
+}
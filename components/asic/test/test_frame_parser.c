@@ -0,0 +1,98 @@
+#include "unity.h"
+
+#include "asic_common.h"
+#include "crc.h"
+
+#include <string.h>
+
+#define FRAME_SIZE 11
+
+// Build a result frame whose trailing CRC5 validates
+static void make_frame(uint8_t frame[FRAME_SIZE], uint8_t seed)
+{
+    frame[0] = 0xAA;
+    frame[1] = 0x55;
+    for (int i = 2; i < FRAME_SIZE - 1; i++) {
+        frame[i] = (uint8_t)(seed * 31 + i);
+    }
+    for (uint8_t crc = 0; crc < 32; crc++) {
+        frame[FRAME_SIZE - 1] = 0x80 | crc;
+        if (crc5(frame + 2, FRAME_SIZE - 2) == 0) {
+            return;
+        }
+    }
+    TEST_FAIL_MESSAGE("no CRC5 found");
+}
+
+static void feed(asic_frame_parser_t *parser, const uint8_t *data, int len)
+{
+    TEST_ASSERT_LESS_OR_EQUAL(ASIC_RX_BUFFER_SIZE, parser->len + len);
+    memcpy(parser->buf + parser->len, data, len);
+    parser->len += len;
+}
+
+TEST_CASE("Frame parser passes clean frames through", "[asic_rx]")
+{
+    asic_frame_parser_t parser = {0};
+    uint8_t a[FRAME_SIZE], b[FRAME_SIZE], out[FRAME_SIZE];
+    make_frame(a, 1);
+    make_frame(b, 2);
+
+    feed(&parser, a, FRAME_SIZE);
+    feed(&parser, b, 5);
+    TEST_ASSERT_TRUE(asic_frame_parser_next(&parser, out, FRAME_SIZE));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(a, out, FRAME_SIZE);
+
+    // half a frame is kept for the next read
+    TEST_ASSERT_FALSE(asic_frame_parser_next(&parser, out, FRAME_SIZE));
+    TEST_ASSERT_EQUAL(5, parser.len);
+
+    feed(&parser, b + 5, FRAME_SIZE - 5);
+    TEST_ASSERT_TRUE(asic_frame_parser_next(&parser, out, FRAME_SIZE));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(b, out, FRAME_SIZE);
+
+    TEST_ASSERT_EQUAL(2, parser.stats.frames);
+    TEST_ASSERT_EQUAL(0, parser.stats.resyncs);
+    TEST_ASSERT_EQUAL(0, parser.stats.bytes_dropped);
+}
+
+TEST_CASE("Frame parser skips garbage without losing queued frames", "[asic_rx]")
+{
+    asic_frame_parser_t parser = {0};
+    uint8_t a[FRAME_SIZE], b[FRAME_SIZE], out[FRAME_SIZE];
+    const uint8_t noise[] = {0x13, 0xAA, 0x00, 0x55};
+    make_frame(a, 3);
+    make_frame(b, 4);
+
+    feed(&parser, noise, sizeof(noise));
+    feed(&parser, a, FRAME_SIZE);
+    feed(&parser, b, FRAME_SIZE);
+
+    TEST_ASSERT_TRUE(asic_frame_parser_next(&parser, out, FRAME_SIZE));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(a, out, FRAME_SIZE);
+    TEST_ASSERT_TRUE(asic_frame_parser_next(&parser, out, FRAME_SIZE));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(b, out, FRAME_SIZE);
+
+    TEST_ASSERT_EQUAL(1, parser.stats.resyncs);
+    TEST_ASSERT_EQUAL(sizeof(noise), parser.stats.bytes_dropped);
+    TEST_ASSERT_EQUAL(0, parser.len);
+}
+
+TEST_CASE("Frame parser rejects a corrupted frame and recovers the next one", "[asic_rx]")
+{
+    asic_frame_parser_t parser = {0};
+    uint8_t a[FRAME_SIZE], b[FRAME_SIZE], out[FRAME_SIZE];
+    make_frame(a, 5);
+    make_frame(b, 6);
+    a[4] ^= 0x01;
+
+    feed(&parser, a, FRAME_SIZE);
+    feed(&parser, b, FRAME_SIZE);
+
+    TEST_ASSERT_TRUE(asic_frame_parser_next(&parser, out, FRAME_SIZE));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(b, out, FRAME_SIZE);
+
+    TEST_ASSERT_GREATER_OR_EQUAL(1, parser.stats.crc_errors);
+    TEST_ASSERT_EQUAL(FRAME_SIZE, parser.stats.bytes_dropped);
+    TEST_ASSERT_EQUAL(1, parser.stats.frames);
+}
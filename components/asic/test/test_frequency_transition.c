@@ -0,0 +1,70 @@
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "global_state.h"
+#include "frequency_transition_bmXX.h"
+
+#define MAX_WRITES 64
+
+static float writes[MAX_WRITES];
+static int write_count;
+static int done_count;
+
+static float record_frequency(float frequency)
+{
+    if (write_count < MAX_WRITES) {
+        writes[write_count] = frequency;
+    }
+    write_count++;
+    return frequency;
+}
+
+static void record_done(GlobalState * GLOBAL_STATE)
+{
+    done_count++;
+}
+
+// GlobalState is too large for the test task stack
+static GlobalState state;
+
+TEST_CASE("Frequency ramp steps on the 6.25 MHz grid in the background", "[frequency_transition]")
+{
+    write_count = 0;
+    done_count = 0;
+    state.POWER_MANAGEMENT_MODULE.actual_frequency = 50;
+    state.POWER_MANAGEMENT_MODULE.frequency_value = 100;
+
+    frequency_transition_start(&state, record_frequency, record_done);
+    TEST_ASSERT_TRUE(state.POWER_MANAGEMENT_MODULE.frequency_ramping);
+    TEST_ASSERT_TRUE(frequency_transition_is_active());
+
+    TEST_ASSERT_TRUE(frequency_transition_wait(5000));
+    TEST_ASSERT_EQUAL(8, write_count);
+    for (int i = 0; i < write_count; i++) {
+        TEST_ASSERT_EQUAL_FLOAT(50 + 6.25f * (i + 1), writes[i]);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(100, state.POWER_MANAGEMENT_MODULE.actual_frequency);
+    TEST_ASSERT_FALSE(state.POWER_MANAGEMENT_MODULE.frequency_ramping);
+    TEST_ASSERT_EQUAL(1, done_count);
+}
+
+TEST_CASE("Frequency ramp can be retargeted mid-ramp", "[frequency_transition]")
+{
+    write_count = 0;
+    done_count = 0;
+    state.POWER_MANAGEMENT_MODULE.actual_frequency = 50;
+    state.POWER_MANAGEMENT_MODULE.frequency_value = 500;
+
+    frequency_transition_start(&state, record_frequency, record_done);
+    vTaskDelay(pdMS_TO_TICKS(350));
+
+    // turn around before the ramp gets anywhere near 500 MHz
+    state.POWER_MANAGEMENT_MODULE.frequency_value = 60;
+    frequency_transition_start(&state, record_frequency, record_done);
+
+    TEST_ASSERT_TRUE(frequency_transition_wait(5000));
+    TEST_ASSERT_TRUE(write_count < 16);
+    TEST_ASSERT_EQUAL_FLOAT(60, writes[write_count - 1]);
+    TEST_ASSERT_EQUAL_FLOAT(60, state.POWER_MANAGEMENT_MODULE.actual_frequency);
+    TEST_ASSERT_EQUAL(1, done_count);
+}
@@ -14,13 +14,13 @@ TEST_CASE("Check known working midstate + job command", "[bm1397]")
 
     if (!uart_initialized)
     {
-        SERIAL_init();
+        SERIAL_init(0);
         uart_initialized = 1;
 
         BM1397_init(425, 1, 256);
 
         // read back response
-        SERIAL_debug_rx();
+        SERIAL_debug_rx(0);
     }
 
     uint8_t work1[146] = {
@@ -178,7 +178,7 @@ TEST_CASE("Check known working midstate + job command", "[bm1397]")
     memset(buf, 0, 1024);
 
     BM1397_send_work(&GLOBAL_STATE, &test_job);
-    uint16_t received = SERIAL_rx(buf, 9, 20);
+    uint16_t received = SERIAL_rx(0, buf, 9, 20);
     TEST_ASSERT_GREATER_OR_EQUAL_UINT16(sizeof(struct asic_result), received);
 
     int i;
@@ -0,0 +1,151 @@
+#include "unity.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "bm1366.h"
+#include "bm1368.h"
+#include "bm1370.h"
+#include "bm1373.h"
+#include "bm1397.h"
+#include "crc.h"
+#include "job_encoder.h"
+
+static const bm13xx_chip_t * const CHIPS[] = {
+    &BM1366_CHIP, &BM1368_CHIP, &BM1370_CHIP, &BM1373_CHIP, &BM1397_CHIP,
+};
+
+#define CHIP_COUNT (sizeof(CHIPS) / sizeof(CHIPS[0]))
+
+// What BM13XX_send_work() and BM13XX_send() used to do for every job
+static uint8_t encode_reference(uint8_t * packet, bm13xx_job_layout_t layout, uint8_t job_id, const bm_job * job)
+{
+    union {
+        BM13XX_job header;
+        job_packet midstates;
+    } work;
+    uint8_t job_length;
+
+    memset(&work, 0, sizeof(work));
+    if (layout == BM13XX_JOB_MIDSTATES) {
+        work.midstates.job_id = job_id;
+        work.midstates.num_midstates = job->num_midstates;
+        memcpy(&work.midstates.starting_nonce, &job->starting_nonce, 4);
+        memcpy(&work.midstates.nbits, &job->target, 4);
+        memcpy(&work.midstates.ntime, &job->ntime, 4);
+        memcpy(&work.midstates.merkle4, job->merkle_root, 4);
+        memcpy(work.midstates.midstate, job->midstate, 32);
+        memcpy(work.midstates.midstate1, job->midstate1, 32);
+        memcpy(work.midstates.midstate2, job->midstate2, 32);
+        memcpy(work.midstates.midstate3, job->midstate3, 32);
+        job_length = sizeof(job_packet);
+    } else {
+        work.header.job_id = job_id;
+        work.header.num_midstates = 0x01;
+        memcpy(&work.header.starting_nonce, &job->starting_nonce, 4);
+        memcpy(&work.header.nbits, &job->target, 4);
+        memcpy(&work.header.ntime, &job->ntime, 4);
+        memcpy(work.header.merkle_root, job->merkle_root, 32);
+        memcpy(work.header.prev_block_hash, job->prev_block_hash, 32);
+        memcpy(&work.header.version, &job->version, 4);
+        job_length = sizeof(BM13XX_job);
+    }
+
+    packet[0] = 0x55;
+    packet[1] = 0xAA;
+    packet[2] = TYPE_JOB | GROUP_SINGLE | CMD_WRITE;
+    packet[3] = job_length + 4;
+    memcpy(packet + 4, &work, job_length);
+    uint16_t crc = crc16_false(packet + 2, job_length + 2);
+    packet[4 + job_length] = crc >> 8;
+    packet[5 + job_length] = crc & 0xFF;
+    return job_length + 6;
+}
+
+static void fill(uint8_t * data, size_t length, uint32_t seed)
+{
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+    }
+}
+
+static void new_notify(bm_job * job, uint32_t seed)
+{
+    memset(job, 0, sizeof(*job));
+    fill(job->prev_block_hash, 32, seed);
+    job->version = 0x20000000 | seed;
+    job->target = 0x17034219 + seed;
+    job->num_midstates = 4;
+}
+
+// the merkle root (and with it the midstates) changes with every extranonce2
+static void next_job(bm_job * job, uint32_t seed)
+{
+    fill(job->merkle_root, 32, seed);
+    fill(job->midstate, 32, seed + 1);
+    fill(job->midstate1, 32, seed + 2);
+    fill(job->midstate2, 32, seed + 3);
+    fill(job->midstate3, 32, seed + 4);
+    job->ntime = 0x66000000 + seed / 16;
+    job->starting_nonce = seed;
+}
+
+TEST_CASE("Pre-encoded job packets match the full encoding for every chip", "[job_encoder]")
+{
+    static job_encoder_t encoder;
+    uint8_t expected[JOB_ENCODER_MAX_PACKET];
+    bm_job job;
+
+    for (int c = 0; c < CHIP_COUNT; c++) {
+        const bm13xx_chip_t * chip = CHIPS[c];
+        job_encoder_reset(&encoder);
+        uint8_t id = 0;
+
+        for (uint32_t i = 0; i < 200; i++) {
+            if (i % 16 == 0) {
+                new_notify(&job, i);
+            }
+            next_job(&job, i);
+            id = (id + chip->job_id_step) % 128;
+
+            uint8_t length = job_encoder_encode(&encoder, chip->job_layout, id, &job);
+            TEST_ASSERT_EQUAL(encode_reference(expected, chip->job_layout, id, &job), length);
+            TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, encoder.packet, length);
+        }
+    }
+}
+
+TEST_CASE("Pre-encoded job packet throughput", "[job_encoder][benchmark]")
+{
+    static job_encoder_t encoder;
+    static uint8_t packet[JOB_ENCODER_MAX_PACKET];
+    const int iterations = 20000;
+    bm_job job;
+
+    for (int c = 0; c < CHIP_COUNT; c++) {
+        const bm13xx_chip_t * chip = CHIPS[c];
+        new_notify(&job, c);
+        next_job(&job, c);
+
+        int64_t start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            job.starting_nonce = i;
+            encode_reference(packet, chip->job_layout, i & 0x7F, &job);
+        }
+        int64_t reference_us = esp_timer_get_time() - start;
+
+        job_encoder_reset(&encoder);
+        start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            job.starting_nonce = i;
+            job_encoder_encode(&encoder, chip->job_layout, i & 0x7F, &job);
+        }
+        int64_t encoder_us = esp_timer_get_time() - start;
+
+        printf("%s: full encoding %.2f us/job, pre-encoded %.2f us/job\n", chip->name,
+               reference_us / (double)iterations, encoder_us / (double)iterations);
+    }
+}
@@ -0,0 +1,175 @@
+#include "unity.h"
+
+#include <math.h>
+
+#include "asic_common.h"
+#include "job_interval.h"
+
+#define MS 1000LL
+#define S (1000 * MS)
+
+static const job_interval_chain_t BM1370_CHAIN = {
+    .frequency_mhz = 525,
+    .asic_count = 1,
+    .cores = 128,
+    .small_cores = 2040,
+    .version_size = 65536,
+    .nonce_percent = 1.0,
+};
+
+// Feeds `nonces` distinct results and `duplicates` repeats, then closes one window
+static bool run_window(job_interval_t * interval, int64_t * now, int nonces, int duplicates,
+                       double model_ms, double cap_ms, double expected_per_s)
+{
+    static uint32_t nonce;
+    bool changed = job_interval_update(interval, model_ms, cap_ms, expected_per_s, *now);
+
+    for (int i = 0; i < nonces; i++) {
+        job_interval_result(interval, 1, ++nonce, 0x20000000);
+    }
+    for (int i = 0; i < duplicates; i++) {
+        job_interval_result(interval, 1, nonce, 0x20000000);
+    }
+
+    for (int64_t end = *now + JOB_INTERVAL_WINDOW_S * S; *now < end;) {
+        *now += 100 * MS;
+        changed |= job_interval_update(interval, model_ms, cap_ms, expected_per_s, *now);
+    }
+    return changed;
+}
+
+TEST_CASE("Job interval model matches the BM1397 timeout", "[job_interval]")
+{
+    job_interval_chain_t chain = {
+        .frequency_mhz = 450,
+        .asic_count = 1,
+        .cores = 168,
+        .small_cores = 672,
+        .version_size = 4,
+        .nonce_percent = 1.0,
+    };
+
+    double expected = calculate_bm_timeout_ms(450, 1, 672, 168, 4, 1.0, 20);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, expected, job_interval_model_ms(&chain));
+}
+
+TEST_CASE("Job interval model follows frequency, version bits and nonce space", "[job_interval]")
+{
+    job_interval_chain_t chain = BM1370_CHAIN;
+    double full = job_interval_model_ms(&chain);
+
+    chain.frequency_mhz = 1050;
+    TEST_ASSERT_FLOAT_WITHIN(0.01, full / 2, job_interval_model_ms(&chain));
+
+    chain = BM1370_CHAIN;
+    chain.nonce_percent = 0.5;
+    TEST_ASSERT_FLOAT_WITHIN(0.01, full / 2, job_interval_model_ms(&chain));
+
+    // a pool granting only 4 version bits: 16 versions fill the small cores once
+    chain = BM1370_CHAIN;
+    chain.version_size = 16;
+    double one_pass = NONCE_SPACE / 128 / (525 * 1000.0);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, one_pass, job_interval_model_ms(&chain));
+
+    // without version rolling it is still one pass over the nonces
+    chain.version_size = 1;
+    TEST_ASSERT_FLOAT_WITHIN(0.01, one_pass, job_interval_model_ms(&chain));
+
+    chain.asic_count = 0;
+    TEST_ASSERT_EQUAL_FLOAT(0, job_interval_model_ms(&chain));
+}
+
+TEST_CASE("Job interval is capped, floored and falls back without a model", "[job_interval]")
+{
+    job_interval_t interval;
+    job_interval_init(&interval);
+
+    TEST_ASSERT_EQUAL_FLOAT(500, job_interval_ms(&interval, 76000, 500));
+    TEST_ASSERT_EQUAL_FLOAT(64, job_interval_ms(&interval, 64, 500));
+    TEST_ASSERT_EQUAL_FLOAT(JOB_INTERVAL_MIN_MS, job_interval_ms(&interval, 2, 500));
+    TEST_ASSERT_EQUAL_FLOAT(500, job_interval_ms(&interval, 0, 500));
+}
+
+TEST_CASE("Job interval shrinks on duplicates and recovers", "[job_interval]")
+{
+    job_interval_t interval;
+    job_interval_init(&interval);
+    int64_t now = 1 * S;
+
+    TEST_ASSERT_TRUE(job_interval_result(&interval, 1, 42, 0x20000000) == false);
+    TEST_ASSERT_TRUE(job_interval_result(&interval, 1, 42, 0x20000000));
+    TEST_ASSERT_TRUE(job_interval_result(&interval, 2, 42, 0x20000000) == false);
+
+    job_interval_init(&interval);
+    TEST_ASSERT_TRUE(run_window(&interval, &now, 100, 10, 64, 500, 100.0 / JOB_INTERVAL_WINDOW_S));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, JOB_INTERVAL_SHRINK, interval.correction);
+    TEST_ASSERT_FLOAT_WITHIN(0.1, 64 * JOB_INTERVAL_SHRINK, job_interval_ms(&interval, 64, 500));
+
+    // clean windows walk it back up, never past the model
+    for (int i = 0; i < 20; i++) {
+        run_window(&interval, &now, 100, 0, 64, 500, 100.0 / JOB_INTERVAL_WINDOW_S);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, interval.correction);
+}
+
+TEST_CASE("Job interval shrinks on a low nonce rate only when the model sets it", "[job_interval]")
+{
+    job_interval_t interval;
+    int64_t now = 1 * S;
+    double expected_per_s = 200.0 / JOB_INTERVAL_WINDOW_S;
+
+    // half the expected nonces while the jobs last as long as the model says
+    job_interval_init(&interval);
+    TEST_ASSERT_TRUE(run_window(&interval, &now, 100, 0, 64, 500, expected_per_s));
+    TEST_ASSERT_TRUE(interval.correction < 1.0f);
+
+    // the same rate under the freshness cap is not the job interval's doing
+    job_interval_init(&interval);
+    TEST_ASSERT_FALSE(run_window(&interval, &now, 100, 0, 76000, 500, expected_per_s));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, interval.correction);
+
+    // too few nonces expected to tell
+    job_interval_init(&interval);
+    TEST_ASSERT_FALSE(run_window(&interval, &now, 10, 0, 64, 500, 20.0 / JOB_INTERVAL_WINDOW_S));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, interval.correction);
+}
+
+TEST_CASE("Job interval restarts its window after jobs stopped", "[job_interval]")
+{
+    job_interval_t interval;
+    job_interval_init(&interval);
+    int64_t now = 1 * S;
+
+    job_interval_update(&interval, 64, 500, 10, now);
+    now += 30 * S;
+    job_interval_update(&interval, 64, 500, 10, now);
+
+    // a pool outage counted as idle cores would shrink the interval for nothing
+    TEST_ASSERT_EQUAL(now, interval.window_start_us);
+    TEST_ASSERT_EQUAL(0, interval.nonces);
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, interval.correction);
+}
+
+TEST_CASE("Job interval without a cap bounds the gap by the model", "[job_interval]")
+{
+    job_interval_t interval;
+    job_interval_init(&interval);
+    int64_t now = 1 * S;
+
+    // BM1397: midstate jobs have no freshness cap, the model alone sets the interval
+    TEST_ASSERT_EQUAL_FLOAT(64, job_interval_ms(&interval, 64, INFINITY));
+
+    job_interval_update(&interval, 64, INFINITY, 10, now);
+    int64_t window_start = interval.window_start_us;
+    now += 500 * MS;
+    job_interval_update(&interval, 64, INFINITY, 10, now);
+    TEST_ASSERT_EQUAL(window_start, interval.window_start_us);
+
+    now += 30 * S;
+    job_interval_update(&interval, 64, INFINITY, 10, now);
+    TEST_ASSERT_EQUAL(now, interval.window_start_us);
+
+    // and the correction still works off a full window
+    TEST_ASSERT_TRUE(run_window(&interval, &now, 100, 10, 64, INFINITY, 100.0 / JOB_INTERVAL_WINDOW_S));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, JOB_INTERVAL_SHRINK, interval.correction);
+}
@@ -1,6 +1,11 @@
 #include "unity.h"
 
 #include "pll.h"
+#include "bm1366.h"
+#include "bm1368.h"
+#include "bm1370.h"
+#include "bm1373.h"
+#include "bm1397.h"
 
 TEST_CASE("Check PLL frequency calculation", "[pll]")
 {
@@ -16,3 +21,53 @@ TEST_CASE("Check PLL frequency calculation", "[pll]")
     TEST_ASSERT_EQUAL_UINT8(1, postdiv2);
     TEST_ASSERT_FLOAT_WITHIN(0.01, 450.0, actual_freq);
 }
+
+static const bm13xx_chip_t * const CHIPS[] = { &BM1397_CHIP, &BM1366_CHIP, &BM1368_CHIP, &BM1370_CHIP, &BM1373_CHIP };
+
+// every configured frequency option that is off the 6.25 MHz grid
+static const float OFF_GRID_OPTIONS[] = { 327, 380, 410, 485, 490 };
+
+static void assert_table_matches_search(const bm13xx_chip_t * chip, float frequency)
+{
+    pll_setting_t table, search;
+
+    TEST_ASSERT_TRUE_MESSAGE(pll_lookup_parameters(frequency, chip->pll_fb_min, chip->pll_fb_max, &table), "missing from the PLL table");
+    pll_search_parameters(frequency, chip->pll_fb_min, chip->pll_fb_max, &search);
+
+    TEST_ASSERT_EQUAL_UINT8(search.fb_divider, table.fb_divider);
+    TEST_ASSERT_EQUAL_UINT8(search.refdiv, table.refdiv);
+    TEST_ASSERT_EQUAL_UINT8(search.postdiv1, table.postdiv1);
+    TEST_ASSERT_EQUAL_UINT8(search.postdiv2, table.postdiv2);
+    // exact, not within a tolerance: the table has to reproduce the search bit for bit
+    TEST_ASSERT_TRUE(search.actual_freq == table.actual_freq);
+}
+
+TEST_CASE("PLL table matches the search on the 6.25 MHz grid and the frequency options", "[pll]")
+{
+    for (int c = 0; c < sizeof(CHIPS) / sizeof(CHIPS[0]); c++) {
+        for (int step = 8; step <= 160; step++) {
+            assert_table_matches_search(CHIPS[c], step * 6.25f);
+        }
+        for (int i = 0; i < sizeof(OFF_GRID_OPTIONS) / sizeof(OFF_GRID_OPTIONS[0]); i++) {
+            assert_table_matches_search(CHIPS[c], OFF_GRID_OPTIONS[i]);
+        }
+    }
+}
+
+TEST_CASE("PLL falls back to the search off the table", "[pll]")
+{
+    pll_setting_t setting;
+    uint8_t fb_divider, refdiv, postdiv1, postdiv2;
+    float actual_freq;
+
+    TEST_ASSERT_FALSE(pll_lookup_parameters(452.5f, 144, 235, &setting));
+    TEST_ASSERT_FALSE(pll_lookup_parameters(450.0f, 100, 150, &setting));
+
+    pll_search_parameters(452.5f, 144, 235, &setting);
+    pll_get_parameters(452.5f, 144, 235, &fb_divider, &refdiv, &postdiv1, &postdiv2, &actual_freq);
+    TEST_ASSERT_EQUAL_UINT8(setting.fb_divider, fb_divider);
+    TEST_ASSERT_EQUAL_UINT8(setting.refdiv, refdiv);
+    TEST_ASSERT_EQUAL_UINT8(setting.postdiv1, postdiv1);
+    TEST_ASSERT_EQUAL_UINT8(setting.postdiv2, postdiv2);
+    TEST_ASSERT_TRUE(setting.actual_freq == actual_freq);
+}
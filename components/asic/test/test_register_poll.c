@@ -0,0 +1,117 @@
+#include "unity.h"
+
+#include "register_poll.h"
+
+#define MS 1000LL
+
+static const register_type_t REGISTER_MAP[] = {
+    [0x08] = REGISTER_PLL_PARAM,
+    [0x4C] = REGISTER_ERROR_COUNT,
+    [0x88] = REGISTER_DOMAIN_0_COUNT,
+    [0x8C] = REGISTER_TOTAL_COUNT,
+    [0xB4] = REGISTER_TEMPERATURE,
+};
+
+TEST_CASE("Register poll reads each register at its own rate", "[register_poll]")
+{
+    register_poll_t poll;
+    uint8_t addresses[REGISTER_POLL_MAX];
+    int reads[256] = {0};
+
+    register_poll_init(&poll, REGISTER_MAP, sizeof(REGISTER_MAP) / sizeof(REGISTER_MAP[0]), 1, 1 * MS);
+    TEST_ASSERT_EQUAL(5, poll.count);
+
+    // a job every 100 ms for 20 s, every read answered right away
+    for (int64_t now = 1 * MS; now < 20001 * MS; now += 100 * MS) {
+        int count = register_poll_due(&poll, now, 0, addresses, 4);
+        for (int i = 0; i < count; i++) {
+            reads[addresses[i]]++;
+            register_poll_response(&poll, addresses[i], now + 1 * MS);
+        }
+    }
+
+    TEST_ASSERT_EQUAL(20, reads[0x8C]);
+    TEST_ASSERT_EQUAL(20, reads[0x4C]);
+    TEST_ASSERT_EQUAL(10, reads[0x88]);
+    TEST_ASSERT_EQUAL(4, reads[0xB4]);
+    TEST_ASSERT_EQUAL(2, reads[0x08]);
+    TEST_ASSERT_EQUAL(poll.stats.reads, poll.stats.completed);
+    TEST_ASSERT_EQUAL(0, poll.stats.timeouts);
+    TEST_ASSERT_EQUAL(1 * MS, poll.stats.max_latency_us);
+}
+
+TEST_CASE("Register poll spreads due reads over several jobs", "[register_poll]")
+{
+    register_poll_t poll;
+    uint8_t addresses[REGISTER_POLL_MAX];
+
+    register_poll_init(&poll, REGISTER_MAP, sizeof(REGISTER_MAP) / sizeof(REGISTER_MAP[0]), 1, 1 * MS);
+
+    TEST_ASSERT_EQUAL(2, register_poll_due(&poll, 1 * MS, 0, addresses, 2));
+    TEST_ASSERT_EQUAL(2, register_poll_due(&poll, 2 * MS, 0, addresses, 2));
+    TEST_ASSERT_EQUAL(1, register_poll_due(&poll, 3 * MS, 0, addresses, 2));
+    TEST_ASSERT_EQUAL(0, register_poll_due(&poll, 4 * MS, 0, addresses, 2));
+}
+
+TEST_CASE("Register poll waits for every chip and gives up on missing answers", "[register_poll]")
+{
+    register_poll_t poll;
+    uint8_t addresses[REGISTER_POLL_MAX];
+    static const register_type_t map[] = { [0x8C] = REGISTER_TOTAL_COUNT };
+
+    register_poll_init(&poll, map, sizeof(map) / sizeof(map[0]), 3, 1 * MS);
+
+    TEST_ASSERT_EQUAL(1, register_poll_due(&poll, 1 * MS, 0, addresses, 4));
+    TEST_ASSERT_EQUAL_UINT8(0x8C, addresses[0]);
+    register_poll_response(&poll, 0x8C, 2 * MS);
+    register_poll_response(&poll, 0x8C, 3 * MS);
+    TEST_ASSERT_EQUAL(0, poll.stats.completed);
+
+    // the third chip never answers: no second read while the first is outstanding
+    TEST_ASSERT_EQUAL(0, register_poll_due(&poll, 1001 * MS - REGISTER_POLL_TIMEOUT_MS * MS - 1, 0, addresses, 4));
+    TEST_ASSERT_EQUAL(1, register_poll_due(&poll, 1001 * MS, 0, addresses, 4));
+    TEST_ASSERT_EQUAL(1, poll.stats.timeouts);
+
+    // a straggler from the expired read does not count towards the new one
+    for (int chip = 0; chip < 3; chip++) {
+        register_poll_response(&poll, 0x8C, 1002 * MS);
+    }
+    TEST_ASSERT_EQUAL(1, poll.stats.completed);
+    register_poll_response(&poll, 0x8C, 1003 * MS);
+    TEST_ASSERT_EQUAL(1, poll.stats.unexpected);
+}
+
+TEST_CASE("Register poll fallback only picks up overdue registers", "[register_poll]")
+{
+    register_poll_t poll;
+    uint8_t addresses[REGISTER_POLL_MAX];
+    static const register_type_t map[] = { [0x8C] = REGISTER_TOTAL_COUNT };
+
+    register_poll_init(&poll, map, sizeof(map) / sizeof(map[0]), 1, 1 * MS);
+
+    TEST_ASSERT_EQUAL(0, register_poll_due(&poll, 400 * MS, 500 * MS, addresses, 4));
+    TEST_ASSERT_EQUAL(1, register_poll_due(&poll, 501 * MS, 500 * MS, addresses, 4));
+    register_poll_response(&poll, 0x8C, 502 * MS);
+
+    // late by more than a period: the next read is a period from now, not right away
+    TEST_ASSERT_EQUAL(1, register_poll_due(&poll, 5000 * MS, 0, addresses, 4));
+    register_poll_response(&poll, 0x8C, 5001 * MS);
+    TEST_ASSERT_EQUAL(0, register_poll_due(&poll, 5500 * MS, 0, addresses, 4));
+    TEST_ASSERT_EQUAL(1, register_poll_due(&poll, 6000 * MS, 0, addresses, 4));
+}
+
+TEST_CASE("On-die temperature decodes only finished conversions", "[register_poll]")
+{
+    float temp_c = 0;
+
+    TEST_ASSERT_FALSE(asic_decode_temperature(0x00000900, &temp_c));
+    TEST_ASSERT_EQUAL_FLOAT(0, temp_c);
+
+    // 0x900 = 2304 -> 2304 * 0.171342 - 299.5144
+    TEST_ASSERT_TRUE(asic_decode_temperature(0x80000900, &temp_c));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 95.26f, temp_c);
+
+    // the bits between the flag and the reading are not part of it
+    TEST_ASSERT_TRUE(asic_decode_temperature(0x80AB0900, &temp_c));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 95.26f, temp_c);
+}
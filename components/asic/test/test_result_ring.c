@@ -0,0 +1,104 @@
+#include "unity.h"
+
+#include "result_ring.h"
+
+#include <string.h>
+
+static task_result nonce_result(uint32_t nonce)
+{
+    task_result result = {
+        .job_id = nonce & 0x7F,
+        .nonce = nonce,
+        .rolled_version = 0x20000000 | nonce,
+        .timestamp_us = 1000 + nonce,
+    };
+    return result;
+}
+
+TEST_CASE("Result ring keeps results in order", "[result_ring]")
+{
+    static result_ring_t ring;
+    memset(&ring, 0, sizeof(ring));
+
+    task_result out;
+
+    // run the indices around the ring a few times
+    for (uint32_t i = 0; i < 3 * RESULT_RING_SIZE; i++) {
+        task_result in = nonce_result(i);
+        TEST_ASSERT_TRUE(result_ring_push(&ring, &in));
+        TEST_ASSERT_EQUAL(1, result_ring_count(&ring));
+
+        TEST_ASSERT_TRUE(result_ring_pop(&ring, &out));
+        TEST_ASSERT_EQUAL_MEMORY(&in, &out, sizeof(task_result));
+    }
+
+    TEST_ASSERT_FALSE(result_ring_pop(&ring, &out));
+
+    result_ring_stats_t stats;
+    result_ring_get_stats(&ring, &stats);
+    TEST_ASSERT_EQUAL(3 * RESULT_RING_SIZE, stats.pushed);
+    TEST_ASSERT_EQUAL(1, stats.high_water);
+    TEST_ASSERT_EQUAL(0, stats.overflows);
+}
+
+TEST_CASE("Result ring counts overflows and keeps the oldest results", "[result_ring]")
+{
+    static result_ring_t ring;
+    memset(&ring, 0, sizeof(ring));
+
+    task_result in, out;
+
+    for (uint32_t i = 0; i < RESULT_RING_SIZE; i++) {
+        in = nonce_result(i);
+        TEST_ASSERT_TRUE(result_ring_push(&ring, &in));
+    }
+    in = nonce_result(RESULT_RING_SIZE);
+    TEST_ASSERT_FALSE(result_ring_push(&ring, &in));
+    TEST_ASSERT_FALSE(result_ring_push(&ring, &in));
+
+    result_ring_stats_t stats;
+    result_ring_get_stats(&ring, &stats);
+    TEST_ASSERT_EQUAL(RESULT_RING_SIZE, stats.pushed);
+    TEST_ASSERT_EQUAL(RESULT_RING_SIZE, stats.high_water);
+    TEST_ASSERT_EQUAL(2, stats.overflows);
+
+    TEST_ASSERT_TRUE(result_ring_pop(&ring, &out));
+    TEST_ASSERT_EQUAL_HEX32(0, out.nonce);
+
+    result_ring_discard(&ring);
+    TEST_ASSERT_EQUAL(0, result_ring_count(&ring));
+    TEST_ASSERT_FALSE(result_ring_pop(&ring, &out));
+}
+
+TEST_CASE("Result ring high-water mark tracks the deepest backlog", "[result_ring]")
+{
+    static result_ring_t ring;
+    memset(&ring, 0, sizeof(ring));
+
+    task_result in = nonce_result(1), out;
+
+    // a consumer that keeps up: never more than a batch waiting
+    for (int batch = 0; batch < 10; batch++) {
+        for (int i = 0; i < 4; i++) {
+            TEST_ASSERT_TRUE(result_ring_push(&ring, &in));
+        }
+        while (result_ring_pop(&ring, &out)) {
+        }
+    }
+
+    result_ring_stats_t stats;
+    result_ring_get_stats(&ring, &stats);
+    TEST_ASSERT_EQUAL(4, stats.high_water);
+
+    // one that stalls for a while: the mark stays after it catches up
+    for (int i = 0; i < 20; i++) {
+        TEST_ASSERT_TRUE(result_ring_push(&ring, &in));
+    }
+    while (result_ring_pop(&ring, &out)) {
+    }
+    TEST_ASSERT_TRUE(result_ring_push(&ring, &in));
+
+    result_ring_get_stats(&ring, &stats);
+    TEST_ASSERT_EQUAL(20, stats.high_water);
+    TEST_ASSERT_EQUAL(61, stats.pushed);
+}
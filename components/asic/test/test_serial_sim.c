@@ -0,0 +1,148 @@
+#include "unity.h"
+#include "sdkconfig.h"
+
+#if CONFIG_ASIC_SERIAL_SIMULATOR
+
+#include "bm1370.h"
+#include "asic_rx.h"
+#include "esp_timer.h"
+#include "global_state.h"
+#include "serial.h"
+#include "mining.h"
+#include "utils.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SIM_TICKET_DIFF 16
+#define SIM_JOB_ID 24
+
+// GlobalState is too large for the test task stack
+static GlobalState state;
+
+TEST_CASE("Batched chip init stops enumerating once every chip answered", "[asic_sim]")
+{
+    int chip_count = CONFIG_ASIC_SIM_CHIP_COUNT;
+
+    // the family's chips are split evenly over the chains
+    state.DEVICE_CONFIG.family.asic_count = chip_count * ASIC_CHAIN_COUNT;
+    state.DEVICE_CONFIG.family.asic.difficulty = SIM_TICKET_DIFF;
+    state.DEVICE_CONFIG.family.asic.core_count = 80;
+    state.POWER_MANAGEMENT_MODULE.frequency_value = 525;
+
+    TEST_ASSERT_EQUAL(ESP_OK, SERIAL_init(0));
+    asic_rx_stop(0);
+    BM13XX_select_chip(&BM1370_CHIP);
+    SERIAL_clear_buffer(0);
+
+    // the whole sequence used to wait out a 1 s read timeout after the last CHIP_ID answer
+    int64_t start_us = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(chip_count, BM13XX_init(&state, 0));
+    TEST_ASSERT_LESS_THAN(500000, esp_timer_get_time() - start_us);
+
+    // the queued commands went out in order: the chain answers at its new addresses
+    uint8_t frame[BM13XX_MAX_RESULT_LENGTH];
+    BM13XX_read_chip_id(0);
+    for (int i = 0; i < chip_count; i++) {
+        TEST_ASSERT_EQUAL(BM1370_CHIP.chip_id_response_length, SERIAL_rx(0, frame, BM1370_CHIP.chip_id_response_length, 1000));
+        TEST_ASSERT_EQUAL_UINT8(i * (256 / chip_count), frame[6]);
+    }
+}
+
+#if ASIC_CHAIN_COUNT > 1
+TEST_CASE("Chains enumerate independently and only answer on their own UART", "[asic_sim]")
+{
+    int chip_count = CONFIG_ASIC_SIM_CHIP_COUNT;
+
+    BM13XX_select_chip(&BM1370_CHIP);
+    for (uint8_t chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        TEST_ASSERT_EQUAL(ESP_OK, SERIAL_init(chain));
+        asic_rx_stop(chain);
+        SERIAL_clear_buffer(chain);
+        TEST_ASSERT_EQUAL(chip_count, BM13XX_init(&state, chain));
+    }
+
+    uint8_t frame[BM13XX_MAX_RESULT_LENGTH];
+    BM13XX_read_chip_id(1);
+    for (int i = 0; i < chip_count; i++) {
+        TEST_ASSERT_EQUAL(BM1370_CHIP.chip_id_response_length, SERIAL_rx(1, frame, BM1370_CHIP.chip_id_response_length, 1000));
+    }
+    TEST_ASSERT_EQUAL(0, SERIAL_rx(0, frame, BM1370_CHIP.chip_id_response_length, 50));
+}
+#endif
+
+TEST_CASE("Simulated chain enumerates, negotiates baud and returns valid nonces", "[asic_sim]")
+{
+    const bm13xx_chip_t * chip = &BM1370_CHIP;
+    int chip_count = CONFIG_ASIC_SIM_CHIP_COUNT;
+
+    TEST_ASSERT_EQUAL(ESP_OK, SERIAL_init(0));
+    asic_rx_stop(0);
+    BM13XX_select_chip(chip);
+    SERIAL_clear_buffer(0);
+
+    BM13XX_read_chip_id(0);
+    TEST_ASSERT_EQUAL(chip_count, BM13XX_count_chips(0, chip_count));
+
+    BM13XX_send_chain_inactive(0);
+    uint8_t address_interval = 256 / chip_count;
+    for (int i = 0; i < chip_count; i++) {
+        BM13XX_set_chip_address(0, i * address_interval);
+    }
+    BM13XX_set_chain(0, chip_count, address_interval);
+
+    uint8_t difficulty_mask[6];
+    get_difficulty_mask(SIM_TICKET_DIFF, difficulty_mask);
+    BM13XX_send(0, (TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, false);
+    BM13XX_set_version_mask(0, STRATUM_DEFAULT_VERSION_MASK);
+
+    TEST_ASSERT_EQUAL(ESP_OK, asic_rx_start(0, chip->result_length));
+
+    // the probe reads must come back from every chip through the RX task
+    asic_rx_stats_t before, after;
+    get_receive_work_stats(0, &before);
+    TEST_ASSERT_EQUAL(1000000, BM13XX_negotiate_baud(0, chip_count));
+    get_receive_work_stats(0, &after);
+    TEST_ASSERT_TRUE(after.frames - before.frames >= chip_count);
+
+    bm_job job = {
+        .version = 0x20000000,
+        .version_mask = STRATUM_DEFAULT_VERSION_MASK,
+        .ntime = 0x66000000,
+        .target = 0x17034219,
+    };
+    for (int i = 0; i < 32; i++) {
+        job.prev_block_hash[i] = i;
+        job.merkle_root[i] = 0xA5 ^ i;
+    }
+
+    BM13XX_job packet = { .job_id = SIM_JOB_ID, .num_midstates = 1 };
+    memcpy(packet.nbits, &job.target, 4);
+    memcpy(packet.ntime, &job.ntime, 4);
+    memcpy(packet.merkle_root, job.merkle_root, 32);
+    memcpy(packet.prev_block_hash, job.prev_block_hash, 32);
+    memcpy(packet.version, &job.version, 4);
+    BM13XX_send(0, (TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&packet, sizeof(packet), false);
+
+    // every nonce that makes it through the RX path must really meet the scaled ticket mask
+    uint8_t frame[BM13XX_MAX_RESULT_LENGTH];
+    uint64_t timestamp_us;
+    for (int found = 0; found < 8;) {
+        TEST_ASSERT_EQUAL(ESP_OK, receive_work(0, frame, chip->result_length, &timestamp_us));
+        if (!(frame[chip->result_length - 1] & 0x80)) {
+            continue;
+        }
+
+        uint32_t nonce;
+        memcpy(&nonce, frame + 2, 4);
+        uint32_t rolled_version = job.version | (((frame[8] << 8) | frame[9]) << 13);
+
+        TEST_ASSERT_EQUAL_UINT8(SIM_JOB_ID, (frame[7] & chip->result_job_id.mask) >> chip->result_job_id.shift);
+        TEST_ASSERT_TRUE(test_nonce_value(&job, nonce, rolled_version) >= ldexp(SIM_TICKET_DIFF, -CONFIG_ASIC_SIM_DIFFICULTY_SHIFT));
+        found++;
+    }
+
+    asic_rx_stop(0);
+}
+
+#endif
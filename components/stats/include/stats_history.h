@@ -0,0 +1,44 @@
+#ifndef STATS_HISTORY_H_
+#define STATS_HISTORY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "stats_store.h"
+
+#define STATS_HISTORY_PARTITION "stats"
+#define STATS_HISTORY_PARTITION_SUBTYPE 0x40
+
+// Flash the logs live on, addresses relative to its start; size is a
+// multiple of the 4 KiB sector and erase works on whole sectors
+typedef struct
+{
+    uint32_t size;
+    void * context;
+    esp_err_t (*read)(void * context, uint32_t address, void * data, uint32_t length);
+    esp_err_t (*write)(void * context, uint32_t address, const void * data, uint32_t length);
+    esp_err_t (*erase)(void * context, uint32_t address, uint32_t length);
+} stats_history_flash_t;
+
+// Finds the partition and where each log left off, false without the partition
+bool stats_history_init(uint8_t metrics);
+
+// The same on other flash, the unit tests keep theirs in RAM
+bool stats_history_init_flash(const stats_history_flash_t * flash, uint8_t metrics);
+
+// Forgets the logs and frees their buffers, the flash stays as it is
+void stats_history_deinit(void);
+
+// Queues a closed 1m or 1h rollup, timestamped on the uptime clock
+void stats_history_add(stats_resolution_t resolution, const stats_point_t * point);
+
+// Writes the queued points of every resolution whose batch is full or old
+// enough, or all of them with force. Nothing is written until the wall clock is set.
+void stats_history_flush(bool force);
+
+// Adds the persisted points of the query's resolution that are older than
+// before, moved to the uptime clock; earlier boots land before 0. Only the
+// sectors holding points of the range are read.
+void stats_history_merge(stats_merge_t * merge, int64_t before);
+
+#endif /* STATS_HISTORY_H_ */
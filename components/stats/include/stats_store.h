@@ -0,0 +1,148 @@
+#ifndef STATS_STORE_H_
+#define STATS_STORE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATS_STORE_MAX_METRICS 20
+
+typedef enum
+{
+    STATS_RESOLUTION_AUTO = -1,
+    STATS_RESOLUTION_1S,
+    STATS_RESOLUTION_1M,
+    STATS_RESOLUTION_1H,
+    STATS_STORE_RESOLUTIONS
+} stats_resolution_t;
+
+// One point as queries see it; at 1s resolution min, avg and max are the sample itself
+typedef struct
+{
+    int64_t timestamp; // ms, the start of the interval for rollups and merged points
+    float min[STATS_STORE_MAX_METRICS];
+    float avg[STATS_STORE_MAX_METRICS];
+    float max[STATS_STORE_MAX_METRICS];
+} stats_point_t;
+
+// Return false to end the query early
+typedef bool (*stats_store_visitor_t)(const stats_point_t * point, void * context);
+
+// Called for every 1m and 1h rollup as its interval closes
+typedef void (*stats_store_rollup_t)(stats_resolution_t resolution, const stats_point_t * point, void * context);
+
+typedef struct
+{
+    stats_resolution_t resolution; // the resolution actually used is written back
+    int64_t from;                  // ms, inclusive
+    int64_t to;                    // ms, inclusive
+    uint32_t bucket_ms;            // points are merged to this spacing, rounded up to the resolution
+    uint32_t metrics;              // bit mask of the metrics to decode, 0 for all
+} stats_range_t;
+
+// One resolution. Points collect uncompressed in the open block; a full block
+// is compressed column by column into a ring of variable sized records and the
+// oldest records make room when the ring is full.
+typedef struct
+{
+    uint32_t interval_ms;
+    uint16_t block_points;
+    uint8_t metrics;
+    uint16_t columns; // one per metric, or min, avg and max per metric for rollups
+
+    uint8_t * arena;
+    uint32_t arena_size;
+    uint32_t head;   // where the next record goes
+    uint32_t tail;   // oldest record
+    uint32_t wrap;   // end of the records before head wrapped around, 0 while not wrapped
+    uint16_t blocks;
+
+    uint64_t * open_timestamps;
+    float * open_values; // column major, block_points per column
+    uint16_t open_points;
+
+    // rollup of the next finer resolution for the interval in progress
+    uint64_t bucket;
+    uint16_t bucket_points;
+    float bucket_min[STATS_STORE_MAX_METRICS];
+    float bucket_max[STATS_STORE_MAX_METRICS];
+    double bucket_sum[STATS_STORE_MAX_METRICS];
+    uint16_t bucket_count[STATS_STORE_MAX_METRICS];
+} stats_tier_t;
+
+// Time series of up to STATS_STORE_MAX_METRICS float metrics, kept at 1s, 1m
+// and 1h resolution. Timestamps are delta-of-delta coded and values XOR coded
+// against their predecessor, as in Facebook's Gorilla.
+typedef struct
+{
+    uint8_t metrics;
+    bool has_data;
+    uint64_t first_timestamp; // of the first sample ever added
+    stats_tier_t tiers[STATS_STORE_RESOLUTIONS];
+
+    stats_store_rollup_t on_rollup;
+    void * rollup_context;
+
+    uint8_t * scratch; // a block being compressed
+    uint64_t * decoded_timestamps;
+    float * decoded_values;
+    uint16_t decoded_capacity; // points of the largest block
+} stats_store_t;
+
+// Merges the points of a query into buckets of range->bucket_ms on their way to the visitor
+typedef struct
+{
+    stats_store_t * store;
+    const stats_range_t * range;
+    stats_store_visitor_t visitor;
+    void * context;
+    bool merge;
+    bool stopped;
+    uint32_t visited;
+
+    bool pending;
+    int64_t key;
+    stats_point_t point;
+    double sum[STATS_STORE_MAX_METRICS];
+    uint16_t count[STATS_STORE_MAX_METRICS];
+} stats_merge_t;
+
+bool stats_store_init(stats_store_t * store, uint8_t metrics);
+void stats_store_free(stats_store_t * store);
+
+// Timestamps have to increase, samples that go back in time are dropped
+void stats_store_add(stats_store_t * store, uint64_t timestamp, const float * values);
+
+uint32_t stats_store_interval_ms(stats_resolution_t resolution);
+bool stats_store_oldest(const stats_store_t * store, stats_resolution_t resolution, uint64_t * timestamp);
+uint32_t stats_store_bytes(const stats_store_t * store, stats_resolution_t resolution);
+
+// Visits the points of range oldest first, returns how many were visited
+uint32_t stats_store_query(stats_store_t * store, stats_range_t * range, stats_store_visitor_t visitor, void * context);
+
+// The steps of stats_store_query(), for queries that add points from elsewhere
+// ahead of the ones in memory
+void stats_store_resolve(stats_store_t * store, stats_range_t * range);
+void stats_merge_init(stats_merge_t * merge, stats_store_t * store, const stats_range_t * range, stats_store_visitor_t visitor, void * context);
+void stats_merge_add(stats_merge_t * merge, const stats_point_t * point);
+// Adds the points of a compressed block earlier than before, shifted by offset_ms
+void stats_merge_block(stats_merge_t * merge, const uint8_t * block, int64_t offset_ms, int64_t before);
+void stats_store_merge(stats_store_t * store, stats_merge_t * merge);
+uint32_t stats_merge_finish(stats_merge_t * merge);
+
+// PSRAM where there is some, internal RAM otherwise; free with heap_caps_free()
+void * stats_alloc(size_t size);
+
+// A tier without an arena is a batch of points that compresses into one block
+bool stats_tier_init(stats_tier_t * tier, stats_resolution_t resolution, uint8_t metrics, uint16_t block_points, uint32_t arena_size);
+void stats_tier_free(stats_tier_t * tier);
+void stats_tier_append(stats_tier_t * tier, const stats_point_t * point);
+uint32_t stats_tier_block_max(const stats_tier_t * tier);
+// Compresses and empties the open block, its timestamps shifted by offset_ms, returns the block length
+uint32_t stats_tier_encode(stats_tier_t * tier, uint8_t * out, int64_t offset_ms);
+// Length of a compressed block, 0 if block does not hold one
+uint32_t stats_block_length(const uint8_t * block, uint32_t size);
+// Timestamps of the first and last point of a compressed block, as encoded
+void stats_block_span(const uint8_t * block, int64_t * first, int64_t * last);
+
+#endif /* STATS_STORE_H_ */
@@ -0,0 +1,389 @@
+#include <inttypes.h>
+#include <string.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_crc.h"
+#include <esp_heap_caps.h>
+#include "stats_history.h"
+
+static const char * TAG = "stats_history";
+
+#define SECTOR_SIZE 4096
+#define SECTOR_MAGIC 0x53544831 // "STH1", bump when the block layout changes
+#define RECORD_ERASED 0xFFFF
+#define WALL_CLOCK_VALID_S 1600000000 // the clock is set from the first job's ntime
+
+// Every sector starts with this, the sequence grows by one per sector started
+typedef struct
+{
+    uint32_t magic;
+    uint32_t sequence;
+} sector_header_t;
+
+// Followed by a compressed block of length bytes
+typedef struct
+{
+    uint16_t length;
+    uint16_t reserved;
+    uint32_t crc;
+} record_header_t;
+
+typedef struct
+{
+    uint16_t batch_points;
+    uint32_t flush_ms; // a batch is written at least this often
+    uint8_t sixths;    // of the partition
+} history_config_t;
+
+// About 1 KiB every 10 minutes for 1m keeps four days in 640 KiB, the 1h log
+// holds over a month. Every sector is erased once per pass through its log.
+static const history_config_t HISTORY_CONFIG[STATS_STORE_RESOLUTIONS] = {
+    [STATS_RESOLUTION_1M] = {10, 10 * 60 * 1000, 5},
+    [STATS_RESOLUTION_1H] = {6, 6 * 60 * 60 * 1000, 1},
+};
+
+// Wall clock ms of the points in a sector, first > last while it has none
+typedef struct
+{
+    int64_t first;
+    int64_t last;
+} sector_span_t;
+
+// A ring of sectors written front to back; starting a sector erases the oldest one
+typedef struct
+{
+    sector_span_t * spans; // per sector, so queries only read the sectors they need
+    uint32_t first_sector;
+    uint32_t sectors;
+    int32_t head;      // sector being written, -1 while the log is empty
+    uint32_t offset;   // of the next record in the head sector
+    uint32_t sequence; // of the head sector
+
+    stats_tier_t batch;
+    int64_t batch_started; // uptime ms
+} history_log_t;
+
+static stats_history_flash_t flash;
+static bool enabled;
+static history_log_t logs[STATS_STORE_RESOLUTIONS];
+static uint8_t * sector_buffer;
+static uint8_t * record_buffer;
+static int64_t clock_offset_ms;
+static bool clock_offset_valid;
+
+// Wall clock minus uptime, in ms. Taken once per boot from one microsecond
+// sample, so writes and queries agree to the ms and the hourly clock syncs
+// from ntime do not move this boot's points against each other.
+static bool wall_clock_offset(int64_t * offset_ms)
+{
+    if (!clock_offset_valid) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        int64_t uptime_us = esp_timer_get_time();
+        if (now.tv_sec < WALL_CLOCK_VALID_S) return false;
+
+        int64_t offset_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec - uptime_us;
+        clock_offset_ms = (offset_us + 500) / 1000;
+        clock_offset_valid = true;
+    }
+
+    *offset_ms = clock_offset_ms;
+    return true;
+}
+
+static uint32_t sector_address(const history_log_t * log, uint32_t sector)
+{
+    return (log->first_sector + sector) * SECTOR_SIZE;
+}
+
+static esp_err_t partition_read(void * context, uint32_t address, void * data, uint32_t length)
+{
+    return esp_partition_read(context, address, data, length);
+}
+
+static esp_err_t partition_write(void * context, uint32_t address, const void * data, uint32_t length)
+{
+    return esp_partition_write(context, address, data, length);
+}
+
+static esp_err_t partition_erase(void * context, uint32_t address, uint32_t length)
+{
+    return esp_partition_erase_range(context, address, length);
+}
+
+static void span_clear(sector_span_t * span)
+{
+    span->first = INT64_MAX;
+    span->last = INT64_MIN;
+}
+
+static void span_add(sector_span_t * span, const uint8_t * block)
+{
+    int64_t first, last;
+
+    stats_block_span(block, &first, &last);
+    if (first < span->first) span->first = first;
+    if (last > span->last) span->last = last;
+}
+
+// Whether the sector can hold points of the merge, compared on the uptime clock
+static bool span_wanted(const sector_span_t * span, const stats_merge_t * merge, int64_t offset_ms, int64_t before)
+{
+    if (span->first > span->last) return false;
+
+    int64_t first = span->first - offset_ms;
+    int64_t last = span->last - offset_ms;
+    return last >= merge->range->from && first <= merge->range->to && first < before;
+}
+
+// Length of the record at data including its header, 0 at the end of the sector or a damaged record
+static uint32_t record_size(const uint8_t * data, uint32_t size)
+{
+    record_header_t record;
+
+    if (size < sizeof(record)) return 0;
+    memcpy(&record, data, sizeof(record));
+
+    if (record.length == RECORD_ERASED || record.length > size - sizeof(record)) return 0;
+    if (stats_block_length(data + sizeof(record), record.length) != record.length) return 0;
+    if (esp_crc32_le(0, data + sizeof(record), record.length) != record.crc) return 0;
+    return sizeof(record) + record.length;
+}
+
+static bool read_sector(const history_log_t * log, uint32_t sector, sector_header_t * header)
+{
+    if (flash.read(flash.context, sector_address(log, sector), sector_buffer, SECTOR_SIZE) != ESP_OK) return false;
+    memcpy(header, sector_buffer, sizeof(*header));
+    return header->magic == SECTOR_MAGIC;
+}
+
+// Notes the span of the records in sector_buffer and returns where appends
+// continue: after the last good record, or past a damaged one at the end
+static uint32_t scan_sector(sector_span_t * span)
+{
+    uint32_t offset = sizeof(sector_header_t);
+    uint16_t length = 0;
+
+    while (true) {
+        uint32_t size = record_size(sector_buffer + offset, SECTOR_SIZE - offset);
+        if (size == 0) break;
+
+        span_add(span, sector_buffer + offset + sizeof(record_header_t));
+        offset += size;
+    }
+
+    if (offset + sizeof(record_header_t) <= SECTOR_SIZE) {
+        memcpy(&length, sector_buffer + offset, sizeof(length));
+    }
+    return length == RECORD_ERASED ? offset : SECTOR_SIZE;
+}
+
+static void history_recover(history_log_t * log)
+{
+    sector_header_t header;
+
+    log->head = -1;
+    for (uint32_t sector = 0; sector < log->sectors; sector++) {
+        span_clear(&log->spans[sector]);
+        if (!read_sector(log, sector, &header)) continue;
+
+        uint32_t offset = scan_sector(&log->spans[sector]);
+        if (log->head < 0 || header.sequence > log->sequence) {
+            log->head = sector;
+            log->sequence = header.sequence;
+            log->offset = offset;
+        }
+    }
+}
+
+static bool history_append(history_log_t * log, uint32_t length)
+{
+    uint32_t size = sizeof(record_header_t) + length;
+
+    if (size > SECTOR_SIZE - sizeof(sector_header_t)) return false;
+
+    if (log->head < 0 || log->offset + size > SECTOR_SIZE) {
+        uint32_t next = log->head < 0 ? 0 : (log->head + 1) % log->sectors;
+        sector_header_t header = {SECTOR_MAGIC, log->sequence + 1};
+
+        span_clear(&log->spans[next]);
+        if (flash.erase(flash.context, sector_address(log, next), SECTOR_SIZE) != ESP_OK) return false;
+        if (flash.write(flash.context, sector_address(log, next), &header, sizeof(header)) != ESP_OK) return false;
+        log->head = next;
+        log->sequence = header.sequence;
+        log->offset = sizeof(header);
+    }
+
+    record_header_t record = {
+        .length = length,
+        .crc = esp_crc32_le(0, record_buffer + sizeof(record), length),
+    };
+    memcpy(record_buffer, &record, sizeof(record));
+
+    // one write, so a power cut leaves a record that fails its CRC rather than a gap
+    if (flash.write(flash.context, sector_address(log, log->head) + log->offset, record_buffer, size) != ESP_OK) {
+        log->offset = SECTOR_SIZE;
+        return false;
+    }
+    log->offset += size;
+    span_add(&log->spans[log->head], record_buffer + sizeof(record));
+    return true;
+}
+
+static void flush_log(stats_resolution_t resolution, bool force, int64_t now_ms)
+{
+    history_log_t * log = &logs[resolution];
+    stats_tier_t * batch = &log->batch;
+    int64_t offset_ms;
+
+    if (batch->open_points == 0) return;
+
+    bool full = batch->open_points == batch->block_points;
+    if (!force && !full && now_ms - log->batch_started < HISTORY_CONFIG[resolution].flush_ms) return;
+
+    if (!wall_clock_offset(&offset_ms)) {
+        // the points can only be placed in time once the clock is set
+        if (full) batch->open_points = 0;
+        return;
+    }
+
+    uint32_t length = stats_tier_encode(batch, record_buffer + sizeof(record_header_t), offset_ms);
+    if (!history_append(log, length)) {
+        ESP_LOGW(TAG, "Failed to write %s statistics", resolution == STATS_RESOLUTION_1M ? "1m" : "1h");
+    }
+}
+
+void stats_history_deinit(void)
+{
+    for (int resolution = STATS_RESOLUTION_1M; resolution < STATS_STORE_RESOLUTIONS; resolution++) {
+        stats_tier_free(&logs[resolution].batch);
+        heap_caps_free(logs[resolution].spans);
+    }
+    memset(logs, 0, sizeof(logs));
+    heap_caps_free(sector_buffer);
+    heap_caps_free(record_buffer);
+    sector_buffer = record_buffer = NULL;
+    clock_offset_valid = false;
+    enabled = false;
+}
+
+static bool history_disable(void)
+{
+    ESP_LOGE(TAG, "Statistics history disabled");
+    stats_history_deinit();
+    return false;
+}
+
+bool stats_history_init(uint8_t metrics)
+{
+    const esp_partition_t * partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, STATS_HISTORY_PARTITION_SUBTYPE, STATS_HISTORY_PARTITION);
+    if (partition == NULL) {
+        ESP_LOGW(TAG, "No %s partition, statistics do not survive a reboot", STATS_HISTORY_PARTITION);
+        return false;
+    }
+
+    stats_history_flash_t partition_flash = {
+        .size = partition->size,
+        .context = (void *)partition,
+        .read = partition_read,
+        .write = partition_write,
+        .erase = partition_erase,
+    };
+    return stats_history_init_flash(&partition_flash, metrics);
+}
+
+bool stats_history_init_flash(const stats_history_flash_t * history_flash, uint8_t metrics)
+{
+    flash = *history_flash;
+
+    sector_buffer = stats_alloc(SECTOR_SIZE);
+    record_buffer = stats_alloc(SECTOR_SIZE);
+    if (sector_buffer == NULL || record_buffer == NULL) {
+        return history_disable();
+    }
+
+    uint32_t sectors = flash.size / SECTOR_SIZE;
+    uint32_t first_sector = 0;
+    for (int resolution = STATS_RESOLUTION_1M; resolution < STATS_STORE_RESOLUTIONS; resolution++) {
+        history_log_t * log = &logs[resolution];
+
+        log->first_sector = first_sector;
+        log->sectors = resolution == STATS_STORE_RESOLUTIONS - 1 ? sectors - first_sector : sectors * HISTORY_CONFIG[resolution].sixths / 6;
+        first_sector += log->sectors;
+
+        if (log->sectors < 2 || !stats_tier_init(&log->batch, resolution, metrics, HISTORY_CONFIG[resolution].batch_points, 0)) {
+            return history_disable();
+        }
+        log->spans = stats_alloc(log->sectors * sizeof(sector_span_t));
+        if (log->spans == NULL) {
+            return history_disable();
+        }
+        if (sizeof(record_header_t) + stats_tier_block_max(&log->batch) > SECTOR_SIZE - sizeof(sector_header_t)) {
+            return history_disable();
+        }
+
+        history_recover(log);
+        ESP_LOGI(TAG, "%s log: %" PRIu32 " sectors, head %" PRId32 " at %" PRIu32, resolution == STATS_RESOLUTION_1M ? "1m" : "1h",
+                 log->sectors, log->head, log->offset);
+    }
+
+    enabled = true;
+    return true;
+}
+
+void stats_history_add(stats_resolution_t resolution, const stats_point_t * point)
+{
+    if (!enabled || resolution == STATS_RESOLUTION_1S) return;
+
+    history_log_t * log = &logs[resolution];
+    int64_t now_ms = esp_timer_get_time() / 1000;
+
+    // still full when the clock was not set in time
+    flush_log(resolution, false, now_ms);
+
+    if (log->batch.open_points == 0) {
+        log->batch_started = now_ms;
+    }
+    stats_tier_append(&log->batch, point);
+}
+
+void stats_history_flush(bool force)
+{
+    if (!enabled) return;
+
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    for (int resolution = STATS_RESOLUTION_1M; resolution < STATS_STORE_RESOLUTIONS; resolution++) {
+        flush_log(resolution, force, now_ms);
+    }
+}
+
+void stats_history_merge(stats_merge_t * merge, int64_t before)
+{
+    stats_resolution_t resolution = merge->range->resolution;
+    int64_t offset_ms;
+
+    if (!enabled || resolution == STATS_RESOLUTION_1S) return;
+
+    history_log_t * log = &logs[resolution];
+    if (log->head < 0 || !wall_clock_offset(&offset_ms)) return;
+
+    // oldest sector first, the head comes last
+    for (uint32_t i = 1; i <= log->sectors && !merge->stopped; i++) {
+        uint32_t sector = (log->head + i) % log->sectors;
+        sector_header_t header;
+
+        if (!span_wanted(&log->spans[sector], merge, offset_ms, before)) continue;
+        if (!read_sector(log, sector, &header)) continue;
+
+        uint32_t offset = sizeof(sector_header_t);
+        while (!merge->stopped) {
+            uint32_t size = record_size(sector_buffer + offset, SECTOR_SIZE - offset);
+            if (size == 0) break;
+
+            stats_merge_block(merge, sector_buffer + offset + sizeof(record_header_t), -offset_ms, before);
+            offset += size;
+        }
+    }
+}
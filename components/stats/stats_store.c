@@ -0,0 +1,725 @@
+#include <math.h>
+#include <string.h>
+#include <esp_heap_caps.h>
+#include "stats_store.h"
+
+typedef struct
+{
+    uint32_t interval_ms;
+    uint16_t block_points;
+    uint32_t arena_size;
+} stats_tier_config_t;
+
+// At typical compression 1s holds about 40 minutes, 1m most of a day and 1h two weeks
+static const stats_tier_config_t TIER_CONFIG[STATS_STORE_RESOLUTIONS] = {
+    {1000, 120, 64 * 1024},
+    {60 * 1000, 60, 96 * 1024},
+    {60 * 60 * 1000, 24, 32 * 1024},
+};
+
+// Header of a compressed block, followed by the byte offset of every column,
+// the timestamp stream and the column streams, each starting on a byte
+typedef struct
+{
+    uint32_t length; // whole record, a multiple of 4
+    uint16_t points;
+    uint16_t columns;
+    uint32_t interval_ms;
+    uint16_t metrics;
+    uint16_t reserved;
+    int64_t first;
+    int64_t last;
+} stats_block_t;
+
+#define TIMESTAMP_MAX_BITS 68 // '1111' and a raw delta-of-delta
+#define VALUE_MAX_BITS 44     // '11', leading zeros, length and 32 bits
+
+typedef struct
+{
+    uint8_t * data;
+    uint32_t bit;
+} bit_stream_t;
+
+static void put_bits(bit_stream_t * stream, uint64_t value, uint8_t count)
+{
+    while (count > 0) {
+        uint8_t * byte = &stream->data[stream->bit >> 3];
+        uint8_t offset = stream->bit & 7;
+        uint8_t room = 8 - offset;
+        uint8_t take = count < room ? count : room;
+        uint8_t chunk = (value >> (count - take)) & ((1u << take) - 1);
+
+        if (offset == 0) *byte = 0;
+        *byte |= chunk << (room - take);
+        stream->bit += take;
+        count -= take;
+    }
+}
+
+static uint64_t get_bits(bit_stream_t * stream, uint8_t count)
+{
+    uint64_t value = 0;
+    while (count > 0) {
+        uint8_t byte = stream->data[stream->bit >> 3];
+        uint8_t offset = stream->bit & 7;
+        uint8_t room = 8 - offset;
+        uint8_t take = count < room ? count : room;
+
+        value = (value << take) | ((byte >> (room - take)) & ((1u << take) - 1));
+        stream->bit += take;
+        count -= take;
+    }
+    return value;
+}
+
+static uint32_t float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// The first delta is predicted to be the tier interval, so a steady series costs a bit per point
+static void encode_timestamps(bit_stream_t * stream, const uint64_t * timestamps, uint16_t points, uint32_t interval_ms)
+{
+    int64_t previous_delta = interval_ms;
+
+    for (int i = 1; i < points; i++) {
+        int64_t delta = timestamps[i] - timestamps[i - 1];
+        int64_t dod = delta - previous_delta;
+        previous_delta = delta;
+
+        if (dod == 0) {
+            put_bits(stream, 0, 1);
+        } else if (dod >= -63 && dod <= 64) {
+            put_bits(stream, 0x2, 2);
+            put_bits(stream, dod + 63, 7);
+        } else if (dod >= -255 && dod <= 256) {
+            put_bits(stream, 0x6, 3);
+            put_bits(stream, dod + 255, 9);
+        } else if (dod >= -2047 && dod <= 2048) {
+            put_bits(stream, 0xE, 4);
+            put_bits(stream, dod + 2047, 12);
+        } else {
+            put_bits(stream, 0xF, 4);
+            put_bits(stream, (uint64_t)dod, 64);
+        }
+    }
+}
+
+static void decode_timestamps(bit_stream_t * stream, uint64_t * timestamps, uint64_t first, uint16_t points, uint32_t interval_ms)
+{
+    int64_t previous_delta = interval_ms;
+
+    timestamps[0] = first;
+    for (int i = 1; i < points; i++) {
+        int64_t dod;
+        if (get_bits(stream, 1) == 0) {
+            dod = 0;
+        } else if (get_bits(stream, 1) == 0) {
+            dod = (int64_t)get_bits(stream, 7) - 63;
+        } else if (get_bits(stream, 1) == 0) {
+            dod = (int64_t)get_bits(stream, 9) - 255;
+        } else if (get_bits(stream, 1) == 0) {
+            dod = (int64_t)get_bits(stream, 12) - 2047;
+        } else {
+            dod = (int64_t)get_bits(stream, 64);
+        }
+        previous_delta += dod;
+        timestamps[i] = timestamps[i - 1] + previous_delta;
+    }
+}
+
+// A value equal to the last costs a bit. Otherwise the XOR with it is stored,
+// reusing the last window of meaningful bits when it still fits.
+static void encode_values(bit_stream_t * stream, const float * values, uint16_t points)
+{
+    uint32_t previous = float_bits(values[0]);
+    uint8_t leading = 0xFF;
+    uint8_t trailing = 0;
+
+    put_bits(stream, previous, 32);
+    for (int i = 1; i < points; i++) {
+        uint32_t bits = float_bits(values[i]);
+        uint32_t xor = bits ^ previous;
+        previous = bits;
+
+        if (xor == 0) {
+            put_bits(stream, 0, 1);
+            continue;
+        }
+
+        uint8_t xor_leading = __builtin_clz(xor);
+        uint8_t xor_trailing = __builtin_ctz(xor);
+        if (leading != 0xFF && xor_leading >= leading && xor_trailing >= trailing) {
+            put_bits(stream, 0x2, 2);
+            put_bits(stream, xor >> trailing, 32 - leading - trailing);
+        } else {
+            uint8_t length = 32 - xor_leading - xor_trailing;
+            put_bits(stream, 0x3, 2);
+            put_bits(stream, xor_leading, 5);
+            put_bits(stream, length - 1, 5);
+            put_bits(stream, xor >> xor_trailing, length);
+            leading = xor_leading;
+            trailing = xor_trailing;
+        }
+    }
+}
+
+static void decode_values(bit_stream_t * stream, float * values, uint16_t points)
+{
+    uint32_t previous = get_bits(stream, 32);
+    uint8_t leading = 0;
+    uint8_t trailing = 0;
+
+    values[0] = bits_float(previous);
+    for (int i = 1; i < points; i++) {
+        if (get_bits(stream, 1) != 0) {
+            if (get_bits(stream, 1) != 0) {
+                leading = get_bits(stream, 5);
+                trailing = 32 - leading - (get_bits(stream, 5) + 1);
+            }
+            previous ^= (uint32_t)get_bits(stream, 32 - leading - trailing) << trailing;
+        }
+        values[i] = bits_float(previous);
+    }
+}
+
+uint32_t stats_tier_block_max(const stats_tier_t * tier)
+{
+    uint32_t bits = tier->block_points * TIMESTAMP_MAX_BITS + tier->columns * (32 + tier->block_points * VALUE_MAX_BITS);
+    return sizeof(stats_block_t) + tier->columns * (sizeof(uint16_t) + 1) + bits / 8 + 8;
+}
+
+uint32_t stats_tier_encode(stats_tier_t * tier, uint8_t * out, int64_t offset_ms)
+{
+    uint16_t points = tier->open_points;
+    uint16_t offsets[tier->columns];
+    stats_block_t block = {
+        .points = points,
+        .columns = tier->columns,
+        .interval_ms = tier->interval_ms,
+        .metrics = tier->metrics,
+        .first = (int64_t)tier->open_timestamps[0] + offset_ms,
+        .last = (int64_t)tier->open_timestamps[points - 1] + offset_ms,
+    };
+
+    bit_stream_t stream = {out, (sizeof(block) + sizeof(offsets)) * 8};
+    encode_timestamps(&stream, tier->open_timestamps, points, tier->interval_ms);
+
+    for (int column = 0; column < tier->columns; column++) {
+        stream.bit = (stream.bit + 7) & ~7;
+        offsets[column] = stream.bit / 8;
+        encode_values(&stream, &tier->open_values[column * tier->block_points], points);
+    }
+
+    uint32_t length = (stream.bit + 7) / 8;
+    block.length = (length + 3) & ~3;
+    memset(out + length, 0, block.length - length);
+
+    memcpy(out, &block, sizeof(block));
+    memcpy(out + sizeof(block), offsets, sizeof(offsets));
+
+    tier->open_points = 0;
+    return block.length;
+}
+
+uint32_t stats_block_length(const uint8_t * data, uint32_t size)
+{
+    stats_block_t block;
+
+    if (size < sizeof(block)) return 0;
+    memcpy(&block, data, sizeof(block));
+
+    if (block.length > size || block.length < sizeof(block) + block.columns * sizeof(uint16_t)) return 0;
+    if (block.points == 0 || block.interval_ms == 0 || block.metrics == 0 || block.metrics > STATS_STORE_MAX_METRICS) return 0;
+    if (block.columns != block.metrics && block.columns != 3 * block.metrics) return 0;
+    return block.length;
+}
+
+void stats_block_span(const uint8_t * data, int64_t * first, int64_t * last)
+{
+    stats_block_t block;
+
+    memcpy(&block, data, sizeof(block));
+    *first = block.first;
+    *last = block.last;
+}
+
+static bool column_wanted(const stats_store_t * store, int column, uint32_t metrics)
+{
+    return metrics == 0 || (metrics & (1u << (column % store->metrics)));
+}
+
+static void arena_evict(stats_tier_t * tier)
+{
+    stats_block_t block;
+    memcpy(&block, tier->arena + tier->tail, sizeof(block));
+
+    tier->tail += block.length;
+    tier->blocks--;
+    if (tier->wrap != 0 && tier->tail >= tier->wrap) {
+        tier->tail = 0;
+        tier->wrap = 0;
+    }
+}
+
+static uint8_t * arena_reserve(stats_tier_t * tier, uint32_t length)
+{
+    if (length > tier->arena_size) return NULL;
+
+    while (true) {
+        if (tier->blocks == 0) {
+            tier->head = tier->tail = tier->wrap = 0;
+        }
+        if (tier->wrap == 0) {
+            if (tier->arena_size - tier->head >= length) break;
+            if (tier->blocks > 0 && tier->tail >= length) {
+                tier->wrap = tier->head;
+                tier->head = 0;
+                break;
+            }
+        } else if (tier->tail - tier->head >= length) {
+            break;
+        }
+        arena_evict(tier);
+    }
+
+    uint8_t * record = tier->arena + tier->head;
+    tier->head += length;
+    tier->blocks++;
+    return record;
+}
+
+void stats_tier_append(stats_tier_t * tier, const stats_point_t * point)
+{
+    uint16_t index = tier->open_points;
+    uint8_t metrics = tier->metrics;
+
+    if (point->timestamp < 0) return;
+    if (index > 0 && (uint64_t)point->timestamp <= tier->open_timestamps[index - 1]) return;
+
+    tier->open_timestamps[index] = point->timestamp;
+    for (int metric = 0; metric < metrics; metric++) {
+        if (tier->columns == metrics) {
+            tier->open_values[metric * tier->block_points + index] = point->avg[metric];
+        } else {
+            tier->open_values[metric * tier->block_points + index] = point->min[metric];
+            tier->open_values[(metrics + metric) * tier->block_points + index] = point->avg[metric];
+            tier->open_values[(2 * metrics + metric) * tier->block_points + index] = point->max[metric];
+        }
+    }
+    tier->open_points++;
+}
+
+static void tier_append(stats_store_t * store, stats_tier_t * tier, const stats_point_t * point)
+{
+    stats_tier_append(tier, point);
+
+    if (tier->open_points == tier->block_points) {
+        uint32_t length = stats_tier_encode(tier, store->scratch, 0);
+        uint8_t * record = arena_reserve(tier, length);
+        if (record != NULL) {
+            memcpy(record, store->scratch, length);
+        }
+    }
+}
+
+static void bucket_result(const stats_store_t * store, const stats_tier_t * tier, stats_point_t * point)
+{
+    point->timestamp = tier->bucket;
+    for (int metric = 0; metric < store->metrics; metric++) {
+        if (tier->bucket_count[metric] > 0) {
+            point->min[metric] = tier->bucket_min[metric];
+            point->avg[metric] = tier->bucket_sum[metric] / tier->bucket_count[metric];
+            point->max[metric] = tier->bucket_max[metric];
+        } else {
+            point->min[metric] = point->avg[metric] = point->max[metric] = NAN;
+        }
+    }
+}
+
+// Feeds a point of the finer resolution into the interval in progress of
+// resolution, closing the interval and passing it on once time moves past it
+static void rollup(stats_store_t * store, int resolution, const stats_point_t * point)
+{
+    if (resolution >= STATS_STORE_RESOLUTIONS) return;
+
+    stats_tier_t * tier = &store->tiers[resolution];
+    uint64_t bucket = point->timestamp - point->timestamp % tier->interval_ms;
+
+    if (tier->bucket_points > 0 && bucket != tier->bucket) {
+        stats_point_t closed;
+
+        bucket_result(store, tier, &closed);
+        tier_append(store, tier, &closed);
+        if (store->on_rollup != NULL) {
+            store->on_rollup(resolution, &closed, store->rollup_context);
+        }
+        rollup(store, resolution + 1, &closed);
+        tier->bucket_points = 0;
+    }
+
+    if (tier->bucket_points == 0) {
+        tier->bucket = bucket;
+        memset(tier->bucket_count, 0, sizeof(tier->bucket_count));
+    }
+    tier->bucket_points++;
+
+    for (int metric = 0; metric < store->metrics; metric++) {
+        if (isnan(point->avg[metric])) continue;
+        if (tier->bucket_count[metric]++ == 0) {
+            tier->bucket_min[metric] = point->min[metric];
+            tier->bucket_max[metric] = point->max[metric];
+            tier->bucket_sum[metric] = point->avg[metric];
+        } else {
+            tier->bucket_min[metric] = fminf(tier->bucket_min[metric], point->min[metric]);
+            tier->bucket_max[metric] = fmaxf(tier->bucket_max[metric], point->max[metric]);
+            tier->bucket_sum[metric] += point->avg[metric];
+        }
+    }
+}
+
+// the unit tests run without PSRAM
+void * stats_alloc(size_t size)
+{
+    return heap_caps_malloc_prefer(size, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+}
+
+void stats_tier_free(stats_tier_t * tier)
+{
+    heap_caps_free(tier->arena);
+    heap_caps_free(tier->open_timestamps);
+    heap_caps_free(tier->open_values);
+    memset(tier, 0, sizeof(*tier));
+}
+
+bool stats_tier_init(stats_tier_t * tier, stats_resolution_t resolution, uint8_t metrics, uint16_t block_points, uint32_t arena_size)
+{
+    memset(tier, 0, sizeof(*tier));
+    tier->interval_ms = TIER_CONFIG[resolution].interval_ms;
+    tier->block_points = block_points;
+    tier->metrics = metrics;
+    tier->columns = resolution == STATS_RESOLUTION_1S ? metrics : 3 * metrics;
+    tier->arena_size = arena_size;
+
+    if (arena_size > 0) {
+        tier->arena = stats_alloc(arena_size);
+    }
+    tier->open_timestamps = stats_alloc(block_points * sizeof(uint64_t));
+    tier->open_values = stats_alloc(block_points * tier->columns * sizeof(float));
+    if ((arena_size > 0 && tier->arena == NULL) || tier->open_timestamps == NULL || tier->open_values == NULL) {
+        stats_tier_free(tier);
+        return false;
+    }
+    return true;
+}
+
+void stats_store_free(stats_store_t * store)
+{
+    for (int resolution = 0; resolution < STATS_STORE_RESOLUTIONS; resolution++) {
+        stats_tier_free(&store->tiers[resolution]);
+    }
+    heap_caps_free(store->scratch);
+    heap_caps_free(store->decoded_timestamps);
+    heap_caps_free(store->decoded_values);
+    memset(store, 0, sizeof(*store));
+}
+
+bool stats_store_init(stats_store_t * store, uint8_t metrics)
+{
+    uint32_t scratch_size = 0;
+    uint16_t decoded_points = 0;
+
+    memset(store, 0, sizeof(*store));
+    if (metrics == 0 || metrics > STATS_STORE_MAX_METRICS) return false;
+    store->metrics = metrics;
+
+    for (int resolution = 0; resolution < STATS_STORE_RESOLUTIONS; resolution++) {
+        const stats_tier_config_t * config = &TIER_CONFIG[resolution];
+        stats_tier_t * tier = &store->tiers[resolution];
+
+        if (!stats_tier_init(tier, resolution, metrics, config->block_points, config->arena_size)) {
+            stats_store_free(store);
+            return false;
+        }
+
+        uint32_t max_length = stats_tier_block_max(tier);
+        if (max_length > scratch_size) scratch_size = max_length;
+        if (tier->block_points > decoded_points) decoded_points = tier->block_points;
+    }
+
+    // room for the largest block of any resolution, rollup columns included
+    store->scratch = stats_alloc(scratch_size);
+    store->decoded_timestamps = stats_alloc(decoded_points * sizeof(uint64_t));
+    store->decoded_values = stats_alloc(decoded_points * 3 * metrics * sizeof(float));
+    store->decoded_capacity = decoded_points;
+    if (store->scratch == NULL || store->decoded_timestamps == NULL || store->decoded_values == NULL) {
+        stats_store_free(store);
+        return false;
+    }
+
+    return true;
+}
+
+void stats_store_add(stats_store_t * store, uint64_t timestamp, const float * values)
+{
+    stats_tier_t * tier = &store->tiers[STATS_RESOLUTION_1S];
+    stats_point_t point = {.timestamp = timestamp};
+
+    if (tier->open_points > 0 && timestamp <= tier->open_timestamps[tier->open_points - 1]) return;
+
+    if (!store->has_data) {
+        store->has_data = true;
+        store->first_timestamp = timestamp;
+    }
+
+    memcpy(point.min, values, store->metrics * sizeof(float));
+    memcpy(point.avg, values, store->metrics * sizeof(float));
+    memcpy(point.max, values, store->metrics * sizeof(float));
+
+    tier_append(store, tier, &point);
+    rollup(store, STATS_RESOLUTION_1M, &point);
+}
+
+uint32_t stats_store_interval_ms(stats_resolution_t resolution)
+{
+    return TIER_CONFIG[resolution].interval_ms;
+}
+
+bool stats_store_oldest(const stats_store_t * store, stats_resolution_t resolution, uint64_t * timestamp)
+{
+    const stats_tier_t * tier = &store->tiers[resolution];
+
+    if (tier->blocks > 0) {
+        stats_block_t block;
+        memcpy(&block, tier->arena + tier->tail, sizeof(block));
+        *timestamp = block.first;
+    } else if (tier->open_points > 0) {
+        *timestamp = tier->open_timestamps[0];
+    } else if (tier->bucket_points > 0) {
+        *timestamp = tier->bucket;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+uint32_t stats_store_bytes(const stats_store_t * store, stats_resolution_t resolution)
+{
+    const stats_tier_t * tier = &store->tiers[resolution];
+
+    if (tier->blocks == 0) return 0;
+    if (tier->wrap != 0) return tier->wrap - tier->tail + tier->head;
+    return tier->head - tier->tail;
+}
+
+void stats_merge_init(stats_merge_t * merge, stats_store_t * store, const stats_range_t * range, stats_store_visitor_t visitor, void * context)
+{
+    memset(merge, 0, sizeof(*merge));
+    merge->store = store;
+    merge->range = range;
+    merge->visitor = visitor;
+    merge->context = context;
+    merge->merge = range->bucket_ms > TIER_CONFIG[range->resolution].interval_ms;
+}
+
+static void merge_emit(stats_merge_t * merge, const stats_point_t * point)
+{
+    merge->visited++;
+    if (!merge->visitor(point, merge->context)) {
+        merge->stopped = true;
+    }
+}
+
+static void merge_flush(stats_merge_t * merge)
+{
+    for (int metric = 0; metric < merge->store->metrics; metric++) {
+        if (merge->count[metric] > 0) {
+            merge->point.avg[metric] = merge->sum[metric] / merge->count[metric];
+        } else {
+            merge->point.min[metric] = merge->point.avg[metric] = merge->point.max[metric] = NAN;
+        }
+    }
+    merge->pending = false;
+    merge_emit(merge, &merge->point);
+}
+
+void stats_merge_add(stats_merge_t * merge, const stats_point_t * point)
+{
+    const stats_range_t * range = merge->range;
+
+    if (merge->stopped || point->timestamp < range->from || point->timestamp > range->to) return;
+
+    if (!merge->merge) {
+        merge_emit(merge, point);
+        return;
+    }
+
+    // floor, the points of earlier boots lie before 0
+    int64_t key = point->timestamp >= 0 ? point->timestamp / range->bucket_ms
+                                        : -((-point->timestamp + range->bucket_ms - 1) / range->bucket_ms);
+    if (merge->pending && key != merge->key) {
+        merge_flush(merge);
+        if (merge->stopped) return;
+    }
+    if (!merge->pending) {
+        merge->pending = true;
+        merge->key = key;
+        merge->point.timestamp = key * range->bucket_ms;
+        memset(merge->count, 0, sizeof(merge->count));
+    }
+
+    for (int metric = 0; metric < merge->store->metrics; metric++) {
+        if (isnan(point->avg[metric])) continue;
+        if (merge->count[metric]++ == 0) {
+            merge->point.min[metric] = point->min[metric];
+            merge->point.max[metric] = point->max[metric];
+            merge->sum[metric] = point->avg[metric];
+        } else {
+            merge->point.min[metric] = fminf(merge->point.min[metric], point->min[metric]);
+            merge->point.max[metric] = fmaxf(merge->point.max[metric], point->max[metric]);
+            merge->sum[metric] += point->avg[metric];
+        }
+    }
+}
+
+static void merge_points(stats_merge_t * merge, bool rollup, const uint64_t * timestamps, const float * values,
+                         uint16_t points, uint16_t stride, int64_t offset_ms, int64_t before)
+{
+    uint8_t metrics = merge->store->metrics;
+    stats_point_t point;
+
+    for (int i = 0; i < points && !merge->stopped; i++) {
+        point.timestamp = (int64_t)timestamps[i] + offset_ms;
+        if (point.timestamp >= before) break;
+
+        for (int metric = 0; metric < metrics; metric++) {
+            if (!column_wanted(merge->store, metric, merge->range->metrics)) {
+                point.min[metric] = point.avg[metric] = point.max[metric] = NAN;
+            } else if (rollup) {
+                point.min[metric] = values[metric * stride + i];
+                point.avg[metric] = values[(metrics + metric) * stride + i];
+                point.max[metric] = values[(2 * metrics + metric) * stride + i];
+            } else {
+                point.min[metric] = point.avg[metric] = point.max[metric] = values[metric * stride + i];
+            }
+        }
+        stats_merge_add(merge, &point);
+    }
+}
+
+void stats_merge_block(stats_merge_t * merge, const uint8_t * record, int64_t offset_ms, int64_t before)
+{
+    stats_store_t * store = merge->store;
+    const stats_range_t * range = merge->range;
+    stats_block_t block;
+
+    memcpy(&block, record, sizeof(block));
+    if (merge->stopped || block.metrics != store->metrics || block.points > store->decoded_capacity) return;
+    if (block.first + offset_ms > range->to || block.first + offset_ms >= before || block.last + offset_ms < range->from) return;
+
+    uint16_t offsets[block.columns];
+    memcpy(offsets, record + sizeof(block), sizeof(offsets));
+
+    bit_stream_t stream = {(uint8_t *)record, (sizeof(block) + sizeof(offsets)) * 8};
+    decode_timestamps(&stream, store->decoded_timestamps, block.first, block.points, block.interval_ms);
+
+    for (int column = 0; column < block.columns; column++) {
+        if (!column_wanted(store, column, range->metrics)) continue;
+        stream.bit = offsets[column] * 8;
+        decode_values(&stream, &store->decoded_values[column * block.points], block.points);
+    }
+
+    merge_points(merge, block.columns != block.metrics, store->decoded_timestamps, store->decoded_values,
+                 block.points, block.points, offset_ms, before);
+}
+
+// Finest resolution that still reaches back to from, stepping up while the
+// merged points are at least as far apart as the next one
+static stats_resolution_t pick_resolution(const stats_store_t * store, int64_t from, uint32_t bucket_ms)
+{
+    uint64_t start = from > (int64_t)store->first_timestamp ? (uint64_t)from : store->first_timestamp;
+    int resolution = STATS_STORE_RESOLUTIONS - 1;
+
+    for (int r = 0; r < STATS_STORE_RESOLUTIONS; r++) {
+        uint64_t oldest;
+        if (stats_store_oldest(store, r, &oldest) && oldest <= start) {
+            resolution = r;
+            break;
+        }
+    }
+
+    while (resolution + 1 < STATS_STORE_RESOLUTIONS && bucket_ms >= TIER_CONFIG[resolution + 1].interval_ms) {
+        uint64_t oldest;
+        if (!stats_store_oldest(store, resolution + 1, &oldest) || oldest > start) break;
+        resolution++;
+    }
+
+    return resolution;
+}
+
+void stats_store_resolve(stats_store_t * store, stats_range_t * range)
+{
+    if (range->resolution < 0 || range->resolution >= STATS_STORE_RESOLUTIONS) {
+        range->resolution = pick_resolution(store, range->from, range->bucket_ms);
+    }
+
+    uint32_t interval_ms = TIER_CONFIG[range->resolution].interval_ms;
+    if (range->bucket_ms < interval_ms) range->bucket_ms = interval_ms;
+    range->bucket_ms = (range->bucket_ms + interval_ms - 1) / interval_ms * interval_ms;
+}
+
+void stats_store_merge(stats_store_t * store, stats_merge_t * merge)
+{
+    const stats_tier_t * tier = &store->tiers[merge->range->resolution];
+
+    uint32_t position = tier->tail;
+    for (int i = 0; i < tier->blocks && !merge->stopped; i++) {
+        stats_block_t block;
+        memcpy(&block, tier->arena + position, sizeof(block));
+        if (block.first > merge->range->to) break;
+
+        stats_merge_block(merge, tier->arena + position, 0, INT64_MAX);
+
+        position += block.length;
+        if (tier->wrap != 0 && position >= tier->wrap) position = 0;
+    }
+
+    merge_points(merge, tier->columns != store->metrics, tier->open_timestamps, tier->open_values,
+                 tier->open_points, tier->block_points, 0, INT64_MAX);
+
+    // the interval still in progress
+    if (tier->bucket_points > 0) {
+        stats_point_t point;
+        bucket_result(store, tier, &point);
+        stats_merge_add(merge, &point);
+    }
+}
+
+uint32_t stats_merge_finish(stats_merge_t * merge)
+{
+    if (merge->pending && !merge->stopped) {
+        merge_flush(merge);
+    }
+    return merge->visited;
+}
+
+uint32_t stats_store_query(stats_store_t * store, stats_range_t * range, stats_store_visitor_t visitor, void * context)
+{
+    stats_merge_t merge;
+
+    if (!store->has_data || range->from > range->to) return 0;
+
+    stats_store_resolve(store, range);
+    stats_merge_init(&merge, store, range, visitor, context);
+    stats_store_merge(store, &merge);
+    return stats_merge_finish(&merge);
+}
@@ -0,0 +1,215 @@
+#include "unity.h"
+
+#include "stats_history.h"
+#include "stats_store.h"
+
+#include <string.h>
+#include <sys/time.h>
+#include "esp_timer.h"
+
+#define METRICS 3
+#define M (60 * 1000LL)
+#define FLASH_SECTOR_SIZE 4096
+#define FLASH_SECTORS 12 // ten for the 1m log, two for 1h
+
+typedef struct
+{
+    uint8_t data[FLASH_SECTORS * FLASH_SECTOR_SIZE];
+    uint32_t reads;
+} ram_flash_t;
+
+static ram_flash_t ram;
+
+static esp_err_t ram_read(void * context, uint32_t address, void * data, uint32_t length)
+{
+    ram_flash_t * flash = context;
+    if (address + length > sizeof(flash->data)) return ESP_ERR_INVALID_SIZE;
+
+    memcpy(data, flash->data + address, length);
+    flash->reads++;
+    return ESP_OK;
+}
+
+// NOR flash only clears bits
+static esp_err_t ram_write(void * context, uint32_t address, const void * data, uint32_t length)
+{
+    ram_flash_t * flash = context;
+    if (address + length > sizeof(flash->data)) return ESP_ERR_INVALID_SIZE;
+
+    for (uint32_t i = 0; i < length; i++) {
+        flash->data[address + i] &= ((const uint8_t *)data)[i];
+    }
+    return ESP_OK;
+}
+
+static esp_err_t ram_erase(void * context, uint32_t address, uint32_t length)
+{
+    ram_flash_t * flash = context;
+    if (address % FLASH_SECTOR_SIZE != 0 || address + length > sizeof(flash->data)) return ESP_ERR_INVALID_ARG;
+
+    memset(flash->data + address, 0xFF, length);
+    return ESP_OK;
+}
+
+static const stats_history_flash_t RAM_FLASH = {
+    .size = sizeof(ram.data),
+    .context = &ram,
+    .read = ram_read,
+    .write = ram_write,
+    .erase = ram_erase,
+};
+
+// Nothing is written before the wall clock is set. Every boot sets it to the
+// same offset from uptime, so the points of earlier boots come back unmoved.
+static void history_boot(bool blank)
+{
+    int64_t wall_us = 1700000000 * 1000000LL + esp_timer_get_time();
+    struct timeval now = {.tv_sec = wall_us / 1000000, .tv_usec = wall_us % 1000000};
+    settimeofday(&now, NULL);
+
+    if (blank) memset(ram.data, 0xFF, sizeof(ram.data));
+    TEST_ASSERT_TRUE(stats_history_init_flash(&RAM_FLASH, METRICS));
+}
+
+static void add_minutes(int first, int count)
+{
+    for (int minute = first; minute < first + count; minute++) {
+        stats_point_t point = {.timestamp = minute * M};
+        float values[METRICS] = {minute, -minute, minute * 0.5f};
+
+        for (int metric = 0; metric < METRICS; metric++) {
+            point.min[metric] = values[metric] - 1;
+            point.avg[metric] = values[metric];
+            point.max[metric] = values[metric] + 1;
+        }
+        stats_history_add(STATS_RESOLUTION_1M, &point);
+    }
+    stats_history_flush(true);
+}
+
+typedef struct
+{
+    int visited;
+    int64_t first;
+    int64_t last;
+} minutes_t;
+
+// Points come back on the uptime clock they were added on
+static bool check_minute(const stats_point_t * point, void * context)
+{
+    minutes_t * minutes = context;
+    int64_t minute = (point->timestamp + M / 2) / M;
+
+    TEST_ASSERT_EQUAL_INT64(minute * M, point->timestamp);
+    if (minutes->visited > 0) {
+        TEST_ASSERT_EQUAL_INT64(minutes->last + 1, minute);
+    } else {
+        minutes->first = minute;
+    }
+    minutes->last = minute;
+    minutes->visited++;
+
+    TEST_ASSERT_EQUAL_FLOAT(minute, point->avg[0]);
+    TEST_ASSERT_EQUAL_FLOAT(-minute - 1, point->min[1]);
+    TEST_ASSERT_EQUAL_FLOAT(minute * 0.5f + 1, point->max[2]);
+    return true;
+}
+
+static minutes_t query_minutes(stats_store_t * store, int64_t from, int64_t to)
+{
+    minutes_t minutes = {0};
+    stats_range_t range = {
+        .resolution = STATS_RESOLUTION_1M,
+        .from = from,
+        .to = to,
+        .bucket_ms = M,
+    };
+    stats_merge_t merge;
+
+    stats_merge_init(&merge, store, &range, check_minute, &minutes);
+    stats_history_merge(&merge, INT64_MAX);
+    TEST_ASSERT_EQUAL_UINT32(minutes.visited, stats_merge_finish(&merge));
+    return minutes;
+}
+
+TEST_CASE("Stats history round trip through flash", "[stats_history]")
+{
+    static stats_store_t store;
+    TEST_ASSERT_TRUE(stats_store_init(&store, METRICS));
+    history_boot(true);
+
+    // two full batches and the rest on the forced flush
+    add_minutes(0, 25);
+
+    minutes_t minutes = query_minutes(&store, 0, INT64_MAX);
+    TEST_ASSERT_EQUAL(25, minutes.visited);
+    TEST_ASSERT_EQUAL_INT64(0, minutes.first);
+    TEST_ASSERT_EQUAL_INT64(24, minutes.last);
+
+    stats_history_deinit();
+    stats_store_free(&store);
+}
+
+TEST_CASE("Stats history recovers its logs after a reboot", "[stats_history]")
+{
+    static stats_store_t store;
+    TEST_ASSERT_TRUE(stats_store_init(&store, METRICS));
+    history_boot(true);
+    add_minutes(0, 25);
+    stats_history_deinit();
+
+    // appends continue where the last boot stopped
+    history_boot(false);
+    TEST_ASSERT_EQUAL(25, query_minutes(&store, 0, INT64_MAX).visited);
+    add_minutes(25, 10);
+    TEST_ASSERT_EQUAL(35, query_minutes(&store, 0, INT64_MAX).visited);
+    stats_history_deinit();
+
+    // a power cut during the last write damages that record only
+    int end = FLASH_SECTOR_SIZE - 1;
+    while (ram.data[end] == 0xFF) end--;
+    ram.data[end] ^= 0x01;
+
+    history_boot(false);
+    minutes_t minutes = query_minutes(&store, 0, INT64_MAX);
+    TEST_ASSERT_EQUAL(25, minutes.visited);
+    TEST_ASSERT_EQUAL_INT64(24, minutes.last);
+
+    // the damaged sector counts as full, new records start the next one
+    add_minutes(25, 5);
+    TEST_ASSERT_EQUAL(30, query_minutes(&store, 0, INT64_MAX).visited);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, ram.data[end + 1]);
+
+    stats_history_deinit();
+    stats_store_free(&store);
+}
+
+TEST_CASE("Stats history wraps its ring and reads only the sectors a query needs", "[stats_history]")
+{
+    static stats_store_t store;
+    TEST_ASSERT_TRUE(stats_store_init(&store, METRICS));
+    history_boot(true);
+
+    // more than the ten sectors of the 1m log hold
+    const int written = 4000;
+    add_minutes(0, written);
+
+    minutes_t minutes = query_minutes(&store, 0, INT64_MAX);
+    TEST_ASSERT_GREATER_THAN(written / 4, minutes.visited);
+    TEST_ASSERT_LESS_THAN(written, minutes.visited);
+    TEST_ASSERT_EQUAL_INT64(written - 1, minutes.last);
+
+    ram.reads = 0;
+    // from between two points, the range does not hinge on the offset's rounding
+    minutes = query_minutes(&store, (written - 10) * M - M / 2, INT64_MAX);
+    TEST_ASSERT_EQUAL(10, minutes.visited);
+    TEST_ASSERT_LESS_OR_EQUAL(2, ram.reads);
+
+    // long overwritten
+    ram.reads = 0;
+    TEST_ASSERT_EQUAL(0, query_minutes(&store, 0, 10 * M).visited);
+    TEST_ASSERT_EQUAL(0, ram.reads);
+
+    stats_history_deinit();
+    stats_store_free(&store);
+}
@@ -0,0 +1,162 @@
+#include "unity.h"
+
+#include "stats_store.h"
+
+#include <math.h>
+#include <string.h>
+
+#define METRICS 3
+#define S 1000LL
+#define M (60 * S)
+
+// NaN, both zeros, repeats and plain values, in a pattern that shifts per metric
+static float sample_value(int i, int metric)
+{
+    if (metric == 2) return (float)(i / 5);
+
+    switch ((i + metric) % 7) {
+    case 0:
+        return NAN;
+    case 1:
+        return 0.0f;
+    case 2:
+        return -0.0f;
+    default:
+        return metric * 100.0f + i * 0.37f + (i % 3);
+    }
+}
+
+// A second apart with some jitter and a gap, as the statistics task samples
+static uint64_t sample_time(int i)
+{
+    return 5 * S + i * S + (i % 11 == 0 ? 3 : 0) + (i >= 200 ? 2 * M : 0);
+}
+
+static uint32_t bits(float value)
+{
+    uint32_t result;
+    memcpy(&result, &value, sizeof(result));
+    return result;
+}
+
+typedef struct
+{
+    int visited;
+} round_trip_t;
+
+static bool check_sample(const stats_point_t * point, void * context)
+{
+    round_trip_t * round_trip = context;
+    int i = round_trip->visited++;
+
+    TEST_ASSERT_EQUAL_INT64(sample_time(i), point->timestamp);
+    for (int metric = 0; metric < METRICS; metric++) {
+        uint32_t expected = bits(sample_value(i, metric));
+        TEST_ASSERT_EQUAL_HEX32(expected, bits(point->min[metric]));
+        TEST_ASSERT_EQUAL_HEX32(expected, bits(point->avg[metric]));
+        TEST_ASSERT_EQUAL_HEX32(expected, bits(point->max[metric]));
+    }
+    return true;
+}
+
+TEST_CASE("Stats 1s samples round trip bit for bit", "[stats_store]")
+{
+    static stats_store_t store;
+    TEST_ASSERT_TRUE(stats_store_init(&store, METRICS));
+
+    // two compressed blocks and a partly filled open one
+    const int samples = 300;
+    for (int i = 0; i < samples; i++) {
+        float values[METRICS];
+        for (int metric = 0; metric < METRICS; metric++) {
+            values[metric] = sample_value(i, metric);
+        }
+        stats_store_add(&store, sample_time(i), values);
+    }
+
+    round_trip_t round_trip = {0};
+    stats_range_t range = {
+        .resolution = STATS_RESOLUTION_1S,
+        .from = 0,
+        .to = INT64_MAX,
+    };
+    TEST_ASSERT_EQUAL_UINT32(samples, stats_store_query(&store, &range, check_sample, &round_trip));
+    TEST_ASSERT_EQUAL(samples, round_trip.visited);
+
+    stats_store_free(&store);
+}
+
+typedef struct
+{
+    int visited;
+    stats_point_t first;
+} rollups_t;
+
+// Metric 0 counts the seconds, metric 1 is missing for the first half of every
+// minute and metric 2 is never there
+static bool check_minute(const stats_point_t * point, void * context)
+{
+    rollups_t * rollups = context;
+    int minute = rollups->visited++;
+    float start = minute * 60;
+
+    TEST_ASSERT_EQUAL_INT64(minute * M, point->timestamp);
+    TEST_ASSERT_EQUAL_FLOAT(start, point->min[0]);
+    TEST_ASSERT_EQUAL_FLOAT(start + 29.5f, point->avg[0]);
+    TEST_ASSERT_EQUAL_FLOAT(start + 59, point->max[0]);
+
+    TEST_ASSERT_EQUAL_FLOAT(-59, point->min[1]);
+    TEST_ASSERT_EQUAL_FLOAT(-44.5f, point->avg[1]);
+    TEST_ASSERT_EQUAL_FLOAT(-30, point->max[1]);
+
+    TEST_ASSERT_TRUE(isnan(point->min[2]) && isnan(point->avg[2]) && isnan(point->max[2]));
+    return true;
+}
+
+static bool keep_first(const stats_point_t * point, void * context)
+{
+    rollups_t * rollups = context;
+    if (rollups->visited++ == 0) rollups->first = *point;
+    return true;
+}
+
+TEST_CASE("Stats 1m and 1h rollups keep min, avg and max", "[stats_store]")
+{
+    static stats_store_t store;
+    TEST_ASSERT_TRUE(stats_store_init(&store, METRICS));
+
+    // a compressed block of 60 minutes, an open one and the last minute closed
+    const int minutes = 62;
+    for (int i = 0; i < minutes * 60; i++) {
+        float values[METRICS] = {
+            i,
+            i % 60 < 30 ? NAN : -(float)(i % 60),
+            NAN,
+        };
+        stats_store_add(&store, i * S, values);
+    }
+    // the sample that closes the last minute
+    stats_store_add(&store, minutes * M, (float[METRICS]){NAN, NAN, NAN});
+
+    rollups_t rollups = {0};
+    stats_range_t range = {
+        .resolution = STATS_RESOLUTION_1M,
+        .from = 0,
+        .to = (minutes - 1) * M,
+    };
+    TEST_ASSERT_EQUAL_UINT32(minutes, stats_store_query(&store, &range, check_minute, &rollups));
+
+    // the first hour from its minutes, the average of their averages
+    memset(&rollups, 0, sizeof(rollups));
+    range.resolution = STATS_RESOLUTION_1H;
+    range.to = INT64_MAX;
+    TEST_ASSERT_EQUAL_UINT32(2, stats_store_query(&store, &range, keep_first, &rollups));
+    TEST_ASSERT_EQUAL_INT64(0, rollups.first.timestamp);
+    TEST_ASSERT_EQUAL_FLOAT(0, rollups.first.min[0]);
+    TEST_ASSERT_EQUAL_FLOAT(1799.5f, rollups.first.avg[0]);
+    TEST_ASSERT_EQUAL_FLOAT(3599, rollups.first.max[0]);
+    TEST_ASSERT_EQUAL_FLOAT(-44.5f, rollups.first.avg[1]);
+    TEST_ASSERT_TRUE(isnan(rollups.first.avg[2]));
+
+    stats_store_free(&store);
+}
@@ -23,6 +23,7 @@ typedef struct bm_job
     double pool_diff;
     char *jobid;
     char *extranonce2;
+    uint32_t sv2_channel_id; // SV2 standard channel the job belongs to
 } bm_job;
 
 void free_bm_job(bm_job *job);
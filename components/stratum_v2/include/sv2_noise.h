@@ -7,7 +7,15 @@
 
 typedef struct sv2_noise_ctx sv2_noise_ctx_t;
 
-// Create a new Noise context (allocates secp256k1 context internally).
+// One-time Noise setup: creates the shared, randomized secp256k1 context, runs
+// the ECDH self-test and starts precomputing the next ephemeral keypair in the
+// background. Safe to call on every connection attempt; later calls only
+// return the cached result and refill the ephemeral key if needed.
+// Returns 0 on success, -1 on error.
+int sv2_noise_init(void);
+
+// Create a new Noise context using the shared secp256k1 context.
+// Calls sv2_noise_init() if it has not run yet.
 sv2_noise_ctx_t *sv2_noise_create(void);
 
 // Destroy a Noise context and free all resources.
@@ -26,6 +34,12 @@ int sv2_noise_handshake(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
 int sv2_noise_send(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
                    const uint8_t *frame, int frame_len);
 
+// Send several SV2 frames laid out back to back in frames (each a complete
+// plaintext header + payload) with a single encrypted write.
+// Returns 0 on success, -1 on error.
+int sv2_noise_send_frames(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
+                          const uint8_t *frames, int frames_len);
+
 // Receive and decrypt an SV2 frame via Noise.
 // hdr_out receives the 6-byte decrypted frame header.
 // payload_out receives the decrypted payload (up to max_payload_len bytes).
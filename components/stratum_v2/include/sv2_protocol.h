@@ -20,6 +20,8 @@
 #define SV2_MSG_OPEN_EXTENDED_MINING_CHANNEL            0x13
 #define SV2_MSG_OPEN_EXTENDED_MINING_CHANNEL_SUCCESS    0x14
 #define SV2_MSG_NEW_MINING_JOB                          0x15
+#define SV2_MSG_UPDATE_CHANNEL                          0x16
+#define SV2_MSG_UPDATE_CHANNEL_ERROR                    0x17
 #define SV2_MSG_NEW_EXTENDED_MINING_JOB                 0x1f
 #define SV2_MSG_SUBMIT_SHARES_STANDARD                  0x1a
 #define SV2_MSG_SUBMIT_SHARES_EXTENDED                  0x1b
@@ -52,6 +54,7 @@ typedef struct {
 
 // Complete SV2 job (NewMiningJob + SetNewPrevHash combined)
 typedef struct {
+    uint32_t channel_id;
     uint32_t job_id;
     uint32_t version;
     uint8_t merkle_root[32]; // Internal byte order (as received from SV2)
@@ -88,18 +91,38 @@ typedef struct {
 
 #define SV2_PENDING_JOBS_SIZE 8
 
+#define SV2_MAX_STANDARD_CHANNELS 4
+
+// Standard channel state. Multi-chip boards open several standard channels so
+// header-only mining gets one independent job stream per chip group.
+typedef struct {
+    uint32_t channel_id;
+    uint32_t request_id;
+    bool opened;
+    double difficulty;
+    sv2_pending_job_t pending_jobs[SV2_PENDING_JOBS_SIZE];
+    sv2_job_t current_job;          // latest active job, re-sent in rotation
+    bool has_job;
+    uint32_t ntime_rolls;           // times current_job went out, each one a second later
+    uint32_t sequence_number;       // of the next share on this channel
+    uint32_t resolved_shares;       // shares on this channel the pool has accepted or rejected
+} sv2_std_channel_t;
+
 #define SV2_MAX_ACTIVE_JOB_IDS 16
 
 // SV2 connection state
 typedef struct sv2_conn {
     uint32_t channel_id;
-    uint32_t sequence_number;       // also the count of shares submitted
-    uint32_t resolved_shares;       // shares the pool has accepted or rejected
+    uint32_t sequence_number;       // extended channel sequence, also the count of shares submitted
+    uint32_t resolved_shares;       // shares the pool has accepted or rejected, on all channels
     uint8_t target[32]; // U256 LE target
     bool channel_opened;
 
-    // Pending future jobs ring buffer (standard channels)
-    sv2_pending_job_t pending_jobs[SV2_PENDING_JOBS_SIZE];
+    // Standard channels; index 0 is the first channel opened (channel_id above),
+    // its jobs go through the stratum queue. All of them are fed in rotation.
+    sv2_std_channel_t std_channels[SV2_MAX_STANDARD_CHANNELS];
+    uint8_t std_channel_count;
+    uint8_t next_std_channel;       // to get the ASICs on the next job interval
 
     // Latest prev_hash state
     uint8_t prev_hash[32];
@@ -117,6 +140,13 @@ typedef struct sv2_conn {
     // Active job IDs tracking for duplicate detection
     uint32_t active_job_ids[SV2_MAX_ACTIVE_JOB_IDS];
     int active_job_ids_count;
+
+    // UpdateChannel state (hashrate last announced to the pool, in H/s)
+    float announced_hash_rate;
+    int64_t last_update_channel_us;
+    bool max_target_rejected;       // pool refused our maximum_target, send hashrate only
+    double update_channel_difficulty; // pool difficulty when the last UpdateChannel went out
+    int64_t update_channel_backoff_us; // before asking again for a target the pool ignored
 } sv2_conn_t;
 
 // --- Frame encode/decode ---
@@ -145,6 +175,10 @@ int sv2_build_submit_shares_standard(uint8_t *buf, size_t buf_len,
                                      uint32_t job_id, uint32_t nonce,
                                      uint32_t ntime, uint32_t version);
 
+int sv2_build_update_channel(uint8_t *buf, size_t buf_len,
+                             uint32_t channel_id, float nominal_hash_rate,
+                             const uint8_t maximum_target[32]);
+
 // --- Message parsers (return 0 on success, -1 on error) ---
 
 int sv2_parse_setup_connection_success(const uint8_t *payload, uint32_t len,
@@ -178,6 +212,20 @@ int sv2_parse_submit_shares_error(const uint8_t *payload, uint32_t len,
                                   uint32_t *channel_id, uint32_t *seq_num,
                                   char *error_code, size_t error_code_size);
 
+int sv2_parse_open_mining_channel_error(const uint8_t *payload, uint32_t len,
+                                        uint32_t *request_id,
+                                        char *error_code, size_t error_code_size);
+
+int sv2_parse_update_channel_error(const uint8_t *payload, uint32_t len,
+                                   uint32_t *channel_id,
+                                   char *error_code, size_t error_code_size);
+
+// --- Target helpers ---
+
+// Encode the U256 LE target for a pool difficulty (difficulty 1 = 0xFFFF << 208).
+// Difficulties too low to be expressed saturate to the all-0xFF target.
+void sv2_difficulty_to_target(double difficulty, uint8_t target[32]);
+
 // --- Extended channel message builders/parsers ---
 
 int sv2_build_open_extended_mining_channel(uint8_t *buf, size_t buf_len,
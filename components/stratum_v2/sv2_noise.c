@@ -8,6 +8,8 @@
 #include "esp_log.h"
 #include "esp_random.h"
 #include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include "psa/crypto.h"
 
@@ -24,6 +26,9 @@ static const char *TAG = "sv2_noise";
 // want to fail and reconnect rather than block here for 3 minutes.
 #define HANDSHAKE_TIMEOUT_MS    10000
 
+#define KEYGEN_TASK_STACK_SIZE  6144
+#define KEYGEN_TASK_PRIORITY    3
+
 // Noise protocol name used to initialize h and ck
 static const char NOISE_PROTOCOL_NAME[] = "Noise_NX_Secp256k1+EllSwift_ChaChaPoly_SHA256";
 
@@ -37,9 +42,27 @@ struct sv2_noise_ctx {
     uint64_t send_nonce;
     uint64_t recv_nonce;
     bool handshake_complete;
-    secp256k1_context *secp_ctx;
+    secp256k1_context *secp_ctx; // shared, owned by s_secp_ctx
 };
 
+// Process-wide state that survives reconnects. The secp256k1 context is created
+// and randomized once, the ECDH self-test and the initial protocol hash are
+// computed once per boot, and the next ephemeral keypair is generated in the
+// background so a reconnect only pays for the handshake round trips.
+static secp256k1_context *s_secp_ctx = NULL;
+static int s_init_result = 1;         // 1 = not run yet, 0 = ok, -1 = failed
+static uint8_t s_initial_h[32];       // SHA-256(protocol_name)
+
+typedef struct {
+    uint8_t priv[32];
+    uint8_t pub_encoded[64];
+    bool ready;
+    bool pending;
+} sv2_noise_ephemeral_t;
+
+static sv2_noise_ephemeral_t s_spare_ephemeral;
+static portMUX_TYPE s_spare_mux = portMUX_INITIALIZER_UNLOCKED;
+
 // --- Transport helpers ---
 
 static int noise_recv_exact(esp_transport_handle_t transport, uint8_t *buf, int len, int timeout_ms)
@@ -231,46 +254,7 @@ static int noise_decrypt(const uint8_t key[32], uint64_t nonce_counter,
     return 0;
 }
 
-// --- Public API ---
-
-sv2_noise_ctx_t *sv2_noise_create(void)
-{
-    sv2_noise_ctx_t *ctx = calloc(1, sizeof(sv2_noise_ctx_t));
-    if (!ctx) return NULL;
-
-    ctx->secp_ctx = secp256k1_context_create(SECP256K1_CONTEXT_NONE);
-    if (!ctx->secp_ctx) {
-        free(ctx);
-        return NULL;
-    }
-
-    // Randomize the context for side-channel protection
-    uint8_t seed[32];
-    esp_fill_random(seed, sizeof(seed));
-    if (!secp256k1_context_randomize(ctx->secp_ctx, seed)) {
-        ESP_LOGE(TAG, "Failed to randomize secp256k1 context");
-        secp256k1_context_destroy(ctx->secp_ctx);
-        free(ctx);
-        return NULL;
-    }
-
-    return ctx;
-}
-
-void sv2_noise_destroy(sv2_noise_ctx_t *ctx)
-{
-    if (!ctx) return;
-
-    // Securely zero sensitive material
-    memset(ctx->e_priv, 0, 32);
-    memset(ctx->send_key, 0, 32);
-    memset(ctx->recv_key, 0, 32);
-
-    if (ctx->secp_ctx) {
-        secp256k1_context_destroy(ctx->secp_ctx);
-    }
-    free(ctx);
-}
+// --- Shared context and ephemeral keys ---
 
 // Self-test: verify secp256k1 ellswift ECDH produces matching shared secrets
 // Uses deterministic keys to test both sides of the ECDH
@@ -316,37 +300,180 @@ static bool sv2_noise_selftest(secp256k1_context *secp_ctx)
     return true;
 }
 
-int sv2_noise_handshake(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
-                        const uint8_t *authority_pubkey)
+// Generate an ElligatorSwift-encoded ephemeral keypair
+static bool sv2_noise_generate_ephemeral(uint8_t priv[32], uint8_t pub_encoded[64])
 {
-    int64_t hs_start_us = esp_timer_get_time();
+    uint8_t auxrand[32];
+    esp_fill_random(priv, 32);
+    esp_fill_random(auxrand, sizeof(auxrand));
 
-    // Run self-test on first handshake attempt
-    static bool selftest_done = false;
-    if (!selftest_done) {
-        if (!sv2_noise_selftest(ctx->secp_ctx)) {
-            ESP_LOGE(TAG, "secp256k1 library self-test FAILED - library may be misconfigured");
-            return -1;
-        }
-        selftest_done = true;
+    if (!secp256k1_ellswift_create(s_secp_ctx, pub_encoded, priv, auxrand)) {
+        memset(priv, 0, 32);
+        return false;
     }
+    return true;
+}
+
+static void sv2_noise_keygen_task(void *pvParameters)
+{
+    uint8_t priv[32];
+    uint8_t pub_encoded[64];
+    bool ok = sv2_noise_generate_ephemeral(priv, pub_encoded);
+
+    taskENTER_CRITICAL(&s_spare_mux);
+    if (ok) {
+        memcpy(s_spare_ephemeral.priv, priv, 32);
+        memcpy(s_spare_ephemeral.pub_encoded, pub_encoded, 64);
+        s_spare_ephemeral.ready = true;
+    }
+    s_spare_ephemeral.pending = false;
+    taskEXIT_CRITICAL(&s_spare_mux);
+
+    memset(priv, 0, sizeof(priv));
+    if (!ok) {
+        ESP_LOGW(TAG, "Background ephemeral key generation failed");
+    }
+    vTaskDelete(NULL);
+}
+
+// Start generating the next ephemeral keypair unless one is ready or in flight
+static void sv2_noise_schedule_keygen(void)
+{
+    bool start = false;
+    taskENTER_CRITICAL(&s_spare_mux);
+    if (!s_spare_ephemeral.ready && !s_spare_ephemeral.pending) {
+        s_spare_ephemeral.pending = true;
+        start = true;
+    }
+    taskEXIT_CRITICAL(&s_spare_mux);
+
+    if (!start) return;
+
+    if (xTaskCreate(sv2_noise_keygen_task, "sv2 keygen", KEYGEN_TASK_STACK_SIZE,
+                    NULL, KEYGEN_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to create keygen task, keys will be generated inline");
+        taskENTER_CRITICAL(&s_spare_mux);
+        s_spare_ephemeral.pending = false;
+        taskEXIT_CRITICAL(&s_spare_mux);
+    }
+}
+
+// Take the precomputed ephemeral keypair. Each keypair is handed out exactly
+// once; returns false if none is ready yet.
+static bool sv2_noise_take_ephemeral(uint8_t priv[32], uint8_t pub_encoded[64])
+{
+    bool taken = false;
+    taskENTER_CRITICAL(&s_spare_mux);
+    if (s_spare_ephemeral.ready) {
+        memcpy(priv, s_spare_ephemeral.priv, 32);
+        memcpy(pub_encoded, s_spare_ephemeral.pub_encoded, 64);
+        memset(s_spare_ephemeral.priv, 0, 32);
+        s_spare_ephemeral.ready = false;
+        taken = true;
+    }
+    taskEXIT_CRITICAL(&s_spare_mux);
+    return taken;
+}
 
-    // Step 1: Initialize h and ck = SHA-256(protocol_name)
+// --- Public API ---
+
+int sv2_noise_init(void)
+{
+    if (s_init_result != 1) {
+        if (s_init_result == 0) sv2_noise_schedule_keygen();
+        return s_init_result;
+    }
+
+    int64_t init_start_us = esp_timer_get_time();
+
+    s_secp_ctx = secp256k1_context_create(SECP256K1_CONTEXT_NONE);
+    if (!s_secp_ctx) {
+        ESP_LOGE(TAG, "Failed to create secp256k1 context");
+        return -1;
+    }
+
+    // Randomize the context for side-channel protection
+    uint8_t seed[32];
+    esp_fill_random(seed, sizeof(seed));
+    if (!secp256k1_context_randomize(s_secp_ctx, seed)) {
+        ESP_LOGE(TAG, "Failed to randomize secp256k1 context");
+        secp256k1_context_destroy(s_secp_ctx);
+        s_secp_ctx = NULL;
+        return -1;
+    }
+    memset(seed, 0, sizeof(seed));
+
+    if (!sv2_noise_selftest(s_secp_ctx)) {
+        ESP_LOGE(TAG, "secp256k1 library self-test FAILED - library may be misconfigured");
+        s_init_result = -1;
+        return -1;
+    }
+
+    // Initialize h = SHA-256(protocol_name)
     sha256_bin((const uint8_t *)NOISE_PROTOCOL_NAME,
-               strlen(NOISE_PROTOCOL_NAME), ctx->h);
-    memcpy(ctx->ck, ctx->h, 32);
+               strlen(NOISE_PROTOCOL_NAME), s_initial_h);
 
     // Verify initial hash matches known reference value
     static const uint8_t expected_h[32] = {
         46, 180, 120, 129, 32, 142, 158, 238, 31, 102, 159, 103, 198, 110, 231, 14,
         169, 234, 136, 9, 13, 80, 63, 232, 48, 220, 75, 200, 62, 41, 191, 16
     };
-    if (memcmp(ctx->h, expected_h, 32) != 0) {
+    if (memcmp(s_initial_h, expected_h, 32) != 0) {
         ESP_LOGE(TAG, "Initial protocol hash mismatch! SHA-256 implementation issue.");
-        ESP_LOG_BUFFER_HEX_LEVEL(TAG, ctx->h, 32, ESP_LOG_ERROR);
+        ESP_LOG_BUFFER_HEX_LEVEL(TAG, s_initial_h, 32, ESP_LOG_ERROR);
+        s_init_result = -1;
+        return -1;
+    }
+
+    s_init_result = 0;
+
+    float init_elapsed_ms = (float)(esp_timer_get_time() - init_start_us) / 1000.0f;
+    ESP_LOGI(TAG, "Noise initialized (%.0f ms)", init_elapsed_ms);
+
+    sv2_noise_schedule_keygen();
+    return 0;
+}
+
+sv2_noise_ctx_t *sv2_noise_create(void)
+{
+    if (sv2_noise_init() != 0) {
+        return NULL;
+    }
+
+    sv2_noise_ctx_t *ctx = calloc(1, sizeof(sv2_noise_ctx_t));
+    if (!ctx) return NULL;
+
+    ctx->secp_ctx = s_secp_ctx;
+    return ctx;
+}
+
+void sv2_noise_destroy(sv2_noise_ctx_t *ctx)
+{
+    if (!ctx) return;
+
+    // Securely zero sensitive material
+    memset(ctx->e_priv, 0, 32);
+    memset(ctx->send_key, 0, 32);
+    memset(ctx->recv_key, 0, 32);
+
+    free(ctx);
+}
+
+int sv2_noise_handshake(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
+                        const uint8_t *authority_pubkey)
+{
+    int64_t hs_start_us = esp_timer_get_time();
+
+    if (s_init_result != 0) {
+        ESP_LOGE(TAG, "Noise not initialized, refusing handshake");
         return -1;
     }
 
+    // Step 1: Initialize h and ck = SHA-256(protocol_name), computed and
+    // verified once by sv2_noise_init
+    memcpy(ctx->h, s_initial_h, 32);
+    memcpy(ctx->ck, s_initial_h, 32);
+
     // MixHash(prologue): SV2 uses an empty prologue, so h = SHA-256(h || "")
     // This is required by the Noise framework before processing any handshake tokens
     mix_hash(ctx->h, (const uint8_t *)"", 0);
@@ -354,19 +481,21 @@ int sv2_noise_handshake(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
     ESP_LOGI(TAG, "h after MixHash(prologue):");
     ESP_LOG_BUFFER_HEX_LEVEL(TAG, ctx->h, 32, ESP_LOG_INFO);
 
-    // Step 2: Generate ephemeral keypair
-    ESP_LOGI(TAG, "Generating ephemeral keypair (ElligatorSwift)");
-    esp_fill_random(ctx->e_priv, 32);
-
-    uint8_t auxrand[32];
-    esp_fill_random(auxrand, sizeof(auxrand));
-
-    if (!secp256k1_ellswift_create(ctx->secp_ctx, ctx->e_pub_encoded,
-                                    ctx->e_priv, auxrand)) {
-        ESP_LOGE(TAG, "Failed to generate ephemeral key");
-        return -1;
+    // Step 2: Use the precomputed ephemeral keypair, or generate one now if the
+    // background task has not finished yet
+    if (sv2_noise_take_ephemeral(ctx->e_priv, ctx->e_pub_encoded)) {
+        ESP_LOGI(TAG, "Using precomputed ephemeral keypair (ElligatorSwift)");
+    } else {
+        ESP_LOGI(TAG, "Generating ephemeral keypair (ElligatorSwift)");
+        if (!sv2_noise_generate_ephemeral(ctx->e_priv, ctx->e_pub_encoded)) {
+            ESP_LOGE(TAG, "Failed to generate ephemeral key");
+            return -1;
+        }
     }
 
+    // Refill for the next connection while this one does its round trips
+    sv2_noise_schedule_keygen();
+
     // Step 3: mix_hash(h, e_pub_encoded) — process 'e' token
     mix_hash(ctx->h, ctx->e_pub_encoded, 64);
 
@@ -540,6 +669,31 @@ int sv2_noise_handshake(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
     return 0;
 }
 
+// Encrypt one plaintext frame (header + payload_len bytes of payload) into out.
+// The encrypted header and payload use separate Noise nonces but are just
+// consecutive bytes on the wire, so the receiver, which reads the 22-byte
+// header first and then the payload, is unaffected.
+// out must have room for 22 + payload_len + 16 bytes. Returns bytes written, or -1.
+static int noise_encrypt_frame(sv2_noise_ctx_t *ctx, const uint8_t *frame,
+                               int payload_len, uint8_t *out)
+{
+    // Encrypt header (nonce N) into out[0..21]
+    if (noise_encrypt(ctx->send_key, ctx->send_nonce++, NULL, 0,
+                      frame, SV2_FRAME_HEADER_SIZE, out) != 0) {
+        return -1;
+    }
+    if (payload_len <= 0) {
+        return 22;
+    }
+
+    // Encrypt payload (nonce N+1) into out[22..]
+    if (noise_encrypt(ctx->send_key, ctx->send_nonce++, NULL, 0,
+                      frame + SV2_FRAME_HEADER_SIZE, payload_len, out + 22) != 0) {
+        return -1;
+    }
+    return 22 + payload_len + 16;
+}
+
 int sv2_noise_send(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
                    const uint8_t *frame, int frame_len)
 {
@@ -552,8 +706,7 @@ int sv2_noise_send(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
     // Header-only frame: encrypt (6 -> 22 bytes) and send directly off the stack.
     if (payload_len <= 0) {
         uint8_t enc_hdr[22];
-        if (noise_encrypt(ctx->send_key, ctx->send_nonce++, NULL, 0,
-                          frame, SV2_FRAME_HEADER_SIZE, enc_hdr) != 0) {
+        if (noise_encrypt_frame(ctx, frame, 0, enc_hdr) < 0) {
             return -1;
         }
         return noise_send_all(transport, enc_hdr, 22);
@@ -561,27 +714,57 @@ int sv2_noise_send(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
 
     // Build the encrypted header and payload contiguously and send them in a
     // single write, so a frame leaves as one TCP segment instead of a header
-    // segment followed by a payload segment. The two parts use separate Noise
-    // nonces but are just consecutive bytes on the wire, so the receiver, which
-    // reads the 22-byte header first and then the payload, is unaffected.
+    // segment followed by a payload segment.
     int total_len = 22 + payload_len + 16;
     uint8_t *out = malloc(total_len);
     if (!out) return -1;
 
-    // Encrypt header (nonce N) into out[0..21]
-    if (noise_encrypt(ctx->send_key, ctx->send_nonce++, NULL, 0,
-                      frame, SV2_FRAME_HEADER_SIZE, out) != 0) {
+    if (noise_encrypt_frame(ctx, frame, payload_len, out) < 0) {
         free(out);
         return -1;
     }
 
-    // Encrypt payload (nonce N+1) into out[22..]
-    if (noise_encrypt(ctx->send_key, ctx->send_nonce++, NULL, 0,
-                      frame + SV2_FRAME_HEADER_SIZE, payload_len, out + 22) != 0) {
-        free(out);
+    int ret = noise_send_all(transport, out, total_len);
+    free(out);
+    return ret;
+}
+
+int sv2_noise_send_frames(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
+                          const uint8_t *frames, int frames_len)
+{
+    if (!ctx || !ctx->handshake_complete || frames_len < SV2_FRAME_HEADER_SIZE) {
         return -1;
     }
 
+    // Walk the frame headers once to size the ciphertext buffer
+    int total_len = 0;
+    int pos = 0;
+    while (pos < frames_len) {
+        if (frames_len - pos < SV2_FRAME_HEADER_SIZE) return -1;
+        sv2_frame_header_t hdr;
+        sv2_parse_frame_header(frames + pos, &hdr);
+        if ((int)hdr.msg_length > frames_len - pos - SV2_FRAME_HEADER_SIZE) return -1;
+        total_len += 22 + (hdr.msg_length > 0 ? (int)hdr.msg_length + 16 : 0);
+        pos += SV2_FRAME_HEADER_SIZE + hdr.msg_length;
+    }
+
+    uint8_t *out = malloc(total_len);
+    if (!out) return -1;
+
+    int out_pos = 0;
+    pos = 0;
+    while (pos < frames_len) {
+        sv2_frame_header_t hdr;
+        sv2_parse_frame_header(frames + pos, &hdr);
+        int n = noise_encrypt_frame(ctx, frames + pos, hdr.msg_length, out + out_pos);
+        if (n < 0) {
+            free(out);
+            return -1;
+        }
+        out_pos += n;
+        pos += SV2_FRAME_HEADER_SIZE + hdr.msg_length;
+    }
+
     int ret = noise_send_all(transport, out, total_len);
     free(out);
     return ret;
@@ -211,6 +211,32 @@ int sv2_build_submit_shares_standard(uint8_t *buf, size_t buf_len,
     return total;
 }
 
+int sv2_build_update_channel(uint8_t *buf, size_t buf_len,
+                             uint32_t channel_id, float nominal_hash_rate,
+                             const uint8_t maximum_target[32])
+{
+    // Payload: channel_id(4) + nominal_hash_rate(4) + maximum_target(32) = 40 bytes
+    int payload_len = 40;
+    int total = SV2_FRAME_HEADER_SIZE + payload_len;
+    if ((size_t)total > buf_len) return -1;
+
+    // Channel message: extension_type has bit 15 set
+    sv2_encode_frame_header(buf, SV2_CHANNEL_MSG_FLAG, SV2_MSG_UPDATE_CHANNEL, (uint32_t)payload_len);
+
+    int pos = 0;
+    uint8_t *payload = buf + SV2_FRAME_HEADER_SIZE;
+    write_u32_le(payload + pos, channel_id); pos += 4;
+
+    // nominal_hash_rate: f32 LE
+    uint32_t f_bits;
+    memcpy(&f_bits, &nominal_hash_rate, 4);
+    write_u32_le(payload + pos, f_bits); pos += 4;
+
+    memcpy(payload + pos, maximum_target, 32);
+
+    return total;
+}
+
 // --- Message parsers ---
 
 int sv2_parse_setup_connection_success(const uint8_t *payload, uint32_t len,
@@ -337,6 +363,56 @@ int sv2_parse_submit_shares_error(const uint8_t *payload, uint32_t len,
     return 0;
 }
 
+int sv2_parse_open_mining_channel_error(const uint8_t *payload, uint32_t len,
+                                        uint32_t *request_id,
+                                        char *error_code, size_t error_code_size)
+{
+    // request_id(4) + STR0_255(1+N) = min 5 bytes
+    if (len < 5) return -1;
+
+    *request_id = read_u32_le(payload);
+
+    int n = read_str0255(payload + 4, len - 4, error_code, error_code_size);
+    if (n < 0) return -1;
+    return 0;
+}
+
+int sv2_parse_update_channel_error(const uint8_t *payload, uint32_t len,
+                                   uint32_t *channel_id,
+                                   char *error_code, size_t error_code_size)
+{
+    // channel_id(4) + STR0_255(1+N) = min 5 bytes
+    if (len < 5) return -1;
+
+    *channel_id = read_u32_le(payload);
+
+    int n = read_str0255(payload + 4, len - 4, error_code, error_code_size);
+    if (n < 0) return -1;
+    return 0;
+}
+
+// --- Target helpers ---
+
+void sv2_difficulty_to_target(double difficulty, uint8_t target[32])
+{
+    // Difficulty 1 target = 0xFFFF * 2^208
+    double t = (difficulty > 0) ? ldexp(65535.0, 208) / difficulty : INFINITY;
+    if (t >= ldexp(1.0, 256)) {
+        memset(target, 0xFF, 32);
+        return;
+    }
+
+    // Peel off bytes from the most significant end (target is little-endian)
+    for (int i = 31; i >= 0; i--) {
+        double scale = ldexp(1.0, 8 * i);
+        double byte = floor(t / scale);
+        if (byte > 255.0) byte = 255.0;
+        target[i] = (uint8_t)byte;
+        t -= byte * scale;
+        if (t < 0) t = 0;
+    }
+}
+
 // --- Extended channel message builders/parsers ---
 
 int sv2_build_open_extended_mining_channel(uint8_t *buf, size_t buf_len,
@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_transport.h"
+#include "psa/crypto.h"
+#include "secp256k1.h"
+#include "secp256k1_ellswift.h"
+#include "secp256k1_extrakeys.h"
+#include "secp256k1_schnorrsig.h"
+#include "sv2_noise.h"
+#include "sv2_protocol.h"
+
+// The responder side of Noise_NX with fixed keys, run in memory behind a fake
+// transport. The initiator's ephemeral key is still random, so every handshake
+// derives fresh transport keys; the responder derives the same ones.
+
+#define RESPONSE_SIZE 234
+#define LINK_BUFFER_SIZE 4096
+
+static const char NOISE_PROTOCOL_NAME[] = "Noise_NX_Secp256k1+EllSwift_ChaChaPoly_SHA256";
+
+static const uint8_t RESPONDER_EPHEMERAL_KEY[32] = {
+    0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+    0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+};
+static const uint8_t RESPONDER_STATIC_KEY[32] = {
+    0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22,
+    0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22,
+};
+static const uint8_t AUTHORITY_KEY[32] = {
+    0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33,
+    0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33,
+};
+static const uint8_t OTHER_AUTHORITY_KEY[32] = {
+    0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44,
+    0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44,
+};
+
+typedef struct {
+    uint8_t send_key[32]; // responder -> initiator
+    uint8_t recv_key[32];
+    uint64_t send_nonce;
+    uint64_t recv_nonce;
+
+    // handshake response tampering
+    int flip_bit;       // bit of the response to flip, -1 for none
+    int response_len;   // bytes of the response actually sent
+} responder_t;
+
+typedef struct {
+    uint8_t rx[LINK_BUFFER_SIZE]; // responder -> initiator
+    int rx_len;
+    int rx_pos;
+    uint8_t tx[LINK_BUFFER_SIZE]; // initiator -> responder
+    int tx_len;
+    int tx_pos;
+    bool handshake_answered;
+} fake_link_t;
+
+static secp256k1_context *secp_ctx;
+static responder_t responder;
+static fake_link_t link;
+
+// Deterministic xorshift32 so failures reproduce from the printed seed
+static uint32_t rng_state;
+
+static uint32_t rng_next(void)
+{
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng_state = x;
+    return x;
+}
+
+static void rng_fill(uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)rng_next();
+    }
+}
+
+// --- Responder crypto ---
+
+static void sha256(const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len, uint8_t out[32])
+{
+    psa_hash_operation_t operation = PSA_HASH_OPERATION_INIT;
+    size_t out_len = 0;
+    TEST_ASSERT_EQUAL(PSA_SUCCESS, psa_hash_setup(&operation, PSA_ALG_SHA_256));
+    if (a_len > 0) TEST_ASSERT_EQUAL(PSA_SUCCESS, psa_hash_update(&operation, a, a_len));
+    if (b_len > 0) TEST_ASSERT_EQUAL(PSA_SUCCESS, psa_hash_update(&operation, b, b_len));
+    TEST_ASSERT_EQUAL(PSA_SUCCESS, psa_hash_finish(&operation, out, 32, &out_len));
+}
+
+static void mix_hash(uint8_t h[32], const uint8_t *data, size_t len)
+{
+    sha256(h, 32, data, len, h);
+}
+
+static void hmac_sha256(const uint8_t key[32], const uint8_t *data, size_t len, uint8_t out[32])
+{
+    psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
+    psa_set_key_usage_flags(&attributes, PSA_KEY_USAGE_SIGN_MESSAGE);
+    psa_set_key_algorithm(&attributes, PSA_ALG_HMAC(PSA_ALG_SHA_256));
+    psa_set_key_type(&attributes, PSA_KEY_TYPE_HMAC);
+
+    psa_key_id_t key_id = 0;
+    size_t out_len = 0;
+    TEST_ASSERT_EQUAL(PSA_SUCCESS, psa_import_key(&attributes, key, 32, &key_id));
+    TEST_ASSERT_EQUAL(PSA_SUCCESS, psa_mac_compute(key_id, PSA_ALG_HMAC(PSA_ALG_SHA_256), data, len, out, 32, &out_len));
+    psa_destroy_key(key_id);
+}
+
+static void hkdf2(uint8_t ck[32], const uint8_t *ikm, size_t ikm_len, uint8_t out1[32], uint8_t out2[32])
+{
+    uint8_t prk[32];
+    uint8_t buf[33];
+
+    hmac_sha256(ck, ikm, ikm_len, prk);
+    buf[0] = 0x01;
+    hmac_sha256(prk, buf, 1, out1);
+    memcpy(buf, out1, 32);
+    buf[32] = 0x02;
+    hmac_sha256(prk, buf, 33, out2);
+}
+
+// ChaCha20-Poly1305 with the Noise nonce layout; in_len excludes the tag when encrypting
+static int aead(bool encrypt, const uint8_t key[32], uint64_t counter, const uint8_t *ad, size_t ad_len,
+                const uint8_t *in, size_t in_len, uint8_t *out)
+{
+    uint8_t nonce[12] = {0};
+    for (int i = 0; i < 8; i++) {
+        nonce[4 + i] = (uint8_t)(counter >> (i * 8));
+    }
+
+    psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
+    psa_set_key_usage_flags(&attributes, encrypt ? PSA_KEY_USAGE_ENCRYPT : PSA_KEY_USAGE_DECRYPT);
+    psa_set_key_algorithm(&attributes, PSA_ALG_CHACHA20_POLY1305);
+    psa_set_key_type(&attributes, PSA_KEY_TYPE_CHACHA20);
+    psa_set_key_bits(&attributes, 256);
+
+    psa_key_id_t key_id = 0;
+    size_t out_len = 0;
+    psa_status_t status = psa_import_key(&attributes, key, 32, &key_id);
+    if (status == PSA_SUCCESS && encrypt) {
+        status = psa_aead_encrypt(key_id, PSA_ALG_CHACHA20_POLY1305, nonce, sizeof(nonce), ad, ad_len,
+                                  in, in_len, out, in_len + 16, &out_len);
+    } else if (status == PSA_SUCCESS) {
+        status = psa_aead_decrypt(key_id, PSA_ALG_CHACHA20_POLY1305, nonce, sizeof(nonce), ad, ad_len,
+                                  in, in_len, out, in_len - 16, &out_len);
+    }
+    psa_destroy_key(key_id);
+    return status == PSA_SUCCESS ? 0 : -1;
+}
+
+// Act 2 of Noise_NX for the initiator's ephemeral key, signed by AUTHORITY_KEY
+static void responder_answer(const uint8_t initiator_ephemeral[64], uint8_t out[RESPONSE_SIZE])
+{
+    uint8_t h[32], ck[32], k[32], shared[32];
+    uint8_t static_encoded[64];
+    uint8_t aux[32] = {0};
+
+    sha256((const uint8_t *)NOISE_PROTOCOL_NAME, strlen(NOISE_PROTOCOL_NAME), NULL, 0, h);
+    memcpy(ck, h, 32);
+    mix_hash(h, NULL, 0);
+    mix_hash(h, initiator_ephemeral, 64);
+    mix_hash(h, NULL, 0);
+
+    // e, ee
+    TEST_ASSERT_TRUE(secp256k1_ellswift_create(secp_ctx, out, RESPONDER_EPHEMERAL_KEY, aux));
+    mix_hash(h, out, 64);
+    TEST_ASSERT_TRUE(secp256k1_ellswift_xdh(secp_ctx, shared, initiator_ephemeral, out, RESPONDER_EPHEMERAL_KEY, 1,
+                                            secp256k1_ellswift_xdh_hash_function_bip324, NULL));
+    hkdf2(ck, shared, 32, ck, k);
+
+    // s, es
+    TEST_ASSERT_TRUE(secp256k1_ellswift_create(secp_ctx, static_encoded, RESPONDER_STATIC_KEY, aux));
+    TEST_ASSERT_EQUAL(0, aead(true, k, 0, h, 32, static_encoded, 64, out + 64));
+    mix_hash(h, out + 64, 80);
+    TEST_ASSERT_TRUE(secp256k1_ellswift_xdh(secp_ctx, shared, initiator_ephemeral, static_encoded, RESPONDER_STATIC_KEY, 1,
+                                            secp256k1_ellswift_xdh_hash_function_bip324, NULL));
+    hkdf2(ck, shared, 32, ck, k);
+
+    // Certificate: version, valid_from, not_valid_after and a signature over
+    // them and the static key
+    uint8_t cert[74] = {0};
+    cert[6] = 0xFF;
+    cert[7] = 0xFF;
+    cert[8] = 0xFF;
+    cert[9] = 0xFF;
+
+    secp256k1_pubkey static_pubkey;
+    secp256k1_xonly_pubkey static_xonly;
+    secp256k1_keypair authority;
+    uint8_t static_xonly_bytes[32], digest[32];
+    TEST_ASSERT_TRUE(secp256k1_ellswift_decode(secp_ctx, &static_pubkey, static_encoded));
+    TEST_ASSERT_TRUE(secp256k1_xonly_pubkey_from_pubkey(secp_ctx, &static_xonly, NULL, &static_pubkey));
+    secp256k1_xonly_pubkey_serialize(secp_ctx, static_xonly_bytes, &static_xonly);
+    sha256(cert, 10, static_xonly_bytes, 32, digest);
+    TEST_ASSERT_TRUE(secp256k1_keypair_create(secp_ctx, &authority, AUTHORITY_KEY));
+    TEST_ASSERT_TRUE(secp256k1_schnorrsig_sign32(secp_ctx, cert + 10, digest, &authority, aux));
+    TEST_ASSERT_EQUAL(0, aead(true, k, 0, h, 32, cert, sizeof(cert), out + 144));
+
+    // Split: the first key carries initiator -> responder traffic
+    hkdf2(ck, NULL, 0, responder.recv_key, responder.send_key);
+    responder.send_nonce = 0;
+    responder.recv_nonce = 0;
+}
+
+static void authority_pubkey(const uint8_t key[32], uint8_t out[32])
+{
+    secp256k1_keypair authority;
+    secp256k1_xonly_pubkey xonly;
+    TEST_ASSERT_TRUE(secp256k1_keypair_create(secp_ctx, &authority, key));
+    TEST_ASSERT_TRUE(secp256k1_keypair_xonly_pub(secp_ctx, &xonly, NULL, &authority));
+    secp256k1_xonly_pubkey_serialize(secp_ctx, out, &xonly);
+}
+
+// --- Fake transport ---
+
+static int fake_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    int available = link.rx_len - link.rx_pos;
+    if (available <= 0) {
+        return 0; // reads as a timeout
+    }
+    if (len > available) {
+        len = available;
+    }
+    memcpy(buffer, link.rx + link.rx_pos, len);
+    link.rx_pos += len;
+    return len;
+}
+
+static int fake_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    TEST_ASSERT_LESS_OR_EQUAL(LINK_BUFFER_SIZE - link.tx_len, len);
+    memcpy(link.tx + link.tx_len, buffer, len);
+    link.tx_len += len;
+
+    // Act 1 is the initiator's 64 byte ephemeral key, answer it right away
+    if (!link.handshake_answered && link.tx_len >= 64) {
+        uint8_t response[RESPONSE_SIZE];
+        responder_answer(link.tx, response);
+        if (responder.flip_bit >= 0) {
+            response[responder.flip_bit / 8] ^= 1 << (responder.flip_bit % 8);
+        }
+        memcpy(link.rx + link.rx_len, response, responder.response_len);
+        link.rx_len += responder.response_len;
+        link.tx_pos = 64;
+        link.handshake_answered = true;
+    }
+    return len;
+}
+
+static int fake_close(esp_transport_handle_t t)
+{
+    return 0;
+}
+
+static esp_transport_handle_t fake_transport(void)
+{
+    memset(&link, 0, sizeof(link));
+    responder.flip_bit = -1;
+    responder.response_len = RESPONSE_SIZE;
+
+    esp_transport_handle_t transport = esp_transport_init();
+    TEST_ASSERT_NOT_NULL(transport);
+    esp_transport_set_func(transport, NULL, fake_read, fake_write, fake_close, NULL, NULL, NULL);
+    return transport;
+}
+
+static void drain_rx(void)
+{
+    link.rx_len = 0;
+    link.rx_pos = 0;
+}
+
+// Encrypt a frame from the responder into the initiator's receive buffer
+static void responder_send(const uint8_t *frame, int payload_len)
+{
+    TEST_ASSERT_LESS_OR_EQUAL(LINK_BUFFER_SIZE - link.rx_len, 22 + payload_len + 16);
+    TEST_ASSERT_EQUAL(0, aead(true, responder.send_key, responder.send_nonce++, NULL, 0,
+                              frame, SV2_FRAME_HEADER_SIZE, link.rx + link.rx_len));
+    link.rx_len += 22;
+    if (payload_len > 0) {
+        TEST_ASSERT_EQUAL(0, aead(true, responder.send_key, responder.send_nonce++, NULL, 0,
+                                  frame + SV2_FRAME_HEADER_SIZE, payload_len, link.rx + link.rx_len));
+        link.rx_len += payload_len + 16;
+    }
+}
+
+// Decrypt the next frame the initiator sent, returns its plaintext length
+static int responder_receive(uint8_t *frame)
+{
+    sv2_frame_header_t hdr;
+
+    TEST_ASSERT_GREATER_OR_EQUAL(22, link.tx_len - link.tx_pos);
+    TEST_ASSERT_EQUAL(0, aead(false, responder.recv_key, responder.recv_nonce++, NULL, 0,
+                              link.tx + link.tx_pos, 22, frame));
+    link.tx_pos += 22;
+    sv2_parse_frame_header(frame, &hdr);
+    if (hdr.msg_length > 0) {
+        TEST_ASSERT_GREATER_OR_EQUAL(hdr.msg_length + 16, link.tx_len - link.tx_pos);
+        TEST_ASSERT_EQUAL(0, aead(false, responder.recv_key, responder.recv_nonce++, NULL, 0,
+                                  link.tx + link.tx_pos, hdr.msg_length + 16, frame + SV2_FRAME_HEADER_SIZE));
+        link.tx_pos += hdr.msg_length + 16;
+    }
+    return SV2_FRAME_HEADER_SIZE + hdr.msg_length;
+}
+
+static int make_frame(uint8_t *frame, uint8_t msg_type, int payload_len)
+{
+    sv2_encode_frame_header(frame, SV2_CHANNEL_MSG_FLAG, msg_type, payload_len);
+    rng_fill(frame + SV2_FRAME_HEADER_SIZE, payload_len);
+    return SV2_FRAME_HEADER_SIZE + payload_len;
+}
+
+static void noise_setup(void)
+{
+    if (!secp_ctx) {
+        TEST_ASSERT_EQUAL(PSA_SUCCESS, psa_crypto_init());
+        TEST_ASSERT_EQUAL(0, sv2_noise_init());
+        secp_ctx = secp256k1_context_create(SECP256K1_CONTEXT_NONE);
+        TEST_ASSERT_NOT_NULL(secp_ctx);
+    }
+}
+
+static sv2_noise_ctx_t *connect_ctx(esp_transport_handle_t transport, const uint8_t *authority)
+{
+    sv2_noise_ctx_t *ctx = sv2_noise_create();
+    TEST_ASSERT_NOT_NULL(ctx);
+    TEST_ASSERT_EQUAL(0, sv2_noise_handshake(ctx, transport, authority));
+    return ctx;
+}
+
+TEST_CASE("Noise handshake and transport round trip", "[sv2_noise]")
+{
+    noise_setup();
+    rng_state = 0x5eed0001;
+
+    uint8_t authority[32];
+    authority_pubkey(AUTHORITY_KEY, authority);
+
+    esp_transport_handle_t transport = fake_transport();
+    sv2_noise_ctx_t *ctx = connect_ctx(transport, authority);
+
+    // initiator -> responder, single frames including a header-only one
+    uint8_t frame[SV2_FRAME_HEADER_SIZE + 512];
+    uint8_t decoded[SV2_FRAME_HEADER_SIZE + 512];
+    int sizes[] = {0, 1, 24, 300, 512};
+    for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        int len = make_frame(frame, SV2_MSG_SUBMIT_SHARES_STANDARD, sizes[i]);
+        TEST_ASSERT_EQUAL(0, sv2_noise_send(ctx, transport, frame, len));
+        TEST_ASSERT_EQUAL(len, responder_receive(decoded));
+        TEST_ASSERT_EQUAL_MEMORY(frame, decoded, len);
+    }
+
+    // several frames in one write decrypt in order
+    uint8_t frames[3 * (SV2_FRAME_HEADER_SIZE + 24)];
+    int frames_len = 0;
+    for (int i = 0; i < 3; i++) {
+        frames_len += make_frame(frames + frames_len, SV2_MSG_SUBMIT_SHARES_STANDARD, i == 1 ? 0 : 24);
+    }
+    TEST_ASSERT_EQUAL(0, sv2_noise_send_frames(ctx, transport, frames, frames_len));
+    for (int pos = 0; pos < frames_len;) {
+        int len = responder_receive(decoded);
+        TEST_ASSERT_EQUAL_MEMORY(frames + pos, decoded, len);
+        pos += len;
+    }
+    TEST_ASSERT_EQUAL(link.tx_len, link.tx_pos);
+
+    // responder -> initiator
+    for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint8_t hdr[SV2_FRAME_HEADER_SIZE];
+        int payload_len = -1;
+        int len = make_frame(frame, SV2_MSG_NEW_MINING_JOB, sizes[i]);
+        responder_send(frame, sizes[i]);
+        TEST_ASSERT_EQUAL(0, sv2_noise_recv(ctx, transport, hdr, decoded, sizes[i], &payload_len));
+        TEST_ASSERT_EQUAL(sizes[i], payload_len);
+        TEST_ASSERT_EQUAL_MEMORY(frame, hdr, SV2_FRAME_HEADER_SIZE);
+        TEST_ASSERT_EQUAL_MEMORY(frame + SV2_FRAME_HEADER_SIZE, decoded, len - SV2_FRAME_HEADER_SIZE);
+    }
+
+    sv2_noise_destroy(ctx);
+    esp_transport_destroy(transport);
+
+    // A certificate signed by another authority is refused
+    authority_pubkey(OTHER_AUTHORITY_KEY, authority);
+    transport = fake_transport();
+    ctx = sv2_noise_create();
+    TEST_ASSERT_EQUAL(-1, sv2_noise_handshake(ctx, transport, authority));
+    sv2_noise_destroy(ctx);
+    esp_transport_destroy(transport);
+}
+
+TEST_CASE("Noise handshake rejects corrupted and short responses", "[sv2_noise]")
+{
+    noise_setup();
+    rng_state = 0x5eed0002;
+    printf("seed 0x%08lx\n", (unsigned long)rng_state);
+
+    uint8_t authority[32];
+    authority_pubkey(AUTHORITY_KEY, authority);
+
+    // The region edges of Act 2 (ephemeral key, encrypted static key and
+    // certificate, each with its tag), then random bits
+    int bytes[] = {0, 63, 64, 127, 128, 143, 144, 217, 218, 233};
+    int cases = sizeof(bytes) / sizeof(bytes[0]);
+    for (int i = 0; i < cases + 22; i++) {
+        int bit = i < cases ? bytes[i] * 8 + (int)(rng_next() % 8) : (int)(rng_next() % (RESPONSE_SIZE * 8));
+
+        esp_transport_handle_t transport = fake_transport();
+        responder.flip_bit = bit;
+        sv2_noise_ctx_t *ctx = sv2_noise_create();
+        TEST_ASSERT_NOT_NULL(ctx);
+        // Without an authority key only the AEAD tags stand in the way
+        if (sv2_noise_handshake(ctx, transport, (i & 1) ? authority : NULL) != -1) {
+            TEST_FAIL_MESSAGE("handshake accepted a flipped bit");
+        }
+        sv2_noise_destroy(ctx);
+        esp_transport_destroy(transport);
+    }
+
+    int lengths[] = {0, 1, 63, 64, 143, 144, 233};
+    for (int i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        esp_transport_handle_t transport = fake_transport();
+        responder.response_len = lengths[i];
+        sv2_noise_ctx_t *ctx = sv2_noise_create();
+        TEST_ASSERT_EQUAL(-1, sv2_noise_handshake(ctx, transport, NULL));
+        sv2_noise_destroy(ctx);
+        esp_transport_destroy(transport);
+    }
+}
+
+TEST_CASE("Noise transport rejects corrupted, oversized and short frames", "[sv2_noise]")
+{
+    noise_setup();
+    rng_state = 0x5eed0003;
+    printf("seed 0x%08lx\n", (unsigned long)rng_state);
+
+    esp_transport_handle_t transport = fake_transport();
+    sv2_noise_ctx_t *ctx = connect_ctx(transport, NULL);
+
+    // Not usable before the handshake
+    sv2_noise_ctx_t *fresh = sv2_noise_create();
+    uint8_t hdr[SV2_FRAME_HEADER_SIZE];
+    int payload_len;
+    uint8_t frame[SV2_FRAME_HEADER_SIZE + 400];
+    int len = make_frame(frame, SV2_MSG_NEW_MINING_JOB, 8);
+    TEST_ASSERT_EQUAL(-1, sv2_noise_send(fresh, transport, frame, len));
+    TEST_ASSERT_EQUAL(-1, sv2_noise_recv(fresh, transport, hdr, frame, 8, &payload_len));
+    sv2_noise_destroy(fresh);
+
+    for (int i = 0; i < 200; i++) {
+        int size = rng_next() % 400;
+        int mode = rng_next() % 4;
+        if (size == 0 && mode >= 2) {
+            mode = 0;
+        }
+        len = make_frame(frame, (uint8_t)rng_next(), size);
+        int rx_start = link.rx_len;
+        uint64_t nonce = responder.send_nonce;
+        responder_send(frame, size);
+
+        // payload decoded into a buffer of exactly the allowed size
+        int max_payload_len = mode == 3 ? size - 1 : size;
+        uint8_t *payload = malloc(size > 0 ? size : 1);
+        TEST_ASSERT_NOT_NULL(payload);
+
+        if (mode == 1) {
+            link.rx[rx_start + rng_next() % 22] ^= 1 << (rng_next() % 8);
+        } else if (mode == 2) {
+            link.rx[rx_start + 22 + rng_next() % (size + 16)] ^= 1 << (rng_next() % 8);
+        }
+
+        int ret = sv2_noise_recv(ctx, transport, hdr, payload, max_payload_len, &payload_len);
+        if (mode == 0) {
+            TEST_ASSERT_EQUAL(0, ret);
+            TEST_ASSERT_EQUAL(size, payload_len);
+            TEST_ASSERT_EQUAL_MEMORY(frame, hdr, SV2_FRAME_HEADER_SIZE);
+            TEST_ASSERT_EQUAL_MEMORY(frame + SV2_FRAME_HEADER_SIZE, payload, size);
+        } else {
+            TEST_ASSERT_EQUAL(-1, ret);
+            // a bad header or a refused length leaves the payload unread and its nonce unused
+            if (mode != 2) {
+                responder.send_nonce = nonce + 1;
+            }
+            drain_rx();
+        }
+        free(payload);
+    }
+
+    // The stream ends inside a payload
+    len = make_frame(frame, SV2_MSG_NEW_MINING_JOB, 100);
+    responder_send(frame, 100);
+    link.rx_len -= 50;
+    TEST_ASSERT_EQUAL(-1, sv2_noise_recv(ctx, transport, hdr, frame, 400, &payload_len));
+
+    sv2_noise_destroy(ctx);
+    esp_transport_destroy(transport);
+}
@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "sv2_protocol.h"
+#include "mining.h"
+
+// Deterministic xorshift32 so failures reproduce from the printed seed
+static uint32_t rng_state;
+
+static uint32_t rng_next(void)
+{
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng_state = x;
+    return x;
+}
+
+static void rng_fill(uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)rng_next();
+    }
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+// NewMiningJob payload with min_ntime set (49 bytes)
+static int make_new_mining_job(uint8_t *p)
+{
+    int pos = 0;
+    put_u32(p + pos, 7); pos += 4;             // channel_id
+    put_u32(p + pos, 42); pos += 4;            // job_id
+    p[pos++] = 0x01;                           // min_ntime present
+    put_u32(p + pos, 0x66000000); pos += 4;    // min_ntime
+    put_u32(p + pos, 0x20000000); pos += 4;    // version
+    for (int i = 0; i < 32; i++) p[pos++] = (uint8_t)i;
+    return pos;
+}
+
+// NewExtendedMiningJob payload with a merkle path and coinbase halves
+static int make_new_extended_mining_job(uint8_t *p, int branches, int prefix_len, int suffix_len)
+{
+    int pos = 0;
+    put_u32(p + pos, 7); pos += 4;             // channel_id
+    put_u32(p + pos, 43); pos += 4;            // job_id
+    p[pos++] = 0x00;                           // future job, no min_ntime
+    put_u32(p + pos, 0x20000000); pos += 4;    // version
+    p[pos++] = 0x01;                           // version_rolling_allowed
+    p[pos++] = (uint8_t)branches;
+    for (int i = 0; i < branches * 32; i++) p[pos++] = (uint8_t)(i * 3);
+    put_u16(p + pos, (uint16_t)prefix_len); pos += 2;
+    for (int i = 0; i < prefix_len; i++) p[pos++] = (uint8_t)(0xA0 + i);
+    put_u16(p + pos, (uint16_t)suffix_len); pos += 2;
+    for (int i = 0; i < suffix_len; i++) p[pos++] = (uint8_t)(0x50 + i);
+    return pos;
+}
+
+// OpenExtendedMiningChannel.Success payload
+static int make_open_extended_channel_success(uint8_t *p)
+{
+    int pos = 0;
+    put_u32(p + pos, 1); pos += 4;             // request_id
+    put_u32(p + pos, 7); pos += 4;             // channel_id
+    memset(p + pos, 0xFF, 32); pos += 32;      // target
+    put_u16(p + pos, 8); pos += 2;             // extranonce_size
+    p[pos++] = 4;                              // extranonce_prefix len
+    put_u32(p + pos, 0xDEADBEEF); pos += 4;
+    put_u32(p + pos, 3); pos += 4;             // group_channel_id
+    return pos;
+}
+
+// OpenStandardMiningChannel.Success payload
+static int make_open_channel_success(uint8_t *p)
+{
+    int pos = 0;
+    put_u32(p + pos, 1); pos += 4;
+    put_u32(p + pos, 7); pos += 4;
+    memset(p + pos, 0xFF, 32); pos += 32;
+    p[pos++] = 4;
+    put_u32(p + pos, 0xDEADBEEF); pos += 4;
+    put_u32(p + pos, 3); pos += 4;
+    return pos;
+}
+
+static int make_submit_shares_error(uint8_t *p)
+{
+    const char *code = "stale-share";
+    int pos = 0;
+    put_u32(p + pos, 7); pos += 4;
+    put_u32(p + pos, 9); pos += 4;
+    p[pos++] = (uint8_t)strlen(code);
+    memcpy(p + pos, code, strlen(code)); pos += strlen(code);
+    return pos;
+}
+
+// Run every parser over one input. The input lives in an exactly-sized heap
+// block so an overread lands on heap metadata instead of leftover payload.
+static void parse_all(const uint8_t *data, uint32_t len)
+{
+    uint8_t *p = malloc(len ? len : 1);
+    TEST_ASSERT_NOT_NULL(p);
+    memcpy(p, data, len);
+
+    uint16_t u16;
+    uint32_t a, b, c;
+    bool flag;
+    uint8_t target[32], root[32];
+    uint8_t prefix[32];
+    uint8_t prefix_len = 0;
+    char code[64];
+
+    sv2_parse_setup_connection_success(p, len, &u16, &a);
+
+    if (sv2_parse_open_channel_success(p, len, &a, &b, target, prefix, &prefix_len, &c) == 0) {
+        TEST_ASSERT_LESS_OR_EQUAL(32, prefix_len);
+    }
+    if (sv2_parse_open_extended_channel_success(p, len, &a, &b, target, &u16, prefix, &prefix_len, &c) == 0) {
+        TEST_ASSERT_LESS_OR_EQUAL(32, prefix_len);
+    }
+
+    sv2_parse_new_mining_job(p, len, &a, &b, &flag, &c, &a, root);
+    sv2_parse_set_new_prev_hash(p, len, &a, &b, root, &c, &a);
+    sv2_parse_set_target(p, len, &a, target);
+    sv2_parse_submit_shares_success(p, len, &a, &b, &c);
+
+    if (sv2_parse_submit_shares_error(p, len, &a, &b, code, sizeof(code)) == 0) {
+        TEST_ASSERT_LESS_THAN(sizeof(code), strlen(code));
+    }
+    if (sv2_parse_update_channel_error(p, len, &a, code, sizeof(code)) == 0) {
+        TEST_ASSERT_LESS_THAN(sizeof(code), strlen(code));
+    }
+
+    sv2_ext_job_t *job = sv2_parse_new_extended_mining_job(p, len, &a);
+    if (job) {
+        TEST_ASSERT_LESS_OR_EQUAL(SV2_MAX_MERKLE_BRANCHES, job->merkle_path_count);
+        TEST_ASSERT_LESS_OR_EQUAL(len, job->coinbase_prefix_len + job->coinbase_suffix_len);
+        sv2_ext_job_free(job);
+    }
+
+    free(p);
+}
+
+TEST_CASE("Build and parse UpdateChannel frame", "[sv2_protocol]")
+{
+    uint8_t target[32];
+    memset(target, 0xAB, sizeof(target));
+
+    uint8_t frame[SV2_FRAME_HEADER_SIZE + 40];
+    int len = sv2_build_update_channel(frame, sizeof(frame), 7, 1.5e12f, target);
+    TEST_ASSERT_EQUAL_INT(sizeof(frame), len);
+    TEST_ASSERT_EQUAL_INT(-1, sv2_build_update_channel(frame, sizeof(frame) - 1, 7, 1.5e12f, target));
+
+    sv2_frame_header_t hdr;
+    sv2_parse_frame_header(frame, &hdr);
+    TEST_ASSERT_EQUAL_HEX16(SV2_CHANNEL_MSG_FLAG, hdr.extension_type);
+    TEST_ASSERT_EQUAL_HEX8(SV2_MSG_UPDATE_CHANNEL, hdr.msg_type);
+    TEST_ASSERT_EQUAL_UINT32(40, hdr.msg_length);
+
+    float hash_rate;
+    memcpy(&hash_rate, frame + SV2_FRAME_HEADER_SIZE + 4, 4);
+    TEST_ASSERT_EQUAL_FLOAT(1.5e12f, hash_rate);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(target, frame + SV2_FRAME_HEADER_SIZE + 8, 32);
+}
+
+TEST_CASE("Difficulty to target matches pdiff", "[sv2_protocol]")
+{
+    uint8_t target[32];
+
+    sv2_difficulty_to_target(1.0, target);
+    uint8_t diff1[32] = {0};
+    diff1[26] = 0xFF;
+    diff1[27] = 0xFF;
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(diff1, target, 32);
+
+    const double difficulties[] = {2.0, 1000.0, 65536.0, 1.23e6, 5.5e9};
+    for (size_t i = 0; i < sizeof(difficulties) / sizeof(difficulties[0]); i++) {
+        sv2_difficulty_to_target(difficulties[i], target);
+        double pdiff = hash_to_pdiff(target);
+        TEST_ASSERT_DOUBLE_WITHIN(difficulties[i] * 1e-9, difficulties[i], pdiff);
+    }
+
+    sv2_difficulty_to_target(0.5, target);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.5, hash_to_pdiff(target));
+
+    sv2_difficulty_to_target(1e-12, target);
+    for (int i = 0; i < 32; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0xFF, target[i]);
+    }
+}
+
+TEST_CASE("Parsers reject every truncation of a valid message", "[sv2_protocol]")
+{
+    uint8_t msg[512];
+    uint32_t a, b, c;
+    bool flag;
+    uint16_t u16;
+    uint8_t target[32], root[32], prefix[32], prefix_len;
+    char code[64];
+
+    int len = make_new_mining_job(msg);
+    TEST_ASSERT_EQUAL_INT(0, sv2_parse_new_mining_job(msg, len, &a, &b, &flag, &c, &a, root));
+    for (int i = 0; i < len; i++) {
+        TEST_ASSERT_EQUAL_INT(-1, sv2_parse_new_mining_job(msg, i, &a, &b, &flag, &c, &a, root));
+    }
+
+    len = make_open_channel_success(msg);
+    TEST_ASSERT_EQUAL_INT(0, sv2_parse_open_channel_success(msg, len, &a, &b, target, prefix, &prefix_len, &c));
+    TEST_ASSERT_EQUAL_UINT32(3, c);
+    for (int i = 0; i < len; i++) {
+        TEST_ASSERT_EQUAL_INT(-1, sv2_parse_open_channel_success(msg, i, &a, &b, target, prefix, &prefix_len, &c));
+    }
+
+    len = make_open_extended_channel_success(msg);
+    TEST_ASSERT_EQUAL_INT(0, sv2_parse_open_extended_channel_success(msg, len, &a, &b, target, &u16,
+                                                                     prefix, &prefix_len, &c));
+    TEST_ASSERT_EQUAL_UINT8(4, prefix_len);
+    for (int i = 0; i < len; i++) {
+        TEST_ASSERT_EQUAL_INT(-1, sv2_parse_open_extended_channel_success(msg, i, &a, &b, target, &u16,
+                                                                          prefix, &prefix_len, &c));
+    }
+
+    len = make_submit_shares_error(msg);
+    TEST_ASSERT_EQUAL_INT(0, sv2_parse_submit_shares_error(msg, len, &a, &b, code, sizeof(code)));
+    TEST_ASSERT_EQUAL_STRING("stale-share", code);
+    for (int i = 0; i < len; i++) {
+        TEST_ASSERT_EQUAL_INT(-1, sv2_parse_submit_shares_error(msg, i, &a, &b, code, sizeof(code)));
+    }
+
+    len = make_new_extended_mining_job(msg, 3, 40, 20);
+    sv2_ext_job_t *job = sv2_parse_new_extended_mining_job(msg, len, &a);
+    TEST_ASSERT_NOT_NULL(job);
+    TEST_ASSERT_EQUAL_UINT8(3, job->merkle_path_count);
+    TEST_ASSERT_EQUAL_UINT16(40, job->coinbase_prefix_len);
+    TEST_ASSERT_EQUAL_UINT16(20, job->coinbase_suffix_len);
+    sv2_ext_job_free(job);
+    for (int i = 0; i < len; i++) {
+        TEST_ASSERT_NULL(sv2_parse_new_extended_mining_job(msg, i, &a));
+    }
+}
+
+TEST_CASE("Parsers survive random and mutated input", "[sv2_protocol]")
+{
+    rng_state = 0x5eed2u;
+    printf("sv2 fuzz seed 0x%08x\n", (unsigned)rng_state);
+
+    uint8_t seeds[5][512];
+    int seed_len[5];
+    seed_len[0] = make_new_mining_job(seeds[0]);
+    seed_len[1] = make_new_extended_mining_job(seeds[1], 4, 60, 30);
+    seed_len[2] = make_open_extended_channel_success(seeds[2]);
+    seed_len[3] = make_open_channel_success(seeds[3]);
+    seed_len[4] = make_submit_shares_error(seeds[4]);
+
+    uint8_t buf[512];
+
+    // Pure noise of every short length
+    for (int iter = 0; iter < 2000; iter++) {
+        uint32_t len = rng_next() % 128;
+        rng_fill(buf, len);
+        parse_all(buf, len);
+    }
+
+    // Valid messages with a few bytes flipped, biased towards length fields
+    for (int iter = 0; iter < 4000; iter++) {
+        int s = rng_next() % 5;
+        uint32_t len = seed_len[s];
+        memcpy(buf, seeds[s], len);
+        int flips = 1 + rng_next() % 4;
+        for (int f = 0; f < flips; f++) {
+            buf[rng_next() % len] = (uint8_t)rng_next();
+        }
+        if (rng_next() % 4 == 0) {
+            len = rng_next() % (len + 1);
+        }
+        parse_all(buf, len);
+    }
+}
+
+TEST_CASE("SV2 parse throughput", "[sv2_protocol][benchmark]")
+{
+    const int iterations = 10000;
+    uint8_t msg[1024];
+    uint8_t frame[SV2_FRAME_HEADER_SIZE + 64];
+    uint32_t a, b, c;
+    bool flag;
+    uint8_t root[32];
+
+    int len = make_new_mining_job(msg);
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        TEST_ASSERT_EQUAL_INT(0, sv2_parse_new_mining_job(msg, len, &a, &b, &flag, &c, &a, root));
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    printf("NewMiningJob: %.0f msg/s\n", iterations * 1e6 / (double)(elapsed ? elapsed : 1));
+
+    // Typical mainnet job: 12 branches, ~150 byte coinbase prefix, ~80 byte suffix
+    len = make_new_extended_mining_job(msg, 12, 150, 80);
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        sv2_ext_job_t *job = sv2_parse_new_extended_mining_job(msg, len, &a);
+        TEST_ASSERT_NOT_NULL(job);
+        sv2_ext_job_free(job);
+    }
+    elapsed = esp_timer_get_time() - start;
+    printf("NewExtendedMiningJob: %.0f msg/s\n", iterations * 1e6 / (double)(elapsed ? elapsed : 1));
+
+    uint8_t extranonce[8] = {0};
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        TEST_ASSERT_GREATER_THAN(0, sv2_build_submit_shares_extended(frame, sizeof(frame), 7, i, 43, i * 7919,
+                                                                     0x66000000, 0x20000000, extranonce,
+                                                                     sizeof(extranonce)));
+    }
+    elapsed = esp_timer_get_time() - start;
+    printf("SubmitSharesExtended build: %.0f msg/s\n", iterations * 1e6 / (double)(elapsed ? elapsed : 1));
+}
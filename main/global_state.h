@@ -9,6 +9,8 @@
 #include "freertos/portmacro.h"
 #include "power_management_task.h"
 #include "hashrate_monitor_task.h"
+#include "core_stats.h"
+#include "chip_tuner.h"
 #include "coinbase_decoder.h"
 #include "work_queue.h"
 #include "device_config.h"
@@ -166,6 +168,8 @@ typedef struct GlobalState
     PowerManagementModule POWER_MANAGEMENT_MODULE;
     SelfTestModule SELF_TEST_MODULE;
     HashrateMonitorModule HASHRATE_MONITOR_MODULE;
+    CoreStatsModule CORE_STATS_MODULE;
+    ChipTunerModule CHIP_TUNER_MODULE;
 
     char * extranonce_str;
     int extranonce_2_len;
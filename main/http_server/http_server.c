@@ -2,6 +2,7 @@
 #include <fcntl.h>
 #include <string.h>
 #include <limits.h>
+#include <math.h>
 #include <sys/param.h>
 #include <sys/stat.h>
 #include <esp_heap_caps.h>
@@ -32,6 +33,7 @@
 #include "system.h"
 #include "connect.h"
 #include "statistics_task.h"
+#include "core_stats.h"
 #include "theme_api.h"
 #include "axe-os/api/system/asic_settings.h"
 #include "display.h"
@@ -97,6 +99,8 @@ typedef enum
     SRC_NONE // last
 } DataSource;
 
+_Static_assert((int)SRC_NONE == (int)STATS_METRIC_COUNT, "DataSource follows the statistics metric order");
+
 DataSource strToDataSource(const char * sourceStr)
 {
     if (NULL != sourceStr) {
@@ -1496,6 +1500,60 @@ static esp_err_t POST_system_boot(httpd_req_t *req)
     return send_res;
 }
 
+typedef enum
+{
+    AGGREGATE_MIN,
+    AGGREGATE_AVG,
+    AGGREGATE_MAX,
+} StatisticsAggregate;
+
+typedef struct
+{
+    cJSON * statsArray;
+    const bool * dataSelection;
+    StatisticsAggregate aggregate;
+} StatisticsRows;
+
+static bool isIntegerDataSource(DataSource source)
+{
+    return source == SRC_ASIC_VOLTAGE || source == SRC_FAN_RPM || source == SRC_FAN2_RPM ||
+           source == SRC_WIFI_RSSI || source == SRC_FREE_HEAP;
+}
+
+static bool addStatisticsRow(const stats_point_t * point, void * context)
+{
+    StatisticsRows * rows = context;
+    const float * values = rows->aggregate == AGGREGATE_MIN ? point->min
+                         : rows->aggregate == AGGREGATE_MAX ? point->max
+                         : point->avg;
+
+    cJSON * valueArray = cJSON_CreateArray();
+    for (int source = 0; source < SRC_NONE; source++) {
+        if (!rows->dataSelection[source]) continue;
+        if (isIntegerDataSource(source)) {
+            cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(roundf(values[source])));
+        } else {
+            cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(values[source]));
+        }
+    }
+    cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(point->timestamp));
+
+    cJSON_AddItemToArray(rows->statsArray, valueArray);
+    return true;
+}
+
+static bool getQueryI64(const char * query, const char * key, int64_t * value)
+{
+    char buf[24];
+    char * end;
+
+    if (httpd_query_key_value(query, key, buf, sizeof(buf)) != ESP_OK) return false;
+    int64_t parsed = strtoll(buf, &end, 10);
+    if (end == buf || *end != '\0') return false;
+    *value = parsed;
+    return true;
+}
+
 static esp_err_t GET_system_statistics(httpd_req_t * req)
 {
     if (is_network_allowed(req) != ESP_OK) {
@@ -1514,6 +1572,17 @@ static esp_err_t GET_system_statistics(httpd_req_t * req)
     bool dataSelection[SRC_NONE] = {false};
     bool selectionCheck = false;
 
+    // Without a range the last MAX_STATISTICS_COUNT points at the configured frequency
+    const int64_t currentTimestamp = esp_timer_get_time() / 1000;
+    const int64_t statsFrequency = nvs_config_get_u16(NVS_CONFIG_STATISTICS_FREQUENCY);
+    const int64_t defaultSpan = MAX_STATISTICS_COUNT * statsFrequency * 1000;
+    stats_range_t range = {
+        .resolution = STATS_RESOLUTION_AUTO,
+        .to = currentTimestamp,
+    };
+    bool hasFrom = false;
+    StatisticsAggregate aggregate = AGGREGATE_AVG;
+
     // Check query parameters
     if (1 < bufLen) {
         char buf[bufLen];
@@ -1532,9 +1601,32 @@ static esp_err_t GET_system_statistics(httpd_req_t * req)
                     param = strtok(NULL, ",");
                 }
             }
+
+            hasFrom = getQueryI64(buf, "from", &range.from);
+            getQueryI64(buf, "to", &range.to);
+
+            char value[8];
+            if (httpd_query_key_value(buf, "resolution", value, sizeof(value)) == ESP_OK) {
+                if (strcmp(value, "1s") == 0) range.resolution = STATS_RESOLUTION_1S;
+                if (strcmp(value, "1m") == 0) range.resolution = STATS_RESOLUTION_1M;
+                if (strcmp(value, "1h") == 0) range.resolution = STATS_RESOLUTION_1H;
+            }
+            if (httpd_query_key_value(buf, "aggregate", value, sizeof(value)) == ESP_OK) {
+                if (strcmp(value, "min") == 0) aggregate = AGGREGATE_MIN;
+                if (strcmp(value, "max") == 0) aggregate = AGGREGATE_MAX;
+            }
         }
     }
 
+    // history from before this boot has negative timestamps
+    if (!hasFrom) {
+        range.from = range.to - defaultSpan;
+    }
+    // merge points so a response holds about MAX_STATISTICS_COUNT at most
+    if (range.to > range.from) {
+        range.bucket_ms = (range.to - range.from + MAX_STATISTICS_COUNT - 1) / MAX_STATISTICS_COUNT;
+    }
+
     if (!selectionCheck) {
         // Enable all
         for (int i = 0; i < SRC_NONE; i++) {
@@ -1544,7 +1636,7 @@ static esp_err_t GET_system_statistics(httpd_req_t * req)
 
     // Create object for statistics
     cJSON * root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "currentTimestamp", (esp_timer_get_time() / 1000));
+    cJSON_AddNumberToObject(root, "currentTimestamp", currentTimestamp);
 
     cJSON * labelArray = cJSON_CreateArray();
     if (dataSelection[SRC_HASHRATE]) { cJSON_AddItemToArray(labelArray, cJSON_CreateString(STATS_LABEL_HASHRATE)); }
@@ -1569,33 +1661,20 @@ static esp_err_t GET_system_statistics(httpd_req_t * req)
 
     cJSON_AddItemToObject(root, "labels", labelArray);
 
-    cJSON * statsArray = cJSON_AddArrayToObject(root, "statistics");
-    struct StatisticsData statsData;
-    uint16_t index = 0;
-
-    while (getStatisticData(index++, &statsData)) {
-        cJSON * valueArray = cJSON_CreateArray();
-        if (dataSelection[SRC_HASHRATE]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.hashrate)); }
-        if (dataSelection[SRC_HASHRATE_1m]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.hashrate_1m)); }
-        if (dataSelection[SRC_HASHRATE_10m]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.hashrate_10m)); }
-        if (dataSelection[SRC_HASHRATE_1h]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.hashrate_1h)); }
-        if (dataSelection[SRC_ERROR_PERCENTAGE]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.errorPercentage)); }
-        if (dataSelection[SRC_ASIC_TEMP]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.chipTemperature)); }
-        if (dataSelection[SRC_ASIC_TEMP2]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.chipTemperature2)); }
-        if (dataSelection[SRC_VR_TEMP]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.vrTemperature)); }
-        if (dataSelection[SRC_ASIC_VOLTAGE]) { cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(statsData.coreVoltageActual)); }
-        if (dataSelection[SRC_VOLTAGE]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.voltage)); }
-        if (dataSelection[SRC_POWER]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.power)); }
-        if (dataSelection[SRC_CURRENT]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.current)); }
-        if (dataSelection[SRC_FAN_SPEED]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.fanSpeed)); }
-        if (dataSelection[SRC_FAN_RPM]) { cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(statsData.fanRPM)); }
-        if (dataSelection[SRC_FAN2_RPM]) { cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(statsData.fan2RPM)); }
-        if (dataSelection[SRC_WIFI_RSSI]) { cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(statsData.wifiRSSI)); }
-        if (dataSelection[SRC_FREE_HEAP]) { cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(statsData.freeHeap)); }
-        if (dataSelection[SRC_RESPONSE_TIME]) { cJSON_AddItemToArray(valueArray, cJSON_CreateFloat(statsData.responseTime)); }
-        cJSON_AddItemToArray(valueArray, cJSON_CreateNumber(statsData.timestamp));
-
-        cJSON_AddItemToArray(statsArray, valueArray);
+    for (int source = 0; source < SRC_NONE; source++) {
+        if (dataSelection[source]) range.metrics |= 1u << source;
+    }
+
+    StatisticsRows rows = {
+        .statsArray = cJSON_AddArrayToObject(root, "statistics"),
+        .dataSelection = dataSelection,
+        .aggregate = aggregate,
+    };
+    statistics_query(&range, addStatisticsRow, &rows);
+
+    if (range.resolution != STATS_RESOLUTION_AUTO) {
+        cJSON_AddNumberToObject(root, "resolution", stats_store_interval_ms(range.resolution));
+        cJSON_AddNumberToObject(root, "interval", range.bucket_ms);
     }
 
     esp_err_t res = HTTP_send_json(req, root, &system_statistics_prebuffer_len);
@@ -1605,6 +1684,109 @@ static esp_err_t GET_system_statistics(httpd_req_t * req)
     return res;
 }
 
+static esp_err_t GET_asic_cores(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    CoreStatsModule *core_stats = &GLOBAL_STATE->CORE_STATS_MODULE;
+    if (core_stats->mutex == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Core stats not available");
+        return ESP_OK;
+    }
+
+    // the small core rates are 16 numbers per core, only sent when asked for
+    bool small_core_rates = false;
+    size_t bufLen = httpd_req_get_url_query_len(req) + 1;
+    if (1 < bufLen) {
+        char buf[bufLen];
+        char value[8];
+        if (httpd_req_get_url_query_str(req, buf, bufLen) == ESP_OK &&
+            httpd_query_key_value(buf, "rates", value, sizeof(value)) == ESP_OK) {
+            small_core_rates = strcmp(value, "true") == 0;
+        }
+    }
+
+    // one chip at a time, the JSON is built outside the lock
+    core_stats_cell_t * cells = heap_caps_malloc((size_t)core_stats->core_count * CORE_STATS_SMALL_CORES * sizeof(core_stats_cell_t), MALLOC_CAP_SPIRAM);
+    if (cells == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_OK;
+    }
+
+    cJSON * root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "coreCount", core_stats->core_count);
+    cJSON_AddNumberToObject(root, "smallCoreCount", CORE_STATS_SMALL_CORES);
+    cJSON * asics = cJSON_AddArrayToObject(root, "asics");
+
+    for (int asic_nr = 0; asic_nr < core_stats->asic_count; asic_nr++) {
+        uint32_t core_nonces[CORE_STATS_MAX_CORES] = {0};
+        uint32_t core_invalid[CORE_STATS_MAX_CORES] = {0};
+        float core_rate[CORE_STATS_MAX_CORES] = {0};
+        float core_invalid_rate[CORE_STATS_MAX_CORES] = {0};
+        uint32_t asic_nonces = 0;
+        uint32_t asic_invalid = 0;
+        float asic_rate = 0;
+
+        core_stats_copy_asic(core_stats, asic_nr, cells);
+
+        cJSON * asic = cJSON_CreateObject();
+        cJSON * cores = cJSON_AddArrayToObject(asic, "cores");
+        for (int core_id = 0; core_id < core_stats->core_count; core_id++) {
+            const core_stats_cell_t * core_cells = &cells[core_id * CORE_STATS_SMALL_CORES];
+            cJSON * core = cJSON_CreateObject();
+            cJSON * rates = small_core_rates ? cJSON_AddArrayToObject(core, "rates") : NULL;
+            for (int small_core_id = 0; small_core_id < CORE_STATS_SMALL_CORES; small_core_id++) {
+                const core_stats_cell_t * cell = &core_cells[small_core_id];
+                core_nonces[core_id] += cell->nonces;
+                core_invalid[core_id] += cell->invalid;
+                core_rate[core_id] += cell->rate;
+                core_invalid_rate[core_id] += cell->invalid_rate;
+                if (rates != NULL) {
+                    cJSON_AddItemToArray(rates, cJSON_CreateNumber(roundf(cell->rate * 10.0f) / 10.0f));
+                }
+            }
+            asic_nonces += core_nonces[core_id];
+            asic_invalid += core_invalid[core_id];
+            asic_rate += core_rate[core_id];
+            cJSON_AddNumberToObject(core, "nonces", core_nonces[core_id]);
+            cJSON_AddNumberToObject(core, "invalid", core_invalid[core_id]);
+            cJSON_AddNumberToObject(core, "rate", roundf(core_rate[core_id] * 10.0f) / 10.0f);
+            cJSON_AddItemToArray(cores, core);
+        }
+
+        // judged on recent rates, the totals since boot are only reported
+        float expected_rate = asic_rate / core_stats->core_count;
+        cJSON * core = NULL;
+        int core_id = 0;
+        cJSON_ArrayForEach(core, cores) {
+            core_status_t status = core_stats_classify(core_rate[core_id], core_invalid_rate[core_id], expected_rate);
+            cJSON_AddStringToObject(core, "status", core_stats_status_name(status));
+            core_id++;
+        }
+
+        cJSON_AddNumberToObject(asic, "nonces", asic_nonces);
+        cJSON_AddNumberToObject(asic, "invalid", asic_invalid);
+        cJSON_AddItemToArray(asics, asic);
+    }
+    heap_caps_free(cells);
+
+    esp_err_t res = HTTP_send_json(req, root, &api_common_prebuffer_len);
+
+    cJSON_Delete(root);
+
+    return res;
+}
+
 static esp_err_t GET_scoreboard(httpd_req_t * req)
 {
     if (is_network_allowed(req) != ESP_OK) {
@@ -1852,7 +2034,7 @@ esp_err_t start_rest_server(GlobalState * global_state)
     config.uri_match_fn = httpd_uri_match_wildcard;
     config.stack_size = 8192;
     config.max_open_sockets = 20;
-    config.max_uri_handlers = 25;
+    config.max_uri_handlers = 26;
     config.close_fn = websocket_close_fn;
     config.lru_purge_enable = true;
 
@@ -1925,6 +2107,14 @@ esp_err_t start_rest_server(GlobalState * global_state)
     };
     httpd_register_uri_handler(server, &scoreboard_get_uri);
 
+    httpd_uri_t asic_cores_get_uri = {
+        .uri = "/api/system/asic/cores",
+        .method = HTTP_GET,
+        .handler = GET_asic_cores,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &asic_cores_get_uri);
+
     /* URI handler for WiFi scan */
     httpd_uri_t wifi_scan_get_uri = {
         .uri = "/api/system/wifi/scan",
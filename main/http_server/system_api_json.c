@@ -55,6 +55,7 @@ static void system_api_add_telemetry(cJSON *root, GlobalState *g) {
     cJSON_AddFloatToObject(root, "vrTemp", g->POWER_MANAGEMENT_MODULE.vr_temp);
     cJSON_AddFloatToObject(root, "coreVoltageActual", g->POWER_MANAGEMENT_MODULE.core_voltage);
     cJSON_AddFloatToObject(root, "actualFrequency", g->POWER_MANAGEMENT_MODULE.actual_frequency);
+    cJSON_AddBoolToObject(root, "frequencyRamping", g->POWER_MANAGEMENT_MODULE.frequency_ramping);
     cJSON_AddFloatToObject(root, "expectedHashrate", g->POWER_MANAGEMENT_MODULE.expected_hashrate);
     cJSON_AddNumberToObject(root, "fanspeed", g->POWER_MANAGEMENT_MODULE.fan_perc);
     cJSON_AddNumberToObject(root, "fanrpm", g->POWER_MANAGEMENT_MODULE.fan_rpm);
@@ -218,10 +219,12 @@ static void system_api_add_config(cJSON *root, GlobalState *g) {
     cJSON_AddStringToObject(root, "fallbackStratumProtocol", sec_pool->protocol == STRATUM_PROTOCOL_V2 ? STRATUM_V2 : STRATUM_V1);
     cJSON_AddStringToObject(root, "fallbackStratumV2AuthorityPubkey", sec_pool->sv2_authority_pubkey ? sec_pool->sv2_authority_pubkey : "");
     cJSON_AddStringToObject(root, "fallbackStratumV2ChannelType", sec_pool->sv2_channel_type == SV2_CHANNEL_STANDARD ? SV2_CHANNEL_TYPE_STANDARD : SV2_CHANNEL_TYPE_EXTENDED);
+    cJSON_AddNumberToObject(root, "sv2SubmitBatchMs", nvs_config_get_u16(NVS_CONFIG_SV2_SUBMIT_BATCH_MS));
 
     // User Preferences
     cJSON_AddNumberToObject(root, "useCustomWWW", nvs_config_get_bool(NVS_CONFIG_USE_CUSTOM_WWW) ? 1 : 0);
     cJSON_AddNumberToObject(root, "overclockEnabled", nvs_config_get_bool(NVS_CONFIG_OVERCLOCK_ENABLED) ? 1 : 0);
+    cJSON_AddNumberToObject(root, "chipTuning", nvs_config_get_bool(NVS_CONFIG_CHIP_TUNING) ? 1 : 0);
     char *disp_name = nvs_config_get_string(NVS_CONFIG_DISPLAY);
     cJSON_AddStringToObject(root, "display", disp_name ? disp_name : "");
     free(disp_name);
@@ -256,6 +259,12 @@ static void system_api_add_hashrate_monitor(cJSON *root, GlobalState *g) {
         
         cJSON_AddNumberToObject(asic, "total", g->HASHRATE_MONITOR_MODULE.total_measurement[i].hashrate);
         cJSON_AddNumberToObject(asic, "errorCount", g->HASHRATE_MONITOR_MODULE.error_measurement[i].value);
+        cJSON_AddNumberToObject(asic, "temp", i < g->POWER_MANAGEMENT_MODULE.chip_temp_count
+                                              ? g->POWER_MANAGEMENT_MODULE.chip_temps[i]
+                                              : -1);
+        cJSON_AddNumberToObject(asic, "frequency", g->CHIP_TUNER_MODULE.chips && g->CHIP_TUNER_MODULE.base > 0
+                                                   ? g->CHIP_TUNER_MODULE.chips[i].frequency
+                                                   : g->POWER_MANAGEMENT_MODULE.actual_frequency);
         
         cJSON *domains = cJSON_CreateArray();
         cJSON_AddItemToObject(asic, "domains", domains);
@@ -263,6 +272,34 @@ static void system_api_add_hashrate_monitor(cJSON *root, GlobalState *g) {
             cJSON_AddItemToArray(domains, cJSON_CreateNumber(g->HASHRATE_MONITOR_MODULE.domain_measurements[i][j].hashrate));
         }
     }
+
+    cJSON *chains = cJSON_CreateArray();
+    cJSON_AddItemToObject(monitor, "chains", chains);
+    for (int i = 0; i < ASIC_CHAIN_COUNT; i++) {
+        cJSON_AddItemToArray(chains, cJSON_CreateNumber(g->HASHRATE_MONITOR_MODULE.chain_hashrate[i]));
+    }
+
+    pthread_mutex_lock(&g->HASHRATE_MONITOR_MODULE.lock);
+    hashrate_estimator_t estimator = g->HASHRATE_MONITOR_MODULE.estimator;
+    bool divergent = g->HASHRATE_MONITOR_MODULE.divergent;
+    pthread_mutex_unlock(&g->HASHRATE_MONITOR_MODULE.lock);
+
+    cJSON *estimates = cJSON_CreateArray();
+    cJSON_AddItemToObject(monitor, "estimates", estimates);
+    for (int i = 0; i < HASHRATE_ESTIMATOR_HORIZONS; i++) {
+        hashrate_estimate_t registers = hashrate_estimator_registers(&estimator, i);
+        hashrate_estimate_t shares = hashrate_estimator_shares(&estimator, i);
+
+        cJSON *estimate = cJSON_CreateObject();
+        cJSON_AddItemToArray(estimates, estimate);
+        cJSON_AddNumberToObject(estimate, "horizon", hashrate_estimator_horizon_s(i));
+        cJSON_AddNumberToObject(estimate, "registers", registers.value);
+        cJSON_AddNumberToObject(estimate, "registersError", registers.error);
+        cJSON_AddNumberToObject(estimate, "shares", shares.value);
+        cJSON_AddNumberToObject(estimate, "sharesError", shares.error);
+        cJSON_AddNumberToObject(estimate, "divergence", hashrate_estimator_divergence(&estimator, i));
+    }
+    cJSON_AddBoolToObject(monitor, "divergent", divergent);
 }
 
 static void system_api_add_rejected_reasons(cJSON *root, GlobalState *g) {
@@ -20,6 +20,7 @@
 #include "nvs_config.h"
 #include "self_test.h"
 #include "asic.h"
+#include "asic_common.h"
 #include "bap/bap.h"
 #include "device_config.h"
 #include "connect.h"
@@ -32,6 +33,7 @@
 #include "esp_ota_ops.h"
 
 static GlobalState GLOBAL_STATE;
+static asic_decode_params_t DECODE_PARAMS[ASIC_CHAIN_COUNT];
 
 static const char * TAG = "bitaxe";
 
@@ -141,6 +143,15 @@ void app_main(void)
     if (scoreboard_init(&GLOBAL_STATE.SYSTEM_MODULE.scoreboard) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to init scoreboard");
     }
+    if (core_stats_init(&GLOBAL_STATE.CORE_STATS_MODULE, GLOBAL_STATE.DEVICE_CONFIG.family.asic_count, GLOBAL_STATE.DEVICE_CONFIG.family.asic.core_count) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to init core stats");
+    }
+    if (chip_tuner_init(&GLOBAL_STATE.CHIP_TUNER_MODULE, GLOBAL_STATE.DEVICE_CONFIG.family.asic_count) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to init chip tuner");
+    }
+    if (POWER_MANAGEMENT_init_chip_temps(&GLOBAL_STATE.POWER_MANAGEMENT_MODULE, GLOBAL_STATE.DEVICE_CONFIG.family.asic_count) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to init chip temperatures");
+    }
 
     if (!GLOBAL_STATE.SELF_TEST_MODULE.is_active) {
         wifi_init(&GLOBAL_STATE);
@@ -173,11 +184,16 @@ void app_main(void)
     SYSTEM_init_partitions(&GLOBAL_STATE);
 
     // Initialize BAP interface
+#if ASIC_CHAIN_COUNT > 1
+    // the second ASIC chain runs on the BAP UART
+    ESP_LOGW(TAG, "BAP disabled, its UART drives ASIC chain 1");
+#else
     esp_err_t bap_ret = BAP_init(&GLOBAL_STATE);
     if (bap_ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize BAP interface: %d", bap_ret);
         // Continue anyway, as BAP is not critical for core functionality
     }
+#endif
 
     // While the device is still in setup mode (config AP up but no WiFi
     // connection), expose the BLE provisioning service so the miner can be
@@ -218,6 +234,12 @@ void app_main(void)
             if (xTaskCreate(create_jobs_task, "stratum miner", 8192, (void *) &GLOBAL_STATE, 20, NULL) != pdPASS) {
                 ESP_LOGE(TAG, "Error creating stratum miner task");
             }
+            for (uint8_t chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+                DECODE_PARAMS[chain] = (asic_decode_params_t) { .GLOBAL_STATE = &GLOBAL_STATE, .chain = chain };
+                if (xTaskCreate(ASIC_decode_task, "asic decode", 4096, (void *) &DECODE_PARAMS[chain], 16, NULL) != pdPASS) {
+                    ESP_LOGE(TAG, "Error creating asic decode task for chain %u", chain);
+                }
+            }
             if (xTaskCreate(ASIC_result_task, "asic result", 8192, (void *) &GLOBAL_STATE, 15, NULL) != pdPASS) {
                 ESP_LOGE(TAG, "Error creating asic result task");
             }
@@ -14,10 +14,13 @@ typedef enum {
     NVS_CONFIG_PRIMARY_POOL_INDEX,
     NVS_CONFIG_SECONDARY_POOL_INDEX,
     NVS_CONFIG_USE_FALLBACK_STRATUM,
+    NVS_CONFIG_SV2_SUBMIT_BATCH_MS,
     
     NVS_CONFIG_ASIC_FREQUENCY,
     NVS_CONFIG_ASIC_VOLTAGE,
     NVS_CONFIG_OVERCLOCK_ENABLED,
+    NVS_CONFIG_CHIP_TUNING,
+    NVS_CONFIG_CHIP_FREQUENCY_PROFILE,
     
     NVS_CONFIG_DISPLAY,
     NVS_CONFIG_ROTATION,
@@ -1,6 +1,8 @@
+#include <stdio.h>
 #include "asic_init.h"
 #include "global_state.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "asic.h"
@@ -10,54 +12,136 @@
 
 static const char *TAG = "asic_init";
 
+typedef enum {
+    PHASE_RESET,
+    PHASE_UART,
+    PHASE_CHAIN,
+    PHASE_RX,
+    PHASE_BAUD,
+    PHASE_FREQUENCY,
+    PHASE_STABILIZE,
+    PHASE_COUNT
+} init_phase_t;
+
+static const char *PHASE_NAMES[PHASE_COUNT] = {"reset", "uart", "chain", "rx", "baud", "frequency", "stabilize"};
+
+typedef struct {
+    int64_t start_us;
+    int64_t phase_start_us;
+    int64_t phase_us[PHASE_COUNT];
+} init_timing_t;
+
+static void timing_start(init_timing_t *timing)
+{
+    *timing = (init_timing_t){0};
+    timing->start_us = timing->phase_start_us = esp_timer_get_time();
+}
+
+static void timing_end_phase(init_timing_t *timing, init_phase_t phase)
+{
+    int64_t now_us = esp_timer_get_time();
+    timing->phase_us[phase] = now_us - timing->phase_start_us;
+    timing->phase_start_us = now_us;
+}
+
+// One line with every phase, the ones that did not run show as 0
+static void timing_log(const init_timing_t *timing, const char *mode_str, bool success)
+{
+    char line[160];
+    int length = 0;
+    for (int phase = 0; phase < PHASE_COUNT && length < sizeof(line); phase++) {
+        length += snprintf(line + length, sizeof(line) - length, "%s %lld ms, ", PHASE_NAMES[phase],
+                           timing->phase_us[phase] / 1000);
+    }
+
+    int64_t total_ms = (esp_timer_get_time() - timing->start_us) / 1000;
+    if (success) {
+        ESP_LOGI(TAG, "ASIC init phases (%s): %stotal %lld ms", mode_str, line, total_ms);
+    } else {
+        ESP_LOGW(TAG, "ASIC init phases (%s, failed): %stotal %lld ms", mode_str, line, total_ms);
+    }
+}
+
 uint8_t asic_initialize(GlobalState *GLOBAL_STATE, asic_init_mode_t mode, uint32_t stabilization_delay_ms)
 {
     const char *mode_str = (mode == ASIC_INIT_COLD_BOOT) ? "cold boot" : "recovery";
     ESP_LOGI(TAG, "Starting ASIC initialization (%s mode)", mode_str);
 
+    init_timing_t timing;
+    timing_start(&timing);
+
+    // Chip detection reads the UART directly, keep the RX task off it
+    ASIC_stop_rx(GLOBAL_STATE);
+
     if (asic_reset() != ESP_OK) {
         GLOBAL_STATE->SYSTEM_MODULE.asic_status = "ASIC reset failed";
         ESP_LOGE(TAG, "ASIC reset failed!");
+        timing_end_phase(&timing, PHASE_RESET);
+        timing_log(&timing, mode_str, false);
         return 0;
     }
+    timing_end_phase(&timing, PHASE_RESET);
 
-    // Check actual UART state for safety
-    bool uart_initialized = SERIAL_is_initialized();
-    
-    // Verify mode matches actual state
-    if (mode == ASIC_INIT_COLD_BOOT && uart_initialized) {
-        ESP_LOGW(TAG, "Cold boot mode but UART already initialized - will reset baud only");
-    } else if (mode == ASIC_INIT_RECOVERY && !uart_initialized) {
-        ESP_LOGW(TAG, "Recovery mode but UART not initialized - will do full init");
-    }
-    
-    // Use actual state for decision, not just mode
-    if (!uart_initialized) {
-        // Fresh boot - full UART initialization
-        ESP_LOGI(TAG, "Performing full UART initialization");
-        SERIAL_init();
-    } else {
-        // Live recovery - ASIC was reset, UART needs baud reset to 115200
-        // This preserves the running system and avoids reboot
-        ESP_LOGI(TAG, "UART already initialized, resetting baud to %d", UART_FREQ);
-        SERIAL_set_baud(UART_FREQ);
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+    // The reset line is shared, every chain's UART starts over
+    for (uint8_t chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        // Check actual UART state for safety
+        bool uart_initialized = SERIAL_is_initialized(chain);
+
+        // Verify mode matches actual state
+        if (mode == ASIC_INIT_COLD_BOOT && uart_initialized) {
+            ESP_LOGW(TAG, "Cold boot mode but chain %u UART already initialized - will reset baud only", chain);
+        } else if (mode == ASIC_INIT_RECOVERY && !uart_initialized) {
+            ESP_LOGW(TAG, "Recovery mode but chain %u UART not initialized - will do full init", chain);
+        }
+
+        // Use actual state for decision, not just mode
+        if (!uart_initialized) {
+            // Fresh boot - full UART initialization
+            ESP_LOGI(TAG, "Performing full UART initialization of chain %u", chain);
+            SERIAL_init(chain);
+        } else {
+            // Live recovery - ASIC was reset, UART needs baud reset to 115200
+            // This preserves the running system and avoids reboot
+            ESP_LOGI(TAG, "Chain %u UART already initialized, resetting baud to %d", chain, UART_FREQ);
+            SERIAL_set_baud(chain, UART_FREQ);
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+        }
     }
+    timing_end_phase(&timing, PHASE_UART);
 
     ESP_LOGI(TAG, "Detecting ASIC chips...");
     clear_asic_chain_error();
     uint8_t chip_count = ASIC_init(GLOBAL_STATE);
-    
+    timing_end_phase(&timing, PHASE_CHAIN);
+
     if (chip_count == 0) {
         const char *chain_error = get_asic_chain_error();
         ESP_LOGE(TAG, "ASIC initialization failed - chip chain detection failed");
         GLOBAL_STATE->SYSTEM_MODULE.asic_status = chain_error != NULL ? chain_error : "ASIC chain detection failed";
+        timing_log(&timing, mode_str, false);
+        return 0;
+    }
+
+    for (uint8_t chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        SERIAL_clear_buffer(chain);
+    }
+
+    if (ASIC_start_rx(GLOBAL_STATE) != ESP_OK) {
+        GLOBAL_STATE->SYSTEM_MODULE.asic_status = "ASIC RX start failed";
+        timing_end_phase(&timing, PHASE_RX);
+        timing_log(&timing, mode_str, false);
         return 0;
     }
+    timing_end_phase(&timing, PHASE_RX);
+
+    // register reads go through the RX path, results are not consumed until ASIC_initalized
+    ESP_LOGI(TAG, "Negotiating baud rate");
+    ASIC_negotiate_baud(GLOBAL_STATE);
+    timing_end_phase(&timing, PHASE_BAUD);
 
-    ESP_LOGI(TAG, "Setting max baud rate and clearing buffers");
-    SERIAL_set_baud(ASIC_set_max_baud(GLOBAL_STATE));
-    SERIAL_clear_buffer();
+    // the PLL ramps up in the background while the first jobs go out
+    ASIC_set_frequency(GLOBAL_STATE);
+    timing_end_phase(&timing, PHASE_FREQUENCY);
 
     GLOBAL_STATE->ASIC_initalized = true;
     
@@ -65,7 +149,9 @@ uint8_t asic_initialize(GlobalState *GLOBAL_STATE, asic_init_mode_t mode, uint32
         ESP_LOGI(TAG, "Waiting %u ms for tasks to stabilize...", stabilization_delay_ms);
         vTaskDelay(stabilization_delay_ms / portTICK_PERIOD_MS);
     }
+    timing_end_phase(&timing, PHASE_STABILIZE);
 
     ESP_LOGI(TAG, "ASIC initialized successfully with %d chip(s) (%s mode)", chip_count, mode_str);
+    timing_log(&timing, mode_str, true);
     return chip_count;
 }
@@ -14,6 +14,7 @@
 #include "nvs_config.h"
 #include "global_state.h"
 #include "asic_reset.h"
+#include "asic.h"
 #include "device_config.h"
 #include "hashrate_monitor_task.h"
 #include "PID.h"
@@ -487,6 +488,9 @@ void self_test_task(void * pvParameters)
 
     vTaskDelay(1000 / portTICK_PERIOD_MS);
 
+    // the hashrate target assumes the full frequency
+    ASIC_wait_frequency(GLOBAL_STATE);
+
     // setup and test hashrate
     StratumApiV1Message msg = {0};
 
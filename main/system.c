@@ -22,6 +22,7 @@
 #include "esp_timer.h"
 
 #include "global_state.h"
+#include "asic_common.h"
 #include "system.h"
 #include "connect.h"
 #include "nvs_config.h"
@@ -416,7 +417,7 @@ void SYSTEM_clean_jobs_queue(GlobalState * GLOBAL_STATE)
     queue_clear(&GLOBAL_STATE->stratum_queue);
 
     pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    for (int i = 0; i < 128; i = i + 4) {
+    for (int i = 0; i < ASIC_JOB_IDS * ASIC_CHAIN_COUNT; i = i + 4) {
         GLOBAL_STATE->valid_jobs[i] = 0;
     }
     pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
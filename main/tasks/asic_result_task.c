@@ -15,13 +15,20 @@
 #include "asic.h"
 #include "freertos/task.h"
 #include "scoreboard.h"
+#include "core_stats.h"
 #include "self_test.h"
+#include "asic_result_task.h"
 
 static const char *TAG = "asic_result";
 
-void ASIC_result_task(void *pvParameters)
+#define RESULT_WAIT_MS 1000
+
+// Decodes the chain's frames into the result ring, ASIC_result_task() validates
+// and submits them, so a slow submit never holds up the UART side.
+void ASIC_decode_task(void *pvParameters)
 {
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+    asic_decode_params_t *params = (asic_decode_params_t *)pvParameters;
+    GlobalState *GLOBAL_STATE = params->GLOBAL_STATE;
 
     while (1)
     {
@@ -31,36 +38,48 @@ void ASIC_result_task(void *pvParameters)
             continue;
         }
 
-        task_result *asic_result = ASIC_process_work(GLOBAL_STATE);
+        ASIC_process_work(GLOBAL_STATE, params->chain);
+    }
+}
+
+void ASIC_result_task(void *pvParameters)
+{
+    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+    task_result result;
 
-        if (asic_result == NULL)
+    while (1)
+    {
+        if (!ASIC_take_result(GLOBAL_STATE, &result, RESULT_WAIT_MS))
         {
             continue;
         }
 
+        task_result *asic_result = &result;
+
         if (asic_result->register_type != REGISTER_INVALID) {
             hashrate_monitor_register_read(GLOBAL_STATE, asic_result->register_type, asic_result->asic_nr, asic_result->value, asic_result->timestamp_us);
             continue;
         }
 
         uint8_t job_id = asic_result->job_id;
+        int slot = ASIC_JOB_SLOT(asic_result->chain, job_id);
 
         // Snapshot the job while holding the lock. The shared slot
-        // (ASIC_TASK_MODULE.active_jobs[job_id]) can be freed and reused by
-        // BM1370_send_work() while we run the (potentially multi-second, blocking)
+        // (ASIC_TASK_MODULE.active_jobs[slot]) can be freed and reused by
+        // BM13XX_send_work() while we run the (potentially multi-second, blocking)
         // share submit below; keeping a pointer into it is a use-after-free. The
         // bm_job body is inline and safe to copy by value — deep-copy the two
         // heap-owned strings so the snapshot stays valid after we unlock.
         pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-        bool valid = (GLOBAL_STATE->valid_jobs[job_id] != 0) &&
-                     (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id] != NULL);
+        bool valid = (GLOBAL_STATE->valid_jobs[slot] != 0) &&
+                     (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[slot] != NULL);
         if (!valid)
         {
             pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
-            ESP_LOGW(TAG, "Invalid job nonce found, 0x%02X", job_id);
+            ESP_LOGW(TAG, "Invalid job nonce found, 0x%02X on chain %u", job_id, asic_result->chain);
             continue;
         }
-        bm_job active_job_snapshot = *GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id];
+        bm_job active_job_snapshot = *GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[slot];
         active_job_snapshot.jobid = active_job_snapshot.jobid ? strdup(active_job_snapshot.jobid) : NULL;
         active_job_snapshot.extranonce2 = active_job_snapshot.extranonce2 ? strdup(active_job_snapshot.extranonce2) : NULL;
         pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
@@ -68,6 +87,13 @@ void ASIC_result_task(void *pvParameters)
         // check the nonce difficulty
         double nonce_diff = test_nonce_value(active_job, asic_result->nonce, asic_result->rolled_version);
 
+        bool meets_ticket = nonce_diff >= GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty;
+        core_stats_record(&GLOBAL_STATE->CORE_STATS_MODULE, asic_result->asic_nr, asic_result->core_id, asic_result->small_core_id,
+                          meets_ticket);
+        if (meets_ticket) {
+            hashrate_monitor_nonce(GLOBAL_STATE, GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty);
+        }
+
         if (GLOBAL_STATE->SELF_TEST_MODULE.is_active) {
             self_test_record_nonce(GLOBAL_STATE, nonce_diff);
             free(active_job->jobid);
@@ -96,7 +122,8 @@ void ASIC_result_task(void *pvParameters)
                                                            asic_result->rolled_version,
                                                            extranonce_2, en2_len);
                 } else {
-                    ret = stratum_v2_submit_share(GLOBAL_STATE, sv2_job_id,
+                    // Route back to the standard channel the job came from
+                    ret = stratum_v2_submit_share(GLOBAL_STATE, active_job->sv2_channel_id, sv2_job_id,
                                                    asic_result->nonce,
                                                    active_job->ntime,
                                                    asic_result->rolled_version);
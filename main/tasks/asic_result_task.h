@@ -1,6 +1,18 @@
 #ifndef ASIC_result_TASK_H_
 #define ASIC_result_TASK_H_
 
+#include <stdint.h>
+
+#include "global_state.h"
+
+typedef struct
+{
+    GlobalState * GLOBAL_STATE;
+    uint8_t chain;
+} asic_decode_params_t;
+
+// pvParameters is an asic_decode_params_t, one task per chain
+void ASIC_decode_task(void *pvParameters);
 void ASIC_result_task(void *pvParameters);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "global_state.h"
+#include "nvs_config.h"
+#include "asic.h"
+#include "chip_tuner.h"
+
+static const char * TAG = "chip_tuner";
+
+static void clear_window(chip_tune_t * chip)
+{
+    chip->hashrate_sum = 0;
+    chip->error_sum = 0;
+    chip->samples = 0;
+    chip->lagging = 0;
+}
+
+static float clamp_offset(float offset)
+{
+    return fminf(fmaxf(offset, -CHIP_TUNER_MAX_DOWN), CHIP_TUNER_MAX_UP);
+}
+
+static void load_profile(ChipTunerModule * module)
+{
+    char * profile = nvs_config_get_string(NVS_CONFIG_CHIP_FREQUENCY_PROFILE);
+    if (profile == NULL) return;
+
+    // comma separated offsets in MHz, one per chip in chain order
+    char * cursor = profile;
+    for (int asic_nr = 0; asic_nr < module->asic_count && *cursor != '\0'; asic_nr++) {
+        char * end;
+        float offset = strtof(cursor, &end);
+        if (end == cursor) break;
+        module->chips[asic_nr].offset = clamp_offset(offset);
+        cursor = *end == ',' ? end + 1 : end;
+    }
+
+    free(profile);
+}
+
+static void save_profile(ChipTunerModule * module)
+{
+    size_t size = module->asic_count * 16;
+    char * profile = malloc(size);
+    if (profile == NULL) return;
+
+    size_t length = 0;
+    for (int asic_nr = 0; asic_nr < module->asic_count && length < size; asic_nr++) {
+        length += snprintf(profile + length, size - length, "%s%g", asic_nr ? "," : "", module->chips[asic_nr].offset);
+    }
+
+    nvs_config_set_string(NVS_CONFIG_CHIP_FREQUENCY_PROFILE, profile);
+    free(profile);
+}
+
+esp_err_t chip_tuner_init(ChipTunerModule * module, int asic_count)
+{
+    module->asic_count = asic_count;
+    module->base = 0;
+
+    module->chips = calloc(asic_count, sizeof(chip_tune_t));
+    if (module->chips == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %d chip profiles", asic_count);
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int asic_nr = 0; asic_nr < asic_count; asic_nr++) {
+        module->chips[asic_nr].ceiling = INFINITY;
+    }
+    load_profile(module);
+
+    return ESP_OK;
+}
+
+// A chain wide PLL write put every chip back on the chain frequency
+static void rebase(ChipTunerModule * module, PowerManagementModule * power_management)
+{
+    module->base = power_management->actual_frequency;
+    for (int asic_nr = 0; asic_nr < module->asic_count; asic_nr++) {
+        chip_tune_t * chip = &module->chips[asic_nr];
+        chip->applied = 0;
+        chip->frequency = module->base;
+        clear_window(chip);
+    }
+    power_management->max_chip_offset = 0;
+}
+
+// Moves each chip one grid step towards its offset, the same pace as the chain ramp
+static void step_chips(GlobalState * GLOBAL_STATE, bool enabled)
+{
+    ChipTunerModule * module = &GLOBAL_STATE->CHIP_TUNER_MODULE;
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+
+    float max_offset = 0;
+    for (int asic_nr = 0; asic_nr < module->asic_count; asic_nr++) {
+        chip_tune_t * chip = &module->chips[asic_nr];
+        float target = enabled ? chip->offset : 0;
+
+        if (chip->applied != target) {
+            float applied = target > chip->applied ? fminf(chip->applied + CHIP_TUNER_STEP, target)
+                                                   : fmaxf(chip->applied - CHIP_TUNER_STEP, target);
+            float frequency = ASIC_set_chip_frequency(GLOBAL_STATE, asic_nr, module->base + applied);
+            if (frequency > 0) {
+                chip->applied = applied;
+                chip->frequency = frequency;
+            }
+            // whatever was measured so far belongs to the old frequency
+            clear_window(chip);
+        }
+        max_offset = fmaxf(max_offset, chip->applied);
+    }
+
+    if (max_offset != power_management->max_chip_offset) {
+        power_management->max_chip_offset = max_offset;
+        ASIC_set_nonce_space(GLOBAL_STATE);
+    }
+}
+
+static void sample_chips(GlobalState * GLOBAL_STATE)
+{
+    ChipTunerModule * module = &GLOBAL_STATE->CHIP_TUNER_MODULE;
+    HashrateMonitorModule * monitor = &GLOBAL_STATE->HASHRATE_MONITOR_MODULE;
+    int hash_domains = GLOBAL_STATE->DEVICE_CONFIG.family.asic.hash_domains;
+
+    pthread_mutex_lock(&monitor->lock);
+    for (int asic_nr = 0; asic_nr < module->asic_count; asic_nr++) {
+        chip_tune_t * chip = &module->chips[asic_nr];
+        float hashrate = monitor->total_measurement[asic_nr].hashrate;
+        if (hashrate <= 0) continue;
+
+        chip->hashrate_sum += hashrate;
+        chip->error_sum += monitor->error_measurement[asic_nr].hashrate;
+        chip->samples++;
+
+        if (hash_domains > 1) {
+            float sum = 0, min = INFINITY;
+            for (int domain = 0; domain < hash_domains; domain++) {
+                float domain_hashrate = monitor->domain_measurements[asic_nr][domain].hashrate;
+                sum += domain_hashrate;
+                min = fminf(min, domain_hashrate);
+            }
+            if (min < sum / hash_domains * CHIP_TUNER_DOMAIN_MIN_FRACTION) {
+                chip->lagging++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&monitor->lock);
+}
+
+// Returns true when the chip's offset changed. temp_c is the on-die reading, -1 without one.
+static bool tune_chip(int asic_nr, chip_tune_t * chip, float temp_c)
+{
+    float error_percentage = chip->error_sum / chip->hashrate_sum * 100.0f;
+    bool lagging = chip->lagging * 2 > chip->samples;
+    bool hot = temp_c > CHIP_TUNER_TEMP_HIGH;
+    float offset = chip->offset;
+
+    if (error_percentage > CHIP_TUNER_ERROR_HIGH || lagging) {
+        // don't come back up to where it went wrong
+        chip->ceiling = fminf(chip->ceiling, chip->offset);
+        offset = clamp_offset(chip->offset - CHIP_TUNER_STEP);
+    } else if (hot) {
+        // heat comes and goes with the fan and the room, it sets no ceiling
+        offset = clamp_offset(chip->offset - CHIP_TUNER_STEP);
+    } else if (error_percentage < CHIP_TUNER_ERROR_LOW && chip->offset + CHIP_TUNER_STEP < chip->ceiling) {
+        offset = clamp_offset(chip->offset + CHIP_TUNER_STEP);
+    }
+
+    if (offset == chip->offset) return false;
+
+    ESP_LOGI(TAG, "Chip %d: %.2f%% errors%s%s, offset %+g -> %+g MHz", asic_nr, error_percentage,
+             lagging ? ", lagging hash domain" : "", hot ? ", hot" : "", chip->offset, offset);
+    chip->offset = offset;
+    return true;
+}
+
+void chip_tuner_tick(GlobalState * GLOBAL_STATE)
+{
+    ChipTunerModule * module = &GLOBAL_STATE->CHIP_TUNER_MODULE;
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+
+    if (module->chips == NULL || !ASIC_supports_chip_frequency(GLOBAL_STATE)) return;
+
+    if (power_management->frequency_ramping) {
+        rebase(module, power_management);
+        return;
+    }
+    if (power_management->actual_frequency != module->base) {
+        rebase(module, power_management);
+    }
+
+    bool enabled = nvs_config_get_bool(NVS_CONFIG_CHIP_TUNING);
+    step_chips(GLOBAL_STATE, enabled);
+    if (!enabled) return;
+
+    sample_chips(GLOBAL_STATE);
+
+    bool changed = false;
+    for (int asic_nr = 0; asic_nr < module->asic_count; asic_nr++) {
+        chip_tune_t * chip = &module->chips[asic_nr];
+        if (chip->applied != chip->offset || chip->samples < CHIP_TUNER_WINDOW_S) continue;
+
+        float temp_c = asic_nr < power_management->chip_temp_count ? power_management->chip_temps[asic_nr] : -1;
+        changed |= tune_chip(asic_nr, chip, temp_c);
+        clear_window(chip);
+    }
+
+    if (changed) {
+        save_profile(module);
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef CHIP_TUNER_H_
+#define CHIP_TUNER_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct GlobalState GlobalState;
+
+#define CHIP_TUNER_STEP 6.25f                // MHz, the same grid the frequency ramp walks
+#define CHIP_TUNER_MAX_UP 50.0f              // MHz a chip may run above the chain frequency
+#define CHIP_TUNER_MAX_DOWN 100.0f           // MHz a chip may run below the chain frequency
+#define CHIP_TUNER_WINDOW_S 300              // error rate averaging per decision
+#define CHIP_TUNER_ERROR_HIGH 2.0f           // error % that takes a chip a step down
+#define CHIP_TUNER_ERROR_LOW 0.5f            // error % under which a chip may take a step up
+#define CHIP_TUNER_DOMAIN_MIN_FRACTION 0.75f // a hash domain under this share of the chip's mean is lagging
+#define CHIP_TUNER_TEMP_HIGH 90.0f           // on-die C above which a chip takes a step down
+
+typedef struct
+{
+    float offset;       // MHz from the chain frequency the chip should run at, saved in NVS
+    float applied;      // offset the chip PLL is programmed with right now
+    float ceiling;      // lowest offset the chip had to back off from since boot
+    float frequency;    // PLL frequency the chip runs at
+
+    // current decision window
+    float hashrate_sum;
+    float error_sum;
+    uint16_t samples;
+    uint16_t lagging;   // samples with a hash domain well behind the others
+} chip_tune_t;
+
+typedef struct
+{
+    // written by the hashrate monitor task only
+    chip_tune_t * chips;
+    int asic_count;
+    float base;         // chain frequency the applied offsets are relative to
+} ChipTunerModule;
+
+esp_err_t chip_tuner_init(ChipTunerModule * module, int asic_count);
+
+// Called once per hashrate monitor poll while the ASICs run
+void chip_tuner_tick(GlobalState * GLOBAL_STATE);
+
+#endif /* CHIP_TUNER_H_ */
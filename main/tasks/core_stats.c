@@ -0,0 +1,152 @@
+#include <math.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "core_stats.h"
+
+static const char * TAG = "core_stats";
+
+static size_t cell_count(const CoreStatsModule * module)
+{
+    return (size_t)module->asic_count * module->core_count * CORE_STATS_SMALL_CORES;
+}
+
+esp_err_t core_stats_init(CoreStatsModule * module, int asic_count, int core_count)
+{
+    module->asic_count = asic_count;
+    module->core_count = core_count < CORE_STATS_MAX_CORES ? core_count : CORE_STATS_MAX_CORES;
+    module->window_start_us = 0;
+
+    module->cells = heap_caps_calloc(cell_count(module), sizeof(core_stats_cell_t), MALLOC_CAP_SPIRAM);
+    if (module->cells == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %u core counters", (unsigned)cell_count(module));
+        return ESP_ERR_NO_MEM;
+    }
+
+    module->mutex = xSemaphoreCreateMutex();
+    if (module->mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create mutex");
+        heap_caps_free(module->cells);
+        module->cells = NULL;
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+void core_stats_reset(CoreStatsModule * module)
+{
+    if (module->mutex == NULL) return;
+
+    xSemaphoreTake(module->mutex, portMAX_DELAY);
+    memset(module->cells, 0, cell_count(module) * sizeof(core_stats_cell_t));
+    module->window_start_us = 0;
+    xSemaphoreGive(module->mutex);
+}
+
+core_stats_cell_t * core_stats_cell(CoreStatsModule * module, int asic_nr, int core_id, int small_core_id)
+{
+    return &module->cells[((size_t)asic_nr * module->core_count + core_id) * CORE_STATS_SMALL_CORES + small_core_id];
+}
+
+void core_stats_copy_asic(CoreStatsModule * module, int asic_nr, core_stats_cell_t * cells)
+{
+    xSemaphoreTake(module->mutex, portMAX_DELAY);
+    memcpy(cells, core_stats_cell(module, asic_nr, 0, 0), (size_t)module->core_count * CORE_STATS_SMALL_CORES * sizeof(core_stats_cell_t));
+    xSemaphoreGive(module->mutex);
+}
+
+void core_stats_record(CoreStatsModule * module, uint8_t asic_nr, uint8_t core_id, uint8_t small_core_id, bool valid)
+{
+    if (module->mutex == NULL) return;
+
+    // a corrupted result can carry any ids, keep those out of the matrix
+    if (asic_nr >= module->asic_count || core_id >= module->core_count || small_core_id >= CORE_STATS_SMALL_CORES) {
+        ESP_LOGD(TAG, "Result outside the core map: asic %d core %d/%d", asic_nr, core_id, small_core_id);
+        return;
+    }
+
+    xSemaphoreTake(module->mutex, portMAX_DELAY);
+    core_stats_cell_t * cell = core_stats_cell(module, asic_nr, core_id, small_core_id);
+    if (valid) {
+        cell->nonces++;
+        cell->window++;
+    } else {
+        cell->invalid++;
+        cell->invalid_window++;
+    }
+    xSemaphoreGive(module->mutex);
+}
+
+void core_stats_tick(CoreStatsModule * module, int64_t now_us)
+{
+    if (module->mutex == NULL) return;
+
+    xSemaphoreTake(module->mutex, portMAX_DELAY);
+
+    if (module->window_start_us == 0) {
+        module->window_start_us = now_us;
+    } else if (now_us - module->window_start_us >= CORE_STATS_WINDOW_S * 1000000LL) {
+        // fold the window into the decayed rate as if it lasted exactly one period,
+        // a late tick only stretches it by a poll interval
+        const float alpha = 1.0f - expf(-1.0f / CORE_STATS_RATE_TAU_WINDOWS);
+        const float per_hour = 3600.0f / CORE_STATS_WINDOW_S;
+
+        size_t count = cell_count(module);
+        for (size_t i = 0; i < count; i++) {
+            core_stats_cell_t * cell = &module->cells[i];
+            cell->rate += alpha * (cell->window * per_hour - cell->rate);
+            cell->invalid_rate += alpha * (cell->invalid_window * per_hour - cell->invalid_rate);
+            cell->window = 0;
+            cell->invalid_window = 0;
+        }
+        module->window_start_us = now_us;
+    }
+
+    xSemaphoreGive(module->mutex);
+}
+
+// A decayed rate per hour as the nonces it weighs, about those of the last time constant
+static float recent_count(float rate)
+{
+    return rate * (CORE_STATS_RATE_TAU_WINDOWS * CORE_STATS_WINDOW_S / 3600.0f);
+}
+
+core_status_t core_stats_classify(float rate, float invalid_rate, float expected_rate)
+{
+    float nonces = recent_count(rate);
+    float invalid = recent_count(invalid_rate);
+    float expected = recent_count(expected_rate);
+
+    if (invalid >= CORE_STATS_INVALID_MIN && invalid > nonces) {
+        return CORE_STATUS_INVALID;
+    }
+
+    if (expected < CORE_STATS_DEAD_EXPECTED) {
+        return CORE_STATUS_UNKNOWN;
+    }
+
+    if (nonces < CORE_STATS_DEAD_COUNT) {
+        return CORE_STATUS_DEAD;
+    }
+
+    // Poisson: the standard deviation of a plain count is sqrt(expected), the
+    // decayed count spreads less so this errs on the side of ok
+    if (nonces < expected * CORE_STATS_WEAK_FRACTION &&
+        expected - nonces >= CORE_STATS_WEAK_SIGMAS * sqrtf(expected)) {
+        return CORE_STATUS_WEAK;
+    }
+
+    return CORE_STATUS_OK;
+}
+
+const char * core_stats_status_name(core_status_t status)
+{
+    switch (status) {
+        case CORE_STATUS_OK:      return "ok";
+        case CORE_STATUS_DEAD:    return "dead";
+        case CORE_STATUS_WEAK:    return "weak";
+        case CORE_STATUS_INVALID: return "invalid";
+        default:                  return "unknown";
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef CORE_STATS_H_
+#define CORE_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+
+#define CORE_STATS_MAX_CORES 128      // core id is 7 bits in the nonce
+#define CORE_STATS_SMALL_CORES 16     // small core id is 4 bits in the result id
+#define CORE_STATS_WINDOW_S 60
+#define CORE_STATS_RATE_TAU_WINDOWS 10 // decayed rates follow roughly the last 10 minutes
+
+// Cores are judged on their decayed rates, taken as counts over the rate time
+// constant, so a core that stops working shows up within a few time constants
+// however long it ran before.
+// A core below one recent nonce while its share of the chip says it should have
+// this many is reported dead. The decayed count of a working core has about half
+// the variance of a plain count, P(< 1) ~ e^-15 * 16 here.
+#define CORE_STATS_DEAD_EXPECTED 24.0f
+#define CORE_STATS_DEAD_COUNT 1.0f
+// weak: under a quarter of the expected share and at least this many sigmas low
+#define CORE_STATS_WEAK_FRACTION 0.25f
+#define CORE_STATS_WEAK_SIGMAS 4.0f
+// mostly invalid: more recent nonces failing the ticket mask than passing it
+#define CORE_STATS_INVALID_MIN 8.0f
+
+typedef enum
+{
+    CORE_STATUS_OK,
+    CORE_STATUS_UNKNOWN, // not enough nonces on the chip yet to judge
+    CORE_STATUS_DEAD,
+    CORE_STATUS_WEAK,
+    CORE_STATUS_INVALID,
+} core_status_t;
+
+typedef struct
+{
+    uint32_t nonces;         // nonces meeting the ticket mask, since boot
+    uint32_t invalid;        // nonces failing the ticket mask (hardware errors), since boot
+    uint32_t window;         // valid nonces since the last decay step
+    uint32_t invalid_window; // invalid nonces since the last decay step
+    float rate;              // decayed valid nonces per hour
+    float invalid_rate;      // decayed invalid nonces per hour
+} core_stats_cell_t;
+
+typedef struct
+{
+    // [asic][core][small core], in PSRAM
+    core_stats_cell_t * cells;
+    int asic_count;
+    int core_count;
+    int64_t window_start_us;
+    SemaphoreHandle_t mutex;
+} CoreStatsModule;
+
+esp_err_t core_stats_init(CoreStatsModule * module, int asic_count, int core_count);
+void core_stats_reset(CoreStatsModule * module);
+void core_stats_record(CoreStatsModule * module, uint8_t asic_nr, uint8_t core_id, uint8_t small_core_id, bool valid);
+void core_stats_tick(CoreStatsModule * module, int64_t now_us);
+
+// Caller holds module->mutex
+core_stats_cell_t * core_stats_cell(CoreStatsModule * module, int asic_nr, int core_id, int small_core_id);
+
+// Copies the cells of one chip, core_count * CORE_STATS_SMALL_CORES of them, so
+// readers do not keep the result task waiting on the mutex
+void core_stats_copy_asic(CoreStatsModule * module, int asic_nr, core_stats_cell_t * cells);
+
+// Decayed rates per hour; expected is the core's share of its chip's valid rate
+core_status_t core_stats_classify(float rate, float invalid_rate, float expected_rate);
+const char * core_stats_status_name(core_status_t status);
+
+#endif /* CORE_STATS_H_ */
@@ -10,6 +10,7 @@
 #include "esp_timer.h"
 
 #include "asic.h"
+#include "asic_common.h"
 #include "system.h"
 #include "esp_heap_caps.h"
 #include "sv2_protocol.h"
@@ -45,10 +46,10 @@ void create_jobs_task(void *pvParameters)
 {
     GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
 
-    // Initialize ASIC task module (moved from ASIC_task)
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs = heap_caps_malloc(sizeof(bm_job *) * 128, MALLOC_CAP_SPIRAM);
-    GLOBAL_STATE->valid_jobs = heap_caps_malloc(sizeof(uint8_t) * 128, MALLOC_CAP_SPIRAM);
-    for (int i = 0; i < 128; i++) {
+    // Initialize ASIC task module (moved from ASIC_task), a job id space per chain
+    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs = heap_caps_malloc(sizeof(bm_job *) * ASIC_JOB_IDS * ASIC_CHAIN_COUNT, MALLOC_CAP_SPIRAM);
+    GLOBAL_STATE->valid_jobs = heap_caps_malloc(sizeof(uint8_t) * ASIC_JOB_IDS * ASIC_CHAIN_COUNT, MALLOC_CAP_SPIRAM);
+    for (int i = 0; i < ASIC_JOB_IDS * ASIC_CHAIN_COUNT; i++) {
         GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[i] = NULL;
         GLOBAL_STATE->valid_jobs[i] = 0;
     }
@@ -159,9 +160,16 @@ void create_jobs_task(void *pvParameters)
             // SV2 standard channel: the ASIC has enough nonce+version space
             // (2^32 nonces x version rolls) to keep mining without re-feeding.
             // Re-sending the same job restarts the nonce search from 0 and
-            // produces duplicate shares. Only send work on new jobs.
+            // produces duplicate shares. Only send work on new jobs; with
+            // several standard channels each job interval switches to the
+            // next channel's job, with ntime rolled so it is fresh work again.
             // (V1 and SV2 extended are fine — extranonce_2 gives unique work each time.)
             if (active_protocol == STRATUM_PROTOCOL_V2 && !stratum_v2_is_extended_channel(GLOBAL_STATE)) {
+                sv2_job_t channel_job;
+                double channel_difficulty;
+                if (stratum_v2_next_channel_job(GLOBAL_STATE, &channel_job, &channel_difficulty)) {
+                    generate_work_sv2(GLOBAL_STATE, &channel_job, channel_difficulty);
+                }
                 timeout_ms = ASIC_get_asic_job_frequency_ms(GLOBAL_STATE);
                 continue;
             }
@@ -178,17 +186,26 @@ void create_jobs_task(void *pvParameters)
             continue;
         }
 
-        // Generate and send job
-        if (active_protocol == STRATUM_PROTOCOL_V2) {
-            if (stratum_v2_is_extended_channel(GLOBAL_STATE)) {
-                generate_work_sv2_ext(GLOBAL_STATE, (sv2_ext_job_t *)current_work, difficulty, extranonce_2);
-                extranonce_2++;
+        // Generate and send job. ASIC_send_work() deals jobs out to the chains
+        // in turn, so fresh work goes out once per chain to get every chain off
+        // the old job right away.
+        int jobs = new_work != NULL ? ASIC_CHAIN_COUNT : 1;
+        for (int i = 0; i < jobs; i++) {
+            if (active_protocol == STRATUM_PROTOCOL_V2) {
+                if (stratum_v2_is_extended_channel(GLOBAL_STATE)) {
+                    generate_work_sv2_ext(GLOBAL_STATE, (sv2_ext_job_t *)current_work, difficulty, extranonce_2);
+                    extranonce_2++;
+                } else {
+                    // a standard channel job has no extranonce2, each chain gets
+                    // ntime a second further so no two search the same header
+                    sv2_job_t chain_job = *(sv2_job_t *)current_work;
+                    chain_job.ntime += i;
+                    generate_work_sv2(GLOBAL_STATE, &chain_job, difficulty);
+                }
             } else {
-                generate_work_sv2(GLOBAL_STATE, (sv2_job_t *)current_work, difficulty);
+                generate_work(GLOBAL_STATE, (mining_notify *)current_work, extranonce_2, difficulty);
+                extranonce_2++;
             }
-        } else {
-            generate_work(GLOBAL_STATE, (mining_notify *)current_work, extranonce_2, difficulty);
-            extranonce_2++;
         }
         timeout_ms = ASIC_get_asic_job_frequency_ms(GLOBAL_STATE);
     }
@@ -298,6 +315,7 @@ static void generate_work_sv2(GlobalState *GLOBAL_STATE, sv2_job_t *sv2_job, dou
     next_job->jobid = strdup(jobid_str);
     next_job->extranonce2 = strdup(""); // unused in SV2 standard
     next_job->version_mask = version_mask;
+    next_job->sv2_channel_id = sv2_job->channel_id;
 
     if (!GLOBAL_STATE->ASIC_initalized) {
         ESP_LOGW(TAG, "ASIC not initialized, skipping SV2 job send");
@@ -87,14 +87,21 @@ void FAN_CONTROLLER_task(void * pvParameters)
                     pid_set_output_limits(&pid, pid_output_min, 100);
                 }
 
+                float raw_temp = -1;
                 if (power_management->chip_temp_avg > 0) { // Ignore uninitialized or invalid temperature readings
-                    float raw_temp;
                     if (power_management->chip_temp2_avg > power_management->chip_temp_avg) {
                         raw_temp = power_management->chip_temp2_avg;
                     } else {
                         raw_temp = power_management->chip_temp_avg;
                     }
-                    
+                } else if (power_management->chip_temp_max > 0) {
+                    // no board sensor on the chips, the hottest on-die reading stands in
+                    // against a setpoint raised by how much hotter the junction runs
+                    raw_temp = power_management->chip_temp_max;
+                    pid_setPoint += DIE_TEMP_OFFSET;
+                }
+
+                if (raw_temp > 0) {
                     // Simple EMA filter to reduce jitter from sensor noise
                     // alpha = 0.2 means 20% new value, 80% old value
                     if (filtered_input < 0) {
@@ -0,0 +1,127 @@
+#include <math.h>
+#include <string.h>
+#include "hashrate_estimator.h"
+
+#define HASHES_PER_DIFF 4294967296.0 // 2^32, hashes per difficulty 1 nonce
+
+static const float HORIZONS_S[HASHRATE_ESTIMATOR_HORIZONS] = {60, 600, 3600};
+
+void hashrate_estimator_init(hashrate_estimator_t * estimator)
+{
+    memset(estimator, 0, sizeof(*estimator));
+    for (int horizon = 0; horizon < HASHRATE_ESTIMATOR_HORIZONS; horizon++) {
+        estimator->horizons[horizon].tau_s = HORIZONS_S[horizon];
+    }
+}
+
+void hashrate_estimator_add_nonce(hashrate_estimator_t * estimator, double difficulty)
+{
+    estimator->pending_diff += difficulty;
+    estimator->pending_diff2 += difficulty * difficulty;
+}
+
+void hashrate_estimator_pause(hashrate_estimator_t * estimator)
+{
+    estimator->last_tick_us = 0;
+    estimator->pending_diff = 0;
+    estimator->pending_diff2 = 0;
+}
+
+void hashrate_estimator_tick(hashrate_estimator_t * estimator, float register_hashrate, int64_t now_us)
+{
+    int64_t last_tick_us = estimator->last_tick_us;
+    estimator->last_tick_us = now_us;
+
+    double dt_s = (now_us - last_tick_us) / 1e6;
+    if (last_tick_us == 0 || dt_s > HASHRATE_ESTIMATOR_MAX_GAP_S) {
+        // nonces found before the first tick have no time to go with them
+        estimator->pending_diff = 0;
+        estimator->pending_diff2 = 0;
+        return;
+    }
+    if (dt_s <= 0) return;
+
+    double x = register_hashrate;
+    for (int horizon = 0; horizon < HASHRATE_ESTIMATOR_HORIZONS; horizon++) {
+        hashrate_horizon_t * h = &estimator->horizons[horizon];
+        double decay = exp(-dt_s / h->tau_s);
+
+        h->reg_w = h->reg_w * decay + 1;
+        h->reg_w2 = h->reg_w2 * decay * decay + 1;
+        h->reg_wx = h->reg_wx * decay + x;
+        h->reg_wxx = h->reg_wxx * decay + x * x;
+
+        h->share_diff = h->share_diff * decay + estimator->pending_diff;
+        h->share_diff2 = h->share_diff2 * decay * decay + estimator->pending_diff2;
+        h->share_time_s = h->share_time_s * decay + dt_s;
+    }
+
+    estimator->pending_diff = 0;
+    estimator->pending_diff2 = 0;
+}
+
+float hashrate_estimator_horizon_s(int horizon)
+{
+    return HORIZONS_S[horizon];
+}
+
+// effective number of register readings behind the weighted mean
+static double register_samples(const hashrate_horizon_t * h)
+{
+    return h->reg_w2 > 0 ? h->reg_w * h->reg_w / h->reg_w2 : 0;
+}
+
+// effective number of nonces behind the share estimate
+static double share_nonces(const hashrate_horizon_t * h)
+{
+    return h->share_diff2 > 0 ? h->share_diff * h->share_diff / h->share_diff2 : 0;
+}
+
+hashrate_estimate_t hashrate_estimator_registers(const hashrate_estimator_t * estimator, int horizon)
+{
+    const hashrate_horizon_t * h = &estimator->horizons[horizon];
+    hashrate_estimate_t estimate = {0};
+
+    if (h->reg_w <= 0) return estimate;
+
+    double mean = h->reg_wx / h->reg_w;
+    double variance = fmax(0, h->reg_wxx / h->reg_w - mean * mean);
+
+    estimate.value = mean;
+    estimate.error = HASHRATE_ESTIMATOR_Z * sqrt(variance / register_samples(h));
+    return estimate;
+}
+
+hashrate_estimate_t hashrate_estimator_shares(const hashrate_estimator_t * estimator, int horizon)
+{
+    const hashrate_horizon_t * h = &estimator->horizons[horizon];
+    hashrate_estimate_t estimate = {0};
+
+    if (h->share_time_s <= 0) return estimate;
+
+    // the nonce count is Poisson, its variance is the sum of the squared weights
+    double scale = HASHES_PER_DIFF / h->share_time_s / 1e9;
+    estimate.value = h->share_diff * scale;
+    estimate.error = HASHRATE_ESTIMATOR_Z * sqrt(h->share_diff2) * scale;
+    return estimate;
+}
+
+float hashrate_estimator_divergence(const hashrate_estimator_t * estimator, int horizon)
+{
+    const hashrate_horizon_t * h = &estimator->horizons[horizon];
+
+    if (register_samples(h) < 2 || share_nonces(h) < HASHRATE_ESTIMATOR_MIN_NONCES) return 0;
+
+    hashrate_estimate_t registers = hashrate_estimator_registers(estimator, horizon);
+    hashrate_estimate_t shares = hashrate_estimator_shares(estimator, horizon);
+
+    double sigma = hypot(registers.error, shares.error) / HASHRATE_ESTIMATOR_Z;
+    if (sigma <= 0) return 0;
+
+    return (shares.value - registers.value) / sigma;
+}
+
+bool hashrate_estimator_is_divergent(const hashrate_estimator_t * estimator)
+{
+    return fabsf(hashrate_estimator_divergence(estimator, HASHRATE_ESTIMATOR_HEALTH_HORIZON)) > HASHRATE_ESTIMATOR_DIVERGENCE_SIGMAS;
+}
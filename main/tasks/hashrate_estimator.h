@@ -0,0 +1,67 @@
+#ifndef HASHRATE_ESTIMATOR_H_
+#define HASHRATE_ESTIMATOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HASHRATE_ESTIMATOR_HORIZONS 3             // 1m, 10m, 1h
+#define HASHRATE_ESTIMATOR_HEALTH_HORIZON 1       // the 10m horizon judges divergence
+#define HASHRATE_ESTIMATOR_Z 1.96                 // error bars are 95% intervals
+#define HASHRATE_ESTIMATOR_DIVERGENCE_SIGMAS 4.0f // sources further apart than this are reported divergent
+#define HASHRATE_ESTIMATOR_MIN_NONCES 30.0        // effective nonces before the share estimate is trusted
+#define HASHRATE_ESTIMATOR_MAX_GAP_S 10.0         // a longer gap between ticks means the ASICs were stopped
+
+typedef struct
+{
+    float value; // Gh/s
+    float error; // half width of the 95% interval, Gh/s, 0 while unknown
+} hashrate_estimate_t;
+
+// Exponentially decayed sums of one horizon. Every sample's weight decays by
+// e^(-dt/tau) per tick, the squared weights are kept for the effective sample count.
+typedef struct
+{
+    double tau_s;
+
+    // register counters: weighted mean and variance of the per-poll hashrate
+    double reg_w;
+    double reg_w2;
+    double reg_wx;
+    double reg_wxx;
+
+    // shares: ASIC difficulty of the nonces found, its square per nonce, and the time they took
+    double share_diff;
+    double share_diff2;
+    double share_time_s;
+} hashrate_horizon_t;
+
+// Combines the hashrate the chips count in their registers with the hashrate
+// the nonces they return prove: every nonce at difficulty D stands for D * 2^32
+// hashes, a Poisson count whose spread gives the error bars.
+typedef struct
+{
+    hashrate_horizon_t horizons[HASHRATE_ESTIMATOR_HORIZONS];
+    double pending_diff;  // nonces since the last tick
+    double pending_diff2;
+    int64_t last_tick_us; // 0 while stopped
+} hashrate_estimator_t;
+
+void hashrate_estimator_init(hashrate_estimator_t * estimator);
+void hashrate_estimator_add_nonce(hashrate_estimator_t * estimator, double difficulty);
+
+// Called once per poll while the ASICs hash, register_hashrate in Gh/s
+void hashrate_estimator_tick(hashrate_estimator_t * estimator, float register_hashrate, int64_t now_us);
+
+// Drops the running tick so the time the ASICs stand still is not counted
+void hashrate_estimator_pause(hashrate_estimator_t * estimator);
+
+float hashrate_estimator_horizon_s(int horizon);
+hashrate_estimate_t hashrate_estimator_registers(const hashrate_estimator_t * estimator, int horizon);
+hashrate_estimate_t hashrate_estimator_shares(const hashrate_estimator_t * estimator, int horizon);
+
+// Signed distance of the share estimate from the register estimate in combined
+// standard deviations, 0 while either source lacks data
+float hashrate_estimator_divergence(const hashrate_estimator_t * estimator, int horizon);
+bool hashrate_estimator_is_divergent(const hashrate_estimator_t * estimator);
+
+#endif /* HASHRATE_ESTIMATOR_H_ */
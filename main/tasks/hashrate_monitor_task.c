@@ -3,6 +3,7 @@
 #include <esp_heap_caps.h>
 #include <math.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "global_state.h"
 #include "system.h"
 #include "asic_common.h"
@@ -12,6 +13,9 @@
 #define EPSILON 0.0001f
 
 #define HASHRATE_UNIT 0x100000uLL // Hashrate register unit (2^20 hashes)
+// Counter reads ride behind job packets, so reads scheduled a second apart
+// arrive with some jitter; only real bursts come in closer than this
+#define HASH_COUNTER_MIN_INTERVAL_US 900000
 
 #define POLL_RATE 1000
 #define HASHRATE_1M_SIZE (60000 / POLL_RATE)  // 12
@@ -56,6 +60,9 @@ void hashrate_monitor_reset_measurements(void *pvParameters)
     memset(HASHRATE_MONITOR_MODULE->total_measurement, 0, asic_count * sizeof(measurement_t));
     memset(HASHRATE_MONITOR_MODULE->domain_measurements[0], 0, asic_count * hash_domains * sizeof(measurement_t));
     memset(HASHRATE_MONITOR_MODULE->error_measurement, 0, asic_count * sizeof(measurement_t));
+    memset(HASHRATE_MONITOR_MODULE->chain_hashrate, 0, sizeof(HASHRATE_MONITOR_MODULE->chain_hashrate));
+    // the counters start over, the estimates carry on from the next poll
+    hashrate_estimator_pause(&HASHRATE_MONITOR_MODULE->estimator);
     pthread_mutex_unlock(&HASHRATE_MONITOR_MODULE->lock);
 }
 
@@ -75,7 +82,7 @@ void update_hash_counter(measurement_t * measurement, uint32_t value, uint64_t t
     uint64_t previous_time_us = measurement->time_us;
     if (previous_time_us != 0) {
         uint64_t duration_us = time_us - previous_time_us;
-        if (duration_us < 1000000) {
+        if (duration_us < HASH_COUNTER_MIN_INTERVAL_US) {
             // Ignore updates that are too close (e.g. rapid bursts) to avoid huge hashrate spikes
             return;
         }
@@ -141,6 +148,26 @@ static void update_hashrate_averages(SystemModule * SYSTEM_MODULE)
     poll_count++;
 }
 
+// Caller holds the module lock
+static void update_divergence(HashrateMonitorModule * HASHRATE_MONITOR_MODULE)
+{
+    hashrate_estimator_t * estimator = &HASHRATE_MONITOR_MODULE->estimator;
+    bool divergent = hashrate_estimator_is_divergent(estimator);
+    if (divergent == HASHRATE_MONITOR_MODULE->divergent) return;
+
+    HASHRATE_MONITOR_MODULE->divergent = divergent;
+
+    int horizon = HASHRATE_ESTIMATOR_HEALTH_HORIZON;
+    hashrate_estimate_t registers = hashrate_estimator_registers(estimator, horizon);
+    hashrate_estimate_t shares = hashrate_estimator_shares(estimator, horizon);
+    if (divergent) {
+        ESP_LOGW(TAG, "Share hashrate %.1f +/- %.1f Gh/s diverges from the registers' %.1f +/- %.1f Gh/s (%.1f sigma)",
+                 shares.value, shares.error, registers.value, registers.error, hashrate_estimator_divergence(estimator, horizon));
+    } else {
+        ESP_LOGI(TAG, "Share and register hashrate agree again");
+    }
+}
+
 void hashrate_monitor_task(void *pvParameters)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *)pvParameters;
@@ -158,6 +185,8 @@ void hashrate_monitor_task(void *pvParameters)
     }
     HASHRATE_MONITOR_MODULE->error_measurement = heap_caps_malloc(asic_count * sizeof(measurement_t), MALLOC_CAP_SPIRAM);
 
+    hashrate_estimator_init(&HASHRATE_MONITOR_MODULE->estimator);
+
     pthread_mutex_init(&HASHRATE_MONITOR_MODULE->lock, NULL);
     HASHRATE_MONITOR_MODULE->is_initialized = true;
 
@@ -180,18 +209,31 @@ void hashrate_monitor_task(void *pvParameters)
         was_asic_initialized = is_asic_initialized;
 
         if (is_asic_initialized) {
+            // the counters are polled behind the job packets, this only catches up when no jobs go out
             ASIC_read_registers(GLOBAL_STATE);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+            ASIC_check_baud(GLOBAL_STATE);
 
             pthread_mutex_lock(&HASHRATE_MONITOR_MODULE->lock);
             float current_hashrate = sum_hashrates(HASHRATE_MONITOR_MODULE->total_measurement, asic_count);
             float error_hashrate = sum_hashrates(HASHRATE_MONITOR_MODULE->error_measurement, asic_count);
+            int chain_asic_count = asic_count / ASIC_CHAIN_COUNT;
+            for (int chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+                HASHRATE_MONITOR_MODULE->chain_hashrate[chain] =
+                    sum_hashrates(HASHRATE_MONITOR_MODULE->total_measurement + chain * chain_asic_count, chain_asic_count);
+            }
+            if (current_hashrate > 0.0f) {
+                hashrate_estimator_tick(&HASHRATE_MONITOR_MODULE->estimator, current_hashrate, esp_timer_get_time());
+            }
+            update_divergence(HASHRATE_MONITOR_MODULE);
             pthread_mutex_unlock(&HASHRATE_MONITOR_MODULE->lock);
 
             SYSTEM_MODULE->current_hashrate = current_hashrate;
             SYSTEM_MODULE->error_percentage = current_hashrate > 0 ? error_hashrate / current_hashrate * 100.f : 0;
 
             if (current_hashrate > 0.0f) update_hashrate_averages(SYSTEM_MODULE);
+
+            core_stats_tick(&GLOBAL_STATE->CORE_STATS_MODULE, esp_timer_get_time());
+            chip_tuner_tick(GLOBAL_STATE);
         } else {
             SYSTEM_MODULE->current_hashrate = 0;
         }
@@ -202,6 +244,20 @@ void hashrate_monitor_task(void *pvParameters)
     }
 }
 
+void hashrate_monitor_nonce(void *pvParameters, double difficulty)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *)pvParameters;
+    HashrateMonitorModule * HASHRATE_MONITOR_MODULE = &GLOBAL_STATE->HASHRATE_MONITOR_MODULE;
+
+    if (!HASHRATE_MONITOR_MODULE->is_initialized) {
+        return;
+    }
+
+    pthread_mutex_lock(&HASHRATE_MONITOR_MODULE->lock);
+    hashrate_estimator_add_nonce(&HASHRATE_MONITOR_MODULE->estimator, difficulty);
+    pthread_mutex_unlock(&HASHRATE_MONITOR_MODULE->lock);
+}
+
 void hashrate_monitor_register_read(void *pvParameters, register_type_t register_type, uint8_t asic_nr, uint32_t value, uint64_t timestamp_us)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *)pvParameters;
@@ -242,6 +298,13 @@ void hashrate_monitor_register_read(void *pvParameters, register_type_t register
         case REGISTER_PLL_PARAM:
             ESP_LOGD(TAG, "PLL param read asic %d: 0x%08" PRIX32, asic_nr, value);
             break;
+        case REGISTER_TEMPERATURE: {
+            float temp_c;
+            if (asic_decode_temperature(value, &temp_c)) {
+                POWER_MANAGEMENT_set_chip_temp(&GLOBAL_STATE->POWER_MANAGEMENT_MODULE, asic_nr, temp_c);
+            }
+            break;
+        }
         case REGISTER_INVALID:
             ESP_LOGE(TAG, "Invalid register type");
             break;
@@ -249,13 +312,3 @@ void hashrate_monitor_register_read(void *pvParameters, register_type_t register
 
     pthread_mutex_unlock(&HASHRATE_MONITOR_MODULE->lock);
 }
-
-/*
-    // From NerdAxe codebase, temparature conversion?
-    if (asic_result.data & 0x80000000) {
-        float ftemp = (float) (asic_result.data & 0x0000ffff) * 0.171342f - 299.5144f;
-        ESP_LOGI(TAG, "asic %d temp: %.3f", (int) asic_result.asic_nr, ftemp);
-        board->setChipTemp(asic_result.asic_nr, ftemp);
-    }
-    break;
-*/
@@ -2,6 +2,7 @@
 #define HASHRATE_MONITOR_TASK_H_
 
 #include "asic_common.h"
+#include "hashrate_estimator.h"
 #include <pthread.h>
 
 typedef struct {
@@ -14,6 +15,9 @@ typedef struct {
     measurement_t* total_measurement;
     measurement_t** domain_measurements;
     measurement_t* error_measurement;
+    float chain_hashrate[ASIC_CHAIN_COUNT];
+    hashrate_estimator_t estimator;
+    bool divergent;      // register and share hashrate disagree beyond their error bars
 
     pthread_mutex_t lock;
     bool is_initialized;
@@ -22,6 +26,7 @@ typedef struct {
 void hashrate_monitor_task(void *pvParameters);
 void hashrate_monitor_register_read(void *pvParameters, register_type_t register_type, uint8_t asic_nr, uint32_t value, uint64_t timestamp_us);
 void hashrate_monitor_reset_measurements(void *pvParameters);
+void hashrate_monitor_nonce(void *pvParameters, double difficulty);
 
 void update_hashrate(measurement_t * measurement, uint32_t value);
 void update_hash_counter(measurement_t * measurement, uint32_t value, uint64_t time_us);
@@ -1,4 +1,8 @@
+#include <math.h>
+#include <stdlib.h>
+
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "global_state.h"
@@ -10,11 +14,18 @@
 #include "utils.h"
 #include "asic_init.h"
 #include "asic_reset.h"
-#include "driver/uart.h"
+#include "asic_common.h"
+#include "serial.h"
 
 #define POLL_RATE 100
 #define MAX_TEMP 90.0
 #define THROTTLE_TEMP 75.0
+#define DIE_THROTTLE_TEMP (THROTTLE_TEMP + DIE_TEMP_OFFSET) // step the frequency down above this
+#define DIE_RECOVER_TEMP (DIE_THROTTLE_TEMP - 8.0)            // and back up below this
+#define DIE_MAX_TEMP (DIE_THROTTLE_TEMP + 10.0)               // safe mode, throttling did not hold it
+#define DIE_TEMP_HOLD_MS 15000 // a reading has to last this long, the sensors are noisy
+#define DIE_THROTTLE_STEP 25.0
+#define DIE_THROTTLE_MIN_FREQUENCY 200.0
 #define SAFE_TEMP 45.0
 
 #define VOLTAGE_START_THROTTLE 4900
@@ -28,6 +39,23 @@
 
 static const char * TAG = "power_management";
 
+static void clear_chip_temps(PowerManagementModule * power_management)
+{
+    for (int asic_nr = 0; asic_nr < power_management->chip_temp_count; asic_nr++) {
+        power_management->chip_temps[asic_nr] = -1;
+    }
+    power_management->chip_temp_max = -1;
+}
+
+static float max_chip_temp(PowerManagementModule * power_management)
+{
+    float max = -1;
+    for (int asic_nr = 0; asic_nr < power_management->chip_temp_count; asic_nr++) {
+        max = fmaxf(max, power_management->chip_temps[asic_nr]);
+    }
+    return max;
+}
+
 static void mining_stop(GlobalState * GLOBAL_STATE)
 {
     ESP_LOGI(TAG, "Stopping mining");
@@ -39,7 +67,7 @@ static void mining_stop(GlobalState * GLOBAL_STATE)
     GLOBAL_STATE->POWER_MANAGEMENT_MODULE.expected_hashrate = 0;
 
     ASIC_set_frequency(GLOBAL_STATE);
-    ASIC_set_nonce_space(GLOBAL_STATE);
+    ASIC_wait_frequency(GLOBAL_STATE);
 
     // Cut ASIC power and hold in reset
     VCORE_set_voltage(GLOBAL_STATE, 0.0f);
@@ -47,12 +75,15 @@ static void mining_stop(GlobalState * GLOBAL_STATE)
 
     // Mark uninitialized immediately so tasks stop issuing UART commands
     GLOBAL_STATE->ASIC_initalized = false;
+    clear_chip_temps(&GLOBAL_STATE->POWER_MANAGEMENT_MODULE);
 
     // Give tasks time to complete any in-progress UART operation
     vTaskDelay(500 / portTICK_PERIOD_MS);
 
     // Flush any stale data from the UART buffers
-    uart_flush(UART_NUM_1);
+    for (uint8_t chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        SERIAL_clear_buffer(chain);
+    }
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
     ESP_LOGI(TAG, "Mining stopped");
@@ -70,7 +101,9 @@ static uint8_t mining_start(GlobalState * GLOBAL_STATE)
     vTaskDelay(500 / portTICK_PERIOD_MS);
 
     // Clear any accumulated UART garbage before init
-    uart_flush(UART_NUM_1);
+    for (uint8_t chain = 0; chain < ASIC_CHAIN_COUNT; chain++) {
+        SERIAL_clear_buffer(chain);
+    }
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
     POWER_MANAGEMENT_init_frequency(GLOBAL_STATE);
@@ -92,6 +125,29 @@ static float expected_hashrate(GlobalState * GLOBAL_STATE)
     return GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value * GLOBAL_STATE->DEVICE_CONFIG.family.asic.small_core_count * GLOBAL_STATE->DEVICE_CONFIG.family.asic_count / 1000.0;
 }
 
+static void set_frequency(GlobalState * GLOBAL_STATE, float frequency)
+{
+    GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value = frequency;
+    GLOBAL_STATE->POWER_MANAGEMENT_MODULE.expected_hashrate = expected_hashrate(GLOBAL_STATE);
+
+    // retargets a ramp that is still running, the nonce space follows once it lands
+    ASIC_set_frequency(GLOBAL_STATE);
+}
+
+// True once condition has held for DIE_TEMP_HOLD_MS, then times the next hold
+static bool held(int64_t * since_ms, bool condition, int64_t now_ms)
+{
+    if (!condition) {
+        *since_ms = -1;
+        return false;
+    }
+    if (*since_ms < 0) *since_ms = now_ms;
+    if (now_ms - *since_ms < DIE_TEMP_HOLD_MS) return false;
+
+    *since_ms = now_ms;
+    return true;
+}
+
 void POWER_MANAGEMENT_init_frequency(GlobalState * GLOBAL_STATE)
 {
     float frequency = nvs_config_get_float(NVS_CONFIG_ASIC_FREQUENCY);
@@ -105,6 +161,26 @@ void POWER_MANAGEMENT_init_frequency(GlobalState * GLOBAL_STATE)
     ESP_LOGI(TAG, "ASIC Frequency: %g MHz, Expected hashrate: %sH/s", frequency, expected_hashrate_str);
 }
 
+esp_err_t POWER_MANAGEMENT_init_chip_temps(PowerManagementModule * power_management, int asic_count)
+{
+    power_management->chip_temps = malloc(asic_count * sizeof(float));
+    if (power_management->chip_temps == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %d chip temperatures", asic_count);
+        return ESP_ERR_NO_MEM;
+    }
+    power_management->chip_temp_count = asic_count;
+    clear_chip_temps(power_management);
+
+    return ESP_OK;
+}
+
+void POWER_MANAGEMENT_set_chip_temp(PowerManagementModule * power_management, int asic_nr, float temp_c)
+{
+    if (asic_nr >= power_management->chip_temp_count) return;
+
+    power_management->chip_temps[asic_nr] = temp_c;
+}
+
 void POWER_MANAGEMENT_task(void * pvParameters)
 {
     ESP_LOGI(TAG, "Starting");
@@ -125,6 +201,11 @@ void POWER_MANAGEMENT_task(void * pvParameters)
     float last_known_asic_frequency = 0.0;
     bool is_paused = false;
 
+    float die_throttle = 0; // MHz below the requested frequency while the dies run hot
+    int64_t die_hot_since = -1;
+    int64_t die_cool_since = -1;
+    int64_t die_max_since = -1;
+
     while (1) {
         if (GLOBAL_STATE->SELF_TEST_MODULE.is_finished) {
             ESP_LOGI(TAG, "Stopped");
@@ -138,6 +219,7 @@ void POWER_MANAGEMENT_task(void * pvParameters)
 
         power_management->chip_temp_avg = Thermal_get_chip_temp(GLOBAL_STATE);
         power_management->chip_temp2_avg = Thermal_get_chip_temp2(GLOBAL_STATE);
+        power_management->chip_temp_max = max_chip_temp(power_management);
 
         power_management->vr_temp = Power_get_vreg_temp(GLOBAL_STATE);
         // User pause, hardware fault, or all pools unreachable
@@ -148,6 +230,7 @@ void POWER_MANAGEMENT_task(void * pvParameters)
         } else if (!wants_stop && is_paused) {
             mining_start(GLOBAL_STATE);
             is_paused = false;
+            die_throttle = 0;
         }
 
         // If we've paused or have a hardware fault, skip doing anything else
@@ -156,9 +239,28 @@ void POWER_MANAGEMENT_task(void * pvParameters)
             continue;
         }
 
+        // the on-die readings throttle first and only stop mining when that did not help
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        float die_temp = power_management->chip_temp_max;
+        bool die_hot = held(&die_hot_since, die_temp > DIE_THROTTLE_TEMP, now_ms);
+        bool die_cool = held(&die_cool_since, die_throttle > 0 && die_temp > 0 && die_temp < DIE_RECOVER_TEMP, now_ms);
+        bool die_overheat = held(&die_max_since, die_temp > DIE_MAX_TEMP, now_ms);
+
+        if (die_hot && last_asic_frequency - die_throttle - DIE_THROTTLE_STEP >= DIE_THROTTLE_MIN_FREQUENCY) {
+            die_throttle += DIE_THROTTLE_STEP;
+            die_hot = false;
+            ESP_LOGW(TAG, "On-die temperature %.1fC, throttling to %g MHz", die_temp, last_asic_frequency - die_throttle);
+            set_frequency(GLOBAL_STATE, last_asic_frequency - die_throttle);
+        } else if (die_cool) {
+            die_throttle = fmaxf(die_throttle - DIE_THROTTLE_STEP, 0);
+            ESP_LOGI(TAG, "On-die temperature %.1fC, raising to %g MHz", die_temp, last_asic_frequency - die_throttle);
+            set_frequency(GLOBAL_STATE, last_asic_frequency - die_throttle);
+        }
+
         bool asic_overheat =
             power_management->chip_temp_avg > THROTTLE_TEMP
-            || power_management->chip_temp2_avg > THROTTLE_TEMP;
+            || power_management->chip_temp2_avg > THROTTLE_TEMP
+            || die_hot || die_overheat;
 
         if ((power_management->vr_temp > TPS546_THROTTLE_TEMP || asic_overheat) && (power_management->frequency_value > 50 || power_management->voltage > 1000)) {
             if (power_management->chip_temp2_avg > 0) {
@@ -166,6 +268,9 @@ void POWER_MANAGEMENT_task(void * pvParameters)
             } else {
                 ESP_LOGE(TAG, "OVERHEAT! VR: %fC ASIC: %fC", power_management->vr_temp, power_management->chip_temp_avg);
             }
+            if (power_management->chip_temp_max > 0) {
+                ESP_LOGE(TAG, "Hottest on-die reading: %fC", power_management->chip_temp_max);
+            }
 
             last_known_asic_voltage = nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE);
             last_known_asic_frequency = nvs_config_get_float(NVS_CONFIG_ASIC_FREQUENCY);
@@ -217,6 +322,7 @@ void POWER_MANAGEMENT_task(void * pvParameters)
                      reduced_voltage, last_known_asic_voltage, reduced_asic_frequency, last_known_asic_frequency);
 
             uint8_t chip_count = mining_start(GLOBAL_STATE);
+            die_throttle = 0;
 
             if (chip_count > 0) {
                 // Frequency reduction will now be applied by normal power management loop
@@ -240,13 +346,11 @@ void POWER_MANAGEMENT_task(void * pvParameters)
 
         if (asic_frequency != last_asic_frequency) {
             ESP_LOGI(TAG, "New ASIC frequency requested: %g MHz (current: %g MHz)", asic_frequency, last_asic_frequency);
-            
-            power_management->frequency_value = asic_frequency;
-            power_management->expected_hashrate = expected_hashrate(GLOBAL_STATE);
 
-            ASIC_set_frequency(GLOBAL_STATE);
-            ASIC_set_nonce_space(GLOBAL_STATE);
-            
+            // a new request starts unthrottled, the dies step it down again if still hot
+            die_throttle = 0;
+            set_frequency(GLOBAL_STATE, asic_frequency);
+
             last_asic_frequency = asic_frequency;
         }
 
@@ -1,8 +1,16 @@
 #ifndef POWER_MANAGEMENT_TASK_H_
 #define POWER_MANAGEMENT_TASK_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
 typedef struct GlobalState GlobalState;
 
+// On-die sensors read the junction, about this much above the board sensors
+// the throttle and fan targets were set for
+#define DIE_TEMP_OFFSET 25.0
+
 typedef struct
 {
     float fan_perc;
@@ -10,10 +18,15 @@ typedef struct
     uint16_t fan2_rpm;
     float chip_temp_avg;
     float chip_temp2_avg;
+    float * chip_temps;        // on-die temperature per chip, -1 until its sensor answered
+    int chip_temp_count;
+    float chip_temp_max;       // hottest on-die reading, -1 without any
     float vr_temp;
     float voltage;
     float frequency_value;
     float actual_frequency;    
+    bool frequency_ramping;
+    float max_chip_offset;     // fastest per-chip offset from actual_frequency, see chip_tuner.c
     float expected_hashrate;
     float power;
     float current;
@@ -21,6 +34,10 @@ typedef struct
 } PowerManagementModule;
 
 void POWER_MANAGEMENT_init_frequency(GlobalState * GLOBAL_STATE);
+esp_err_t POWER_MANAGEMENT_init_chip_temps(PowerManagementModule * power_management, int asic_count);
+
+// Called from the result task with each on-die temperature read
+void POWER_MANAGEMENT_set_chip_temp(PowerManagementModule * power_management, int asic_nr, float temp_c);
 
 void POWER_MANAGEMENT_task(void * pvParameters);
 
@@ -4,10 +4,12 @@
 #include <string.h>
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_system.h"
 #include <esp_heap_caps.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "statistics_task.h"
+#include "stats_history.h"
 #include "global_state.h"
 #include "nvs_config.h"
 #include "connect.h"
@@ -16,21 +18,26 @@
 
 static const char * TAG = "statistics_task";
 
-static StatisticsDataPtr statisticsBuffer;
-static uint16_t statisticsDataSize;
+static stats_store_t statisticsStore;
+static bool statisticsStoreReady;
 static pthread_mutex_t statisticsDataLock = PTHREAD_MUTEX_INITIALIZER;
 
-static const uint16_t maxDataCount = MAX_STATISTICS_COUNT;
+static void addStatisticHistory(stats_resolution_t resolution, const stats_point_t * point, void * context)
+{
+    stats_history_add(resolution, point);
+}
 
 void createStatisticsBuffer()
 {
-    if (NULL == statisticsBuffer) {
+    if (!statisticsStoreReady) {
         pthread_mutex_lock(&statisticsDataLock);
 
-        if (NULL == statisticsBuffer) {
-            statisticsBuffer = (StatisticsDataPtr)heap_caps_malloc(sizeof(struct StatisticsData) * maxDataCount, MALLOC_CAP_SPIRAM);
-            if (NULL == statisticsBuffer) {
+        if (!statisticsStoreReady) {
+            statisticsStoreReady = stats_store_init(&statisticsStore, STATS_METRIC_COUNT);
+            if (!statisticsStoreReady) {
                 ESP_LOGW(TAG, "Not enough memory for the statistics data buffer!");
+            } else {
+                statisticsStore.on_rollup = addStatisticHistory;
             }
         }
 
@@ -40,106 +47,69 @@ void createStatisticsBuffer()
 
 void removeStatisticsBuffer()
 {
-    if (NULL != statisticsBuffer) {
+    if (statisticsStoreReady) {
         pthread_mutex_lock(&statisticsDataLock);
 
-        if (NULL != statisticsBuffer) {
-            heap_caps_free(statisticsBuffer);
-
-            statisticsBuffer = NULL;
-            statisticsDataSize = 0;
+        if (statisticsStoreReady) {
+            stats_store_free(&statisticsStore);
+            statisticsStoreReady = false;
         }
 
         pthread_mutex_unlock(&statisticsDataLock);
     }
 }
 
-bool addStatisticData(StatisticsDataPtr data, uint16_t statsFrequency)
+void addStatisticData(uint64_t timestamp, const float * values)
 {
-    bool result = false;
-
-    if (NULL == data) {
-        return result;
-    }
-
     createStatisticsBuffer();
 
     pthread_mutex_lock(&statisticsDataLock);
 
-    if (NULL != statisticsBuffer) {
-        if (statisticsDataSize < maxDataCount) {
-            statisticsBuffer[statisticsDataSize] = *data;
-            statisticsDataSize++;
-            result = true;
-        } else {
-            // Buffer is full. Determine indexToRemove using Triangle Area thinning logic.
-            uint16_t indexToRemove = 0;
-            const uint64_t currentSpan = data->timestamp - statisticsBuffer[0].timestamp;
-            const uint64_t targetDuration = (uint64_t)maxDataCount * (uint64_t)statsFrequency * 1000;
-
-            if (currentSpan >= targetDuration) {
-                indexToRemove = 0;
-            } else {
-                uint16_t low = 1;
-                uint16_t high = maxDataCount - 1;
-
-                while (high - low > 1) {
-                    uint64_t lowTime = statisticsBuffer[low].timestamp;
-                    uint64_t highTime = statisticsBuffer[high].timestamp;
-                    uint64_t midTime = (lowTime + highTime) / 2;
-
-                    uint16_t split = low;
-                    for (uint16_t i = low; i <= high; i++) {
-                        uint64_t t = statisticsBuffer[i].timestamp;
-                        if (t >= midTime) {
-                            split = i;
-                            break;
-                        }
-                    }
-
-                    // Ensure progress
-                    if (split == low) split++;
-                    if (split > high) split = high;
-
-                    uint16_t leftCount = split - low;
-                    uint16_t rightCount = high - split + 1;
-
-                    if (leftCount > rightCount) {
-                        high = split - 1;
-                    } else {
-                        low = split;
-                    }
-                }
-                indexToRemove = low;
-            }
-
-            // Shift and append (Standard linear array shift)
-            if (indexToRemove < maxDataCount - 1) {
-                memmove(&statisticsBuffer[indexToRemove], &statisticsBuffer[indexToRemove + 1], (maxDataCount - indexToRemove - 1) * sizeof(struct StatisticsData));
-            }
-            statisticsBuffer[maxDataCount - 1] = *data;
-            result = true;
-        }
+    if (statisticsStoreReady) {
+        stats_store_add(&statisticsStore, timestamp, values);
     }
 
     pthread_mutex_unlock(&statisticsDataLock);
-
-    return result;
 }
 
-bool getStatisticData(uint16_t index, StatisticsDataPtr dataOut)
+void flushStatisticHistory(bool force)
 {
-    bool result = false;
+    pthread_mutex_lock(&statisticsDataLock);
+    stats_history_flush(force);
+    pthread_mutex_unlock(&statisticsDataLock);
+}
 
-    if ((NULL == statisticsBuffer) || (NULL == dataOut) || (maxDataCount <= index)) {
-        return result;
+// OTA updates and restarts from the API pass here; a power cut or watchdog loses the batches not yet written
+static void statistics_shutdown(void)
+{
+    if (pthread_mutex_trylock(&statisticsDataLock) == 0) {
+        stats_history_flush(true);
+        pthread_mutex_unlock(&statisticsDataLock);
     }
+}
+
+uint32_t statistics_query(stats_range_t * range, stats_store_visitor_t visitor, void * context)
+{
+    uint32_t result = 0;
 
     pthread_mutex_lock(&statisticsDataLock);
 
-    if ((NULL != statisticsBuffer) && (index < statisticsDataSize)) {
-        *dataOut = statisticsBuffer[index];
-        result = true;
+    if (statisticsStoreReady && range->from <= range->to) {
+        stats_merge_t merge;
+        int64_t before = INT64_MAX;
+        uint64_t oldest;
+
+        stats_store_resolve(&statisticsStore, range);
+        stats_merge_init(&merge, &statisticsStore, range, visitor, context);
+
+        // flash holds what memory already dropped or lost in a reboot
+        if (stats_store_oldest(&statisticsStore, range->resolution, &oldest)) {
+            before = oldest;
+        }
+        stats_history_merge(&merge, before);
+        stats_store_merge(&statisticsStore, &merge);
+
+        result = stats_merge_finish(&merge);
     }
 
     pthread_mutex_unlock(&statisticsDataLock);
@@ -154,7 +124,12 @@ void statistics_task(void * pvParameters)
     GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
     SystemModule * sys_module = &GLOBAL_STATE->SYSTEM_MODULE;
     PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
-    struct StatisticsData statsData = {};
+    uint64_t lastTimestamp = 0;
+    float values[STATS_METRIC_COUNT];
+
+    if (stats_history_init(STATS_METRIC_COUNT)) {
+        esp_register_shutdown_handler(statistics_shutdown);
+    }
 
     TickType_t taskWakeTime = xTaskGetTickCount();
 
@@ -163,32 +138,33 @@ void statistics_task(void * pvParameters)
         const uint16_t configStatsFrequency = nvs_config_get_u16(NVS_CONFIG_STATISTICS_FREQUENCY);
 
         if (0 != configStatsFrequency) {
-            // Record every second (DEFAULT_POLL_RATE is 1000ms)
-            if (currentTime >= statsData.timestamp + 1000) {
+            // Record every second (DEFAULT_POLL_RATE is 1000ms), the store rolls them up to minutes and hours
+            if (currentTime >= lastTimestamp + 1000) {
                 int8_t wifiRSSI = -90;
                 get_wifi_current_rssi(&wifiRSSI);
 
-                statsData.timestamp = currentTime;
-                statsData.hashrate = sys_module->current_hashrate;
-                statsData.hashrate_1m = sys_module->hashrate_1m;
-                statsData.hashrate_10m = sys_module->hashrate_10m;
-                statsData.hashrate_1h = sys_module->hashrate_1h;
-                statsData.errorPercentage = sys_module->error_percentage;
-                statsData.chipTemperature = power_management->chip_temp_avg;
-                statsData.chipTemperature2 = power_management->chip_temp2_avg;
-                statsData.vrTemperature = power_management->vr_temp;
-                statsData.power = power_management->power;
-                statsData.voltage = power_management->voltage;
-                statsData.current = power_management->current;
-                statsData.coreVoltageActual = power_management->core_voltage;
-                statsData.fanSpeed = power_management->fan_perc;
-                statsData.fanRPM = power_management->fan_rpm;
-                statsData.fan2RPM = power_management->fan2_rpm;
-                statsData.wifiRSSI = wifiRSSI;
-                statsData.freeHeap = esp_get_free_heap_size();
-                statsData.responseTime = sys_module->response_time;
-
-                addStatisticData(&statsData, configStatsFrequency);
+                values[STATS_METRIC_HASHRATE] = sys_module->current_hashrate;
+                values[STATS_METRIC_HASHRATE_1M] = sys_module->hashrate_1m;
+                values[STATS_METRIC_HASHRATE_10M] = sys_module->hashrate_10m;
+                values[STATS_METRIC_HASHRATE_1H] = sys_module->hashrate_1h;
+                values[STATS_METRIC_ERROR_PERCENTAGE] = sys_module->error_percentage;
+                values[STATS_METRIC_CHIP_TEMP] = power_management->chip_temp_avg;
+                values[STATS_METRIC_CHIP_TEMP2] = power_management->chip_temp2_avg;
+                values[STATS_METRIC_VR_TEMP] = power_management->vr_temp;
+                values[STATS_METRIC_CORE_VOLTAGE_ACTUAL] = power_management->core_voltage;
+                values[STATS_METRIC_VOLTAGE] = power_management->voltage;
+                values[STATS_METRIC_POWER] = power_management->power;
+                values[STATS_METRIC_CURRENT] = power_management->current;
+                values[STATS_METRIC_FAN_SPEED] = power_management->fan_perc;
+                values[STATS_METRIC_FAN_RPM] = power_management->fan_rpm;
+                values[STATS_METRIC_FAN2_RPM] = power_management->fan2_rpm;
+                values[STATS_METRIC_WIFI_RSSI] = wifiRSSI;
+                values[STATS_METRIC_FREE_HEAP] = esp_get_free_heap_size();
+                values[STATS_METRIC_RESPONSE_TIME] = sys_module->response_time;
+
+                lastTimestamp = currentTime;
+                addStatisticData(currentTime, values);
+                flushStatisticHistory(false);
             }
         } else {
             removeStatisticsBuffer();
@@ -3,35 +3,36 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "stats_store.h"
 
-#define MAX_STATISTICS_COUNT 720
+#define MAX_STATISTICS_COUNT 720 // points per query
 
-typedef struct StatisticsData * StatisticsDataPtr;
-
-struct StatisticsData
+// Column order of the statistics store
+typedef enum
 {
-    uint64_t timestamp;
-    float hashrate;
-    float hashrate_1m;
-    float hashrate_10m;
-    float hashrate_1h;
-    float errorPercentage;
-    float chipTemperature;
-    float chipTemperature2;
-    float vrTemperature;
-    float power;
-    float voltage;
-    float current;
-    int16_t coreVoltageActual;
-    float fanSpeed;
-    uint16_t fanRPM;
-    uint16_t fan2RPM;
-    int8_t wifiRSSI;
-    uint32_t freeHeap;
-    float responseTime;
-};
+    STATS_METRIC_HASHRATE,
+    STATS_METRIC_HASHRATE_1M,
+    STATS_METRIC_HASHRATE_10M,
+    STATS_METRIC_HASHRATE_1H,
+    STATS_METRIC_ERROR_PERCENTAGE,
+    STATS_METRIC_CHIP_TEMP,
+    STATS_METRIC_CHIP_TEMP2,
+    STATS_METRIC_VR_TEMP,
+    STATS_METRIC_CORE_VOLTAGE_ACTUAL,
+    STATS_METRIC_VOLTAGE,
+    STATS_METRIC_POWER,
+    STATS_METRIC_CURRENT,
+    STATS_METRIC_FAN_SPEED,
+    STATS_METRIC_FAN_RPM,
+    STATS_METRIC_FAN2_RPM,
+    STATS_METRIC_WIFI_RSSI,
+    STATS_METRIC_FREE_HEAP,
+    STATS_METRIC_RESPONSE_TIME,
+    STATS_METRIC_COUNT
+} StatisticsMetric;
 
-bool getStatisticData(uint16_t index, StatisticsDataPtr dataOut);
+// Visits the recorded points of range, see stats_store_query()
+uint32_t statistics_query(stats_range_t * range, stats_store_visitor_t visitor, void * context);
 
 void statistics_task(void * pvParameters);
 
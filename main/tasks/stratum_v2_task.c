@@ -19,9 +19,12 @@
 #include "device_config.h"
 #include "coinbase_decoder.h"
 #include "esp_heap_caps.h"
+#include "nvs_config.h"
+#include "freertos/semphr.h"
 
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 
 #define MAX_RETRY_ATTEMPTS 3
 #define TRANSPORT_TIMEOUT_MS 5000
@@ -112,9 +115,37 @@ static void clear_active_job_ids(uint32_t *active_job_ids, int *count)
     *count = 0;
 }
 
+// Share batching. A share found while the link is idle (nothing sent within the
+// last sv2SubmitBatchMs) is sent immediately. Shares found within the window
+// after a send are collected and leave together at the end of the window, as
+// one encrypted write and one TCP segment. Each share is still its own Noise
+// frame, so the pool sees exactly the same message stream.
+#define SV2_SUBMIT_FRAME_MAX_SIZE (SV2_FRAME_HEADER_SIZE + 24 + 1 + 32)
+#define SV2_SUBMIT_BATCH_MAX_SHARES 16
+
+typedef struct {
+    SemaphoreHandle_t lock;     // also serializes every send on the connection, see stratum_v2_send_frame
+    TaskHandle_t flush_task;
+    uint8_t frames[SV2_SUBMIT_BATCH_MAX_SHARES * SV2_SUBMIT_FRAME_MAX_SIZE];
+    uint32_t sequence_numbers[SV2_SUBMIT_BATCH_MAX_SHARES];
+    uint8_t channels[SV2_SUBMIT_BATCH_MAX_SHARES];   // index into std_channels, 0 on extended channels
+    int frames_len;
+    int count;
+    int64_t last_send_us;
+} sv2_submit_batch_t;
+
+static sv2_submit_batch_t stratum_v2_batch = {0};
+
 void stratum_v2_close_connection(GlobalState *GLOBAL_STATE)
 {
     ESP_LOGE(TAG, "Shutting down SV2 connection and restarting...");
+    // Take the submit lock so a share send never races the teardown.
+    // Shares still waiting in the batch are dropped with the connection.
+    if (stratum_v2_batch.lock) {
+        xSemaphoreTake(stratum_v2_batch.lock, portMAX_DELAY);
+        stratum_v2_batch.frames_len = 0;
+        stratum_v2_batch.count = 0;
+    }
     if (GLOBAL_STATE->sv2_noise_ctx) {
         sv2_noise_destroy(GLOBAL_STATE->sv2_noise_ctx);
         GLOBAL_STATE->sv2_noise_ctx = NULL;
@@ -124,17 +155,38 @@ void stratum_v2_close_connection(GlobalState *GLOBAL_STATE)
         esp_transport_destroy(GLOBAL_STATE->transport);
         GLOBAL_STATE->transport = NULL;
     }
+    if (stratum_v2_batch.lock) {
+        xSemaphoreGive(stratum_v2_batch.lock);
+    }
     SYSTEM_clean_jobs_queue(GLOBAL_STATE);
     vTaskDelay(1000 / portTICK_PERIOD_MS);
 }
 
+// A channel job rotated back in without a newer one from the pool goes out at
+// most this far past its ntime, well inside what nodes accept as valid
+#define SV2_MAX_NTIME_ROLL_S 600
+
+// Guards the standard channel table and jobs shared with create_jobs_task and
+// the share submit path
+static portMUX_TYPE stratum_v2_channels_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static sv2_std_channel_t *stratum_v2_find_std_channel(sv2_conn_t *conn, uint32_t channel_id)
+{
+    for (int i = 0; i < conn->std_channel_count; i++) {
+        if (conn->std_channels[i].opened && conn->std_channels[i].channel_id == channel_id) {
+            return &conn->std_channels[i];
+        }
+    }
+    return NULL;
+}
+
 // Track per-share submit timestamps for response time measurement.
 // SubmitShares.Success can batch-acknowledge multiple shares via its
 // last_sequence_number field, so we key the submit time by sequence number
-// (ring buffer) and measure against the specific share being acknowledged
-// rather than just the most recent submit.
+// (ring buffer per channel) and measure against the specific share being
+// acknowledged rather than just the most recent submit.
 #define SV2_SUBMIT_TIMING_SLOTS 32
-static int64_t stratum_v2_submit_time_us[SV2_SUBMIT_TIMING_SLOTS] = {0};
+static int64_t stratum_v2_submit_time_us[SV2_MAX_STANDARD_CHANNELS][SV2_SUBMIT_TIMING_SLOTS] = {0};
 
 // Shares submitted but not yet resolved by the pool (rises while it batches acks).
 static void stratum_v2_update_pending_shares(GlobalState *GLOBAL_STATE)
@@ -150,15 +202,150 @@ static void stratum_v2_update_pending_shares(GlobalState *GLOBAL_STATE)
     GLOBAL_STATE->SYSTEM_MODULE.shares_pending = (uint16_t)(pending > UINT16_MAX ? UINT16_MAX : pending);
 }
 
+// Index of a channel in std_channels and the submit timing table, 0 on an
+// extended channel, -1 for a channel that is not ours
+static int stratum_v2_channel_index(sv2_conn_t *conn, uint32_t channel_id)
+{
+    if (conn->channel_type == SV2_CHANNEL_EXTENDED) {
+        return 0;
+    }
+    sv2_std_channel_t *ch = stratum_v2_find_std_channel(conn, channel_id);
+    return ch ? (int)(ch - conn->std_channels) : -1;
+}
+
+// The pool resolved the shares of a channel up to sequence_number
+static void stratum_v2_resolve_shares(GlobalState *GLOBAL_STATE, sv2_conn_t *conn, int channel,
+                                      uint32_t sequence_number)
+{
+    uint32_t resolved = sequence_number + 1;  // 0-based seq -> count
+    if (conn->channel_type == SV2_CHANNEL_EXTENDED) {
+        if (resolved > conn->resolved_shares) {
+            conn->resolved_shares = resolved;
+        }
+    } else if (channel >= 0) {
+        sv2_std_channel_t *ch = &conn->std_channels[channel];
+        if (resolved > ch->resolved_shares) {
+            conn->resolved_shares += resolved - ch->resolved_shares;
+            ch->resolved_shares = resolved;
+        }
+    }
+    stratum_v2_update_pending_shares(GLOBAL_STATE);
+}
+
 // Timestamp a submitted share (for response-time measurement) and refresh pending.
-static void stratum_v2_track_submit(GlobalState *GLOBAL_STATE, uint32_t sequence_number)
+static void stratum_v2_track_submit(GlobalState *GLOBAL_STATE, uint8_t channel, uint32_t sequence_number)
 {
-    stratum_v2_submit_time_us[sequence_number % SV2_SUBMIT_TIMING_SLOTS] = esp_timer_get_time();
+    stratum_v2_submit_time_us[channel][sequence_number % SV2_SUBMIT_TIMING_SLOTS] = esp_timer_get_time();
     stratum_v2_update_pending_shares(GLOBAL_STATE);
 }
 
-int stratum_v2_submit_share(GlobalState *GLOBAL_STATE, uint32_t job_id, uint32_t nonce,
-                            uint32_t ntime, uint32_t version)
+// Send the collected shares. Caller must hold stratum_v2_batch.lock.
+static int stratum_v2_flush_batch_locked(GlobalState *GLOBAL_STATE)
+{
+    if (stratum_v2_batch.count == 0) {
+        return 0;
+    }
+
+    int ret = -1;
+    if (GLOBAL_STATE->transport && GLOBAL_STATE->sv2_noise_ctx) {
+        ret = sv2_noise_send_frames(GLOBAL_STATE->sv2_noise_ctx, GLOBAL_STATE->transport,
+                                    stratum_v2_batch.frames, stratum_v2_batch.frames_len);
+    }
+    if (ret == 0) {
+        for (int i = 0; i < stratum_v2_batch.count; i++) {
+            stratum_v2_track_submit(GLOBAL_STATE, stratum_v2_batch.channels[i], stratum_v2_batch.sequence_numbers[i]);
+        }
+        ESP_LOGD(TAG, "Sent %d batched shares", stratum_v2_batch.count);
+    } else {
+        ESP_LOGW(TAG, "Failed to send %d batched shares", stratum_v2_batch.count);
+    }
+
+    stratum_v2_batch.last_send_us = esp_timer_get_time();
+    stratum_v2_batch.frames_len = 0;
+    stratum_v2_batch.count = 0;
+    return ret;
+}
+
+static void stratum_v2_batch_flush_task(void *pvParameters)
+{
+    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Hold the shares until the window that started with the last send ends
+        int64_t window_us = (int64_t)nvs_config_get_u16(NVS_CONFIG_SV2_SUBMIT_BATCH_MS) * 1000;
+        xSemaphoreTake(stratum_v2_batch.lock, portMAX_DELAY);
+        int64_t wait_us = stratum_v2_batch.last_send_us + window_us - esp_timer_get_time();
+        xSemaphoreGive(stratum_v2_batch.lock);
+        if (wait_us > 0) {
+            vTaskDelay(pdMS_TO_TICKS(wait_us / 1000) + 1);
+        }
+
+        xSemaphoreTake(stratum_v2_batch.lock, portMAX_DELAY);
+        stratum_v2_flush_batch_locked(GLOBAL_STATE);
+        xSemaphoreGive(stratum_v2_batch.lock);
+    }
+}
+
+static void stratum_v2_batch_init(GlobalState *GLOBAL_STATE)
+{
+    if (stratum_v2_batch.lock) {
+        return;
+    }
+    stratum_v2_batch.lock = xSemaphoreCreateMutex();
+    if (xTaskCreateWithCaps(stratum_v2_batch_flush_task, "sv2 submit", 4096, (void *)GLOBAL_STATE,
+                            15, &stratum_v2_batch.flush_task, MALLOC_CAP_SPIRAM) != pdPASS) {
+        ESP_LOGE(TAG, "Error creating SV2 submit batch task, shares will be sent individually");
+        stratum_v2_batch.flush_task = NULL;
+    }
+}
+
+// Send a single SubmitShares frame now, or add it to the current batch.
+static int stratum_v2_submit_frame(GlobalState *GLOBAL_STATE, const uint8_t *frame, int len,
+                                   uint8_t channel, uint32_t sequence_number)
+{
+    if (!stratum_v2_batch.lock) {
+        return -1;
+    }
+
+    int64_t window_us = (int64_t)nvs_config_get_u16(NVS_CONFIG_SV2_SUBMIT_BATCH_MS) * 1000;
+    int ret = 0;
+
+    xSemaphoreTake(stratum_v2_batch.lock, portMAX_DELAY);
+
+    int64_t now_us = esp_timer_get_time();
+    bool idle = stratum_v2_batch.count == 0 && now_us - stratum_v2_batch.last_send_us >= window_us;
+
+    if (window_us == 0 || idle || !stratum_v2_batch.flush_task) {
+        // Flush anything still queued first so sequence numbers stay in order
+        stratum_v2_flush_batch_locked(GLOBAL_STATE);
+        if (GLOBAL_STATE->transport && GLOBAL_STATE->sv2_noise_ctx) {
+            stratum_v2_track_submit(GLOBAL_STATE, channel, sequence_number);
+            ret = sv2_noise_send(GLOBAL_STATE->sv2_noise_ctx, GLOBAL_STATE->transport, frame, len);
+        } else {
+            ret = -1;
+        }
+        stratum_v2_batch.last_send_us = esp_timer_get_time();
+    } else {
+        memcpy(stratum_v2_batch.frames + stratum_v2_batch.frames_len, frame, len);
+        stratum_v2_batch.frames_len += len;
+        stratum_v2_batch.channels[stratum_v2_batch.count] = channel;
+        stratum_v2_batch.sequence_numbers[stratum_v2_batch.count++] = sequence_number;
+
+        if (stratum_v2_batch.count == SV2_SUBMIT_BATCH_MAX_SHARES) {
+            ret = stratum_v2_flush_batch_locked(GLOBAL_STATE);
+        } else if (stratum_v2_batch.count == 1) {
+            xTaskNotifyGive(stratum_v2_batch.flush_task);
+        }
+    }
+
+    xSemaphoreGive(stratum_v2_batch.lock);
+    return ret;
+}
+
+int stratum_v2_submit_share(GlobalState *GLOBAL_STATE, uint32_t channel_id, uint32_t job_id,
+                            uint32_t nonce, uint32_t ntime, uint32_t version)
 {
     if (!GLOBAL_STATE->transport || !GLOBAL_STATE->sv2_conn || !GLOBAL_STATE->sv2_noise_ctx) {
         return -1;
@@ -167,15 +354,27 @@ int stratum_v2_submit_share(GlobalState *GLOBAL_STATE, uint32_t job_id, uint32_t
     sv2_conn_t *conn = GLOBAL_STATE->sv2_conn;
     uint8_t buf[SV2_FRAME_HEADER_SIZE + 24];
 
-    uint32_t sequence_number = conn->sequence_number++;
+    // Each channel numbers its own shares, the pool acknowledges them per channel
+    uint32_t sequence_number = 0;
+    taskENTER_CRITICAL(&stratum_v2_channels_mux);
+    sv2_std_channel_t *ch = stratum_v2_find_std_channel(conn, channel_id);
+    if (ch) {
+        sequence_number = ch->sequence_number++;
+    }
+    taskEXIT_CRITICAL(&stratum_v2_channels_mux);
+    if (!ch) {
+        ESP_LOGW(TAG, "Dropping share for unknown channel %lu", channel_id);
+        return -1;
+    }
+    conn->sequence_number++;
+
     int len = sv2_build_submit_shares_standard(buf, sizeof(buf),
-                                                conn->channel_id,
+                                                channel_id,
                                                 sequence_number,
                                                 job_id, nonce, ntime, version);
     if (len < 0) return -1;
 
-    stratum_v2_track_submit(GLOBAL_STATE, sequence_number);
-    return sv2_noise_send(GLOBAL_STATE->sv2_noise_ctx, GLOBAL_STATE->transport, buf, len);
+    return stratum_v2_submit_frame(GLOBAL_STATE, buf, len, (uint8_t)(ch - conn->std_channels), sequence_number);
 }
 
 int stratum_v2_submit_share_extended(GlobalState *GLOBAL_STATE, uint32_t job_id,
@@ -187,7 +386,7 @@ int stratum_v2_submit_share_extended(GlobalState *GLOBAL_STATE, uint32_t job_id,
     }
 
     sv2_conn_t *conn = GLOBAL_STATE->sv2_conn;
-    uint8_t buf[SV2_FRAME_HEADER_SIZE + 24 + 1 + 32];
+    uint8_t buf[SV2_SUBMIT_FRAME_MAX_SIZE];
 
     uint32_t sequence_number = conn->sequence_number++;
     int len = sv2_build_submit_shares_extended(buf, sizeof(buf),
@@ -197,8 +396,7 @@ int stratum_v2_submit_share_extended(GlobalState *GLOBAL_STATE, uint32_t job_id,
                                                 extranonce, extranonce_len);
     if (len < 0) return -1;
 
-    stratum_v2_track_submit(GLOBAL_STATE, sequence_number);
-    return sv2_noise_send(GLOBAL_STATE->sv2_noise_ctx, GLOBAL_STATE->transport, buf, len);
+    return stratum_v2_submit_frame(GLOBAL_STATE, buf, len, 0, sequence_number);
 }
 
 bool stratum_v2_is_extended_channel(GlobalState *GLOBAL_STATE)
@@ -207,11 +405,77 @@ bool stratum_v2_is_extended_channel(GlobalState *GLOBAL_STATE)
            GLOBAL_STATE->sv2_conn->channel_type == SV2_CHANNEL_EXTENDED;
 }
 
-static void stratum_v2_enqueue_job(GlobalState *GLOBAL_STATE, sv2_conn_t *conn,
+// Store the latest job of a standard channel; create_jobs_task hands it out
+// through stratum_v2_next_channel_job. A primary channel job already went out
+// through the stratum queue. Returns false for a job that is stored already.
+static bool stratum_v2_set_channel_job(sv2_std_channel_t *ch, bool sent,
+                                       uint32_t job_id, uint32_t version,
+                                       const uint8_t merkle_root[32], const uint8_t prev_hash[32],
+                                       uint32_t ntime, uint32_t nbits)
+{
+    taskENTER_CRITICAL(&stratum_v2_channels_mux);
+    if (ch->has_job && ch->current_job.job_id == job_id) {
+        taskEXIT_CRITICAL(&stratum_v2_channels_mux);
+        return false;
+    }
+    ch->current_job.channel_id = ch->channel_id;
+    ch->current_job.job_id = job_id;
+    ch->current_job.version = version;
+    memcpy(ch->current_job.merkle_root, merkle_root, 32);
+    memcpy(ch->current_job.prev_hash, prev_hash, 32);
+    ch->current_job.ntime = ntime;
+    ch->current_job.nbits = nbits;
+    ch->current_job.clean_jobs = false;
+    ch->has_job = true;
+    // create_jobs_task hands a new primary job to every chain, one ntime each
+    ch->ntime_rolls = sent ? ASIC_CHAIN_COUNT : 0;
+    taskEXIT_CRITICAL(&stratum_v2_channels_mux);
+    return true;
+}
+
+// With several standard channels every job interval gets the ASICs onto the
+// current job of the next channel in turn. A job going out again has ntime
+// rolled one second further, so it never repeats the nonce and version space
+// searched on its previous turn.
+bool stratum_v2_next_channel_job(GlobalState *GLOBAL_STATE, sv2_job_t *job, double *difficulty)
+{
+    sv2_conn_t *conn = GLOBAL_STATE->sv2_conn;
+    if (!conn || conn->channel_type == SV2_CHANNEL_EXTENDED) {
+        return false;
+    }
+
+    bool found = false;
+    taskENTER_CRITICAL(&stratum_v2_channels_mux);
+    int count = conn->std_channel_count;
+    for (int i = 0; count > 1 && i < count && !found; i++) {
+        sv2_std_channel_t *ch = &conn->std_channels[conn->next_std_channel % count];
+        conn->next_std_channel = (conn->next_std_channel + 1) % count;
+        if (ch->opened && ch->has_job && ch->ntime_rolls <= SV2_MAX_NTIME_ROLL_S) {
+            *job = ch->current_job;
+            job->ntime += ch->ntime_rolls++;
+            *difficulty = ch->difficulty;
+            found = true;
+        }
+    }
+    taskEXIT_CRITICAL(&stratum_v2_channels_mux);
+    return found;
+}
+
+static void stratum_v2_enqueue_job(GlobalState *GLOBAL_STATE, sv2_conn_t *conn, sv2_std_channel_t *ch,
                                    uint32_t job_id, uint32_t version,
                                    const uint8_t merkle_root[32], const uint8_t prev_hash[32],
                                    uint32_t ntime, uint32_t nbits, bool clean_jobs)
 {
+    bool primary = ch == &conn->std_channels[0];
+    if (!stratum_v2_set_channel_job(ch, primary, job_id, version, merkle_root, prev_hash, ntime, nbits) && !primary) {
+        ESP_LOGW(TAG, "Ignoring duplicate V2 standard job %lu on channel %lu", job_id, ch->channel_id);
+        return;
+    }
+    if (!primary) {
+        GLOBAL_STATE->SYSTEM_MODULE.work_received++;
+        return;
+    }
+
     if (clean_jobs) {
         clear_active_job_ids(conn->active_job_ids, &conn->active_job_ids_count);
     }
@@ -227,6 +491,7 @@ static void stratum_v2_enqueue_job(GlobalState *GLOBAL_STATE, sv2_conn_t *conn,
         return;
     }
 
+    job->channel_id = ch->channel_id;
     job->job_id = job_id;
     job->version = version;
     memcpy(job->merkle_root, merkle_root, 32);
@@ -483,27 +748,32 @@ static void stratum_v2_handle_new_mining_job(GlobalState *GLOBAL_STATE, sv2_conn
         return;
     }
 
-    ESP_LOGI(TAG, "New mining job: id=%lu, version=%08lx, future=%s",
-             job_id, version, has_min_ntime ? "no" : "yes");
+    ESP_LOGI(TAG, "New mining job: channel=%lu, id=%lu, version=%08lx, future=%s",
+             channel_id, job_id, version, has_min_ntime ? "no" : "yes");
+
+    sv2_std_channel_t *ch = stratum_v2_find_std_channel(conn, channel_id);
+    if (!ch) {
+        ch = &conn->std_channels[0];
+    }
 
     int slot = job_id % SV2_PENDING_JOBS_SIZE;
 
     if (has_min_ntime) {
         if (conn->has_prev_hash) {
-            stratum_v2_enqueue_job(GLOBAL_STATE, conn, job_id, version, merkle_root,
+            stratum_v2_enqueue_job(GLOBAL_STATE, conn, ch, job_id, version, merkle_root,
                                    conn->prev_hash, min_ntime,
                                    conn->prev_hash_nbits, true);
         } else {
-            conn->pending_jobs[slot].job_id = job_id;
-            conn->pending_jobs[slot].version = version;
-            memcpy(conn->pending_jobs[slot].merkle_root, merkle_root, 32);
-            conn->pending_jobs[slot].valid = true;
+            ch->pending_jobs[slot].job_id = job_id;
+            ch->pending_jobs[slot].version = version;
+            memcpy(ch->pending_jobs[slot].merkle_root, merkle_root, 32);
+            ch->pending_jobs[slot].valid = true;
         }
     } else {
-        conn->pending_jobs[slot].job_id = job_id;
-        conn->pending_jobs[slot].version = version;
-        memcpy(conn->pending_jobs[slot].merkle_root, merkle_root, 32);
-        conn->pending_jobs[slot].valid = true;
+        ch->pending_jobs[slot].job_id = job_id;
+        ch->pending_jobs[slot].version = version;
+        memcpy(ch->pending_jobs[slot].merkle_root, merkle_root, 32);
+        ch->pending_jobs[slot].valid = true;
     }
 }
 
@@ -534,25 +804,39 @@ static void stratum_v2_handle_set_new_prev_hash(GlobalState *GLOBAL_STATE, sv2_c
 
     int slot = job_id % SV2_PENDING_JOBS_SIZE;
 
-    // Resolve standard channel pending jobs
-    if (conn->pending_jobs[slot].valid && conn->pending_jobs[slot].job_id == job_id) {
-        stratum_v2_enqueue_job(GLOBAL_STATE, conn, job_id,
-                               conn->pending_jobs[slot].version,
-                               conn->pending_jobs[slot].merkle_root,
-                               prev_hash, min_ntime, nbits, true);
-        conn->pending_jobs[slot].valid = false;
-    }
+    // Resolve standard channel pending jobs. The message targets one standard
+    // channel or, when sent to the group channel, all of them.
+    bool group_message = stratum_v2_find_std_channel(conn, channel_id) == NULL;
+    for (int c = 0; c < conn->std_channel_count; c++) {
+        sv2_std_channel_t *ch = &conn->std_channels[c];
+        if (!group_message && ch->channel_id != channel_id) {
+            continue;
+        }
 
-    if (first_prev_hash) {
-        for (int i = 0; i < SV2_PENDING_JOBS_SIZE; i++) {
-            if (conn->pending_jobs[i].valid && conn->pending_jobs[i].job_id != job_id) {
-                ESP_LOGD(TAG, "Enqueuing pending future job %lu with first prev_hash",
-                         conn->pending_jobs[i].job_id);
-                stratum_v2_enqueue_job(GLOBAL_STATE, conn, conn->pending_jobs[i].job_id,
-                                       conn->pending_jobs[i].version,
-                                       conn->pending_jobs[i].merkle_root,
-                                       prev_hash, min_ntime, nbits, true);
-                conn->pending_jobs[i].valid = false;
+        // Previous block jobs are stale now, none of them rotates back in
+        taskENTER_CRITICAL(&stratum_v2_channels_mux);
+        ch->has_job = false;
+        taskEXIT_CRITICAL(&stratum_v2_channels_mux);
+
+        if (ch->pending_jobs[slot].valid && ch->pending_jobs[slot].job_id == job_id) {
+            stratum_v2_enqueue_job(GLOBAL_STATE, conn, ch, job_id,
+                                   ch->pending_jobs[slot].version,
+                                   ch->pending_jobs[slot].merkle_root,
+                                   prev_hash, min_ntime, nbits, true);
+            ch->pending_jobs[slot].valid = false;
+        }
+
+        if (first_prev_hash) {
+            for (int i = 0; i < SV2_PENDING_JOBS_SIZE; i++) {
+                if (ch->pending_jobs[i].valid && ch->pending_jobs[i].job_id != job_id) {
+                    ESP_LOGD(TAG, "Enqueuing pending future job %lu with first prev_hash",
+                             ch->pending_jobs[i].job_id);
+                    stratum_v2_enqueue_job(GLOBAL_STATE, conn, ch, ch->pending_jobs[i].job_id,
+                                           ch->pending_jobs[i].version,
+                                           ch->pending_jobs[i].merkle_root,
+                                           prev_hash, min_ntime, nbits, true);
+                    ch->pending_jobs[i].valid = false;
+                }
             }
         }
     }
@@ -585,6 +869,131 @@ static void stratum_v2_handle_set_new_prev_hash(GlobalState *GLOBAL_STATE, sv2_c
     }
 }
 
+// Hashrate-driven channel updates. The pool sizes our target from the nominal
+// hashrate we announce, so keep that tracking what the chips really do and ask
+// for a maximum target that yields roughly one share per
+// SV2_TARGET_SHARE_INTERVAL_S. Checked from the receive loop; share acks and
+// job updates keep it running often enough.
+#define SV2_TARGET_SHARE_INTERVAL_S 10.0
+#define SV2_UPDATE_CHANNEL_MIN_INTERVAL_US (60 * 1000000LL)
+#define SV2_UPDATE_CHANNEL_MAX_INTERVAL_US (10 * 60 * 1000000LL)
+#define SV2_UPDATE_CHANNEL_HASHRATE_DELTA 0.15f
+#define SV2_UPDATE_CHANNEL_SHARE_RATE_RATIO 2.0
+
+// Measured hashrate in H/s; falls back to shorter averages while they warm up.
+static float stratum_v2_measured_hash_rate(GlobalState *GLOBAL_STATE)
+{
+    float ghs = GLOBAL_STATE->SYSTEM_MODULE.hashrate_10m;
+    if (isnan(ghs) || ghs <= 0) ghs = GLOBAL_STATE->SYSTEM_MODULE.hashrate_1m;
+    if (isnan(ghs) || ghs <= 0) ghs = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.expected_hashrate;
+    if (isnan(ghs) || ghs <= 0) return 0;
+    return ghs * 1e9f;
+}
+
+// Send a non-share frame, serialized with the submit path.
+static int stratum_v2_send_frame(GlobalState *GLOBAL_STATE, const uint8_t *frame, int len)
+{
+    int ret = -1;
+    xSemaphoreTake(stratum_v2_batch.lock, portMAX_DELAY);
+    // Queued shares go first so the pool sees them under the old channel settings
+    stratum_v2_flush_batch_locked(GLOBAL_STATE);
+    if (GLOBAL_STATE->transport && GLOBAL_STATE->sv2_noise_ctx) {
+        ret = sv2_noise_send(GLOBAL_STATE->sv2_noise_ctx, GLOBAL_STATE->transport, frame, len);
+    }
+    xSemaphoreGive(stratum_v2_batch.lock);
+    return ret;
+}
+
+static void stratum_v2_maybe_update_channel(GlobalState *GLOBAL_STATE, sv2_conn_t *conn)
+{
+    if (!conn->channel_opened) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    int64_t since_us = now_us - conn->last_update_channel_us;
+    if (since_us < SV2_UPDATE_CHANNEL_MIN_INTERVAL_US) {
+        return;
+    }
+
+    // Standard channels split the board evenly; keep the board-level share
+    // rate at the target by spacing each channel's shares further apart
+    int channels = 0;
+    for (int i = 0; i < conn->std_channel_count; i++) {
+        if (conn->std_channels[i].opened) channels++;
+    }
+    if (channels == 0) {
+        channels = 1;
+    }
+
+    float hash_rate = stratum_v2_measured_hash_rate(GLOBAL_STATE) / channels;
+    if (hash_rate <= 0) {
+        return;
+    }
+    double target_interval_s = SV2_TARGET_SHARE_INTERVAL_S * channels;
+
+    // Share interval the current pool difficulty gives at the measured hashrate
+    double share_interval_s = GLOBAL_STATE->pool_difficulty * 4294967296.0 / hash_rate;
+    bool hashrate_moved = fabsf(hash_rate - conn->announced_hash_rate) >
+                          conn->announced_hash_rate * SV2_UPDATE_CHANNEL_HASHRATE_DELTA;
+    bool share_rate_off = share_interval_s > target_interval_s * SV2_UPDATE_CHANNEL_SHARE_RATE_RATIO ||
+                          share_interval_s < target_interval_s / SV2_UPDATE_CHANNEL_SHARE_RATE_RATIO;
+
+    // A pool that takes our maximum_target answers with SetTarget. While the
+    // difficulty is still the one the last request was sent at, the pool kept
+    // its own target; asking again every minute would not change that.
+    bool target_ignored = GLOBAL_STATE->pool_difficulty == conn->update_channel_difficulty;
+    if (target_ignored && since_us < conn->update_channel_backoff_us) {
+        share_rate_off = false;
+    }
+    if (!hashrate_moved && !share_rate_off && since_us < SV2_UPDATE_CHANNEL_MAX_INTERVAL_US) {
+        return;
+    }
+
+    // difficulty = hashes per share / 2^32
+    uint8_t maximum_target[32];
+    double difficulty = hash_rate * target_interval_s / 4294967296.0;
+    if (conn->max_target_rejected) {
+        memset(maximum_target, 0xFF, sizeof(maximum_target));
+    } else {
+        sv2_difficulty_to_target(difficulty, maximum_target);
+    }
+
+    // Extended channels have no std_channels entries, only conn->channel_id
+    int slots = conn->std_channel_count > 0 ? conn->std_channel_count : 1;
+    for (int i = 0; i < slots; i++) {
+        uint32_t channel_id = conn->channel_id;
+        if (conn->std_channel_count > 0) {
+            if (!conn->std_channels[i].opened) {
+                continue;
+            }
+            channel_id = conn->std_channels[i].channel_id;
+        }
+
+        uint8_t frame[SV2_FRAME_HEADER_SIZE + 40];
+        int len = sv2_build_update_channel(frame, sizeof(frame), channel_id, hash_rate, maximum_target);
+        if (len < 0 || stratum_v2_send_frame(GLOBAL_STATE, frame, len) != 0) {
+            ESP_LOGW(TAG, "Failed to send UpdateChannel");
+            return;
+        }
+    }
+
+    ESP_LOGI(TAG, "UpdateChannel x%d: %.1f GH/s each, share every %.1f s at diff %g (requested diff %g)",
+             channels, hash_rate / 1e9f, share_interval_s, GLOBAL_STATE->pool_difficulty,
+             conn->max_target_rejected ? 0.0 : difficulty);
+    conn->announced_hash_rate = hash_rate;
+    conn->last_update_channel_us = now_us;
+    conn->update_channel_difficulty = GLOBAL_STATE->pool_difficulty;
+    if (target_ignored) {
+        conn->update_channel_backoff_us *= 2;
+        if (conn->update_channel_backoff_us > SV2_UPDATE_CHANNEL_MAX_INTERVAL_US) {
+            conn->update_channel_backoff_us = SV2_UPDATE_CHANNEL_MAX_INTERVAL_US;
+        }
+    } else {
+        conn->update_channel_backoff_us = SV2_UPDATE_CHANNEL_MIN_INTERVAL_US;
+    }
+}
+
 // Handle SetTarget message
 static void stratum_v2_handle_set_target(GlobalState *GLOBAL_STATE, sv2_conn_t *conn,
                                          const uint8_t *payload, uint32_t len)
@@ -597,8 +1006,18 @@ static void stratum_v2_handle_set_target(GlobalState *GLOBAL_STATE, sv2_conn_t *
         return;
     }
 
-    memcpy(conn->target, max_target, 32);
     double pdiff = hash_to_pdiff(max_target);
+
+    sv2_std_channel_t *ch = stratum_v2_find_std_channel(conn, channel_id);
+    if (ch) {
+        ch->difficulty = pdiff;
+    }
+    if (ch && ch != &conn->std_channels[0]) {
+        ESP_LOGI(TAG, "Set channel %lu difficulty: %g", channel_id, pdiff);
+        return;
+    }
+
+    memcpy(conn->target, max_target, 32);
     ESP_LOGI(TAG, "Set pool difficulty: %g", pdiff);
     GLOBAL_STATE->pool_difficulty = pdiff;
     GLOBAL_STATE->new_set_mining_difficulty_msg = true;
@@ -647,6 +1066,14 @@ void stratum_v2_task(void *pvParameters)
         return;
     }
 
+    stratum_v2_batch_init(GLOBAL_STATE);
+
+    // One-time Noise setup; the first ephemeral key is generated in the
+    // background and overlaps with DNS and TCP connect
+    if (sv2_noise_init() != 0) {
+        ESP_LOGE(TAG, "Noise initialization failed");
+    }
+
     int retry_attempts = 0;
     bool use_fallback = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback;
     uint16_t pool_idx = use_fallback ? GLOBAL_STATE->SYSTEM_MODULE.secondary_pool_index : GLOBAL_STATE->SYSTEM_MODULE.primary_pool_index;
@@ -816,6 +1243,16 @@ void stratum_v2_task(void *pvParameters)
         conn->channel_type = channel_type;
         uint32_t setup_flags = (channel_type == SV2_CHANNEL_STANDARD) ? 0x01 : 0x00;
 
+        // Header-only jobs give one 2^32 x version-roll search space per job. On
+        // multi-chip boards open a standard channel per chip (up to a limit) so
+        // each job round covers one independent job per channel.
+        int std_channel_target = 0;
+        if (channel_type == SV2_CHANNEL_STANDARD) {
+            std_channel_target = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
+            if (std_channel_target > SV2_MAX_STANDARD_CHANNELS) std_channel_target = SV2_MAX_STANDARD_CHANNELS;
+            if (std_channel_target < 1) std_channel_target = 1;
+        }
+
         // 1. Send SetupConnection
         {
             const char *device_model = GLOBAL_STATE->DEVICE_CONFIG.family.asic.name;
@@ -826,7 +1263,7 @@ void stratum_v2_task(void *pvParameters)
                                                        stratum_url, port,
                                                        "bitaxe", device_model ? device_model : "",
                                                        "", "", setup_flags);
-            if (frame_len < 0 || sv2_noise_send(noise_ctx, transport, frame_buf, frame_len) != 0) {
+            if (frame_len < 0 || stratum_v2_send_frame(GLOBAL_STATE, frame_buf, frame_len) != 0) {
                 ESP_LOGE(TAG, "Failed to send SetupConnection");
                 snprintf(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info,
                          sizeof(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info), "SV2: Connection lost");
@@ -874,7 +1311,14 @@ void stratum_v2_task(void *pvParameters)
             uint16_t pool_idx = use_fallback ? GLOBAL_STATE->SYSTEM_MODULE.secondary_pool_index
                                              : GLOBAL_STATE->SYSTEM_MODULE.primary_pool_index;
             char *user = GLOBAL_STATE->SYSTEM_MODULE.pools[pool_idx].user;
-            float hash_rate = 1e12;
+            // Announce what the chips should do; UpdateChannel corrects it once measured
+            float hash_rate = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.expected_hashrate * 1e9f;
+            if (!(hash_rate > 0)) {
+                hash_rate = 1e12;
+            }
+            if (std_channel_target > 1) {
+                hash_rate /= std_channel_target;
+            }
             int frame_len;
 
             if (channel_type == SV2_CHANNEL_EXTENDED) {
@@ -887,7 +1331,7 @@ void stratum_v2_task(void *pvParameters)
                                                                     1, user ? user : "", hash_rate);
             }
 
-            if (frame_len < 0 || sv2_noise_send(noise_ctx, transport, frame_buf, frame_len) != 0) {
+            if (frame_len < 0 || stratum_v2_send_frame(GLOBAL_STATE, frame_buf, frame_len) != 0) {
                 ESP_LOGE(TAG, "Failed to send OpenMiningChannel");
                 snprintf(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info,
                          sizeof(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info), "SV2: Connection lost");
@@ -895,6 +1339,7 @@ void stratum_v2_task(void *pvParameters)
                 retry_attempts++;
                 continue;
             }
+            conn->announced_hash_rate = hash_rate;
         }
 
         // 4. Receive OpenMiningChannelSuccess
@@ -967,6 +1412,7 @@ void stratum_v2_task(void *pvParameters)
 
             conn->channel_id = channel_id;
             conn->channel_opened = true;
+            conn->last_update_channel_us = esp_timer_get_time();
             memcpy(conn->target, target, 32);
 
             double pdiff = hash_to_pdiff(target);
@@ -977,6 +1423,41 @@ void stratum_v2_task(void *pvParameters)
                      channel_id, group_channel_id,
                      channel_type == SV2_CHANNEL_EXTENDED ? SV2_CHANNEL_TYPE_EXTENDED : SV2_CHANNEL_TYPE_STANDARD);
             ESP_LOGI(TAG, "Set pool difficulty: %g", pdiff);
+
+            if (channel_type == SV2_CHANNEL_STANDARD) {
+                sv2_std_channel_t *primary = &conn->std_channels[0];
+                taskENTER_CRITICAL(&stratum_v2_channels_mux);
+                primary->channel_id = channel_id;
+                primary->request_id = request_id;
+                primary->difficulty = pdiff;
+                primary->opened = true;
+                conn->std_channel_count = 1;
+                taskEXIT_CRITICAL(&stratum_v2_channels_mux);
+            }
+        }
+
+        // 5. Open the remaining standard channels. Their Success/Error replies
+        // arrive interleaved with jobs for the first channel, so the receive
+        // loop handles them.
+        if (std_channel_target > 1) {
+            uint16_t pool_idx = use_fallback ? GLOBAL_STATE->SYSTEM_MODULE.secondary_pool_index
+                                             : GLOBAL_STATE->SYSTEM_MODULE.primary_pool_index;
+            char *user = GLOBAL_STATE->SYSTEM_MODULE.pools[pool_idx].user;
+            float hash_rate = conn->announced_hash_rate;
+
+            for (int i = 1; i < std_channel_target; i++) {
+                uint32_t request_id = (uint32_t)i + 1;
+                int frame_len = sv2_build_open_standard_mining_channel(frame_buf, SV2_MAX_FRAME_SIZE,
+                                                                       request_id, user ? user : "", hash_rate);
+                if (frame_len < 0 || stratum_v2_send_frame(GLOBAL_STATE, frame_buf, frame_len) != 0) {
+                    ESP_LOGW(TAG, "Failed to open standard channel %d, continuing with %d", i + 1, i);
+                    break;
+                }
+                taskENTER_CRITICAL(&stratum_v2_channels_mux);
+                conn->std_channels[i].request_id = request_id;
+                conn->std_channel_count = (uint8_t)(i + 1);
+                taskEXIT_CRITICAL(&stratum_v2_channels_mux);
+            }
         }
 
         // Connection successful, reset retry counter
@@ -1026,25 +1507,22 @@ void stratum_v2_task(void *pvParameters)
                         // most recent share in the ack, giving the cleanest available round trip.
                         // accepted_count is surfaced separately so the UI can flag batch acks,
                         // where the elapsed time also includes the pool's batching window.
+                        int channel = stratum_v2_channel_index(conn, channel_id);
                         int slot = last_sequence_number % SV2_SUBMIT_TIMING_SLOTS;
-                        int64_t submit_time_us = stratum_v2_submit_time_us[slot];
+                        int64_t submit_time_us = channel < 0 ? 0 : stratum_v2_submit_time_us[channel][slot];
                         if (submit_time_us > 0) {
                             float response_time_ms = (float)(esp_timer_get_time() - submit_time_us) / 1000.0f;
                             ESP_LOGI(TAG, "Shares accepted: %lu (%.1f ms)", accepted_count, response_time_ms);
                             GLOBAL_STATE->SYSTEM_MODULE.response_time = response_time_ms;
                             GLOBAL_STATE->SYSTEM_MODULE.response_share_batch = (uint16_t)accepted_count;
-                            stratum_v2_submit_time_us[slot] = 0;
+                            stratum_v2_submit_time_us[channel][slot] = 0;
                         } else {
                             ESP_LOGI(TAG, "Shares accepted: %lu", accepted_count);
                         }
                         for (uint32_t i = 0; i < accepted_count; i++) {
                             SYSTEM_notify_accepted_share(GLOBAL_STATE);
                         }
-                        uint32_t resolved = last_sequence_number + 1;  // 0-based seq -> count
-                        if (resolved > conn->resolved_shares) {
-                            conn->resolved_shares = resolved;
-                        }
-                        stratum_v2_update_pending_shares(GLOBAL_STATE);
+                        stratum_v2_resolve_shares(GLOBAL_STATE, conn, channel, last_sequence_number);
                     }
                     break;
                 }
@@ -1057,11 +1535,54 @@ void stratum_v2_task(void *pvParameters)
                                                       error_code, sizeof(error_code)) == 0) {
                         ESP_LOGW(TAG, "Share rejected: %s", error_code);
                         SYSTEM_notify_rejected_share(GLOBAL_STATE, error_code);
-                        uint32_t resolved = seq_num + 1;
-                        if (resolved > conn->resolved_shares) {
-                            conn->resolved_shares = resolved;
+                        stratum_v2_resolve_shares(GLOBAL_STATE, conn, stratum_v2_channel_index(conn, channel_id), seq_num);
+                    }
+                    break;
+                }
+
+                case SV2_MSG_OPEN_STANDARD_MINING_CHANNEL_SUCCESS: {
+                    uint32_t request_id, channel_id, group_channel_id;
+                    uint8_t target[32], prefix[32], prefix_len;
+                    if (sv2_parse_open_channel_success(recv_buf, hdr.msg_length, &request_id, &channel_id,
+                                                       target, prefix, &prefix_len, &group_channel_id) != 0) {
+                        ESP_LOGE(TAG, "Failed to parse OpenChannelSuccess");
+                        break;
+                    }
+                    for (int i = 1; i < conn->std_channel_count; i++) {
+                        sv2_std_channel_t *ch = &conn->std_channels[i];
+                        if (!ch->opened && ch->request_id == request_id) {
+                            taskENTER_CRITICAL(&stratum_v2_channels_mux);
+                            ch->channel_id = channel_id;
+                            ch->difficulty = hash_to_pdiff(target);
+                            ch->opened = true;
+                            taskEXIT_CRITICAL(&stratum_v2_channels_mux);
+                            ESP_LOGI(TAG, "Standard channel %d opened: channel_id=%lu, difficulty %g",
+                                     i + 1, channel_id, ch->difficulty);
+                            break;
                         }
-                        stratum_v2_update_pending_shares(GLOBAL_STATE);
+                    }
+                    break;
+                }
+
+                case SV2_MSG_OPEN_MINING_CHANNEL_ERROR: {
+                    uint32_t request_id;
+                    char error_code[64];
+                    if (sv2_parse_open_mining_channel_error(recv_buf, hdr.msg_length,
+                                                            &request_id, error_code, sizeof(error_code)) == 0) {
+                        ESP_LOGW(TAG, "Pool refused extra standard channel (request %lu): %s",
+                                 request_id, error_code);
+                    }
+                    break;
+                }
+
+                case SV2_MSG_UPDATE_CHANNEL_ERROR: {
+                    uint32_t channel_id;
+                    char error_code[64];
+                    if (sv2_parse_update_channel_error(recv_buf, hdr.msg_length,
+                                                       &channel_id, error_code, sizeof(error_code)) == 0) {
+                        // Keep reporting hashrate, but stop asking for a target ceiling
+                        ESP_LOGW(TAG, "UpdateChannel rejected: %s", error_code);
+                        conn->max_target_rejected = true;
                     }
                     break;
                 }
@@ -1070,6 +1591,8 @@ void stratum_v2_task(void *pvParameters)
                     ESP_LOGW(TAG, "Unknown SV2 message type: 0x%02x (len=%lu)", hdr.msg_type, hdr.msg_length);
                     break;
             }
+
+            stratum_v2_maybe_update_channel(GLOBAL_STATE, conn);
         }
     }
 
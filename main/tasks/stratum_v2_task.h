@@ -3,16 +3,19 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "sv2_protocol.h"
 
 typedef struct GlobalState GlobalState;
 
 void stratum_v2_task(void *pvParameters);
 void stratum_v2_close_connection(GlobalState *GLOBAL_STATE);
-int stratum_v2_submit_share(GlobalState *GLOBAL_STATE, uint32_t job_id, uint32_t nonce,
-                            uint32_t ntime, uint32_t version);
+int stratum_v2_submit_share(GlobalState *GLOBAL_STATE, uint32_t channel_id, uint32_t job_id,
+                            uint32_t nonce, uint32_t ntime, uint32_t version);
 int stratum_v2_submit_share_extended(GlobalState *GLOBAL_STATE, uint32_t job_id,
                                      uint32_t nonce, uint32_t ntime, uint32_t version,
                                      const uint8_t *extranonce, uint8_t extranonce_len);
 bool stratum_v2_is_extended_channel(GlobalState *GLOBAL_STATE);
+// Current job of the next standard channel in rotation, with that channel's difficulty
+bool stratum_v2_next_channel_job(GlobalState *GLOBAL_STATE, sv2_job_t *job, double *difficulty);
 
 #endif // STRATUM_V2_TASK_H
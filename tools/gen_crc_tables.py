@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Generate crc_tables.h, the lookup tables of the CRC kernels in components/asic/crc.c.
+
+CRC16 is CCITT (poly 0x1021, MSB first). CRC5 is the BM13xx x^5 + x^2 + 1,
+MSB first, run as an 8 bit register holding the CRC in its top five bits.
+Table k advances a byte by k further zero bytes, which is what slice-by-8
+needs; table 0 alone is the plain byte-at-a-time kernel.
+"""
+import sys
+
+SLICES = 8
+
+
+def crc16_byte(value):
+    crc = value << 8
+    for _ in range(8):
+        crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+    return crc & 0xFFFF
+
+
+def crc5_byte(value):
+    crc = value
+    for _ in range(8):
+        crc = ((crc << 1) ^ (0x05 << 3)) if crc & 0x80 else (crc << 1)
+    return crc & 0xFF
+
+
+def slices(first, shift):
+    tables = [first]
+    for _ in range(1, SLICES):
+        tables.append([shift(v) for v in tables[-1]])
+    return tables
+
+
+def emit(name, ctype, tables, width, per_line):
+    lines = [f'static const {ctype} {name}[{SLICES}][256] = {{']
+    for table in tables:
+        lines.append('    {')
+        for i in range(0, 256, per_line):
+            row = ', '.join(f'0x{v:0{width}X}' for v in table[i:i + per_line])
+            lines.append(f'        {row},')
+        lines.append('    },')
+    lines.append('};')
+    return lines
+
+
+def main(output_path):
+    crc16 = slices([crc16_byte(i) for i in range(256)],
+                   lambda v: ((v << 8) & 0xFFFF) ^ crc16_byte(v >> 8))
+    crc5 = slices([crc5_byte(i) for i in range(256)], crc5_byte)
+
+    lines = [
+        '// Generated by tools/gen_crc_tables.py, do not edit',
+        '#ifndef CRC_TABLES_H_',
+        '#define CRC_TABLES_H_',
+        '',
+        '#include <stdint.h>',
+        '',
+        f'#define CRC_TABLE_SLICES {SLICES}',
+        '',
+    ]
+    lines += emit('CRC16_TABLES', 'uint16_t', crc16, 4, 8)
+    lines.append('')
+    lines += emit('CRC5_TABLES', 'uint8_t', crc5, 2, 16)
+    lines += ['', '#endif /* CRC_TABLES_H_ */', '']
+
+    with open(output_path, 'w', encoding='utf-8') as f:
+        f.write('\n'.join(lines))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 2:
+        print(f"Usage: {sys.argv[0]} <output header>")
+        sys.exit(1)
+    main(sys.argv[1])
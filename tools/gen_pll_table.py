@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""Generate the precomputed BM13xx PLL settings included by components/asic/pll.c.
+
+The feedback divider ranges are read from the chip descriptors in components/asic
+and the frequency options from main/device_config.h, so the table follows the
+sources it is built from. The search below mirrors pll_search_parameters() in
+pll.c step for step, including its float rounding; the asic unit tests check
+every entry against the C search.
+"""
+import math
+import os
+import re
+import struct
+import sys
+
+FREQ_MULT = 25.0
+EPSILON = 0.0001
+FLT_MAX = 3.4028234663852886e38
+
+STEP = 6.25          # MHz, the grid the frequency ramp walks
+GRID_FIRST = 8       # 50 MHz, the lowest frequency the firmware asks for
+GRID_LAST = 160      # 1000 MHz, well above the highest user setting
+
+
+def f32(value):
+    return struct.unpack('f', struct.pack('f', value))[0]
+
+
+def c_round(value):
+    # C round() goes half away from zero, Python's round() goes to even
+    return int(math.floor(value + 0.5))
+
+
+def search(target_freq, fb_divider_min, fb_divider_max):
+    target_freq = f32(target_freq)
+    best = (0, 0, 0, 0, 0.0)
+    min_diff = f32(FLT_MAX)
+    min_vco_freq = f32(FLT_MAX)
+    min_postdiv = 0xFFFF
+
+    for refdiv in range(2, 0, -1):
+        for postdiv1 in range(7, 0, -1):
+            for postdiv2 in range(7, 0, -1):
+                divider = refdiv * postdiv1 * postdiv2
+                fb_divider = c_round(target_freq / FREQ_MULT * divider) & 0xFFFF
+                if postdiv1 > postdiv2 and fb_divider_min <= fb_divider <= fb_divider_max:
+                    new_freq = f32(FREQ_MULT * fb_divider / divider)
+                    curr_diff = f32(abs(f32(target_freq - new_freq)))
+                    vco_freq = f32(FREQ_MULT * fb_divider / refdiv)
+                    diff_delta = abs(f32(curr_diff - min_diff))
+                    if (curr_diff < min_diff or
+                            (diff_delta < f32(EPSILON) and vco_freq < min_vco_freq) or
+                            (diff_delta < f32(EPSILON) and abs(f32(vco_freq - min_vco_freq)) < f32(EPSILON) and
+                             postdiv1 * postdiv2 < min_postdiv)):
+                        min_diff = curr_diff
+                        min_vco_freq = vco_freq
+                        min_postdiv = postdiv1 * postdiv2
+                        best = (fb_divider, refdiv, postdiv1, postdiv2, new_freq)
+
+    return best
+
+
+def read(path):
+    with open(path, encoding='utf-8') as f:
+        return f.read()
+
+
+def fb_ranges(asic_dir):
+    ranges = set()
+    for name in sorted(os.listdir(asic_dir)):
+        if not re.fullmatch(r'bm\d+\.c', name):
+            continue
+        source = read(os.path.join(asic_dir, name))
+        defines = dict(re.findall(r'#define\s+(\w+)\s+(\d+)', source))
+
+        def value(token):
+            return int(defines.get(token, token))
+
+        fb_min = re.search(r'\.pll_fb_min\s*=\s*(\w+)', source)
+        fb_max = re.search(r'\.pll_fb_max\s*=\s*(\w+)', source)
+        if fb_min and fb_max:
+            ranges.add((value(fb_min.group(1)), value(fb_max.group(1))))
+    return sorted(ranges)
+
+
+def frequency_options(device_config_path):
+    options = set()
+    # BM1370_FRQUENCY_XP_OPTIONS is spelled that way in device_config.h
+    for values in re.findall(r'_FR\w*_OPTIONS\[\]\s*=\s*\{([^}]*)\}', read(device_config_path)):
+        options.update(int(v) for v in values.replace(' ', '').split(',') if v and v != '0')
+    return options
+
+
+def off_grid(options):
+    grid = {STEP * i for i in range(GRID_FIRST, GRID_LAST + 1)}
+    return sorted(f for f in options if f not in grid)
+
+
+def entry(setting):
+    fb_divider, refdiv, postdiv1, postdiv2, frequency = setting
+    return '{ %3d, %d, %d, %d, %sf }' % (fb_divider, refdiv, postdiv1, postdiv2, repr(frequency))
+
+
+def generate(asic_dir, device_config_path, output_path):
+    ranges = fb_ranges(asic_dir)
+    extra = off_grid(frequency_options(device_config_path))
+
+    lines = [
+        '// Generated by tools/gen_pll_table.py, do not edit',
+        '#ifndef PLL_TABLE_H_',
+        '#define PLL_TABLE_H_',
+        '',
+        '#define PLL_TABLE_STEP %sf' % repr(STEP),
+        '#define PLL_TABLE_GRID_FIRST %d' % GRID_FIRST,
+        '#define PLL_TABLE_GRID_LAST %d' % GRID_LAST,
+        '#define PLL_TABLE_GRID_SIZE %d' % (GRID_LAST - GRID_FIRST + 1),
+        '#define PLL_TABLE_EXTRA_SIZE %d' % len(extra),
+        '#define PLL_TABLE_COUNT %d' % len(ranges),
+        '',
+        'typedef struct',
+        '{',
+        '    uint16_t fb_divider_min;',
+        '    uint16_t fb_divider_max;',
+        '    pll_setting_t grid[PLL_TABLE_GRID_SIZE];',
+        '    pll_setting_t extra[PLL_TABLE_EXTRA_SIZE];',
+        '} pll_table_t;',
+        '',
+        '// Off-grid frequency options, in the order of pll_table_t.extra',
+        'static const float PLL_TABLE_EXTRA_FREQUENCIES[PLL_TABLE_EXTRA_SIZE] = { %s };' %
+            ', '.join('%sf' % repr(float(f)) for f in extra),
+        '',
+        'static const pll_table_t PLL_TABLES[PLL_TABLE_COUNT] = {',
+    ]
+
+    for fb_min, fb_max in ranges:
+        lines.append('    {')
+        lines.append('        .fb_divider_min = %d,' % fb_min)
+        lines.append('        .fb_divider_max = %d,' % fb_max)
+        lines.append('        .grid = {')
+        for i in range(GRID_FIRST, GRID_LAST + 1):
+            lines.append('            %s, // %g MHz' % (entry(search(STEP * i, fb_min, fb_max)), STEP * i))
+        lines.append('        },')
+        lines.append('        .extra = {')
+        for f in extra:
+            lines.append('            %s, // %g MHz' % (entry(search(f, fb_min, fb_max)), f))
+        lines.append('        },')
+        lines.append('    },')
+
+    lines += ['};', '', '#endif /* PLL_TABLE_H_ */', '']
+
+    with open(output_path, 'w', encoding='utf-8') as f:
+        f.write('\n'.join(lines))
+
+    print(f"Generated {output_path}: {len(ranges)} PLL ranges, {len(extra)} off-grid options")
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 4:
+        print(f"Usage: {sys.argv[0]} <asic component dir> <device_config.h> <output header>")
+        sys.exit(1)
+    generate(sys.argv[1], sys.argv[2], sys.argv[3])